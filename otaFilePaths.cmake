@@ -29,9 +29,11 @@ set( OTA_SOURCES
     "${CMAKE_CURRENT_LIST_DIR}/source/include/ota_private.h"
     "${CMAKE_CURRENT_LIST_DIR}/source/include/ota_interface_private.h"
     "${CMAKE_CURRENT_LIST_DIR}/source/include/ota_base64_private.h"
+    "${CMAKE_CURRENT_LIST_DIR}/source/include/ota_json_index_private.h"
     "${CMAKE_CURRENT_LIST_DIR}/source/ota.c"
     "${CMAKE_CURRENT_LIST_DIR}/source/ota_interface.c"
     "${CMAKE_CURRENT_LIST_DIR}/source/ota_base64.c"
+    "${CMAKE_CURRENT_LIST_DIR}/source/ota_json_index.c"
     ${JSON_SOURCES}
     ${TINYCBOR_SOURCES}
 )
@@ -93,7 +93,8 @@ typedef enum OtaErr
     OtaErrUserAbort,              /*!< @brief User aborted the active OTA. */
     OtaErrFailedToEncodeCbor,     /*!< @brief Failed to encode CBOR object for requesting data block from streaming service. */
     OtaErrFailedToDecodeCbor,     /*!< @brief Failed to decode CBOR object from streaming service response. */
-    OtaErrActivateFailed          /*!< @brief Failed to activate the new image. */
+    OtaErrActivateFailed,         /*!< @brief Failed to activate the new image. */
+    OtaErrFailedToDecodeJson      /*!< @brief Failed to decode JSON object from streaming service response. */
 } OtaErr_t;
 
 /**
@@ -101,8 +102,6 @@ typedef enum OtaErr
  * @brief OTA Agent states.
  *
  * The current state of the OTA Task (OTA Agent).
- *
- * @note There is currently support only for a single OTA context.
  */
 typedef enum OtaState
 {
@@ -166,6 +165,16 @@ typedef enum OtaJobEvent
     OtaLastJobEvent = OtaJobEventStartTest
 } OtaJobEvent_t;
 
+/**
+ * @ingroup ota_enum_types
+ * @brief State of the connection used by the agent, see @ref OTA_NotifyConnectionState.
+ */
+typedef enum OtaConnectionState
+{
+    OtaConnectionDown = 0, /*!< @brief The connection was lost. */
+    OtaConnectionUp        /*!< @brief The connection is established. */
+} OtaConnectionState_t;
+
 /**
  * @ingroup ota_enum_types
  * @brief Gives the status of the job operation.
@@ -181,6 +190,59 @@ typedef enum
     NumJobStatusMappings
 } OtaJobStatus_t;
 
+/**
+ * @ingroup ota_enum_types
+ * @brief Return status of the job document index functions.
+ */
+typedef enum OtaJobDocIndexStatus
+{
+    OtaJobDocIndexSuccess = 0,   /*!< @brief The key was found or the index was built. */
+    OtaJobDocIndexNullParameter, /*!< @brief A required parameter was NULL or empty. */
+    OtaJobDocIndexNotFound,      /*!< @brief The key path is not in the document. */
+    OtaJobDocIndexMalformedDoc,  /*!< @brief The document is not a JSON object that can be indexed. */
+    OtaJobDocIndexFull           /*!< @brief The key path is not in the index but the index ran out of entries while building. */
+} OtaJobDocIndexStatus_t;
+
+/**
+ * @ingroup ota_struct_types
+ * @brief One key/value pair of an indexed job document.
+ *
+ * Key and value point into the original JSON message. String values exclude
+ * the surrounding quotes, object and array values include their brackets, the
+ * same spans JSON_Search returns.
+ */
+typedef struct OtaJobDocIndexEntry
+{
+    const char * pKey;   /*!< @brief Key of this member, without quotes. */
+    size_t keyLength;    /*!< @brief Length of the key in bytes. */
+    const char * pValue; /*!< @brief Value of this member. */
+    size_t valueLength;  /*!< @brief Length of the value in bytes. */
+    uint32_t pathHash;   /*!< @brief Hash of the full dotted key path of this member. */
+    uint16_t parent;     /*!< @brief Index of the enclosing object member or OTA_JOB_DOC_INDEX_NO_PARENT. */
+} OtaJobDocIndexEntry_t;
+
+/**
+ * @brief Parent value for members of the outermost object.
+ */
+#define OTA_JOB_DOC_INDEX_NO_PARENT    ( 0xFFFFU )
+
+/**
+ * @ingroup ota_struct_types
+ * @brief Index of the members of a job document.
+ *
+ * Every member of every nested object is recorded with its full key path, so
+ * a field can be looked up with @ref OTA_JobDocIndexLookup using the same
+ * dotted query syntax as coreJSON without scanning the document again.
+ * Elements of arrays are not indexed.
+ */
+typedef struct OtaJobDocIndex
+{
+    OtaJobDocIndexEntry_t entries[ otaconfigMAX_JOB_DOC_INDEX_ENTRIES ]; /*!< @brief Indexed members in document order. */
+    uint16_t buckets[ 2U * otaconfigMAX_JOB_DOC_INDEX_ENTRIES ];         /*!< @brief Open addressed hash table of entry index + 1, 0 if empty. */
+    uint16_t numEntries;                                                 /*!< @brief Number of valid entries. */
+    bool full;                                                           /*!< @brief The document had more members than could be indexed. */
+} OtaJobDocIndex_t;
+
 /**
  * @ingroup ota_struct_types
  * @brief OTA Job document.
@@ -191,14 +253,15 @@ typedef enum
  */
 typedef struct OtaJobDocument
 {
-    uint8_t * pJobDocJson;     /*!< @brief Job document in JSON format. */
-    size_t jobDocLength;       /*!< @brief Job document length in bytes. */
-    uint8_t * pJobId;          /*!< @brief Job ID associated with the job document. */
-    size_t jobIdLength;        /*!< @brief Length of job ID in bytes. */
-    OtaJobParseErr_t parseErr; /*!< @brief Job parsing status. */
-    OtaJobStatus_t status;     /*!< @brief Job status. */
-    int32_t reason;            /*!< @brief Job status reason. */
-    int32_t subReason;         /*!< @brief Job status subreason. */
+    uint8_t * pJobDocJson;                 /*!< @brief Job document in JSON format. */
+    size_t jobDocLength;                   /*!< @brief Job document length in bytes. */
+    uint8_t * pJobId;                      /*!< @brief Job ID associated with the job document. */
+    size_t jobIdLength;                    /*!< @brief Length of job ID in bytes. */
+    const OtaJobDocIndex_t * pJobDocIndex; /*!< @brief Index of the whole job message, NULL if it could not be built or otaconfigCUSTOM_JOB_DOC_INDEX is 0. */
+    OtaJobParseErr_t parseErr;             /*!< @brief Job parsing status. */
+    OtaJobStatus_t status;                 /*!< @brief Job status. */
+    int32_t reason;                        /*!< @brief Job status reason. */
+    int32_t subReason;                     /*!< @brief Job status subreason. */
 } OtaJobDocument_t;
 
 /*------------------------- OTA callbacks --------------------------*/
@@ -278,12 +341,74 @@ typedef struct OtaAppBuffer
     uint16_t authSchemeSize;     /*!< @brief Maximum size of the auth scheme. */
 } OtaAppBuffer_t;
 
+/**
+ * @ingroup ota_struct_types
+ * @brief Backoff of retried requests.
+ *
+ * See otaconfigREQUEST_BACKOFF_BASE_MS and otaconfigJOB_START_DELAY_MAX_MS.
+ */
+typedef struct OtaRequestBackoff
+{
+    uint32_t baseMs;          /*!< @brief Shortest wait before a failed job request is retried. */
+    uint32_t maxMs;           /*!< @brief Longest wait before a failed request is retried. */
+    uint32_t startDelayMaxMs; /*!< @brief Longest random delay before the download of a new job starts, 0 for none. */
+} OtaRequestBackoff_t;
+
 /**
  * @ingroup ota_private_struct_types
- * @brief  The OTA agent is a singleton today. The structure keeps it nice and organized.
+ * @brief The OTA agent context.
+ *
+ * Every agent keeps all of its state in one of these. The OTA_*Ctx functions
+ * take it as their first argument, and the other functions of the API use a
+ * default context inside the library.
  */
+typedef struct OtaAgentContext OtaAgentContext_t;
 
-typedef struct OtaAgentContext
+/**
+ * @brief Represents the OTA control interface functions.
+ *
+ * The functions in this structure are used for the control operations
+ * during over the air updates like OTA job status updates.
+ */
+typedef struct
+{
+    OtaErr_t ( * requestJob )( OtaAgentContext_t * pAgentCtx ); /*!< Request for the next available OTA job from the job service. */
+    OtaErr_t ( * updateJobStatus )( OtaAgentContext_t * pAgentCtx,
+                                    OtaJobStatus_t status,
+                                    int32_t reason,
+                                    int32_t subReason );           /*!< Updates the OTA job status with information like in progress, completion, or failure. */
+    OtaErr_t ( * cleanup )( const OtaAgentContext_t * pAgentCtx ); /*!< Cleanup related to OTA control plane. */
+} OtaControlInterface_t;
+
+/**
+ * @brief Represents the OTA data interface functions.
+ *
+ * The functions in this structure are used for the data operations
+ * during over the air updates like requesting file blocks.
+ */
+typedef struct
+{
+    OtaErr_t ( * initFileTransfer )( OtaAgentContext_t * pAgentCtx ); /*!< Initialize file transfer. */
+    OtaErr_t ( * requestFileBlock )( OtaAgentContext_t * pAgentCtx ); /*!< Request File block. */
+    OtaErr_t ( * decodeFileBlock )( OtaAgentContext_t * pAgentCtx,
+                                    const uint8_t * pMessageBuffer,
+                                    size_t messageSize,
+                                    int32_t * pFileId,
+                                    int32_t * pBlockId,
+                                    int32_t * pBlockSize,
+                                    uint8_t ** pPayload,
+                                    size_t * pPayloadSize );       /*!< Decode a cbor encoded fileblock. */
+    OtaErr_t ( * cleanup )( const OtaAgentContext_t * pAgentCtx ); /*!< Cleanup related to OTA data plane. */
+} OtaDataInterface_t;
+
+/**
+ * @ingroup ota_private_struct_types
+ * @brief The members of the OTA agent context.
+ *
+ * A context must be zero-initialized before it is passed to @ref OTA_InitCtx
+ * for the first time.
+ */
+struct OtaAgentContext
 {
     OtaState_t state;                                      /*!< State of the OTA agent. */
     uint8_t pThingName[ otaconfigMAX_THINGNAME_LEN + 1U ]; /*!< Thing name + zero terminator. */
@@ -295,12 +420,45 @@ typedef struct OtaAgentContext
     uint32_t timestampFromJob;                             /*!< Timestamp received from the latest job document. */
     OtaImageState_t imageState;                            /*!< The current application image state. */
     uint32_t numOfBlocksToReceive;                         /*!< Number of data blocks to receive per data request. */
-    OtaAgentStatistics_t statistics;                       /*!< The OTA agent statistics block. */
+    OtaStatisticsCounters_t statistics;                    /*!< The OTA agent statistics block. */
     uint32_t requestMomentum;                              /*!< The number of requests sent before a response was received. */
     OtaInterfaces_t * pOtaInterface;                       /*!< Collection of all interfaces used by the agent. */
     OtaAppCallback_t OtaAppCallback;                       /*!< OTA App callback. */
     uint8_t unsubscribeOnShutdown;                         /*!< Flag to indicate if unsubscribe from job topics should be done at shutdown. */
-} OtaAgentContext_t;
+    OtaControlInterface_t controlInterface;                /*!< Control plane functions of the configured protocol. */
+    OtaDataInterface_t dataInterface;                      /*!< Data plane functions of the protocol selected for the job. */
+    uint8_t pJobNameBuffer[ OTA_JOB_ID_MAX_SIZE ];         /*!< Buffer to store job name. */
+    uint8_t pProtocolBuffer[ OTA_PROTOCOL_BUFFER_SIZE ];   /*!< Buffer to store data protocol. */
+    Sig256_t sig256Buffer;                                 /*!< Buffer to store key file signature. */
+    #if ( otaconfigCUSTOM_JOB_DOC_INDEX == 1U )
+        OtaJobDocIndex_t jobDocIndex;                      /*!< Index of the last custom job document. */
+    #endif
+    uint32_t requestTimerPending;                          /*!< Non-zero while a RequestTimer event is queued. */
+    uint32_t requestFileBlockPending;                      /*!< Non-zero while a RequestFileBlock event is queued. */
+    uint32_t httpCurrentBlock;                             /*!< Next block to request and decode over HTTP. */
+    uint32_t requestTimeoutMs;                             /*!< Timeout of the file block request timer. */
+    uint32_t requestSentTimeMs;                            /*!< Time the last file block request that was not a repeat was sent. */
+    uint32_t smoothedRttMs;                                /*!< Smoothed file block request round trip time, zero until the first sample. */
+    uint32_t rttVariationMs;                               /*!< Variation of the file block request round trip time. */
+    bool rttSamplePending;                                 /*!< Whether the next block received gives a round trip time sample. */
+    uint32_t nextMissingBlock;                             /*!< Lowest block of the current file that may still be missing. */
+    uint32_t blocksPastGap;                                /*!< Number of blocks received past nextMissingBlock. */
+    bool gapRetransmitted;                                 /*!< Whether nextMissingBlock was already requested again. */
+    bool fastRetransmitPending;                            /*!< Whether a missing block should be requested again right away. */
+    uint32_t retransmitNumBlocks;                          /*!< Number of missing blocks the next request asks for after a gap, zero for a full request. */
+    OtaRequestBackoff_t requestBackoff;                    /*!< Backoff of retried requests. */
+    uint32_t retryDelayMs;                                 /*!< Wait before the last retry, zero until a request is retried. */
+    uint32_t randomState;                                  /*!< State of the generator of random waits. */
+    OtaMqttCache_t mqttCache;                              /*!< MQTT topics and request prefix of the active job. */
+    uint32_t progressReportTimeMs;                         /*!< Time the download progress was last reported. */
+    uint32_t progressReportPercent;                        /*!< Download progress in percent at the last report. */
+    bool progressStatusPending;                            /*!< Whether a download progress status waits to be published. */
+    uint32_t connectionGeneration;                         /*!< Incremented by each connection state notification. */
+    uint32_t connectionDown;                               /*!< Nonzero while the connection is down. */
+    uint32_t controlEventsPending;                         /*!< Number of control events signaled and not received yet. */
+    OtaEventMsg_t deferredEvents[ otaconfigMAX_EVENT_BATCH_SIZE ]; /*!< Events of a batch that was ended early for a control event. */
+    uint32_t numDeferredEvents;                            /*!< Number of events in deferredEvents. */
+};
 
 /*------------------------- OTA Public API --------------------------*/
 
@@ -308,8 +466,9 @@ typedef struct OtaAgentContext
  * @brief OTA Agent initialization function.
  *
  * Initialize the OTA engine by starting the OTA Agent ("OTA Task") in the system. This function must
- * be called with the connection client context before calling @ref OTA_CheckForUpdate. Only one
- * OTA Agent may exist.
+ * be called with the connection client context before calling @ref OTA_CheckForUpdate. This
+ * function and the other functions without a context argument use the default agent context. Use
+ * @ref OTA_InitCtx to run more than one agent.
  *
  * @param[in] pOtaBuffer Buffers used by the agent to store different params.
  * @param[in] pOtaInterfaces A pointer to the OS context.
@@ -327,15 +486,39 @@ OtaErr_t OTA_Init( OtaAppBuffer_t * pOtaBuffer,
                    OtaAppCallback_t OtaAppCallback );
 /* @[declare_ota_init] */
 
+/**
+ * @brief OTA Agent initialization function for a given agent context.
+ *
+ * Same as @ref OTA_Init, for the agent that keeps its state in pAgentCtx.
+ * Any number of agents can run in one process, each with its own context,
+ * interfaces and event processing task.
+ *
+ * @param[in] pAgentCtx The agent context. It must be zero-initialized before
+ * the first call to @ref OTA_InitCtx.
+ * @param[in] pOtaBuffer Buffers used by the agent to store different params.
+ * @param[in] pOtaInterfaces A pointer to the OS context.
+ * @param[in] pThingName A pointer to a C string holding the Thing name.
+ * @param[in] OtaAppCallback Static callback function for when an OTA job is complete.
+ * @return OtaErrNone if the agent was initialized, otherwise an error code.
+ */
+/* @[declare_ota_initctx] */
+OtaErr_t OTA_InitCtx( OtaAgentContext_t * pAgentCtx,
+                      OtaAppBuffer_t * pOtaBuffer,
+                      OtaInterfaces_t * pOtaInterfaces,
+                      const uint8_t * pThingName,
+                      OtaAppCallback_t OtaAppCallback );
+/* @[declare_ota_initctx] */
+
 /**
  * @brief Signal to the OTA Agent to shut down.
  *
  * Signals the OTA agent task to shut down. The OTA agent will unsubscribe from all MQTT job
  * notification topics, stop in progress OTA jobs, if any, and clear all resources.
  *
- * @param[in] ticksToWait The number of ticks to wait for the OTA Agent to complete the shutdown process.
+ * @param[in] timeoutMs The number of milliseconds to wait for the OTA Agent to complete the shutdown process.
  * If this is set to zero, the function will return immediately without waiting. The actual state is
- * returned to the caller.
+ * returned to the caller. The wait blocks on OtaEventInterface_t::waitShutdown and uses no CPU. If
+ * the OS interface does not provide it, the function returns without waiting.
  *
  * @param[in] unsubscribeFlag Flag to indicate if unsubscribe operations should be performed from the job topics when
  * shutdown is called. If the flag is 0 then unsubscribe operations are not called for job topics If application
@@ -345,10 +528,26 @@ OtaErr_t OTA_Init( OtaAppBuffer_t * pOtaBuffer,
  * A normal shutdown will return OtaAgentStateNotReady. Otherwise, refer to the OtaState_t enum for details.
  */
 /* @[declare_ota_shutdown] */
-OtaState_t OTA_Shutdown( uint32_t ticksToWait,
+OtaState_t OTA_Shutdown( uint32_t timeoutMs,
                          uint8_t unsubscribeFlag );
 /* @[declare_ota_shutdown] */
 
+/**
+ * @brief Signal the OTA Agent of a given agent context to shut down.
+ *
+ * Same as @ref OTA_Shutdown, for the agent of pAgentCtx.
+ *
+ * @param[in] pAgentCtx The agent context.
+ * @param[in] timeoutMs The number of milliseconds to wait for the agent to shut down.
+ * @param[in] unsubscribeFlag Flag to indicate if unsubscribe operations should be performed from the job topics.
+ * @return One of the OTA agent states from the OtaState_t enum.
+ */
+/* @[declare_ota_shutdownctx] */
+OtaState_t OTA_ShutdownCtx( OtaAgentContext_t * pAgentCtx,
+                            uint32_t timeoutMs,
+                            uint8_t unsubscribeFlag );
+/* @[declare_ota_shutdownctx] */
+
 /**
  * @brief Get the current state of the OTA agent.
  *
@@ -358,6 +557,16 @@ OtaState_t OTA_Shutdown( uint32_t ticksToWait,
 OtaState_t OTA_GetState( void );
 /* @[declare_ota_getstate] */
 
+/**
+ * @brief Get the current state of the OTA agent of a given agent context.
+ *
+ * @param[in] pAgentCtx The agent context.
+ * @return The current state of the OTA agent.
+ */
+/* @[declare_ota_getstatectx] */
+OtaState_t OTA_GetStateCtx( const OtaAgentContext_t * pAgentCtx );
+/* @[declare_ota_getstatectx] */
+
 /**
  * @brief Activate the newest MCU image received via OTA.
  *
@@ -373,6 +582,18 @@ OtaState_t OTA_GetState( void );
 OtaErr_t OTA_ActivateNewImage( void );
 /* @[declare_ota_activatenewimage] */
 
+/**
+ * @brief Activate the newest MCU image received by the agent of a given agent context.
+ *
+ * Same as @ref OTA_ActivateNewImage, for the agent of pAgentCtx.
+ *
+ * @param[in] pAgentCtx The agent context.
+ * @return OtaErrNone if successful, otherwise an error code.
+ */
+/* @[declare_ota_activatenewimagectx] */
+OtaErr_t OTA_ActivateNewImageCtx( OtaAgentContext_t * pAgentCtx );
+/* @[declare_ota_activatenewimagectx] */
+
 /**
  * @brief Set the state of the current MCU image.
  *
@@ -389,6 +610,20 @@ OtaErr_t OTA_ActivateNewImage( void );
 OtaErr_t OTA_SetImageState( OtaImageState_t state );
 /* @[declare_ota_setimagestate] */
 
+/**
+ * @brief Set the state of the current MCU image for the agent of a given agent context.
+ *
+ * Same as @ref OTA_SetImageState, for the agent of pAgentCtx.
+ *
+ * @param[in] pAgentCtx The agent context.
+ * @param[in] state The state to set of the OTA image.
+ * @return OtaErrNone if successful, otherwise an error code.
+ */
+/* @[declare_ota_setimagestatectx] */
+OtaErr_t OTA_SetImageStateCtx( OtaAgentContext_t * pAgentCtx,
+                               OtaImageState_t state );
+/* @[declare_ota_setimagestatectx] */
+
 /**
  * @brief Get the state of the currently running MCU image.
  *
@@ -401,6 +636,16 @@ OtaErr_t OTA_SetImageState( OtaImageState_t state );
 OtaImageState_t OTA_GetImageState( void );
 /* @[declare_ota_getimagestate] */
 
+/**
+ * @brief Get the image state of the agent of a given agent context.
+ *
+ * @param[in] pAgentCtx The agent context.
+ * @return The state of the agent's OTA image.
+ */
+/* @[declare_ota_getimagestatectx] */
+OtaImageState_t OTA_GetImageStateCtx( const OtaAgentContext_t * pAgentCtx );
+/* @[declare_ota_getimagestatectx] */
+
 /**
  * @brief Request for the next available OTA job from the job service.
  *
@@ -411,6 +656,16 @@ OtaImageState_t OTA_GetImageState( void );
 OtaErr_t OTA_CheckForUpdate( void );
 /* @[declare_ota_checkforupdate] */
 
+/**
+ * @brief Request the next available OTA job for the agent of a given agent context.
+ *
+ * @param[in] pAgentCtx The agent context.
+ * @return OtaErrNone if successful, otherwise an error code.
+ */
+/* @[declare_ota_checkforupdatectx] */
+OtaErr_t OTA_CheckForUpdateCtx( OtaAgentContext_t * pAgentCtx );
+/* @[declare_ota_checkforupdatectx] */
+
 /**
  * @brief Suspend OTA agent operations .
  *
@@ -421,6 +676,16 @@ OtaErr_t OTA_CheckForUpdate( void );
 OtaErr_t OTA_Suspend( void );
 /* @[declare_ota_suspend] */
 
+/**
+ * @brief Suspend the OTA agent of a given agent context.
+ *
+ * @param[in] pAgentCtx The agent context.
+ * @return OtaErrNone if successful, otherwise an error code.
+ */
+/* @[declare_ota_suspendctx] */
+OtaErr_t OTA_SuspendCtx( OtaAgentContext_t * pAgentCtx );
+/* @[declare_ota_suspendctx] */
+
 /**
  * @brief Resume OTA agent operations .
  *
@@ -431,6 +696,77 @@ OtaErr_t OTA_Suspend( void );
 OtaErr_t OTA_Resume( void );
 /* @[declare_ota_resume] */
 
+/**
+ * @brief Resume the OTA agent of a given agent context.
+ *
+ * @param[in] pAgentCtx The agent context.
+ * @return OtaErrNone if successful, otherwise an error code.
+ */
+/* @[declare_ota_resumectx] */
+OtaErr_t OTA_ResumeCtx( OtaAgentContext_t * pAgentCtx );
+/* @[declare_ota_resumectx] */
+
+/**
+ * @brief Set the backoff of retried requests.
+ *
+ * Takes effect from the next retry. Call it after @ref OTA_Init, which sets the
+ * backoff to the configured defaults.
+ *
+ * @param[in] pBackoff The backoff. baseMs must not be 0 and maxMs must not be
+ * less than baseMs.
+ *
+ * @return OtaErrNone if the backoff was set, OtaErrInvalidArg otherwise.
+ */
+/* @[declare_ota_setrequestbackoff] */
+OtaErr_t OTA_SetRequestBackoff( const OtaRequestBackoff_t * pBackoff );
+/* @[declare_ota_setrequestbackoff] */
+
+/**
+ * @brief Set the backoff of retried requests of the agent of a given agent context.
+ *
+ * @param[in] pAgentCtx The agent context.
+ * @param[in] pBackoff The backoff.
+ * @return OtaErrNone if the backoff was set, OtaErrInvalidArg otherwise.
+ */
+/* @[declare_ota_setrequestbackoffctx] */
+OtaErr_t OTA_SetRequestBackoffCtx( OtaAgentContext_t * pAgentCtx,
+                                   const OtaRequestBackoff_t * pBackoff );
+/* @[declare_ota_setrequestbackoffctx] */
+
+/**
+ * @brief Notify the OTA agent that the connection was lost or established.
+ *
+ * While the connection is down the agent sends no requests. Request timeouts do not
+ * count against otaconfigMAX_NUM_REQUEST_MOMENTUM, so a download is not aborted
+ * for lack of a connection. Once the connection is up again, the agent subscribes
+ * to its topics again and requests the missing blocks right away instead of waiting
+ * for the request timeout. A job that is not downloaded yet is requested or started
+ * after a random delay, see @ref OTA_SetRequestBackoff, so that devices that lost
+ * the connection together do not all send their requests at once. Call this function
+ * from the connection event handler of the MQTT client. It may be called from any task.
+ *
+ * @param[in] state The new state of the connection.
+ *
+ * @return OtaErrNone if the agent was notified, OtaErrInvalidArg if the state is not
+ * valid, OtaErrSignalEventFailed if the agent could not be told to resume its requests.
+ */
+/* @[declare_ota_notifyconnectionstate] */
+OtaErr_t OTA_NotifyConnectionState( OtaConnectionState_t state );
+/* @[declare_ota_notifyconnectionstate] */
+
+/**
+ * @brief Notify the OTA agent of a given agent context that the connection was lost or established.
+ *
+ * @param[in] pAgentCtx The agent context.
+ * @param[in] state The new state of the connection.
+ * @return OtaErrNone if the agent was notified, OtaErrInvalidArg if the state is not
+ * valid, OtaErrSignalEventFailed if the agent could not be told to resume its requests.
+ */
+/* @[declare_ota_notifyconnectionstatectx] */
+OtaErr_t OTA_NotifyConnectionStateCtx( OtaAgentContext_t * pAgentCtx,
+                                       OtaConnectionState_t state );
+/* @[declare_ota_notifyconnectionstatectx] */
+
 /**
  * @brief OTA agent event processing loop.
  *
@@ -446,6 +782,18 @@ OtaErr_t OTA_Resume( void );
 void OTA_EventProcessingTask( void * pUnused );
 /* @[declare_ota_eventprocessingtask] */
 
+/**
+ * @brief OTA agent event processing loop for a given agent context.
+ *
+ * Same as @ref OTA_EventProcessingTask, for the agent of pAgentCtx. Each
+ * agent needs its own task running this loop.
+ *
+ * @param[in] pAgentCtx The agent context.
+ */
+/* @[declare_ota_eventprocessingtaskctx] */
+void OTA_EventProcessingTaskCtx( OtaAgentContext_t * pAgentCtx );
+/* @[declare_ota_eventprocessingtaskctx] */
+
 
 /**
  * @brief Signal event to the OTA Agent task.
@@ -460,6 +808,100 @@ void OTA_EventProcessingTask( void * pUnused );
 bool OTA_SignalEvent( const OtaEventMsg_t * const pEventMsg );
 /* @[declare_ota_signalevent] */
 
+/**
+ * @brief Signal event to the OTA Agent task of a given agent context.
+ *
+ * @param[in] pAgentCtx The agent context.
+ * @param[in] pEventMsg Event to be added to the queue
+ * @return true If operation is successful, false If the event can not be added
+ */
+/* @[declare_ota_signaleventctx] */
+bool OTA_SignalEventCtx( OtaAgentContext_t * pAgentCtx,
+                         const OtaEventMsg_t * const pEventMsg );
+/* @[declare_ota_signaleventctx] */
+
+/**
+ * @brief Look up a key in an indexed job document.
+ *
+ * Custom job handlers receive the index of the job message in
+ * OtaJobDocument_t::pJobDocIndex with the OtaJobEventParseCustomJob event and
+ * can use this function instead of searching the raw JSON again. The query
+ * uses the coreJSON syntax of keys separated by '.', for example
+ * "execution.jobDocument.operation". Array elements are not indexed.
+ *
+ * @param[in] pIndex The job document index.
+ * @param[in] pKeyPath The dotted key path to look up.
+ * @param[in] keyPathLength Length of pKeyPath in bytes.
+ * @param[out] ppValue Set to the start of the value in the JSON message.
+ * @param[out] pValueLength Set to the length of the value.
+ *
+ * @return OtaJobDocIndexSuccess if the key was found, OtaJobDocIndexFull if it
+ * was not found in an index that was truncated (search the raw JSON instead),
+ * otherwise OtaJobDocIndexNotFound or OtaJobDocIndexNullParameter.
+ */
+/* @[declare_ota_jobdocindexlookup] */
+OtaJobDocIndexStatus_t OTA_JobDocIndexLookup( const OtaJobDocIndex_t * pIndex,
+                                              const char * pKeyPath,
+                                              size_t keyPathLength,
+                                              const char ** ppValue,
+                                              size_t * pValueLength );
+/* @[declare_ota_jobdocindexlookup] */
+
+/**
+ * @brief Get a buffer from the OTA event buffer pool.
+ *
+ * The buffer is returned with one reference held by the caller. Once it is
+ * passed to the agent in a successful @ref OTA_SignalEvent call the reference
+ * belongs to the agent, which releases it after the event is processed. If
+ * the event cannot be signaled the caller must release the buffer itself.
+ *
+ * The pool holds otaconfigEVENT_BUFFER_POOL_SIZE buffers. This function is
+ * safe to call from any thread.
+ *
+ * @return A free buffer, or NULL if there is none. Failures are counted in
+ * OtaAgentStatistics_t::otaBuffersExhausted.
+ */
+/* @[declare_ota_eventbufferget] */
+OtaEventData_t * OTA_EventBufferGet( void );
+/* @[declare_ota_eventbufferget] */
+
+/**
+ * @brief Get a buffer from the OTA event buffer pool for a given agent context.
+ *
+ * Same as @ref OTA_EventBufferGet. The pool is shared by all agents, and a
+ * failure is counted in the statistics of pAgentCtx.
+ *
+ * @param[in] pAgentCtx The agent context.
+ * @return A free buffer, or NULL if there is none.
+ */
+/* @[declare_ota_eventbuffergetctx] */
+OtaEventData_t * OTA_EventBufferGetCtx( OtaAgentContext_t * pAgentCtx );
+/* @[declare_ota_eventbuffergetctx] */
+
+/**
+ * @brief Take another reference to a buffer from @ref OTA_EventBufferGet.
+ *
+ * Use this to keep reading a buffer after handing it to the agent. Every
+ * reference must be dropped with @ref OTA_EventBufferRelease.
+ *
+ * @param[in] pEventData A buffer the caller holds a reference to.
+ */
+/* @[declare_ota_eventbufferretain] */
+void OTA_EventBufferRetain( OtaEventData_t * pEventData );
+/* @[declare_ota_eventbufferretain] */
+
+/**
+ * @brief Drop a reference to a buffer from @ref OTA_EventBufferGet.
+ *
+ * The buffer returns to the pool when its last reference is dropped. Buffers
+ * that are not part of the pool are ignored.
+ *
+ * @param[in] pEventData The buffer to release.
+ */
+/* @[declare_ota_eventbufferrelease] */
+void OTA_EventBufferRelease( OtaEventData_t * pEventData );
+/* @[declare_ota_eventbufferrelease] */
+
 /*---------------------------------------------------------------------------*/
 /*							Statistics API									 */
 /*---------------------------------------------------------------------------*/
@@ -478,15 +920,38 @@ bool OTA_SignalEvent( const OtaEventMsg_t * const pEventMsg );
  *  processed.
  *  <li> Dropped: The number of OTA packets that have been dropped
  *  because of either no queue or at shutdown cleanup.
+ *  <li> Buffers exhausted: The number of times @ref OTA_EventBufferGet
+ *  found no free buffer.
+ *  <li> Requests deferred: The number of file block requests held back
+ *  because no event buffer was free.
+ *  <li> Events coalesced: The number of RequestTimer and RequestFileBlock
+ *  events that were not queued because an equivalent one was pending.
  *</ul>
  * @note Calling @ref OTA_Init will reset this statistic.
  *
+ * @note Each counter is read atomically. A copy that overlaps a reset of the
+ * counters is taken again, so it never mixes counts from before and after the
+ * reset. Counters incremented while the copy is taken are not synchronized
+ * with each other and can be a few counts apart.
+ *
  * @return OtaErrNone if the statistics can be received successfully.
  */
 /* @[declare_ota_getstatistics] */
 OtaErr_t OTA_GetStatistics( OtaAgentStatistics_t * pStatistics );
 /* @[declare_ota_getstatistics] */
 
+/**
+ * @brief Get the statistics of the OTA agent of a given agent context.
+ *
+ * @param[in] pAgentCtx The agent context.
+ * @param[out] pStatistics The statistics of the agent.
+ * @return OtaErrNone if the statistics can be received successfully.
+ */
+/* @[declare_ota_getstatisticsctx] */
+OtaErr_t OTA_GetStatisticsCtx( const OtaAgentContext_t * pAgentCtx,
+                               OtaAgentStatistics_t * pStatistics );
+/* @[declare_ota_getstatisticsctx] */
+
 /**
  * @brief Error code to string conversion for OTA errors.
  *
@@ -0,0 +1,112 @@
+/*
+ * AWS IoT Over-the-air Update v2.0.0 (Release Candidate)
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file ota_atomic_private.h
+ * @brief Atomic operations used by the OTA library.
+ *
+ * The defaults use the __atomic builtins of GCC and Clang. Toolchains without
+ * them can define all of these macros in ota_config.h. The state of the agent
+ * context is also loaded and stored with the uint32_t macros.
+ */
+
+#ifndef OTA_ATOMIC_PRIVATE_H
+#define OTA_ATOMIC_PRIVATE_H
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Load a uint32_t with acquire ordering.
+ */
+#ifndef OTA_ATOMIC_LOAD_U32
+    #define OTA_ATOMIC_LOAD_U32( pValue )    __atomic_load_n( ( pValue ), __ATOMIC_ACQUIRE )
+#endif
+
+/**
+ * @brief Store a uint32_t with release ordering.
+ */
+#ifndef OTA_ATOMIC_STORE_U32
+    #define OTA_ATOMIC_STORE_U32( pValue, value )    __atomic_store_n( ( pValue ), ( value ), __ATOMIC_RELEASE )
+#endif
+
+/**
+ * @brief Load a uint32_t with relaxed ordering.
+ */
+#ifndef OTA_ATOMIC_LOAD_RELAXED_U32
+    #define OTA_ATOMIC_LOAD_RELAXED_U32( pValue )    __atomic_load_n( ( pValue ), __ATOMIC_RELAXED )
+#endif
+
+/**
+ * @brief Store a uint32_t with relaxed ordering.
+ */
+#ifndef OTA_ATOMIC_STORE_RELAXED_U32
+    #define OTA_ATOMIC_STORE_RELAXED_U32( pValue, value )    __atomic_store_n( ( pValue ), ( value ), __ATOMIC_RELAXED )
+#endif
+
+/**
+ * @brief Replace a uint32_t with desired if it equals *pExpected.
+ *
+ * Evaluates to true on success. On failure *pExpected is set to the current value.
+ */
+#ifndef OTA_ATOMIC_COMPARE_AND_SWAP_U32
+    #define OTA_ATOMIC_COMPARE_AND_SWAP_U32( pValue, pExpected, desired ) \
+    __atomic_compare_exchange_n( ( pValue ), ( pExpected ), ( desired ), false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE )
+#endif
+
+/**
+ * @brief Add to a uint32_t and evaluate to the new value.
+ */
+#ifndef OTA_ATOMIC_ADD_U32
+    #define OTA_ATOMIC_ADD_U32( pValue, value )    __atomic_add_fetch( ( pValue ), ( value ), __ATOMIC_ACQ_REL )
+#endif
+
+/**
+ * @brief Add to a uint32_t with relaxed ordering and evaluate to the new value.
+ */
+#ifndef OTA_ATOMIC_ADD_RELAXED_U32
+    #define OTA_ATOMIC_ADD_RELAXED_U32( pValue, value )    __atomic_add_fetch( ( pValue ), ( value ), __ATOMIC_RELAXED )
+#endif
+
+/**
+ * @brief Subtract from a uint32_t and evaluate to the new value.
+ */
+#ifndef OTA_ATOMIC_SUB_U32
+    #define OTA_ATOMIC_SUB_U32( pValue, value )    __atomic_sub_fetch( ( pValue ), ( value ), __ATOMIC_ACQ_REL )
+#endif
+
+/**
+ * @brief Keep later loads from being reordered before earlier loads.
+ */
+#ifndef OTA_ATOMIC_FENCE_ACQUIRE
+    #define OTA_ATOMIC_FENCE_ACQUIRE()    __atomic_thread_fence( __ATOMIC_ACQUIRE )
+#endif
+
+/**
+ * @brief Keep later stores from being reordered before earlier stores.
+ */
+#ifndef OTA_ATOMIC_FENCE_RELEASE
+    #define OTA_ATOMIC_FENCE_RELEASE()    __atomic_thread_fence( __ATOMIC_RELEASE )
+#endif
+
+#endif /* ifndef OTA_ATOMIC_PRIVATE_H */
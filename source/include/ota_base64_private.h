@@ -103,4 +103,24 @@ Base64Status_t base64Decode( uint8_t * pDest,
                              const uint8_t * pEncodedData,
                              const size_t encodedLen );
 
+/**
+ * @brief Encode binary data with Base64, including padding.
+ *
+ * @param[out] pDest Pointer to a buffer for storing the encoded result.
+ * @param[in]  destLen Length of the pDest buffer.
+ * @param[out] pResultLen Pointer to the length of the encoded result.
+ * @param[in]  pData Pointer to the data to encode.
+ * @param[in]  dataLen Length of the pData buffer.
+ *
+ * @return     One of the following:
+ *             - #Base64Success if the data was encoded.
+ *             - #Base64NullPointerInput if a pointer parameter is NULL.
+ *             - #Base64InvalidBufferSize if pDest is too small.
+ */
+Base64Status_t base64Encode( uint8_t * pDest,
+                             const size_t destLen,
+                             size_t * pResultLen,
+                             const uint8_t * pData,
+                             const size_t dataLen );
+
 #endif /* ifndef OTA_BASE64_PRIVATE_H */
@@ -72,4 +72,28 @@ bool OTA_CBOR_Encode_GetStreamRequestMessage( uint8_t * pMessageBuffer,
                                               size_t blockBitmapSize,
                                               int32_t numOfBlocksRequested );
 
+/**
+ * @brief Encode the leading members of a Get Stream Request message, which
+ * are the same for every request of a file.
+ */
+bool OTA_CBOR_Encode_GetStreamRequestPrefix( uint8_t * pMessageBuffer,
+                                             size_t messageBufferSize,
+                                             size_t * pEncodedPrefixSize,
+                                             const char * pClientToken,
+                                             int32_t fileId,
+                                             int32_t blockSize );
+
+/**
+ * @brief Complete a Get Stream Request message by appending the members that
+ * select the blocks to an encoded prefix.
+ */
+bool OTA_CBOR_Encode_GetStreamRequestBlocks( uint8_t * pMessageBuffer,
+                                             size_t messageBufferSize,
+                                             size_t prefixSize,
+                                             size_t * pEncodedMessageSize,
+                                             int32_t blockOffset,
+                                             const uint8_t * pBlockBitmap,
+                                             size_t blockBitmapSize,
+                                             int32_t numOfBlocksRequested );
+
 #endif /* ifndef OTA_CBOR_H */
@@ -116,6 +116,83 @@
     #define otaconfigFILE_REQUEST_WAIT_MS    10000U
 #endif
 
+/**
+ * @brief Lower bound in milliseconds of the adaptive file block request timeout.
+ *
+ * @note If the OS timer interface provides a time source, the agent measures
+ * the time from a file block request to the first block received. It keeps a
+ * smoothed round trip time and its variation, and arms the request timer with
+ * their sum (the variation counting four times) instead of
+ * otaconfigFILE_REQUEST_WAIT_MS. Each request repeated after a timeout doubles
+ * the timeout. The timeout is kept between this value and
+ * otaconfigFILE_REQUEST_WAIT_MAX_MS.
+ *
+ * <b>Possible values:</b> Any unsigned 32 integer greater than 0. <br>
+ * <b>Default value:</b> '1000'
+ */
+#ifndef otaconfigFILE_REQUEST_WAIT_MIN_MS
+    #define otaconfigFILE_REQUEST_WAIT_MIN_MS    1000U
+#endif
+
+/**
+ * @brief Upper bound in milliseconds of the adaptive file block request timeout.
+ *
+ * @note See otaconfigFILE_REQUEST_WAIT_MIN_MS.
+ *
+ * <b>Possible values:</b> Any unsigned 32 integer up to 0x7FFFFFFF and not less than
+ * otaconfigFILE_REQUEST_WAIT_MIN_MS. <br>
+ * <b>Default value:</b> '60000'
+ */
+#ifndef otaconfigFILE_REQUEST_WAIT_MAX_MS
+    #define otaconfigFILE_REQUEST_WAIT_MAX_MS    60000U
+#endif
+
+/**
+ * @brief Shortest wait in milliseconds before a failed job request is retried.
+ *
+ * @note Retries of job requests, of starting a file transfer and of file block
+ * requests that went unanswered back off with decorrelated jitter. Each wait is
+ * random, from the shortest wait up to three times the previous wait, and
+ * never longer than otaconfigREQUEST_BACKOFF_MAX_MS. File block requests wait
+ * at least the file block request timeout. Devices that fail at the same time
+ * therefore spread their retries out. The values can be changed at runtime
+ * with @ref OTA_SetRequestBackoff.
+ *
+ * <b>Possible values:</b> Any unsigned 32 integer greater than 0. <br>
+ * <b>Default value:</b> otaconfigFILE_REQUEST_WAIT_MS
+ */
+#ifndef otaconfigREQUEST_BACKOFF_BASE_MS
+    #define otaconfigREQUEST_BACKOFF_BASE_MS    otaconfigFILE_REQUEST_WAIT_MS
+#endif
+
+/**
+ * @brief Longest wait in milliseconds before a failed request is retried.
+ *
+ * @note See otaconfigREQUEST_BACKOFF_BASE_MS.
+ *
+ * <b>Possible values:</b> Any unsigned 32 integer not less than
+ * otaconfigREQUEST_BACKOFF_BASE_MS. <br>
+ * <b>Default value:</b> '60000'
+ */
+#ifndef otaconfigREQUEST_BACKOFF_MAX_MS
+    #define otaconfigREQUEST_BACKOFF_MAX_MS    60000U
+#endif
+
+/**
+ * @brief Longest random delay in milliseconds before the download of a new job
+ * starts.
+ *
+ * @note A job notification reaches every device of a job at about the same
+ * time. A random delay up to this value spreads the start of the downloads
+ * out. It can be changed at runtime with @ref OTA_SetRequestBackoff.
+ *
+ * <b>Possible values:</b> Any unsigned 32 integer. 0 disables it. <br>
+ * <b>Default value:</b> '0'
+ */
+#ifndef otaconfigJOB_START_DELAY_MAX_MS
+    #define otaconfigJOB_START_DELAY_MAX_MS    0U
+#endif
+
 /**
  * @brief The maximum allowed length of the thing name used by the OTA agent.
  *
@@ -152,6 +229,42 @@
     #define otaconfigMAX_NUM_BLOCKS_REQUEST    1U
 #endif
 
+/**
+ * @brief The number of blocks received past a missing block before it is
+ * requested again.
+ *
+ * @note When more than one block is requested at a time, the streaming
+ * service sends the requested blocks in order. Once this many blocks after a
+ * missing block have arrived, the missing block is assumed lost and the
+ * remaining blocks are requested right away instead of waiting for the request
+ * timer. This is done once per missing block, so a block that is lost again
+ * is left to the request timer. MQTT delivers messages in order, so a single
+ * block is enough; raise it if blocks can arrive out of order. Has no effect
+ * unless it is less than otaconfigMAX_NUM_BLOCKS_REQUEST.
+ *
+ * <b>Possible values:</b> Any unsigned 32 integer. 0 disables it. <br>
+ * <b>Default value:</b> '1'
+ */
+#ifndef otaconfigFAST_RETRANSMIT_THRESHOLD
+    #define otaconfigFAST_RETRANSMIT_THRESHOLD    1U
+#endif
+
+/**
+ * @brief The number of missing blocks at which a file download enters its
+ * endgame.
+ *
+ * @note Once no more than this many blocks of a file are missing, each request
+ * asks for exactly the missing blocks and the request timer runs for half of
+ * the usual timeout, but not less than otaconfigFILE_REQUEST_WAIT_MIN_MS. This
+ * keeps the last few blocks from waiting out full timeouts.
+ *
+ * <b>Possible values:</b> Any unsigned 32 integer. 0 disables it. <br>
+ * <b>Default value:</b> '4'
+ */
+#ifndef otaconfigENDGAME_NUM_BLOCKS
+    #define otaconfigENDGAME_NUM_BLOCKS    4U
+#endif
+
 /**
  * @brief The maximum number of requests allowed to send without a response
  * before we abort.
@@ -168,11 +281,13 @@
 #endif
 
 /**
- * @brief How frequently the device will report its OTA progress to the cloud.
+ * @brief Deprecated. How frequently the device used to report its OTA progress to the cloud.
  *
- * @note Device will update the job status with the number of blocks it has received every certain
- * number of blocks it receives. For example, 64 means device will update job status every 64 blocks
- * it receives.
+ * @note This setting is ignored. The device used to update the job status every
+ * this many blocks it received. The progress is now reported by time and
+ * percentage steps, see otaconfigPROGRESS_MIN_INTERVAL_MS,
+ * otaconfigPROGRESS_MAX_INTERVAL_MS and otaconfigPROGRESS_PERCENT_STEP. The
+ * setting is still accepted so that existing configurations build.
  *
  * <b>Possible values:</b> Any unsigned 32 integer. <br>
  * <b>Default value:</b> '64'
@@ -181,6 +296,50 @@
     #define otaconfigOTA_UPDATE_STATUS_FREQUENCY    64U
 #endif
 
+/**
+ * @brief Shortest time in milliseconds between two reports of the download progress.
+ *
+ * @note The device updates the job status with the number of blocks it has received
+ * while a file is downloaded. Blocks that arrive sooner than this after the last
+ * report are not reported on their own; the next report carries the latest progress.
+ * The limit only applies if the OS interface provides getTimeMs.
+ *
+ * <b>Possible values:</b> Any unsigned 32 integer. <br>
+ * <b>Default value:</b> '1000'
+ */
+#ifndef otaconfigPROGRESS_MIN_INTERVAL_MS
+    #define otaconfigPROGRESS_MIN_INTERVAL_MS    1000U
+#endif
+
+/**
+ * @brief Longest time in milliseconds between two reports of the download progress.
+ *
+ * @note If blocks were received since the last report, the progress is reported
+ * once this much time has passed, even if it did not reach the next
+ * otaconfigPROGRESS_PERCENT_STEP. This keeps progress visible on slow links.
+ * The limit only applies if the OS interface provides getTimeMs.
+ *
+ * <b>Possible values:</b> Any unsigned 32 integer. <br>
+ * <b>Default value:</b> '30000'
+ */
+#ifndef otaconfigPROGRESS_MAX_INTERVAL_MS
+    #define otaconfigPROGRESS_MAX_INTERVAL_MS    30000U
+#endif
+
+/**
+ * @brief Step of the download progress, in percent of the file, that is reported.
+ *
+ * @note The progress is reported each time it reaches the next multiple of this
+ * step, subject to otaconfigPROGRESS_MIN_INTERVAL_MS. If set to '0', the
+ * progress is only reported after otaconfigPROGRESS_MAX_INTERVAL_MS.
+ *
+ * <b>Possible values:</b> 0 to 100. <br>
+ * <b>Default value:</b> '10'
+ */
+#ifndef otaconfigPROGRESS_PERCENT_STEP
+    #define otaconfigPROGRESS_PERCENT_STEP    10U
+#endif
+
 /**
  * @brief The number of data buffers reserved by the OTA agent.
  *
@@ -210,6 +369,146 @@
     #define otaconfigAllowDowngrade    0U
 #endif
 
+/**
+ * @brief Flag to hand custom job callbacks an index of the job document.
+ *
+ * @note Set this configuration parameter to '1' to build the index described
+ * by otaconfigMAX_JOB_DOC_INDEX_ENTRIES and pass it in
+ * OtaJobDocument_t::pJobDocIndex. The index is kept in the agent context, so
+ * it costs RAM even if no custom job is ever received. When '0', pJobDocIndex
+ * is always NULL.
+ *
+ * <b>Possible values:</b> 0 or 1. <br>
+ * <b>Default value:</b> '0'
+ */
+#ifndef otaconfigCUSTOM_JOB_DOC_INDEX
+    #define otaconfigCUSTOM_JOB_DOC_INDEX    0U
+#endif
+
+/**
+ * @brief The maximum number of key/value pairs recorded in the job document
+ * index handed to the application for custom jobs.
+ *
+ * @note The index is built once when a job document cannot be parsed as an
+ * OTA job and is passed to the application callback with the
+ * OtaJobEventParseCustomJob event. Each entry costs a few pointers of RAM.
+ * Documents with more members than this are still indexed up to the limit and
+ * the remaining keys must be searched for in the raw JSON.
+ *
+ * <b>Possible values:</b> Any unsigned 16 integer greater than 0. <br>
+ * <b>Default value:</b> '32'
+ */
+#ifndef otaconfigMAX_JOB_DOC_INDEX_ENTRIES
+    #define otaconfigMAX_JOB_DOC_INDEX_ENTRIES    32U
+#endif
+
+/**
+ * @brief Flag to receive MQTT stream data as JSON instead of CBOR.
+ *
+ * @note Set this configuration parameter to '1' when the MQTT broker or a bridge
+ * in between only forwards JSON payloads. File blocks are then requested on the
+ * stream's get/json topic and received on its data/json topic, with the block
+ * payload encoded in Base64. This needs about a third more memory per data
+ * buffer and more bandwidth than CBOR.
+ *
+ * <b>Possible values:</b> 0 or 1. <br>
+ * <b>Default value:</b> '0'
+ */
+#ifndef otaconfigMQTT_JSON_STREAM_PAYLOAD
+    #define otaconfigMQTT_JSON_STREAM_PAYLOAD    0U
+#endif
+
+/**
+ * @brief Flag to validate job documents with the OTA library's JSON validator.
+ *
+ * @note Set this configuration parameter to '1' to validate job documents with
+ * a validator that gives the same results as coreJSON's JSON_Validate but
+ * scans string content a word at a time. This is faster for large job
+ * documents with long strings, at the cost of extra code size.
+ *
+ * <b>Possible values:</b> 0 or 1. <br>
+ * <b>Default value:</b> '0'
+ */
+#ifndef otaconfigFAST_JSON_VALIDATION
+    #define otaconfigFAST_JSON_VALIDATION    0U
+#endif
+
+/**
+ * @brief Number of event buffers in the OTA library's buffer pool.
+ *
+ * @note Applications get event buffers for OTA_SignalEvent with
+ * OTA_EventBufferGet, and the agent releases them once the event has been
+ * processed. Each buffer takes sizeof( OtaEventData_t ) bytes of RAM. The pool
+ * is shared by all agent contexts and is safe to use from any task. Set this
+ * to '0' to leave out the pool when the application manages its own buffers.
+ *
+ * <b>Possible values:</b> Any unsigned 32 integer. <br>
+ * <b>Default value:</b> '0'
+ */
+#ifndef otaconfigEVENT_BUFFER_POOL_SIZE
+    #define otaconfigEVENT_BUFFER_POOL_SIZE    0U
+#endif
+
+/**
+ * @brief Flag to hold back file block requests while the event buffer pool is empty.
+ *
+ * @note Set this configuration parameter to '1' to skip a file block request
+ * when no buffer is free to receive the reply into. The request timer still
+ * runs, so the request is retried once buffers have been released.
+ *
+ * <b>Possible values:</b> 0 or 1. <br>
+ * <b>Default value:</b> '0'
+ */
+#ifndef otaconfigEVENT_BUFFER_BACKPRESSURE
+    #define otaconfigEVENT_BUFFER_BACKPRESSURE    0U
+#endif
+
+/**
+ * @brief Maximum number of events the agent takes from the event interface per wakeup.
+ *
+ * @note If the OS event interface provides recvBatch, the agent task receives
+ * up to this many pending events at once and processes them in order before
+ * it waits again. The events are held on the agent task's stack.
+ *
+ * <b>Possible values:</b> Any unsigned 32 integer greater than 0. <br>
+ * <b>Default value:</b> '8'
+ */
+#ifndef otaconfigMAX_EVENT_BATCH_SIZE
+    #define otaconfigMAX_EVENT_BATCH_SIZE    8U
+#endif
+
+/**
+ * @brief Size in bytes of a data cache line of the target.
+ *
+ * @note If not zero, the statistics counters updated by the tasks that signal
+ * events and the ones updated by the OTA agent task are kept this many bytes
+ * apart so they never share a cache line. This adds twice this many bytes to
+ * each agent context. Set it to the cache line size, for example '64', on
+ * multicore targets where these tasks run on different cores.
+ *
+ * <b>Possible values:</b> Any unsigned 32 integer. <br>
+ * <b>Default value:</b> '0'
+ */
+#ifndef otaconfigCACHE_LINE_SIZE
+    #define otaconfigCACHE_LINE_SIZE    0U
+#endif
+
+/**
+ * @brief Period in milliseconds after which an idle OTA agent runs its idle hook.
+ *
+ * @note The agent task passes this period as the timeout when it waits for
+ * events. Each time the wait times out without an event, the agent runs
+ * the idle hook for deferred work, and then waits again. If set to '0', the agent
+ * waits for events without a timeout and the idle hook never runs. The OS
+ * event interface must honor the receive timeout for the hook to run.
+ *
+ * <b>Possible values:</b> Any unsigned 32 integer. <br>
+ * <b>Default value:</b> '0'
+ */
+#ifndef otaconfigAGENT_IDLE_PERIOD_MS
+    #define otaconfigAGENT_IDLE_PERIOD_MS    0U
+#endif
+
 /**
  * @brief The protocol selected for OTA control operations.
  *
@@ -66,6 +66,7 @@ OtaErr_t requestDataBlock_Http( OtaAgentContext_t * pAgentCtx );
  * File block received over HTTP does not require decoding, only increment the number
  * of blocks received.
  *
+ * @param[in] pAgentCtx       The OTA agent context.
  * @param[in] pMessageBuffer The message to be decoded.
  * @param[in] messageSize     The size of the message in bytes.
  * @param[out] pFileId        The server file ID.
@@ -77,7 +78,8 @@ OtaErr_t requestDataBlock_Http( OtaAgentContext_t * pAgentCtx );
  * @return The OTA PAL layer error code combined with the MCU specific error code. See OTA Agent
  * error codes information in ota.h.
  */
-OtaErr_t decodeFileBlock_Http( const uint8_t * pMessageBuffer,
+OtaErr_t decodeFileBlock_Http( OtaAgentContext_t * pAgentCtx,
+                               const uint8_t * pMessageBuffer,
                                size_t messageSize,
                                int32_t * pFileId,
                                int32_t * pBlockId,
@@ -22,7 +22,8 @@
 
 /**
  * @file ota_interface_private.h
- * @brief Contains function definitions and structures for data and control interfaces.
+ * @brief Contains function definitions and structures for data and control interfaces,
+ * and the state table entry of the agent state machine.
  */
 
 #ifndef OTA_INTERFACE_PRIVATE_H
@@ -44,40 +45,26 @@
 
 
 /**
- * @brief Represents the OTA control interface functions.
- *
- * The functions in this structure are used for the control operations
- * during over the air updates like OTA job status updates.
+ * @brief OTA event handler definition.
  */
-typedef struct
-{
-    OtaErr_t ( * requestJob )( OtaAgentContext_t * pAgentCtx ); /*!< Request for the next available OTA job from the job service. */
-    OtaErr_t ( * updateJobStatus )( OtaAgentContext_t * pAgentCtx,
-                                    OtaJobStatus_t status,
-                                    int32_t reason,
-                                    int32_t subReason );           /*!< Updates the OTA job status with information like in progress, completion, or failure. */
-    OtaErr_t ( * cleanup )( const OtaAgentContext_t * pAgentCtx ); /*!< Cleanup related to OTA control plane. */
-} OtaControlInterface_t;
+typedef OtaErr_t ( * OtaEventHandler_t )( OtaAgentContext_t * pAgentCtx,
+                                          const OtaEventData_t * pEventMsg );
 
 /**
- * @brief Represents the OTA data interface functions.
+ * @ingroup ota_datatypes_structs
+ * @brief OTA Agent state table entry.
  *
- * The functions in this structure are used for the data operations
- * during over the air updates like requesting file blocks.
- */
-typedef struct
+ * The transition table of the agent state machine is an array of these.
+ * */
+
+typedef struct OtaStateTableEntry
 {
-    OtaErr_t ( * initFileTransfer )( OtaAgentContext_t * pAgentCtx ); /*!< Initialize file transfer. */
-    OtaErr_t ( * requestFileBlock )( OtaAgentContext_t * pAgentCtx ); /*!< Request File block. */
-    OtaErr_t ( * decodeFileBlock )( const uint8_t * pMessageBuffer,
-                                    size_t messageSize,
-                                    int32_t * pFileId,
-                                    int32_t * pBlockId,
-                                    int32_t * pBlockSize,
-                                    uint8_t ** pPayload,
-                                    size_t * pPayloadSize );       /*!< Decode a cbor encoded fileblock. */
-    OtaErr_t ( * cleanup )( const OtaAgentContext_t * pAgentCtx ); /*!< Cleanup related to OTA data plane. */
-} OtaDataInterface_t;
+    OtaState_t currentState;   /**< Current state of the agent. */
+    OtaEvent_t eventId;        /**< Event corresponding to the action. */
+    OtaEventHandler_t handler; /**< Handler to invoke the next action. */
+    OtaState_t nextState;      /**< New state to be triggered*/
+} OtaStateTableEntry_t;
+
 
 /**
  * @brief Set control interface for OTA operations.
@@ -0,0 +1,84 @@
+/*
+ * AWS IoT Over-the-air Update v2.0.0 (Release Candidate)
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file ota_json_index_private.h
+ * @brief Function declarations for ota_json_index.c.
+ */
+
+#ifndef OTA_JSON_INDEX_PRIVATE_H
+#define OTA_JSON_INDEX_PRIVATE_H
+
+/* Standard includes. */
+#include <stddef.h>
+#include <stdint.h>
+
+/* OTA includes. */
+#include "ota.h"
+
+/* JSON library includes. */
+#include "core_json.h"
+
+/**
+ * @brief Maximum nesting of objects whose members are indexed.
+ *
+ * Objects nested deeper than this are recorded as a single value and their
+ * members are left out of the index.
+ */
+#define OTA_JSON_INDEX_MAX_DEPTH    8U
+
+/**
+ * @brief Build the index of all object members of a JSON document.
+ *
+ * The document is scanned once and every member of every nested object is
+ * recorded with the hash of its full dotted key path. The index holds
+ * pointers into pJson, which must outlive it.
+ *
+ * @param[out] pIndex Index to fill.
+ * @param[in] pJson The JSON document. The outermost value must be an object.
+ * @param[in] jsonLength Length of the document in bytes.
+ *
+ * @return OtaJobDocIndexSuccess if every member was indexed,
+ * OtaJobDocIndexFull if the index is usable but incomplete,
+ * OtaJobDocIndexMalformedDoc or OtaJobDocIndexNullParameter otherwise.
+ */
+OtaJobDocIndexStatus_t jsonIndexBuild( OtaJobDocIndex_t * pIndex,
+                                       const char * pJson,
+                                       size_t jsonLength );
+
+/**
+ * @brief Validate a JSON document with the same result as JSON_Validate.
+ *
+ * This follows the grammar checks of coreJSON, including its handling of
+ * JSON_MAX_DEPTH and JSON_VALIDATE_COLLECTIONS_ONLY, but classifies string
+ * content eight bytes at a time so long strings are passed over quickly.
+ * skipString in the job document index uses the same scanner.
+ *
+ * @param[in] pJson The JSON document.
+ * @param[in] length Length of the document in bytes.
+ *
+ * @return The JSONStatus_t that JSON_Validate returns for the same document.
+ */
+JSONStatus_t jsonValidate( const char * pJson,
+                           size_t length );
+
+#endif /* ifndef OTA_JSON_INDEX_PRIVATE_H */
@@ -77,6 +77,7 @@ OtaErr_t requestFileBlock_Mqtt( OtaAgentContext_t * pAgentCtx );
  *
  * This function is used for decoding a file block received over MQTT & encoded in cbor.
  *
+ * @param[in] pAgentCtx       The OTA agent context, unused.
  * @param[in] pMessageBuffer The message to be decoded.
  * @param[in] messageSize     The size of the message in bytes.
  * @param[out] pFileId        The server file ID.
@@ -89,7 +90,8 @@ OtaErr_t requestFileBlock_Mqtt( OtaAgentContext_t * pAgentCtx );
  * error codes information in ota.h.
  */
 
-OtaErr_t decodeFileBlock_Mqtt( const uint8_t * pMessageBuffer,
+OtaErr_t decodeFileBlock_Mqtt( OtaAgentContext_t * pAgentCtx,
+                               const uint8_t * pMessageBuffer,
                                size_t messageSize,
                                int32_t * pFileId,
                                int32_t * pBlockId,
@@ -97,6 +99,34 @@ OtaErr_t decodeFileBlock_Mqtt( const uint8_t * pMessageBuffer,
                                uint8_t ** pPayload,
                                size_t * pPayloadSize );
 
+/**
+ * @brief Decode a JSON encoded fileblock.
+ *
+ * This function is used for decoding a file block received over MQTT & encoded in JSON,
+ * with the block data in Base64. The block data is decoded directly into the buffer
+ * pointed to by *pPayload.
+ *
+ * @param[in] pAgentCtx       The OTA agent context, unused.
+ * @param[in] pMessageBuffer The message to be decoded.
+ * @param[in] messageSize     The size of the message in bytes.
+ * @param[out] pFileId        The server file ID.
+ * @param[out] pBlockId       The file block ID.
+ * @param[out] pBlockSize     The file block size.
+ * @param[in,out] pPayload    The payload buffer.
+ * @param[in,out] pPayloadSize The size of the payload buffer on input, the payload size on output.
+ *
+ * @return OtaErrNone if the block was decoded, OtaErrFailedToDecodeJson otherwise.
+ */
+
+OtaErr_t decodeFileBlockJson_Mqtt( OtaAgentContext_t * pAgentCtx,
+                                   const uint8_t * pMessageBuffer,
+                                   size_t messageSize,
+                                   int32_t * pFileId,
+                                   int32_t * pBlockId,
+                                   int32_t * pBlockSize,
+                                   uint8_t ** pPayload,
+                                   size_t * pPayloadSize );
+
 /**
  * @brief Cleanup related to OTA control plane over MQTT.
  *
@@ -58,6 +58,7 @@
  * - [OTA OS Functional Interface Start Timer](@ref OtaStartTimer_t)
  * - [OTA OS Functional Interface Stop Timer](@ref OtaStopTimer_t)
  * - [OTA OS Functional Interface Delete Timer](@ref OtaDeleteTimer_t)
+ * - [OTA OS Functional Interface Get Time](@ref OtaGetTimeMs_t)
  * - [OTA OS Functional Interface Malloc](@ref OtaMalloc_t)
  * - [OTA OS Functional Interface Free](@ref OtaFree_t)
  *
@@ -75,6 +76,13 @@ struct OtaEventContext;
  */
 typedef struct OtaEventContext OtaEventContext_t;
 
+struct OtaTimerContext;
+
+/**
+ * @brief Type definition for Timer Context.
+ */
+typedef struct OtaTimerContext OtaTimerContext_t;
+
 /**
  * @brief Enumeration for tracking multiple timers.
  */
@@ -100,7 +108,9 @@ typedef enum OtaOsStatus
     OtaOsTimerStartFailed,               /*!< @brief Failed to create the timer. */
     OtaOsTimerRestartFailed,             /*!< @brief Failed to restart the timer. */
     OtaOsTimerStopFailed,                /*!< @brief Failed to stop the timer. */
-    OtaOsTimerDeleteFailed               /*!< @brief Failed to delete the timer. */
+    OtaOsTimerDeleteFailed,              /*!< @brief Failed to delete the timer. */
+    OtaOsShutdownWaitFailed,             /*!< @brief The agent did not finish shutting down in time. */
+    OtaOsEventQueueReceiveTimeout        /*!< @brief No event was received before the timeout expired. */
 } OtaOsStatus_t;
 
 /**
@@ -142,15 +152,48 @@ typedef OtaOsStatus_t ( * OtaSendEvent_t )( OtaEventContext_t * pEventCtx,
  *
  * @param[pEventMsg]     Pointer to store message.
  *
- * @param[timeout]       The maximum amount of time the task should block.
+ * @param[timeout]       The maximum amount of time (msec) the task should block.
+ *                       Zero blocks until an event is received.
  *
- * @return               OtaOsStatus_t, OtaOsSuccess if success , other error code on failure.
+ * @return               OtaOsStatus_t, OtaOsSuccess if success,
+ *                       OtaOsEventQueueReceiveTimeout if the timeout expired first,
+ *                       other error code on failure.
  */
 
 typedef OtaOsStatus_t ( * OtaReceiveEvent_t )( OtaEventContext_t * pEventCtx,
                                                void * pEventMsg,
                                                uint32_t timeout );
 
+/**
+ * @brief Receive a batch of OTA events.
+ *
+ * This function waits like OtaReceiveEvent_t for the next event and then also
+ * takes the events that are already pending, up to maxEvents, without waiting
+ * again. The events are stored in the order they would have been received one
+ * at a time.
+ *
+ * @param[pEventCtx]     Pointer to the OTA event context.
+ *
+ * @param[pEventMsgs]    Array of maxEvents messages to store the events in.
+ *
+ * @param[maxEvents]     The maximum number of events to receive.
+ *
+ * @param[pNumEvents]    Set to the number of events received.
+ *
+ * @param[timeout]       The maximum amount of time (msec) the task should block.
+ *                       Zero blocks until an event is received.
+ *
+ * @return               OtaOsStatus_t, OtaOsSuccess if at least one event was received,
+ *                       OtaOsEventQueueReceiveTimeout if the timeout expired first,
+ *                       other error code on failure.
+ */
+
+typedef OtaOsStatus_t ( * OtaReceiveEventBatch_t )( OtaEventContext_t * pEventCtx,
+                                                    void * pEventMsgs,
+                                                    uint32_t maxEvents,
+                                                    uint32_t * pNumEvents,
+                                                    uint32_t timeout );
+
 /**
  * @brief Deinitialize the OTA Events mechanism.
  *
@@ -164,6 +207,38 @@ typedef OtaOsStatus_t ( * OtaReceiveEvent_t )( OtaEventContext_t * pEventCtx,
 
 typedef OtaOsStatus_t ( * OtaDeinitEvent_t )( OtaEventContext_t * pEventCtx );
 
+/**
+ * @brief Signal that the OTA agent has shut down.
+ *
+ * This function is called from the OTA agent task once it has released its
+ * resources and entered OtaAgentStateStopped. It wakes up a task waiting in
+ * OtaWaitShutdown_t. The signal stays set until the event mechanism is
+ * initialized again.
+ *
+ * @param[pEventCtx]     Pointer to the OTA event context.
+ *
+ * @return               OtaOsStatus_t, OtaOsSuccess if success , other error code on failure.
+ */
+
+typedef OtaOsStatus_t ( * OtaSignalShutdown_t )( OtaEventContext_t * pEventCtx );
+
+/**
+ * @brief Wait for the OTA agent to shut down.
+ *
+ * This function blocks the calling task until OtaSignalShutdown_t is called or
+ * the timeout expires. It returns immediately if the signal is already set.
+ *
+ * @param[pEventCtx]     Pointer to the OTA event context.
+ *
+ * @param[timeout]       The maximum amount of time (msec) the task should block.
+ *
+ * @return               OtaOsStatus_t, OtaOsSuccess if the agent has shut down,
+ *                       OtaOsShutdownWaitFailed if the timeout expired first.
+ */
+
+typedef OtaOsStatus_t ( * OtaWaitShutdown_t )( OtaEventContext_t * pEventCtx,
+                                               uint32_t timeout );
+
 /**
  * @brief Timer callback.
  *
@@ -171,16 +246,21 @@ typedef OtaOsStatus_t ( * OtaDeinitEvent_t )( OtaEventContext_t * pEventCtx );
  *
  * @param[otaTimerId]       Timer ID of type otaTimerId_t
  *
+ * @param[pCallbackContext] Context pointer that was passed when the timer was started.
+ *
  * @return                  OtaOsStatus_t, OtaOsSuccess if success , other error code on failure.
  */
 
-typedef void ( * OtaTimerCallback_t )( OtaTimerId_t otaTimerId );
+typedef void ( * OtaTimerCallback_t )( OtaTimerId_t otaTimerId,
+                                       void * pCallbackContext );
 
 /**
  * @brief Start timer.
  *
  * This function starts the timer or resets it if it has already started.
  *
+ * @param[pTimerCtx]        Pointer to the OTA timer context.
+ *
  * @param[otaTimerId]       Timer ID of type otaTimerId_t
  *
  * @param[pTimerName]       Timer name.
@@ -189,37 +269,58 @@ typedef void ( * OtaTimerCallback_t )( OtaTimerId_t otaTimerId );
  *
  * @param[callback]         Callback to be called when timer expires.
  *
+ * @param[pCallbackContext] Context pointer to pass to the callback.
+ *
  * @return                  OtaOsStatus_t, OtaOsSuccess if success , other error code on failure.
  */
 
-typedef OtaOsStatus_t ( * OtaStartTimer_t ) ( OtaTimerId_t otaTimerId,
+typedef OtaOsStatus_t ( * OtaStartTimer_t ) ( OtaTimerContext_t * pTimerCtx,
+                                              OtaTimerId_t otaTimerId,
                                               const char * const pTimerName,
                                               const uint32_t timeout,
-                                              OtaTimerCallback_t callback );
+                                              OtaTimerCallback_t callback,
+                                              void * pCallbackContext );
 
 /**
  * @brief Stop timer.
  *
  * This function stops the time.
  *
+ * @param[pTimerCtx]      Pointer to the OTA timer context.
+ *
  * @param[otaTimerId]     Timer ID of type otaTimerId_t
  *
  * @return                OtaOsStatus_t, OtaOsSuccess if success , other error code on failure.
  */
 
-typedef OtaOsStatus_t ( * OtaStopTimer_t ) ( OtaTimerId_t otaTimerId );
+typedef OtaOsStatus_t ( * OtaStopTimer_t ) ( OtaTimerContext_t * pTimerCtx,
+                                             OtaTimerId_t otaTimerId );
 
 /**
  * @brief Delete a timer.
  *
  * This function deletes a timer.
  *
+ * @param[pTimerCtx]        Pointer to the OTA timer context.
+ *
  * @param[otaTimerId]       Timer ID of type otaTimerId_t
  *
  * @return                  OtaOsStatus_t, OtaOsSuccess if success , other error code on failure.
  */
 
-typedef OtaOsStatus_t ( * OtaDeleteTimer_t ) ( OtaTimerId_t otaTimerId );
+typedef OtaOsStatus_t ( * OtaDeleteTimer_t ) ( OtaTimerContext_t * pTimerCtx,
+                                               OtaTimerId_t otaTimerId );
+
+/**
+ * @brief Get the current time.
+ *
+ * This function returns the current time in milliseconds on a monotonic clock.
+ * The starting point is arbitrary and the value may wrap around.
+ *
+ * @return                  Current time in milliseconds.
+ */
+
+typedef uint32_t ( * OtaGetTimeMs_t ) ( void );
 
 /**
  * @brief Allocate memory.
@@ -254,11 +355,14 @@ typedef void ( * OtaFree_t ) ( void * ptr );
  */
 typedef struct OtaEventInterface
 {
-    OtaInitEvent_t init;               /*!< @brief Initialization event. */
-    OtaSendEvent_t send;               /*!< @brief Send data. */
-    OtaReceiveEvent_t recv;            /*!< @brief Receive data. */
-    OtaDeinitEvent_t deinit;           /*!< @brief Deinitialize event. */
-    OtaEventContext_t * pEventContext; /*!< @brief Event context to store event information. */
+    OtaInitEvent_t init;                /*!< @brief Initialization event. */
+    OtaSendEvent_t send;                /*!< @brief Send data. */
+    OtaReceiveEvent_t recv;             /*!< @brief Receive data. */
+    OtaDeinitEvent_t deinit;            /*!< @brief Deinitialize event. */
+    OtaEventContext_t * pEventContext;  /*!< @brief Event context to store event information. */
+    OtaReceiveEventBatch_t recvBatch;   /*!< @brief Receive several events at once, optional. Set to NULL to use recv. */
+    OtaSignalShutdown_t signalShutdown; /*!< @brief Signal that the agent has shut down, optional. */
+    OtaWaitShutdown_t waitShutdown;     /*!< @brief Wait for the agent to shut down, optional. Set to NULL to not block OTA_Shutdown. */
 } OtaEventInterface_t;
 
 /**
@@ -267,9 +371,11 @@ typedef struct OtaEventInterface
  */
 typedef struct OtaTimerInterface
 {
-    OtaStartTimer_t start;   /*!< @brief Timer start state. */
-    OtaStopTimer_t stop;     /*!< @brief Timer stop state. */
-    OtaDeleteTimer_t delete; /*!< @brief Delete timer. */
+    OtaStartTimer_t start;             /*!< @brief Timer start state. */
+    OtaStopTimer_t stop;               /*!< @brief Timer stop state. */
+    OtaDeleteTimer_t delete;           /*!< @brief Delete timer. */
+    OtaTimerContext_t * pTimerContext; /*!< @brief Timer context holding the timers of one OTA agent. */
+    OtaGetTimeMs_t getTimeMs;          /*!< @brief Get the monotonic time, optional. Set to NULL to use fixed request timeouts. */
 } OtaTimerInterface_t;
 
 /**
@@ -78,7 +78,11 @@
 #define OTA_JOB_PARAM_OPTIONAL      ( bool ) false                                                              /*!< @brief Used to denote an optional document model parameter. */
 #define OTA_DONT_STORE_PARAM        0xffff                                                                      /*!< @brief If destOffset in the model is 0xffffffff, do not store the value. */
 #define OTA_STORE_NESTED_JSON       0x1fffU                                                                     /*!< @brief Store the reference to a nested JSON in a separate pointer */
-#define OTA_DATA_BLOCK_SIZE         ( ( 1U << otaconfigLOG2_FILE_BLOCK_SIZE ) + OTA_REQUEST_URL_MAX_SIZE + 30 ) /*!< @brief Header is 19 bytes.*/
+#if ( otaconfigMQTT_JSON_STREAM_PAYLOAD == 1U )
+    #define OTA_DATA_BLOCK_SIZE     ( ( ( ( 1U << otaconfigLOG2_FILE_BLOCK_SIZE ) + 2U ) / 3U ) * 4U + OTA_REQUEST_URL_MAX_SIZE + 30 ) /*!< @brief Base64 encoded block and JSON header.*/
+#else
+    #define OTA_DATA_BLOCK_SIZE     ( ( 1U << otaconfigLOG2_FILE_BLOCK_SIZE ) + OTA_REQUEST_URL_MAX_SIZE + 30 ) /*!< @brief Header is 19 bytes.*/
+#endif
 /** @} */
 
 /**
@@ -112,6 +116,19 @@
  */
 #define OTA_PROTOCOL_BUFFER_SIZE    20U
 
+/**
+ * @brief Size of the buffers used to cache the MQTT topics of the active job.
+ *
+ * Large enough for the job status topic, which has the longest variable parts.
+ */
+#define OTA_MQTT_TOPIC_MAX_SIZE    ( otaconfigMAX_THINGNAME_LEN + OTA_JOB_ID_MAX_SIZE + 32U )
+
+/**
+ * @brief Size of the buffer used to cache the leading members of the stream request message.
+ *
+ */
+#define OTA_STREAM_REQUEST_PREFIX_MAX_SIZE    64U
+
 /**
  * @ingroup ota_constants
  * @brief A composite cryptographic signature structure able to hold our largest supported signature.
@@ -291,8 +308,40 @@ typedef struct OtaAgentStatistics
     uint32_t otaPacketsQueued;    /*!< Number of OTA packets queued by the MQTT callback. */
     uint32_t otaPacketsProcessed; /*!< Number of OTA packets processed by the OTA task. */
     uint32_t otaPacketsDropped;   /*!< Number of OTA packets dropped due to congestion. */
+    uint32_t otaBuffersExhausted; /*!< Number of times OTA_EventBufferGet found no free buffer. */
+    uint32_t otaRequestsDeferred; /*!< Number of file block requests held back for lack of free buffers. */
+    uint32_t otaEventsCoalesced;  /*!< Number of request events dropped because an equivalent one was queued. */
 } OtaAgentStatistics_t;
 
+/**
+ * @ingroup ota_private_struct_types
+ * @brief The counters behind OtaAgentStatistics_t.
+ *
+ * Every counter is updated with a relaxed atomic add and read on its own.
+ * The sequence only covers resets: a reset makes it odd until it is done, so
+ * OTA_GetStatistics can retry a copy that overlapped one. If
+ * otaconfigCACHE_LINE_SIZE is not zero, the counters updated by the tasks
+ * that signal events and the ones updated by the agent task are padded onto
+ * separate cache lines.
+ */
+typedef struct OtaStatisticsCounters
+{
+    uint32_t sequence;                                     /*!< Number of reset steps. Odd while a reset is in progress. */
+    #if ( otaconfigCACHE_LINE_SIZE > 0U )
+        uint8_t signalPadding[ otaconfigCACHE_LINE_SIZE ]; /*!< Keeps the counters below off the cache line of sequence. */
+    #endif
+    uint32_t otaPacketsQueued;                             /*!< Number of OTA packets queued by the MQTT callback. */
+    uint32_t otaPacketsRejected;                           /*!< Number of OTA packets the event queue had no room for. */
+    uint32_t otaBuffersExhausted;                          /*!< Number of times OTA_EventBufferGet found no free buffer. */
+    uint32_t otaEventsCoalesced;                           /*!< Number of request events dropped because an equivalent one was queued. */
+    #if ( otaconfigCACHE_LINE_SIZE > 0U )
+        uint8_t agentPadding[ otaconfigCACHE_LINE_SIZE ];  /*!< Keeps the counters below off the cache line of the ones above. */
+    #endif
+    uint32_t otaPacketsProcessed;                          /*!< Number of OTA packets processed by the OTA task. */
+    uint32_t otaPacketsDropped;                            /*!< Number of OTA packets dropped by the OTA task. */
+    uint32_t otaRequestsDeferred;                          /*!< Number of file block requests held back for lack of free buffers. */
+} OtaStatisticsCounters_t;
+
 /**
  * @ingroup ota_enum_types
  * @brief OTA Image states.
@@ -354,9 +403,26 @@ typedef enum OtaEvent
     OtaAgentEventResume,              /*!< @brief Event to resume suspended task */
     OtaAgentEventUserAbort,           /*!< @brief Event triggered by user to stop agent. */
     OtaAgentEventShutdown,            /*!< @brief Event to trigger ota shutdown */
+    OtaAgentEventConnectionUp,        /*!< @brief Event to resume requests once the connection is back. */
     OtaAgentEventMax                  /*!< @brief Last event specifier */
 } OtaEvent_t;
 
+/**
+ * @ingroup ota_enum_types
+ * @brief OTA Agent event priority lanes.
+ *
+ * An event interface that supports priorities delivers every queued event of
+ * a lane before any event of a lower lane, so control events do not wait
+ * behind queued file blocks.
+ */
+typedef enum OtaEventLane
+{
+    OtaEventLaneControl = 0, /*!< @brief Start, suspend, resume, abort, shutdown and connection up. */
+    OtaEventLaneTimer,       /*!< @brief Request timer expiry. */
+    OtaEventLaneData,        /*!< @brief Job documents, file blocks and their requests. */
+    OtaNumOfEventLanes       /*!< @brief Number of lanes. */
+} OtaEventLane_t;
+
 /**
  * @ingroup ota_struct_types
  * @brief OTA File Signature info.
@@ -411,6 +477,33 @@ typedef struct OtaFileContext
     Sig256_t * pSignature;        /*!< @brief Pointer to the file's signature structure. */
 } OtaFileContext_t;
 
+/**
+ * @ingroup ota_private_struct_types
+ * @brief MQTT topics and request prefix of the active job, and the MQTT subscriptions.
+ *
+ * The topics and the prefix only change with the job and the file, so they are built when the
+ * file transfer is initialized instead of for every request. A length of zero means the entry was
+ * not built yet. The subscriptions are only valid for the connection generation they were made in.
+ * The subscribed topics stay in the cache while they are subscribed, because the MQTT client may
+ * keep a pointer to them. Each agent context has its own cache.
+ */
+typedef struct OtaMqttCache
+{
+    char pGetStreamTopic[ OTA_MQTT_TOPIC_MAX_SIZE ];                    /*!< @brief Topic to request file blocks from the stream. */
+    uint16_t getStreamTopicLen;                                         /*!< @brief Length of the get stream topic. */
+    char pJobStatusTopic[ OTA_MQTT_TOPIC_MAX_SIZE ];                    /*!< @brief Topic to update the status of the active job. */
+    uint16_t jobStatusTopicLen;                                         /*!< @brief Length of the job status topic. */
+    uint16_t jobNameOffset;                                             /*!< @brief Offset of the job name in the job status topic. */
+    uint8_t pStreamRequestPrefix[ OTA_STREAM_REQUEST_PREFIX_MAX_SIZE ]; /*!< @brief Encoded members of the stream request that are the same for every request of the file. */
+    uint16_t streamRequestPrefixLen;                                    /*!< @brief Length of the stream request prefix. */
+    uint32_t subscriptionGeneration;                                    /*!< @brief Connection generation of the subscriptions below. */
+    bool jobTopicsSubscribed;                                           /*!< @brief Whether the job notification topic is subscribed. */
+    char pJobNotifyTopic[ OTA_MQTT_TOPIC_MAX_SIZE ];                    /*!< @brief Subscribed job notification topic. */
+    char pDataStreamTopic[ OTA_MQTT_TOPIC_MAX_SIZE ];                   /*!< @brief Subscribed data stream topic. */
+    uint16_t dataStreamTopicLen;                                        /*!< @brief Length of the subscribed data stream topic, zero if none. */
+    uint32_t jobRequestCounter;                                         /*!< @brief Number of job requests sent, used in the client token. */
+} OtaMqttCache_t;
+
 /**
  * @ingroup ota_private_struct_types
  * @brief  The OTA Agent event and data structures.
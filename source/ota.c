@@ -50,12 +50,18 @@
 /* OTA Base64 includes */
 #include "ota_base64_private.h"
 
+/* OTA job document index includes. */
+#include "ota_json_index_private.h"
+
 /* OTA pal includes. */
 #include "ota_platform_interface.h"
 
 /* Internal header file for shared OTA definitions. */
 #include "ota_private.h"
 
+/* OTA atomic operations. */
+#include "ota_atomic_private.h"
+
 /* OTA interface includes. */
 #include "ota_interface_private.h"
 
@@ -75,32 +81,9 @@
 #define U16_OFFSET( type, member )    ( ( uint16_t ) offsetof( type, member ) )
 
 /**
- * @brief OTA event handler definition.
- */
-typedef OtaErr_t ( * OtaEventHandler_t )( const OtaEventData_t * pEventMsg );
-
-/**
- * @ingroup ota_datatypes_structs
- * @brief OTA Agent state table entry.
- * */
-
-typedef struct OtaStateTableEntry
-{
-    OtaState_t currentState;   /**< Current state of the agent. */
-    OtaEvent_t eventId;        /**< Event corresponding to the action. */
-    OtaEventHandler_t handler; /**< Handler to invoke the next action. */
-    OtaState_t nextState;      /**< New state to be triggered*/
-} OtaStateTableEntry_t;
-
-/**
- * @brief OTA control interface.
- */
-static OtaControlInterface_t otaControlInterface;
-
-/**
- * @brief OTA data interface.
+ * @brief Time in milliseconds to wait for a queued event while draining the event queue at shutdown.
  */
-static OtaDataInterface_t otaDataInterface;
+#define OTA_EVENT_DRAIN_TIMEOUT_MS    ( 1U )
 
 /* OTA agent private function prototypes. */
 
@@ -114,13 +97,15 @@ static OtaDataInterface_t otaDataInterface;
  * reboot the system and perform a self test phase. If the close or signature check fails, abort
  * the file transfer and return the result and any available details to the caller.
  *
+ * @param[in] pAgentCtx The OTA agent context.
  * @param[in] pFileContext Information of file to be streamed.
  * @param[in] pRawMsg Raw job document.
  * @param[in] messageSize Length of document.
  * @param[in] pCloseResult Result of closing file in PAL.
  * @return IngestResult_t IngestResultAccepted_Continue if successful, other error for failure.
  */
-static IngestResult_t ingestDataBlock( OtaFileContext_t * pFileContext,
+static IngestResult_t ingestDataBlock( OtaAgentContext_t * pAgentCtx,
+                                       OtaFileContext_t * pFileContext,
                                        const uint8_t * pRawMsg,
                                        uint32_t messageSize,
                                        OtaPalStatus_t * pCloseResult );
@@ -128,6 +113,7 @@ static IngestResult_t ingestDataBlock( OtaFileContext_t * pFileContext,
 /**
  * @brief Validate the incoming data block and store it in the file context.
  *
+ * @param[in] pAgentCtx The OTA agent context.
  * @param[in] pFileContext Information of file to be streamed.
  * @param[in] uBlockIndex Incoming block index.
  * @param[in] uBlockSize Incoming block size.
@@ -135,7 +121,8 @@ static IngestResult_t ingestDataBlock( OtaFileContext_t * pFileContext,
  * @param[in] pPayload Data from the block.
  * @return IngestResult_t IngestResultAccepted_Continue if successful, other error for failure.
  */
-static IngestResult_t processDataBlock( OtaFileContext_t * pFileContext,
+static IngestResult_t processDataBlock( OtaAgentContext_t * pAgentCtx,
+                                        OtaFileContext_t * pFileContext,
                                         uint32_t uBlockIndex,
                                         uint32_t uBlockSize,
                                         OtaPalStatus_t * pCloseResult,
@@ -149,7 +136,8 @@ static IngestResult_t processDataBlock( OtaFileContext_t * pFileContext,
  * @return IngestResult_t IngestResultAccepted_Continue if successful, other error for failure.
  */
 
-static IngestResult_t ingestDataBlockCleanup( OtaFileContext_t * pFileContext,
+static IngestResult_t ingestDataBlockCleanup( OtaAgentContext_t * pAgentCtx,
+                                              OtaFileContext_t * pFileContext,
                                               OtaPalStatus_t * pCloseResult );
 
 /**
@@ -158,11 +146,13 @@ static IngestResult_t ingestDataBlockCleanup( OtaFileContext_t * pFileContext,
  * We received an OTA update job message from the job service so process
  * the message and update the file context.
  *
+ * @param[in] pAgentCtx The OTA agent context.
  * @param[in] pRawMsg Raw job document.
  * @param[in] messageLength length of document.
  * @return OtaFileContext_t* Information of file to be streamed.
  */
-static OtaFileContext_t * getFileContextFromJob( const char * pRawMsg,
+static OtaFileContext_t * getFileContextFromJob( OtaAgentContext_t * pAgentCtx,
+                                                 const char * pRawMsg,
                                                  uint32_t messageLength );
 
 /**
@@ -179,13 +169,15 @@ static DocParseErr_t validateJSON( const char * pJson,
 /**
  * @brief Store the parameter from the json to the offset specified by the document model.
  *
+ * @param[in] pAgentCtx The OTA agent context.
  * @param[in] docParam Structure to store the details of keys and where to store them.
  * @param[in] pContextBase Start of file context.
  * @param[in] pValueInJson Pointer to the value of the key in JSON buffer.
  * @param[in] valueLength Length of the value.
  * @return DocParseErr_t DocParseErrNone if successful, JSON document parser errors.
  */
-static DocParseErr_t extractParameter( JsonDocParam_t docParam,
+static DocParseErr_t extractParameter( OtaAgentContext_t * pAgentCtx,
+                                       JsonDocParam_t docParam,
                                        void * pContextBase,
                                        const char * pValueInJson,
                                        size_t valueLength );
@@ -193,12 +185,14 @@ static DocParseErr_t extractParameter( JsonDocParam_t docParam,
 /**
  * @brief Extract the desired fields from the JSON document based on the specified document model.
  *
+ * @param[in] pAgentCtx The OTA agent context.
  * @param[in] pJson JSON job document.
  * @param[in] messageLength  Length of the job document.
  * @param[in] pDocModel Details of expected parameters in the job doc.
  * @return DocParseErr_t DocParseErr_t DocParseErrNone if successful, JSON document parser errors.
  */
-static DocParseErr_t parseJSONbyModel( const char * pJson,
+static DocParseErr_t parseJSONbyModel( OtaAgentContext_t * pAgentCtx,
+                                       const char * pJson,
                                        uint32_t messageLength,
                                        JsonDocModel_t * pDocModel );
 
@@ -217,6 +211,7 @@ static DocParseErr_t decodeAndStoreKey( const char * pValueInJson,
 /**
  * @brief Extract the value from json and store it into the allocated memory.
  *
+ * @param[in] pAgentCtx The OTA agent context.
  * @param[in] pKey Name of the Key to extract.
  * @param[in] pValueInJson Pointer to the value of the key in JSON buffer.
  * @param[in] valueLength Length of the value.
@@ -224,7 +219,8 @@ static DocParseErr_t decodeAndStoreKey( const char * pValueInJson,
  * @param[in] pParamSizeAdd Size required to store the param.
  * @return DocParseErr_t DocParseErrNone if successful, JSON document parser errors.
  */
-static DocParseErr_t extractAndStoreArray( const char * pKey,
+static DocParseErr_t extractAndStoreArray( OtaAgentContext_t * pAgentCtx,
+                                           const char * pKey,
                                            const char * pValueInJson,
                                            size_t valueLength,
                                            void * pParamAdd,
@@ -243,54 +239,64 @@ static DocParseErr_t verifyRequiredParamsExtracted( const JsonDocParam_t * pMode
 /**
  * @brief Validate the version of the update received.
  *
+ * @param[in] pAgentCtx The OTA agent context.
  * @param[in] pFileContext Information of file to be streamed.
  * @return OtaErr_t OtaErrNone if successful, other error codes if failure.
  */
-static OtaErr_t validateUpdateVersion( const OtaFileContext_t * pFileContext );
+static OtaErr_t validateUpdateVersion( OtaAgentContext_t * pAgentCtx,
+                                       const OtaFileContext_t * pFileContext );
 
 /**
  * @brief Check if the JSON can be parsed through the app callback if initial parsing fails.
  *
+ * @param[in] pAgentCtx The OTA agent context.
  * @param[in] pJson JSON job document.
  * @param[in] messageLength Length of the job document.
  * @return OtaJobParseErr_t OtaJobParseErrNone if successful, other error codes if failure.
  */
-static OtaJobParseErr_t handleCustomJob( const char * pJson,
+static OtaJobParseErr_t handleCustomJob( OtaAgentContext_t * pAgentCtx,
+                                         const char * pJson,
                                          uint32_t messageLength );
 
 /**
  * @brief Check if the incoming job document is not conflicting with current job status.
  *
+ * @param[in] pAgentCtx The OTA agent context.
  * @param[in] pFileContext Information of file to be streamed.
  * @param[out] pFinalFile File that stores all extracted params.
  * @param[out] pUpdateJob Represents if the job is accepted.
  * @return OtaJobParseErr_t OtaErrNone if successful, other error codes if failure.
  */
-static OtaJobParseErr_t verifyActiveJobStatus( OtaFileContext_t * pFileContext,
+static OtaJobParseErr_t verifyActiveJobStatus( OtaAgentContext_t * pAgentCtx,
+                                               OtaFileContext_t * pFileContext,
                                                OtaFileContext_t ** pFinalFile,
                                                bool * pUpdateJob );
 
 /**
  * @brief Check if all the file context params are valid and initialize resources for the job transfer.
  *
+ * @param[in] pAgentCtx The OTA agent context.
  * @param[in] pFileContext Information of file to be streamed.
  * @param[out] pFinalFile File that stores all extracted params.
  * @param[out] pUpdateJob Represents if the job is accepted.
  * @return OtaJobParseErr_t OtaJobParseErrNone if successful, other error codes if failure.
  */
-static OtaJobParseErr_t validateAndStartJob( OtaFileContext_t * pFileContext,
+static OtaJobParseErr_t validateAndStartJob( OtaAgentContext_t * pAgentCtx,
+                                             OtaFileContext_t * pFileContext,
                                              OtaFileContext_t ** pFinalFile,
                                              bool * pUpdateJob );
 
 /**
  * @brief Parse the OTA job document, validate and return the populated OTA context if valid.
  *
+ * @param[in] pAgentCtx The OTA agent context.
  * @param[in] pJson JSON job document.
  * @param[in] messageLength Length of the job document.
  * @param[in] pUpdateJob Represents if the job is accepted.
  * @return OtaFileContext_t* File context to store file information.
  */
-static OtaFileContext_t * parseJobDoc( const char * pJson,
+static OtaFileContext_t * parseJobDoc( OtaAgentContext_t * pAgentCtx,
+                                       const char * pJson,
                                        uint32_t messageLength,
                                        bool * pUpdateJob );
 
@@ -309,6 +315,7 @@ static bool validateDataBlock( const OtaFileContext_t * pFileContext,
 /**
  * @brief Decode and ingest the incoming data block.
  *
+ * @param[in] pAgentCtx The OTA agent context.
  * @param[in] pFileContext Information of file to be streamed.
  * @param[in] pRawMsg Raw job document.
  * @param[in] messageSize Length of document.
@@ -317,7 +324,8 @@ static bool validateDataBlock( const OtaFileContext_t * pFileContext,
  * @param[out] pBlockIndex Block index of incoming data block.
  * @return IngestResult_t IngestResultAccepted_Continue if successful, other error for failure.
  */
-static IngestResult_t decodeAndStoreDataBlock( OtaFileContext_t * pFileContext,
+static IngestResult_t decodeAndStoreDataBlock( OtaAgentContext_t * pAgentCtx,
+                                               OtaFileContext_t * pFileContext,
                                                const uint8_t * pRawMsg,
                                                uint32_t messageSize,
                                                uint8_t ** pPayload,
@@ -327,47 +335,60 @@ static IngestResult_t decodeAndStoreDataBlock( OtaFileContext_t * pFileContext,
 /**
  * @brief Close an open OTA file context and free it.
  *
+ * @param[in] pAgentCtx The OTA agent context.
  * @param[in] pFileContext Information of file to be streamed.
  * @return true if successful, false otherwise.
  */
-static bool otaClose( OtaFileContext_t * const pFileContext );
+static bool otaClose( OtaAgentContext_t * pAgentCtx,
+                      OtaFileContext_t * const pFileContext );
 
 /**
  * @brief OTA Timer callback.
  *
  * @param[in] otaTimerId Reference to the timer to use.
+ * @param[in] pCallbackContext The agent context that started the timer.
  */
-static void otaTimerCallback( OtaTimerId_t otaTimerId );
+static void otaTimerCallback( OtaTimerId_t otaTimerId,
+                              void * pCallbackContext );
 
 /**
  * @brief Internal function to set the image state including an optional reason code.
  *
+ * @param[in] pAgentCtx The OTA agent context.
  * @param[in] stateToSet State to set.
  * @param[in] reasonToSet Reason to set.
  * @return OtaErr_t OtaErrNone if successful, other codes on failure.
  */
-static OtaErr_t setImageStateWithReason( OtaImageState_t stateToSet,
+static OtaErr_t setImageStateWithReason( OtaAgentContext_t * pAgentCtx,
+                                         OtaImageState_t stateToSet,
                                          uint32_t reasonToSet );
 
 /**
  * @brief Internal function to update the job status to the jobs service from current image state.
  *
+ * @param[in] pAgentCtx The OTA agent context.
  * @param[in] state State to set.
  * @param[in] subReason Reason for status.
  * @return OtaErr_t OtaErrNone if successful, other codes on failure.
  */
-static OtaErr_t updateJobStatusFromImageState( OtaImageState_t state,
+static OtaErr_t updateJobStatusFromImageState( OtaAgentContext_t * pAgentCtx,
+                                               OtaImageState_t state,
                                                int32_t subReason );
 
 /**
  * @brief  A helper function to cleanup resources during OTA agent shutdown.
+ *
+ * @param[in] pAgentCtx The OTA agent context.
  */
-static void agentShutdownCleanup( void );
+static void agentShutdownCleanup( OtaAgentContext_t * pAgentCtx );
 
 /**
  * @brief A helper function to cleanup resources when data ingestion is complete.
+ *
+ * @param[in] pAgentCtx The OTA agent context.
  */
-static void dataHandlerCleanup( IngestResult_t result );
+static void dataHandlerCleanup( OtaAgentContext_t * pAgentCtx,
+                                IngestResult_t result );
 
 /**
  * @brief Prepare the document model for use by sanity checking the initialization parameters and detecting all required parameters.
@@ -388,122 +409,518 @@ static DocParseErr_t initDocModel( JsonDocModel_t * pDocModel,
 /**
  * @brief Initialize buffers for storing the file attributes.
  *
+ * @param[in] pAgentCtx The OTA agent context.
  * @param[out] pOtaBuffer OTA Application buffers.
  */
-static void initializeAppBuffers( OtaAppBuffer_t * pOtaBuffer );
+static void initializeAppBuffers( OtaAgentContext_t * pAgentCtx,
+                                  OtaAppBuffer_t * pOtaBuffer );
 
 /**
  * @brief Initialize jobId and protocol buffers.
+ *
+ * @param[in] pAgentCtx The OTA agent context.
+ */
+static void initializeLocalBuffers( OtaAgentContext_t * pAgentCtx );
+
+/**
+ * @brief Build the dense dispatch table from the state transition table.
+ *
+ * Every state and event pair is resolved to the index of the first matching
+ * entry of the transition table, with OtaAgentStateAll rows expanded across
+ * all states. Pairs without a match hold the length of the transition table.
+ * The table is only built by the first call.
  */
-static void initializeLocalBuffers( void );
+static void buildDispatchTable( void );
 
 /**
- * @brief Search the state transition table for the entry based on current state and incoming event.
+ * @brief Look up the transition table entry for the current state and incoming event.
  *
+ * @param[in] pAgentCtx The OTA agent context.
  * @param[in] pEventMsg Incoming event information.
- * @return uint32_t Index of the transition.
+ * @return uint32_t Index of the transition, or the length of the transition
+ * table if there is none.
  */
-static uint32_t searchTransition( const OtaEventMsg_t * pEventMsg );
+static uint32_t searchTransition( OtaAgentContext_t * pAgentCtx,
+                                  const OtaEventMsg_t * pEventMsg );
 
 /**
  * @brief Initiate download if not in self-test else reboot
  *
+ * @param[in] pAgentCtx The OTA agent context.
  * @return OtaErr_t OtaErrNone if successful.
  */
-static OtaErr_t processValidFileContext( void );
+static OtaErr_t processValidFileContext( OtaAgentContext_t * pAgentCtx );
 
 /**
  * @brief Validate update version when receiving job doc in self test state.
  *
+ * @param[in] pAgentCtx The OTA agent context.
  * @param[in] pFileContext Stores file information.
  */
-static void handleSelfTestJobDoc( OtaFileContext_t * pFileContext );
+static void handleSelfTestJobDoc( OtaAgentContext_t * pAgentCtx,
+                                  OtaFileContext_t * pFileContext );
 
 /**
  * @brief Handle invalid file context.
  *
+ * @param[in] pAgentCtx The OTA agent context.
  * @return OtaErr_t OtaErrNone if job parsing is handled.
  */
-static OtaErr_t processNullFileContext( void );
+static OtaErr_t processNullFileContext( OtaAgentContext_t * pAgentCtx );
 
 /**
  * @brief Check if the platform is in self-test
  *
+ * @param[in] pAgentCtx The OTA agent context.
  * @return true if in self-test, else false.
  */
-static bool platformInSelftest( void );
+static bool platformInSelftest( OtaAgentContext_t * pAgentCtx );
 
 /**
  * @brief Function to handle events that were unexpected in the current state.
  *
+ * @param[in] pAgentCtx The OTA agent context.
  * @param[in] pEventMsg Stores information of the event.
  */
-static void handleUnexpectedEvents( const OtaEventMsg_t * pEventMsg );
+static void handleUnexpectedEvents( OtaAgentContext_t * pAgentCtx,
+                                    const OtaEventMsg_t * pEventMsg );
+
+/**
+ * @brief Tell the application an event has been processed and release its buffer.
+ *
+ * The buffer is returned to the event buffer pool if it came from
+ * OTA_EventBufferGet.
+ *
+ * @param[in] pAgentCtx The OTA agent context.
+ * @param[in] pEventData The data of the processed event.
+ */
+static void notifyEventProcessed( OtaAgentContext_t * pAgentCtx,
+                                  const OtaEventData_t * pEventData );
+
+/**
+ * @brief Release the buffers of the events still queued when the agent shuts down.
+ *
+ * The shutdown event overtakes queued job documents and file blocks, and the
+ * agent does not receive events once it has stopped.
+ *
+ * @param[in] pAgentCtx The OTA agent context.
+ */
+static void drainEventQueue( OtaAgentContext_t * pAgentCtx );
+
+/**
+ * @brief Drop one reference to a buffer of the event buffer pool.
+ *
+ * Buffers that are not part of the pool are ignored.
+ *
+ * @param[in] pEventData The buffer to release.
+ */
+static void releaseEventBuffer( const OtaEventData_t * pEventData );
+
+/**
+ * @brief Check if a file block request should wait for an event buffer to be released.
+ *
+ * @return true if otaconfigEVENT_BUFFER_BACKPRESSURE is enabled and the
+ * event buffer pool has no free buffer, false otherwise.
+ */
+static bool holdBackFileBlockRequest( void );
+
+/**
+ * @brief Check if an event is delivered in the control lane.
+ *
+ * @param[in] eventId The event.
+ *
+ * @return true for the events of OtaEventLaneControl, false otherwise.
+ */
+static bool isControlEvent( OtaEvent_t eventId );
+
+/**
+ * @brief Check if an event can be dropped because an equivalent one is pending.
+ *
+ * At most one RequestTimer and one RequestFileBlock event are queued at a time.
+ * While the agent transfers a file a RequestTimer event is also redundant with
+ * a pending RequestFileBlock event, as both request the outstanding blocks.
+ * Events that are not dropped are marked as pending, control events are
+ * counted in controlEventsPending.
+ *
+ * @param[in] pAgentCtx The OTA agent context.
+ * @param[in] eventId The event being signaled.
+ *
+ * @return true if the event should be dropped, false if it should be queued.
+ */
+static bool coalesceEvent( OtaAgentContext_t * pAgentCtx,
+                           OtaEvent_t eventId );
+
+/**
+ * @brief Clear the pending mark of an event that has been received or could not be queued.
+ *
+ * @param[in] pAgentCtx The OTA agent context.
+ * @param[in] eventId The event.
+ */
+static void clearPendingEvent( OtaAgentContext_t * pAgentCtx,
+                               OtaEvent_t eventId );
+
+/**
+ * @brief Reset all the statistics counters.
+ *
+ * The sequence of the counters is odd while they are cleared. Resets from
+ * different tasks are done one after the other.
+ *
+ * @param[in] pAgentCtx The OTA agent context.
+ */
+static void resetStatistics( OtaAgentContext_t * pAgentCtx );
+
+/**
+ * @brief Adapt the file block request timeout to a request being sent.
+ *
+ * A request sent while the previous one got no response doubles the timeout.
+ * Its round trip time is not sampled, as the response cannot be told apart from
+ * a late response to the previous request. Otherwise the time is noted to
+ * sample the round trip time from the first block received.
+ *
+ * Does nothing unless the OS timer interface provides a time source.
+ *
+ * @param[in] pAgentCtx The OTA agent context.
+ */
+static void adaptRequestTimeoutOnRequest( OtaAgentContext_t * pAgentCtx );
+
+/**
+ * @brief Adapt the file block request timeout to a block being received.
+ *
+ * Takes a round trip time sample if one is pending, updates the smoothed round
+ * trip time and its variation, and sets the timeout from them.
+ *
+ * Does nothing unless the OS timer interface provides a time source.
+ *
+ * @param[in] pAgentCtx The OTA agent context.
+ */
+static void adaptRequestTimeoutOnBlock( OtaAgentContext_t * pAgentCtx );
+
+/**
+ * @brief Limit a file block request timeout to the configured bounds.
+ *
+ * @param[in] timeoutMs The timeout.
+ *
+ * @return The timeout between otaconfigFILE_REQUEST_WAIT_MIN_MS and
+ * otaconfigFILE_REQUEST_WAIT_MAX_MS.
+ */
+static uint32_t boundRequestTimeout( uint32_t timeoutMs );
+
+/**
+ * @brief Get the timeout of the file block request timer.
+ *
+ * Once the download of the file is in its endgame, see
+ * otaconfigENDGAME_NUM_BLOCKS, the timeout is shortened.
+ *
+ * @param[in] pAgentCtx The OTA agent context.
+ *
+ * @return The timeout in milliseconds.
+ */
+static uint32_t fileBlockRequestTimeout( const OtaAgentContext_t * pAgentCtx );
+
+/**
+ * @brief Look for a gap in the blocks received before a block.
+ *
+ * Moves past the blocks received since the last call and counts the blocks
+ * received past the lowest missing block. Once otaconfigFAST_RETRANSMIT_THRESHOLD
+ * blocks are past it, the missing block is due to be requested again, along
+ * with the other blocks missing before uBlockIndex. Their number is kept in
+ * retransmitNumBlocks for the request.
+ *
+ * @param[in] pAgentCtx The OTA agent context.
+ * @param[in] pFileContext Information of file to be streamed.
+ * @param[in] uBlockIndex The index of the block just received.
+ *
+ * @return true if the missing block should be requested again right away, false otherwise.
+ */
+static bool detectBlockGap( OtaAgentContext_t * pAgentCtx,
+                            const OtaFileContext_t * pFileContext,
+                            uint32_t uBlockIndex );
+
+/**
+ * @brief Seed the generator of random waits of an agent.
+ *
+ * The seed is taken from the Thing name, so that devices started at the same
+ * time still draw different waits, and from the time if a time source is
+ * available.
+ *
+ * @param[in] pAgentCtx The OTA agent context.
+ */
+static void seedRandom( OtaAgentContext_t * pAgentCtx );
+
+/**
+ * @brief Draw a pseudo-random number.
+ *
+ * @param[in] pAgentCtx The OTA agent context.
+ *
+ * @return The number.
+ */
+static uint32_t randomNumber( OtaAgentContext_t * pAgentCtx );
+
+/**
+ * @brief Get the wait before a failed or unanswered request is retried.
+ *
+ * The wait is drawn at random from baseMs up to three times the previous wait,
+ * and limited to the maximum of the request backoff.
+ *
+ * @param[in] pAgentCtx The OTA agent context.
+ * @param[in] baseMs The shortest wait.
+ *
+ * @return The wait in milliseconds.
+ */
+static uint32_t retryDelay( OtaAgentContext_t * pAgentCtx,
+                            uint32_t baseMs );
+
+/**
+ * @brief Decide whether the download progress is reported for the block just received.
+ *
+ * The progress is reported when it reaches the next otaconfigPROGRESS_PERCENT_STEP, or when
+ * otaconfigPROGRESS_MAX_INTERVAL_MS passed since the last report, but not sooner than
+ * otaconfigPROGRESS_MIN_INTERVAL_MS after it. Progress that is not reported is not kept; the
+ * next report carries the latest progress.
+ *
+ * @param[in] pAgentCtx The OTA agent context.
+ *
+ * @return true if the progress is to be reported, false otherwise.
+ */
+static bool progressReportDue( OtaAgentContext_t * pAgentCtx );
+
+/**
+ * @brief Publish the job status update that was deferred by the data handler.
+ *
+ * The download progress is not published while a block is processed. It is
+ * marked pending instead and published by this function between events, so that
+ * blocks never wait on the control plane. A pending update holds no data; the
+ * status is built when it is published and carries the latest progress. It stays
+ * pending while the connection is down.
+ *
+ * @param[in] pAgentCtx The OTA agent context.
+ */
+static void flushJobStatusOutbox( OtaAgentContext_t * pAgentCtx );
+
+/**
+ * @brief Check whether an event is held back because the connection is down.
+ *
+ * Requests cannot be sent without a connection. Request timer and file block request
+ * events are dropped while the connection is down, so the request timer stops and
+ * the request momentum is not charged. The connection up event sends the missing
+ * file blocks requests again. The job and file creation requests wait for the request
+ * timer, which the connection up event starts with a random delay, so that devices
+ * that lost the connection together do not all send their requests at once.
+ *
+ * @param[in] pAgentCtx The OTA agent context.
+ * @param[in] eventId The event to check.
+ * @return true if the event must not be processed, false otherwise.
+ */
+static bool heldBackByConnection( const OtaAgentContext_t * pAgentCtx,
+                                  OtaEvent_t eventId );
+
+#if ( otaconfigEVENT_BUFFER_POOL_SIZE > 0U )
+
+/**
+ * @brief Find a buffer in the event buffer pool.
+ *
+ * @param[in] pEventData The buffer to look for.
+ *
+ * @return The index of the buffer, or otaconfigEVENT_BUFFER_POOL_SIZE if it is
+ * not part of the pool.
+ */
+    static uint32_t eventBufferIndex( const OtaEventData_t * pEventData );
+#endif
 
 /**
  * @brief Free or clear multiple buffers used in the file context.
  *
+ * @param[in] pAgentCtx The OTA agent context.
  * @param[in] pFileContext Information of file to be streamed.
  */
-static void freeFileContextMem( OtaFileContext_t * const pFileContext );
+static void freeFileContextMem( OtaAgentContext_t * pAgentCtx,
+                                OtaFileContext_t * const pFileContext );
 
 /**
  * @brief Handle job parsing error.
  *
+ * @param[in] pAgentCtx The OTA agent context.
  * @param[in] pFileContext Pointer to the file context.
  *
  * @param[in] err Parsing error of type OtaJobParseErr_t.
  */
-static void handleJobParsingError( const OtaFileContext_t * pFileContext,
+static void handleJobParsingError( OtaAgentContext_t * pAgentCtx,
+                                   const OtaFileContext_t * pFileContext,
                                    OtaJobParseErr_t err );
 
 /**
- * @brief Receive and process the next available event from the event queue.
+ * @brief Receive and process the next available events from the event queue.
+ *
+ * If the event interface provides recvBatch, up to otaconfigMAX_EVENT_BATCH_SIZE
+ * pending events are received at once and processed in order. Otherwise one
+ * event is received with recv. The wait times out after otaconfigAGENT_IDLE_PERIOD_MS,
+ * in which case the idle hook is run instead.
+ *
+ * A batch is ended early when a control event is signaled while it is
+ * processed. The events left are deferred to the next call, which processes
+ * them after the control events received at the head of its batch.
+ *
+ * @param[in] pAgentCtx The OTA agent context.
+ */
+static void receiveAndProcessOtaEvent( OtaAgentContext_t * pAgentCtx );
+
+/**
+ * @brief Process one received event.
+ *
+ * @param[in] pAgentCtx The OTA agent context.
+ * @param[in] pEventMsg The event.
+ * @param[in] dropAfterShutdown Whether the event is dropped if the agent has stopped.
+ */
+static void handleReceivedEvent( OtaAgentContext_t * pAgentCtx,
+                                 const OtaEventMsg_t * pEventMsg,
+                                 bool dropAfterShutdown );
+
+/**
+ * @brief End a batch early for a pending control event.
+ *
+ * The control events left in the batch are processed right away, the other
+ * events are kept in deferredEvents.
+ *
+ * @param[in] pAgentCtx The OTA agent context.
+ * @param[in] pEventMsgs The events left in the batch.
+ * @param[in] numEvents The number of events left in the batch.
+ */
+static void endBatchEarly( OtaAgentContext_t * pAgentCtx,
+                           const OtaEventMsg_t * pEventMsgs,
+                           uint32_t numEvents );
+
+/**
+ * @brief Run the work deferred until the agent is idle.
+ *
+ * Called from the agent task when no event was received for
+ * otaconfigAGENT_IDLE_PERIOD_MS milliseconds.
+ *
+ * @param[in] pAgentCtx The OTA agent context.
+ */
+static void agentIdleHook( OtaAgentContext_t * pAgentCtx );
+
+/**
+ * @brief Process one event.
  *
- * Each event is processed based on the behavior defined in the OTA transition
+ * The event is processed based on the behavior defined in the OTA transition
  * table. The state of the OTA state machine will be updated and the
  * corresponding event handler will be called.
+ *
+ * @param[in] pAgentCtx The OTA agent context.
+ * @param[in] pEventMsg The event to process.
  */
-static void receiveAndProcessOtaEvent( void );
+static void processOtaEvent( OtaAgentContext_t * pAgentCtx,
+                             const OtaEventMsg_t * pEventMsg );
 
 /* OTA state event handler functions. */
 
-static OtaErr_t startHandler( const OtaEventData_t * pEventData );           /*!< Start timers and initiate request for job document. */
-static OtaErr_t requestJobHandler( const OtaEventData_t * pEventData );      /*!< Initiate a request for a job. */
-static OtaErr_t processJobHandler( const OtaEventData_t * pEventData );      /*!< Update file context from job document. */
-static OtaErr_t inSelfTestHandler( const OtaEventData_t * pEventData );      /*!< Handle self test. */
-static OtaErr_t initFileHandler( const OtaEventData_t * pEventData );        /*!< Initialize and handle file transfer. */
-static OtaErr_t processDataHandler( const OtaEventData_t * pEventData );     /*!< Process incoming data blocks. */
-static OtaErr_t requestDataHandler( const OtaEventData_t * pEventData );     /*!< Request for data blocks. */
-static OtaErr_t shutdownHandler( const OtaEventData_t * pEventData );        /*!< Shutdown OTA and cleanup. */
-static OtaErr_t closeFileHandler( const OtaEventData_t * pEventData );       /*!< Close file opened for download. */
-static OtaErr_t userAbortHandler( const OtaEventData_t * pEventData );       /*!< Handle user interrupt to abort task. */
-static OtaErr_t suspendHandler( const OtaEventData_t * pEventData );         /*!< Handle suspend event for OTA agent. */
-static OtaErr_t resumeHandler( const OtaEventData_t * pEventData );          /*!< Resume from a suspended state. */
-static OtaErr_t jobNotificationHandler( const OtaEventData_t * pEventData ); /*!< Upon receiving a new job document cancel current job if present and initiate new download. */
-static void executeHandler( uint32_t index,
+static OtaErr_t startHandler( OtaAgentContext_t * pAgentCtx,
+                              const OtaEventData_t * pEventData );           /*!< Start timers and initiate request for job document. */
+static OtaErr_t requestJobHandler( OtaAgentContext_t * pAgentCtx,
+                                   const OtaEventData_t * pEventData );      /*!< Initiate a request for a job. */
+static OtaErr_t processJobHandler( OtaAgentContext_t * pAgentCtx,
+                                   const OtaEventData_t * pEventData );      /*!< Update file context from job document. */
+static OtaErr_t inSelfTestHandler( OtaAgentContext_t * pAgentCtx,
+                                   const OtaEventData_t * pEventData );      /*!< Handle self test. */
+static OtaErr_t initFileHandler( OtaAgentContext_t * pAgentCtx,
+                                 const OtaEventData_t * pEventData );        /*!< Initialize and handle file transfer. */
+static OtaErr_t processDataHandler( OtaAgentContext_t * pAgentCtx,
+                                    const OtaEventData_t * pEventData );     /*!< Process incoming data blocks. */
+static OtaErr_t requestDataHandler( OtaAgentContext_t * pAgentCtx,
+                                    const OtaEventData_t * pEventData );     /*!< Request for data blocks. */
+static OtaErr_t shutdownHandler( OtaAgentContext_t * pAgentCtx,
+                                 const OtaEventData_t * pEventData );        /*!< Shutdown OTA and cleanup. */
+static OtaErr_t closeFileHandler( OtaAgentContext_t * pAgentCtx,
+                                  const OtaEventData_t * pEventData );       /*!< Close file opened for download. */
+static OtaErr_t userAbortHandler( OtaAgentContext_t * pAgentCtx,
+                                  const OtaEventData_t * pEventData );       /*!< Handle user interrupt to abort task. */
+static OtaErr_t suspendHandler( OtaAgentContext_t * pAgentCtx,
+                                const OtaEventData_t * pEventData );         /*!< Handle suspend event for OTA agent. */
+static OtaErr_t resumeHandler( OtaAgentContext_t * pAgentCtx,
+                               const OtaEventData_t * pEventData );          /*!< Resume from a suspended state. */
+static OtaErr_t resumeJobHandler( OtaAgentContext_t * pAgentCtx,
+                                  const OtaEventData_t * pEventData );       /*!< Request the job after a random wait once the connection is back. */
+static OtaErr_t resumeFileHandler( OtaAgentContext_t * pAgentCtx,
+                                   const OtaEventData_t * pEventData );      /*!< Create the file after a random wait once the connection is back. */
+static OtaErr_t resumeDataHandler( OtaAgentContext_t * pAgentCtx,
+                                   const OtaEventData_t * pEventData );      /*!< Request the missing blocks once the connection is back. */
+static OtaErr_t jobNotificationHandler( OtaAgentContext_t * pAgentCtx,
+                                        const OtaEventData_t * pEventData ); /*!< Upon receiving a new job document cancel current job if present and initiate new download. */
+static void executeHandler( OtaAgentContext_t * pAgentCtx,
+                            uint32_t index,
                             const OtaEventMsg_t * const pEventMsg );         /*!< Execute the handler for selected index from the transition table. */
 
 /**
- * @brief This is THE OTA agent context and initialization state.
+ * @brief The default OTA agent context, used by the API functions without a context argument.
  */
 static OtaAgentContext_t otaAgent =
 {
-    OtaAgentStateStopped, /* state */
-    { 0 },                /* pThingName */
-    { 0 },                /* fileContext */
-    0,                    /* fileIndex */
-    0,                    /* serverFileID */
-    { 0 },                /* pActiveJobName */
-    NULL,                 /* pClientTokenFromJob */
-    0,                    /* timestampFromJob */
-    OtaImageStateUnknown, /* imageState */
-    1,                    /* numOfBlocksToReceive */
-    { 0 },                /* statistics */
-    0,                    /* requestMomentum */
-    NULL,                 /* pOtaInterface */
-    NULL,                 /* OtaAppCallback */
-    1                     /* unsubscribe flag */
+    OtaAgentStateStopped,           /* state */
+    { 0 },                          /* pThingName */
+    { 0 },                          /* fileContext */
+    0,                              /* fileIndex */
+    0,                              /* serverFileID */
+    { 0 },                          /* pActiveJobName */
+    NULL,                           /* pClientTokenFromJob */
+    0,                              /* timestampFromJob */
+    OtaImageStateUnknown,           /* imageState */
+    1,                              /* numOfBlocksToReceive */
+    { 0 },                          /* statistics */
+    0,                              /* requestMomentum */
+    NULL,                           /* pOtaInterface */
+    NULL,                           /* OtaAppCallback */
+    1,                              /* unsubscribe flag */
+    { 0 },                          /* controlInterface */
+    { 0 },                          /* dataInterface */
+    { 0 },                          /* pJobNameBuffer */
+    { 0 },                          /* pProtocolBuffer */
+    { 0 },                          /* sig256Buffer */
+    #if ( otaconfigCUSTOM_JOB_DOC_INDEX == 1U )
+        { { { 0 } }, { 0 }, 0, false }, /* jobDocIndex */
+    #endif
+    0,                              /* requestTimerPending */
+    0,                              /* requestFileBlockPending */
+    0,                              /* httpCurrentBlock */
+    otaconfigFILE_REQUEST_WAIT_MS,  /* requestTimeoutMs */
+    0,                              /* requestSentTimeMs */
+    0,                              /* smoothedRttMs */
+    0,                              /* rttVariationMs */
+    false,                          /* rttSamplePending */
+    0,                              /* nextMissingBlock */
+    0,                              /* blocksPastGap */
+    false,                          /* gapRetransmitted */
+    false,                          /* fastRetransmitPending */
+    0,                              /* retransmitNumBlocks */
+    {
+        otaconfigREQUEST_BACKOFF_BASE_MS,
+        otaconfigREQUEST_BACKOFF_MAX_MS,
+        otaconfigJOB_START_DELAY_MAX_MS
+    },                              /* requestBackoff */
+    0,                              /* retryDelayMs */
+    0,                              /* randomState */
+    {
+        { 0 },
+        0,
+        { 0 },
+        0,
+        0,
+        { 0 },
+        0,
+        0,
+        false,
+        { 0 },
+        { 0 },
+        0,
+        0
+    },                              /* mqttCache */
+    0,                              /* progressReportTimeMs */
+    0,                              /* progressReportPercent */
+    false,                          /* progressStatusPending */
+    0,                              /* connectionGeneration */
+    0,                              /* connectionDown */
+    0,                              /* controlEventsPending */
+    { { 0 } },                      /* deferredEvents */
+    0                               /* numDeferredEvents */
 };
 
 /**
@@ -528,11 +945,36 @@ static OtaStateTableEntry_t otaTransitionTable[] =
     { OtaAgentStateWaitingForFileBlock, OtaAgentEventReceivedJobDocument, jobNotificationHandler, OtaAgentStateRequestingJob       },
     { OtaAgentStateWaitingForFileBlock, OtaAgentEventCloseFile,           closeFileHandler,       OtaAgentStateWaitingForJob       },
     { OtaAgentStateSuspended,           OtaAgentEventResume,              resumeHandler,          OtaAgentStateRequestingJob       },
+    { OtaAgentStateRequestingJob,       OtaAgentEventConnectionUp,        resumeJobHandler,       OtaAgentStateRequestingJob       },
+    { OtaAgentStateWaitingForJob,       OtaAgentEventConnectionUp,        resumeJobHandler,       OtaAgentStateRequestingJob       },
+    { OtaAgentStateCreatingFile,        OtaAgentEventConnectionUp,        resumeFileHandler,      OtaAgentStateCreatingFile        },
+    { OtaAgentStateRequestingFileBlock, OtaAgentEventConnectionUp,        resumeDataHandler,      OtaAgentStateWaitingForFileBlock },
+    { OtaAgentStateWaitingForFileBlock, OtaAgentEventConnectionUp,        resumeDataHandler,      OtaAgentStateWaitingForFileBlock },
     { OtaAgentStateAll,                 OtaAgentEventSuspend,             suspendHandler,         OtaAgentStateSuspended           },
     { OtaAgentStateAll,                 OtaAgentEventUserAbort,           userAbortHandler,       OtaAgentStateWaitingForJob       },
     { OtaAgentStateAll,                 OtaAgentEventShutdown,            shutdownHandler,        OtaAgentStateStopped             },
 };
 
+/**
+ * @brief Number of entries in otaTransitionTable.
+ */
+static const uint32_t otaTransitionTableLength = ( uint32_t ) ( sizeof( otaTransitionTable ) / sizeof( otaTransitionTable[ 0 ] ) );
+
+/**
+ * @brief Dense dispatch table indexed by state and event.
+ *
+ * Each entry holds the index into otaTransitionTable of the transition for the
+ * pair, so the event loop does a single load instead of a scan of the table.
+ * It is built from otaTransitionTable by buildDispatchTable() in the first
+ * OTA_InitCtx and is shared by all agent contexts.
+ */
+static uint8_t otaDispatchTable[ OtaAgentStateAll ][ OtaAgentEventMax ];
+
+/**
+ * @brief Nonzero once otaDispatchTable is built.
+ */
+static uint32_t otaDispatchTableBuilt = 0;
+
 /* MISRA rule 2.2 warns about unused variables. These 2 variables are used in log messages, which is
  * disabled when running static analysis. So it's a false positive. */
 /* coverity[misra_c_2012_rule_2_2_violation] */
@@ -569,16 +1011,24 @@ static const char * pOtaEventStrings[ OtaAgentEventMax ] =
     "Suspend",
     "Resume",
     "UserAbort",
-    "Shutdown"
+    "Shutdown",
+    "ConnectionUp"
 };
 
-static uint8_t pJobNameBuffer[ OTA_JOB_ID_MAX_SIZE ];       /*!< Buffer to store job name. */
-static uint8_t pProtocolBuffer[ OTA_PROTOCOL_BUFFER_SIZE ]; /*!< Buffer to store data protocol. */
-static Sig256_t sig256Buffer;                               /*!< Buffer to store key file signature. */
+/* The event buffer pool is shared by all agent contexts. Buffers are claimed and
+ * released with compare-and-swap on their reference counts, so no lock is needed. */
+#if ( otaconfigEVENT_BUFFER_POOL_SIZE > 0U )
+    static OtaEventData_t otaEventBufferPool[ otaconfigEVENT_BUFFER_POOL_SIZE ]; /*!< Buffers handed out by OTA_EventBufferGet. */
+    static uint32_t otaEventBufferRefs[ otaconfigEVENT_BUFFER_POOL_SIZE ];       /*!< Reference counts of the pool buffers, zero when free. */
+#endif
 
-static void otaTimerCallback( OtaTimerId_t otaTimerId )
+static void otaTimerCallback( OtaTimerId_t otaTimerId,
+                              void * pCallbackContext )
 {
+    OtaAgentContext_t * pAgentCtx = ( OtaAgentContext_t * ) pCallbackContext;
+
     assert( ( otaTimerId == OtaRequestTimer ) || ( otaTimerId == OtaSelfTestTimer ) );
+    assert( pAgentCtx != NULL );
 
     if( otaTimerId == OtaRequestTimer )
     {
@@ -590,7 +1040,7 @@ static void otaTimerCallback( OtaTimerId_t otaTimerId )
         xEventMsg.eventId = OtaAgentEventRequestTimer;
 
         /* Send request timer event. */
-        if( OTA_SignalEvent( &xEventMsg ) == false )
+        if( OTA_SignalEventCtx( pAgentCtx, &xEventMsg ) == false )
         {
             LogError( ( "Failed to signal the OTA Agent to start request timer" ) );
         }
@@ -600,19 +1050,19 @@ static void otaTimerCallback( OtaTimerId_t otaTimerId )
         LogError( ( "Self test failed to complete within %ums",
                     otaconfigSELF_TEST_RESPONSE_WAIT_MS ) );
 
-        ( void ) otaAgent.pOtaInterface->pal.reset( &otaAgent.fileContext );
+        ( void ) pAgentCtx->pOtaInterface->pal.reset( &pAgentCtx->fileContext );
     }
 }
 
 
-static bool platformInSelftest( void )
+static bool platformInSelftest( OtaAgentContext_t * pAgentCtx )
 {
     bool selfTest = false;
 
     /*
      * Get the platform state from the OTA pal layer.
      */
-    if( otaAgent.pOtaInterface->pal.getPlatformImageState( &( otaAgent.fileContext ) ) == OtaPalImageStatePendingCommit )
+    if( pAgentCtx->pOtaInterface->pal.getPlatformImageState( &( pAgentCtx->fileContext ) ) == OtaPalImageStatePendingCommit )
     {
         selfTest = true;
     }
@@ -620,7 +1070,8 @@ static bool platformInSelftest( void )
     return selfTest;
 }
 
-static OtaErr_t updateJobStatusFromImageState( OtaImageState_t state,
+static OtaErr_t updateJobStatusFromImageState( OtaAgentContext_t * pAgentCtx,
+                                               OtaImageState_t state,
                                                int32_t subReason )
 {
     OtaErr_t err = OtaErrNone;
@@ -629,20 +1080,20 @@ static OtaErr_t updateJobStatusFromImageState( OtaImageState_t state,
     if( state == OtaImageStateTesting )
     {
         /* We discovered we're ready for test mode, put job status in self_test active. */
-        err = otaControlInterface.updateJobStatus( &otaAgent,
-                                                   JobStatusInProgress,
-                                                   JobReasonSelfTestActive,
-                                                   0 );
+        err = pAgentCtx->controlInterface.updateJobStatus( pAgentCtx,
+                                                           JobStatusInProgress,
+                                                           JobReasonSelfTestActive,
+                                                           0 );
     }
     else
     {
         if( state == OtaImageStateAccepted )
         {
             /* Now that we have accepted the firmware update, we can complete the job. */
-            err = otaControlInterface.updateJobStatus( &otaAgent,
-                                                       JobStatusSucceeded,
-                                                       JobReasonAccepted,
-                                                       appFirmwareVersion.u.signedVersion32 );
+            err = pAgentCtx->controlInterface.updateJobStatus( pAgentCtx,
+                                                               JobStatusSucceeded,
+                                                               JobReasonAccepted,
+                                                               appFirmwareVersion.u.signedVersion32 );
         }
         else
         {
@@ -651,22 +1102,23 @@ static OtaErr_t updateJobStatusFromImageState( OtaImageState_t state,
              * will not allow us to set REJECTED after the job has been started already).
              */
             reason = ( state == OtaImageStateRejected ) ? JobReasonRejected : JobReasonAborted;
-            err = otaControlInterface.updateJobStatus( &otaAgent,
-                                                       JobStatusFailed,
-                                                       reason,
-                                                       subReason );
+            err = pAgentCtx->controlInterface.updateJobStatus( pAgentCtx,
+                                                               JobStatusFailed,
+                                                               reason,
+                                                               subReason );
         }
 
         /*
          * We don't need the job name memory anymore since we're done with this job.
          */
-        ( void ) memset( otaAgent.pActiveJobName, 0, OTA_JOB_ID_MAX_SIZE );
+        ( void ) memset( pAgentCtx->pActiveJobName, 0, OTA_JOB_ID_MAX_SIZE );
     }
 
     return err;
 }
 
-static OtaErr_t setImageStateWithReason( OtaImageState_t stateToSet,
+static OtaErr_t setImageStateWithReason( OtaAgentContext_t * pAgentCtx,
+                                         OtaImageState_t stateToSet,
                                          uint32_t reasonToSet )
 {
     OtaErr_t err = OtaErrNone;
@@ -675,7 +1127,7 @@ static OtaErr_t setImageStateWithReason( OtaImageState_t stateToSet,
     OtaPalStatus_t palStatus;
 
     /* Call the platform specific code to set the image state. */
-    palStatus = otaAgent.pOtaInterface->pal.setPlatformImageState( &( otaAgent.fileContext ), state );
+    palStatus = pAgentCtx->pOtaInterface->pal.setPlatformImageState( &( pAgentCtx->fileContext ), state );
 
     /*
      * If the platform image state couldn't be set correctly, force fail the update by setting the
@@ -699,11 +1151,11 @@ static OtaErr_t setImageStateWithReason( OtaImageState_t stateToSet,
     }
 
     /* Now update the image state and job status on service side. */
-    otaAgent.imageState = state;
+    pAgentCtx->imageState = state;
 
-    if( strlen( ( const char * ) otaAgent.pActiveJobName ) > 0u )
+    if( strlen( ( const char * ) pAgentCtx->pActiveJobName ) > 0u )
     {
-        err = updateJobStatusFromImageState( state, ( int32_t ) reason );
+        err = updateJobStatusFromImageState( pAgentCtx, state, ( int32_t ) reason );
     }
     else
     {
@@ -726,7 +1178,8 @@ static OtaErr_t setImageStateWithReason( OtaImageState_t stateToSet,
     return err;
 }
 
-static OtaErr_t startHandler( const OtaEventData_t * pEventData )
+static OtaErr_t startHandler( OtaAgentContext_t * pAgentCtx,
+                              const OtaEventData_t * pEventData )
 {
     OtaErr_t retVal = OtaErrNone;
     OtaEventMsg_t eventMsg = { 0 };
@@ -734,18 +1187,20 @@ static OtaErr_t startHandler( const OtaEventData_t * pEventData )
     ( void ) pEventData;
 
     /* Start self-test timer, if platform is in self-test. */
-    if( platformInSelftest() == true )
+    if( platformInSelftest( pAgentCtx ) == true )
     {
-        ( void ) otaAgent.pOtaInterface->os.timer.start( OtaSelfTestTimer,
-                                                         "OtaSelfTestTimer",
-                                                         otaconfigSELF_TEST_RESPONSE_WAIT_MS,
-                                                         otaTimerCallback );
+        ( void ) pAgentCtx->pOtaInterface->os.timer.start( pAgentCtx->pOtaInterface->os.timer.pTimerContext,
+                                                           OtaSelfTestTimer,
+                                                           "OtaSelfTestTimer",
+                                                           otaconfigSELF_TEST_RESPONSE_WAIT_MS,
+                                                           otaTimerCallback,
+                                                           pAgentCtx );
     }
 
     /* Send event to OTA task to get job document. */
     eventMsg.eventId = OtaAgentEventRequestJobDocument;
 
-    if( OTA_SignalEvent( &eventMsg ) == false )
+    if( OTA_SignalEventCtx( pAgentCtx, &eventMsg ) == false )
     {
         retVal = OtaErrSignalEventFailed;
     }
@@ -753,7 +1208,8 @@ static OtaErr_t startHandler( const OtaEventData_t * pEventData )
     return retVal;
 }
 
-static OtaErr_t inSelfTestHandler( const OtaEventData_t * pEventData )
+static OtaErr_t inSelfTestHandler( OtaAgentContext_t * pAgentCtx,
+                                   const OtaEventData_t * pEventData )
 {
     OtaErr_t err = OtaErrNone;
 
@@ -762,16 +1218,17 @@ static OtaErr_t inSelfTestHandler( const OtaEventData_t * pEventData )
     LogInfo( ( "Beginning self-test." ) );
 
     /* Check the platform's OTA update image state. It should also be in self test. */
-    if( platformInSelftest() == true )
+    if( platformInSelftest( pAgentCtx ) == true )
     {
         /* Callback for application specific self-test. */
-        otaAgent.OtaAppCallback( OtaJobEventStartTest, NULL );
+        pAgentCtx->OtaAppCallback( OtaJobEventStartTest, NULL );
 
         /* Clear self-test flag. */
-        otaAgent.fileContext.isInSelfTest = false;
+        pAgentCtx->fileContext.isInSelfTest = false;
 
         /* Stop the self test timer as it is no longer required. */
-        ( void ) otaAgent.pOtaInterface->os.timer.stop( OtaSelfTestTimer );
+        ( void ) pAgentCtx->pOtaInterface->os.timer.stop( pAgentCtx->pOtaInterface->os.timer.pTimerContext,
+                                                          OtaSelfTestTimer );
     }
     else
     {
@@ -781,8 +1238,8 @@ static OtaErr_t inSelfTestHandler( const OtaEventData_t * pEventData )
         LogWarn( ( "Rejecting new image and rebooting:"
                    "The job is in the self-test state while the platform is not." ) );
 
-        err = setImageStateWithReason( OtaImageStateRejected, ( uint32_t ) OtaErrImageStateMismatch );
-        ( void ) otaAgent.pOtaInterface->pal.reset( &( otaAgent.fileContext ) );
+        err = setImageStateWithReason( pAgentCtx, OtaImageStateRejected, ( uint32_t ) OtaErrImageStateMismatch );
+        ( void ) pAgentCtx->pOtaInterface->pal.reset( &( pAgentCtx->fileContext ) );
     }
 
     if( err != OtaErrNone )
@@ -795,7 +1252,8 @@ static OtaErr_t inSelfTestHandler( const OtaEventData_t * pEventData )
     return err;
 }
 
-static OtaErr_t requestJobHandler( const OtaEventData_t * pEventData )
+static OtaErr_t requestJobHandler( OtaAgentContext_t * pAgentCtx,
+                                   const OtaEventData_t * pEventData )
 {
     OtaErr_t retVal = OtaErrUninitialized;
     OtaOsStatus_t osErr = OtaOsSuccess;
@@ -806,17 +1264,19 @@ static OtaErr_t requestJobHandler( const OtaEventData_t * pEventData )
     /*
      * Check if any pending jobs are available from job service.
      */
-    retVal = otaControlInterface.requestJob( &otaAgent );
+    retVal = pAgentCtx->controlInterface.requestJob( pAgentCtx );
 
     if( retVal != OtaErrNone )
     {
-        if( otaAgent.requestMomentum < otaconfigMAX_NUM_REQUEST_MOMENTUM )
+        if( pAgentCtx->requestMomentum < otaconfigMAX_NUM_REQUEST_MOMENTUM )
         {
-            /* Start the request timer. */
-            osErr = otaAgent.pOtaInterface->os.timer.start( OtaRequestTimer,
-                                                            "OtaRequestTimer",
-                                                            otaconfigFILE_REQUEST_WAIT_MS,
-                                                            otaTimerCallback );
+            /* Start the request timer to retry after a random backoff. */
+            osErr = pAgentCtx->pOtaInterface->os.timer.start( pAgentCtx->pOtaInterface->os.timer.pTimerContext,
+                                                              OtaRequestTimer,
+                                                              "OtaRequestTimer",
+                                                              retryDelay( pAgentCtx, OTA_ATOMIC_LOAD_RELAXED_U32( &pAgentCtx->requestBackoff.baseMs ) ),
+                                                              otaTimerCallback,
+                                                              pAgentCtx );
 
             if( osErr != OtaOsSuccess )
             {
@@ -827,18 +1287,19 @@ static OtaErr_t requestJobHandler( const OtaEventData_t * pEventData )
             }
             else
             {
-                otaAgent.requestMomentum++;
+                pAgentCtx->requestMomentum++;
             }
         }
         else
         {
             /* Stop the request timer. */
-            ( void ) otaAgent.pOtaInterface->os.timer.stop( OtaRequestTimer );
+            ( void ) pAgentCtx->pOtaInterface->os.timer.stop( pAgentCtx->pOtaInterface->os.timer.pTimerContext,
+                                                              OtaRequestTimer );
 
             /* Send shutdown event to the OTA Agent task. */
             eventMsg.eventId = OtaAgentEventShutdown;
 
-            if( OTA_SignalEvent( &eventMsg ) == false )
+            if( OTA_SignalEventCtx( pAgentCtx, &eventMsg ) == false )
             {
                 retVal = OtaErrSignalEventFailed;
             }
@@ -853,27 +1314,29 @@ static OtaErr_t requestJobHandler( const OtaEventData_t * pEventData )
     else
     {
         /* Stop the request timer. */
-        ( void ) otaAgent.pOtaInterface->os.timer.stop( OtaRequestTimer );
+        ( void ) pAgentCtx->pOtaInterface->os.timer.stop( pAgentCtx->pOtaInterface->os.timer.pTimerContext,
+                                                          OtaRequestTimer );
 
-        /* Reset the request momentum. */
-        otaAgent.requestMomentum = 0;
+        /* Reset the request momentum and backoff. */
+        pAgentCtx->requestMomentum = 0;
+        pAgentCtx->retryDelayMs = 0;
     }
 
     return retVal;
 }
 
-static OtaErr_t processNullFileContext( void )
+static OtaErr_t processNullFileContext( OtaAgentContext_t * pAgentCtx )
 {
     OtaErr_t retVal = OtaErrNone;
     OtaEventMsg_t eventMsg = { 0 };
 
     /* If the OTA job is in the self_test state, alert the application layer. */
-    if( OTA_GetImageState() == OtaImageStateTesting )
+    if( OTA_GetImageStateCtx( pAgentCtx ) == OtaImageStateTesting )
     {
         /* Send event to OTA task to start self-test. */
         eventMsg.eventId = OtaAgentEventStartSelfTest;
 
-        if( OTA_SignalEvent( &eventMsg ) == false )
+        if( OTA_SignalEventCtx( pAgentCtx, &eventMsg ) == false )
         {
             retVal = OtaErrSignalEventFailed;
         }
@@ -888,7 +1351,7 @@ static OtaErr_t processNullFileContext( void )
          */
         LogError( ( "OTA job doc parse failed: OtaErr_t=%s, aborting current update.", OTA_Err_strerror( retVal ) ) );
 
-        retVal = setImageStateWithReason( OtaImageStateAborted, ( uint32_t ) OtaErrJobParserError );
+        retVal = setImageStateWithReason( pAgentCtx, OtaImageStateAborted, ( uint32_t ) OtaErrJobParserError );
 
         if( retVal != OtaErrNone )
         {
@@ -901,28 +1364,47 @@ static OtaErr_t processNullFileContext( void )
     return retVal;
 }
 
-static OtaErr_t processValidFileContext( void )
+static OtaErr_t processValidFileContext( OtaAgentContext_t * pAgentCtx )
 {
     OtaErr_t retVal = OtaErrNone;
+    OtaOsStatus_t osErr = OtaOsTimerStartFailed;
     OtaEventMsg_t eventMsg = { 0 };
+    uint32_t startDelayMaxMs = 0;
 
     /* If the platform is not in the self_test state, initiate file download. */
-    if( platformInSelftest() == false )
+    if( platformInSelftest( pAgentCtx ) == false )
     {
         /* Init data interface routines */
-        retVal = setDataInterface( &otaDataInterface, otaAgent.fileContext.pProtocols );
+        retVal = setDataInterface( &pAgentCtx->dataInterface, pAgentCtx->fileContext.pProtocols );
 
         if( retVal == OtaErrNone )
         {
             LogInfo( ( "Setting OTA data interface." ) );
 
-            /* Received a valid context so send event to request file blocks. */
-            eventMsg.eventId = OtaAgentEventCreateFile;
+            /* Spread out the start of the downloads of devices that received the job at the
+             * same time. The request timer creates the file once the random delay expires. */
+            startDelayMaxMs = OTA_ATOMIC_LOAD_RELAXED_U32( &pAgentCtx->requestBackoff.startDelayMaxMs );
 
-            /*Send the event to OTA Agent task. */
-            if( OTA_SignalEvent( &eventMsg ) == false )
+            if( startDelayMaxMs > 0U )
             {
-                retVal = OtaErrSignalEventFailed;
+                osErr = pAgentCtx->pOtaInterface->os.timer.start( pAgentCtx->pOtaInterface->os.timer.pTimerContext,
+                                                                  OtaRequestTimer,
+                                                                  "OtaRequestTimer",
+                                                                  1U + ( randomNumber( pAgentCtx ) % startDelayMaxMs ),
+                                                                  otaTimerCallback,
+                                                                  pAgentCtx );
+            }
+
+            if( osErr != OtaOsSuccess )
+            {
+                /* Received a valid context so send event to request file blocks. */
+                eventMsg.eventId = OtaAgentEventCreateFile;
+
+                /*Send the event to OTA Agent task. */
+                if( OTA_SignalEventCtx( pAgentCtx, &eventMsg ) == false )
+                {
+                    retVal = OtaErrSignalEventFailed;
+                }
             }
         }
         else
@@ -933,7 +1415,7 @@ static OtaErr_t processValidFileContext( void )
              */
             LogError( ( "Failed to set OTA data interface: OtaErr_t=%s, aborting current update.", OTA_Err_strerror( retVal ) ) );
 
-            retVal = setImageStateWithReason( OtaImageStateAborted, ( uint32_t ) retVal );
+            retVal = setImageStateWithReason( pAgentCtx, OtaImageStateAborted, ( uint32_t ) retVal );
 
             if( retVal != OtaErrNone )
             {
@@ -950,13 +1432,14 @@ static OtaErr_t processValidFileContext( void )
         LogWarn( ( "Rejecting new image and rebooting:"
                    "The platform is in the self-test state while the job is not." ) );
 
-        ( void ) otaAgent.pOtaInterface->pal.reset( &( otaAgent.fileContext ) );
+        ( void ) pAgentCtx->pOtaInterface->pal.reset( &( pAgentCtx->fileContext ) );
     }
 
     return retVal;
 }
 
-static OtaErr_t processJobHandler( const OtaEventData_t * pEventData )
+static OtaErr_t processJobHandler( OtaAgentContext_t * pAgentCtx,
+                                   const OtaEventData_t * pEventData )
 {
     OtaErr_t retVal = OtaErrNone;
     OtaFileContext_t * pOtaFileContext = NULL;
@@ -964,7 +1447,8 @@ static OtaErr_t processJobHandler( const OtaEventData_t * pEventData )
     /*
      * Parse the job document and update file information in the file context.
      */
-    pOtaFileContext = getFileContextFromJob( ( const char * ) pEventData->data,
+    pOtaFileContext = getFileContextFromJob( pAgentCtx,
+                                             ( const char * ) pEventData->data,
                                              pEventData->dataLength );
 
     /*
@@ -975,20 +1459,21 @@ static OtaErr_t processJobHandler( const OtaEventData_t * pEventData )
      */
     if( pOtaFileContext == NULL )
     {
-        retVal = processNullFileContext();
+        retVal = processNullFileContext( pAgentCtx );
     }
     else
     {
-        retVal = processValidFileContext();
+        retVal = processValidFileContext( pAgentCtx );
     }
 
     /* Application callback for event processed. */
-    otaAgent.OtaAppCallback( OtaJobEventProcessed, ( const void * ) pEventData );
+    notifyEventProcessed( pAgentCtx, pEventData );
 
     return retVal;
 }
 
-static OtaErr_t initFileHandler( const OtaEventData_t * pEventData )
+static OtaErr_t initFileHandler( OtaAgentContext_t * pAgentCtx,
+                                 const OtaEventData_t * pEventData )
 {
     OtaErr_t err = OtaErrUninitialized;
     OtaOsStatus_t osErr = OtaOsSuccess;
@@ -996,17 +1481,19 @@ static OtaErr_t initFileHandler( const OtaEventData_t * pEventData )
 
     ( void ) pEventData;
 
-    err = otaDataInterface.initFileTransfer( &otaAgent );
+    err = pAgentCtx->dataInterface.initFileTransfer( pAgentCtx );
 
     if( err != OtaErrNone )
     {
-        if( otaAgent.requestMomentum < otaconfigMAX_NUM_REQUEST_MOMENTUM )
+        if( pAgentCtx->requestMomentum < otaconfigMAX_NUM_REQUEST_MOMENTUM )
         {
-            /* Start the request timer. */
-            osErr = otaAgent.pOtaInterface->os.timer.start( OtaRequestTimer,
-                                                            "OtaRequestTimer",
-                                                            otaconfigFILE_REQUEST_WAIT_MS,
-                                                            otaTimerCallback );
+            /* Start the request timer to retry after a random backoff. */
+            osErr = pAgentCtx->pOtaInterface->os.timer.start( pAgentCtx->pOtaInterface->os.timer.pTimerContext,
+                                                              OtaRequestTimer,
+                                                              "OtaRequestTimer",
+                                                              retryDelay( pAgentCtx, OTA_ATOMIC_LOAD_RELAXED_U32( &pAgentCtx->requestBackoff.baseMs ) ),
+                                                              otaTimerCallback,
+                                                              pAgentCtx );
 
             if( osErr != OtaOsSuccess )
             {
@@ -1017,18 +1504,19 @@ static OtaErr_t initFileHandler( const OtaEventData_t * pEventData )
             }
             else
             {
-                otaAgent.requestMomentum++;
+                pAgentCtx->requestMomentum++;
             }
         }
         else
         {
             /* Stop the request timer. */
-            ( void ) otaAgent.pOtaInterface->os.timer.stop( OtaRequestTimer );
+            ( void ) pAgentCtx->pOtaInterface->os.timer.stop( pAgentCtx->pOtaInterface->os.timer.pTimerContext,
+                                                              OtaRequestTimer );
 
             /* Send shutdown event. */
             eventMsg.eventId = OtaAgentEventShutdown;
 
-            if( OTA_SignalEvent( &eventMsg ) == false )
+            if( OTA_SignalEventCtx( pAgentCtx, &eventMsg ) == false )
             {
                 err = OtaErrSignalEventFailed;
             }
@@ -1042,15 +1530,16 @@ static OtaErr_t initFileHandler( const OtaEventData_t * pEventData )
     }
     else
     {
-        /* Reset the request momentum. */
-        otaAgent.requestMomentum = 0;
+        /* Reset the request momentum and backoff. */
+        pAgentCtx->requestMomentum = 0;
+        pAgentCtx->retryDelayMs = 0;
 
         /* Reset the OTA statistics. */
-        ( void ) memset( &otaAgent.statistics, 0, sizeof( otaAgent.statistics ) );
+        resetStatistics( pAgentCtx );
 
         eventMsg.eventId = OtaAgentEventRequestFileBlock;
 
-        if( OTA_SignalEvent( &eventMsg ) == false )
+        if( OTA_SignalEventCtx( pAgentCtx, &eventMsg ) == false )
         {
             err = OtaErrSignalEventFailed;
         }
@@ -1059,38 +1548,67 @@ static OtaErr_t initFileHandler( const OtaEventData_t * pEventData )
     return err;
 }
 
-static OtaErr_t requestDataHandler( const OtaEventData_t * pEventData )
+static OtaErr_t requestDataHandler( OtaAgentContext_t * pAgentCtx,
+                                    const OtaEventData_t * pEventData )
 {
     OtaErr_t err = OtaErrNone;
     OtaOsStatus_t osErr = OtaOsSuccess;
     OtaEventMsg_t eventMsg = { 0 };
+    uint32_t timeoutMs = 0;
 
     ( void ) pEventData;
 
-    if( otaAgent.fileContext.blocksRemaining > 0U )
+    if( pAgentCtx->fileContext.blocksRemaining > 0U )
     {
-        /* Start the request timer. */
-        osErr = otaAgent.pOtaInterface->os.timer.start( OtaRequestTimer,
-                                                        "OtaRequestTimer",
-                                                        otaconfigFILE_REQUEST_WAIT_MS,
-                                                        otaTimerCallback );
+        adaptRequestTimeoutOnRequest( pAgentCtx );
+
+        /* Back off at random from the request timeout if the last request went unanswered. */
+        timeoutMs = fileBlockRequestTimeout( pAgentCtx );
 
-        if( ( osErr == OtaOsSuccess ) && ( otaAgent.requestMomentum < otaconfigMAX_NUM_REQUEST_MOMENTUM ) )
+        if( pAgentCtx->requestMomentum > 0U )
+        {
+            timeoutMs = retryDelay( pAgentCtx, timeoutMs );
+        }
+
+        /* Start the request timer. */
+        osErr = pAgentCtx->pOtaInterface->os.timer.start( pAgentCtx->pOtaInterface->os.timer.pTimerContext,
+                                                          OtaRequestTimer,
+                                                          "OtaRequestTimer",
+                                                          timeoutMs,
+                                                          otaTimerCallback,
+                                                          pAgentCtx );
+
+        if( ( osErr == OtaOsSuccess ) && ( pAgentCtx->requestMomentum < otaconfigMAX_NUM_REQUEST_MOMENTUM ) )
         {
-            /* Request data blocks. */
-            err = otaDataInterface.requestFileBlock( &otaAgent );
+            if( holdBackFileBlockRequest() == true )
+            {
+                /* There is no buffer to receive the blocks into. Leave it to the
+                 * request timer to try again once queued blocks are processed. */
+                ( void ) OTA_ATOMIC_ADD_RELAXED_U32( &pAgentCtx->statistics.otaRequestsDeferred, 1U );
+
+                LogDebug( ( "Deferred file block request: No free event buffer." ) );
+            }
+            else
+            {
+                /* Request data blocks. */
+                err = pAgentCtx->dataInterface.requestFileBlock( pAgentCtx );
+
+                /* Blocks after a gap are requested in full again. */
+                pAgentCtx->retransmitNumBlocks = 0;
 
-            /* Each request increases the momentum until a response is received. Too much momentum is
-             * interpreted as a failure to communicate and will cause us to abort the OTA. */
-            otaAgent.requestMomentum++;
+                /* Each request increases the momentum until a response is received. Too much momentum is
+                 * interpreted as a failure to communicate and will cause us to abort the OTA. */
+                pAgentCtx->requestMomentum++;
+            }
         }
         else
         {
             /* Stop the request timer. */
-            ( void ) otaAgent.pOtaInterface->os.timer.stop( OtaRequestTimer );
+            ( void ) pAgentCtx->pOtaInterface->os.timer.stop( pAgentCtx->pOtaInterface->os.timer.pTimerContext,
+                                                              OtaRequestTimer );
 
             /* Failed to send data request abort and close file. */
-            err = setImageStateWithReason( OtaImageStateAborted, ( uint32_t ) err );
+            err = setImageStateWithReason( pAgentCtx, OtaImageStateAborted, ( uint32_t ) err );
 
             if( err != OtaErrNone )
             {
@@ -1100,7 +1618,7 @@ static OtaErr_t requestDataHandler( const OtaEventData_t * pEventData )
             /* Send shutdown event. */
             eventMsg.eventId = OtaAgentEventShutdown;
 
-            if( OTA_SignalEvent( &eventMsg ) == false )
+            if( OTA_SignalEventCtx( pAgentCtx, &eventMsg ) == false )
             {
                 err = OtaErrSignalEventFailed;
             }
@@ -1111,7 +1629,7 @@ static OtaErr_t requestDataHandler( const OtaEventData_t * pEventData )
                 err = OtaErrMomentumAbort;
 
                 /* Reset the request momentum. */
-                otaAgent.requestMomentum = 0;
+                pAgentCtx->requestMomentum = 0;
             }
         }
     }
@@ -1119,12 +1637,17 @@ static OtaErr_t requestDataHandler( const OtaEventData_t * pEventData )
     return err;
 }
 
-static void dataHandlerCleanup( IngestResult_t result )
+static void dataHandlerCleanup( OtaAgentContext_t * pAgentCtx,
+                                IngestResult_t result )
 {
     OtaEventMsg_t eventMsg = { 0 };
 
     /* Stop the request timer. */
-    ( void ) otaAgent.pOtaInterface->os.timer.stop( OtaRequestTimer );
+    ( void ) pAgentCtx->pOtaInterface->os.timer.stop( pAgentCtx->pOtaInterface->os.timer.pTimerContext,
+                                                      OtaRequestTimer );
+
+    /* The final job status supersedes any progress not yet published. */
+    pAgentCtx->progressStatusPending = false;
 
     /* Negative result codes mean we should stop the OTA process
      * because we are either done or in an unrecoverable error state.
@@ -1133,7 +1656,7 @@ static void dataHandlerCleanup( IngestResult_t result )
     /* Send event to close file. */
     eventMsg.eventId = OtaAgentEventCloseFile;
 
-    if( OTA_SignalEvent( &eventMsg ) == false )
+    if( OTA_SignalEventCtx( pAgentCtx, &eventMsg ) == false )
     {
         LogWarn( ( "Failed to trigger closing file: "
                    "Unable to signal event: "
@@ -1142,13 +1665,14 @@ static void dataHandlerCleanup( IngestResult_t result )
     }
 
     /* Let main application know of our result. */
-    otaAgent.OtaAppCallback( ( result == IngestResultFileComplete ) ? OtaJobEventActivate : OtaJobEventFail, NULL );
+    pAgentCtx->OtaAppCallback( ( result == IngestResultFileComplete ) ? OtaJobEventActivate : OtaJobEventFail, NULL );
 
     /* Clear any remaining string memory holding the job name since this job is done. */
-    ( void ) memset( otaAgent.pActiveJobName, 0, OTA_JOB_ID_MAX_SIZE );
+    ( void ) memset( pAgentCtx->pActiveJobName, 0, OTA_JOB_ID_MAX_SIZE );
 }
 
-static OtaErr_t processDataHandler( const OtaEventData_t * pEventData )
+static OtaErr_t processDataHandler( OtaAgentContext_t * pAgentCtx,
+                                    const OtaEventData_t * pEventData )
 {
     OtaErr_t err = OtaErrNone;
     OtaPalStatus_t closeResult = OTA_PAL_COMBINE_ERR( OtaPalUninitialized, 0 );
@@ -1156,12 +1680,13 @@ static OtaErr_t processDataHandler( const OtaEventData_t * pEventData )
     IngestResult_t result = IngestResultUninitialized;
 
     /* Get the file context. */
-    OtaFileContext_t * pFileContext = &( otaAgent.fileContext );
+    OtaFileContext_t * pFileContext = &( pAgentCtx->fileContext );
 
     /* Ingest data blocks received. */
     if( pEventData != NULL )
     {
-        result = ingestDataBlock( pFileContext,
+        result = ingestDataBlock( pAgentCtx,
+                                  pFileContext,
                                   pEventData->data,
                                   pEventData->dataLength,
                                   &closeResult );
@@ -1174,11 +1699,11 @@ static OtaErr_t processDataHandler( const OtaEventData_t * pEventData )
     if( result == IngestResultFileComplete )
     {
         /* File receive is complete and authenticated. Update the job status with the self_test ready identifier. */
-        err = otaControlInterface.updateJobStatus( &otaAgent, JobStatusInProgress, JobReasonSigCheckPassed, 0 );
-        dataHandlerCleanup( result );
+        err = pAgentCtx->controlInterface.updateJobStatus( pAgentCtx, JobStatusInProgress, JobReasonSigCheckPassed, 0 );
+        dataHandlerCleanup( pAgentCtx, result );
 
         /* Last file block processed, increment the statistics. */
-        otaAgent.statistics.otaPacketsProcessed++;
+        ( void ) OTA_ATOMIC_ADD_RELAXED_U32( &pAgentCtx->statistics.otaPacketsProcessed, 1U );
     }
     else if( result < IngestResultFileComplete )
     {
@@ -1187,41 +1712,65 @@ static OtaErr_t processDataHandler( const OtaEventData_t * pEventData )
                     result ) );
 
         /* Call the platform specific code to reject the image. */
-        ( void ) otaAgent.pOtaInterface->pal.setPlatformImageState( &( otaAgent.fileContext ), OtaImageStateRejected );
+        ( void ) pAgentCtx->pOtaInterface->pal.setPlatformImageState( &( pAgentCtx->fileContext ), OtaImageStateRejected );
 
         /* Update the job status with the with failure code. */
-        err = otaControlInterface.updateJobStatus( &otaAgent, JobStatusFailedWithVal, ( int32_t ) closeResult, ( int32_t ) result );
+        err = pAgentCtx->controlInterface.updateJobStatus( pAgentCtx, JobStatusFailedWithVal, ( int32_t ) closeResult, ( int32_t ) result );
 
-        dataHandlerCleanup( result );
+        dataHandlerCleanup( pAgentCtx, result );
     }
     else
     {
         if( result == IngestResultAccepted_Continue )
         {
             /* File block processed, increment the statistics. */
-            otaAgent.statistics.otaPacketsProcessed++;
+            ( void ) OTA_ATOMIC_ADD_RELAXED_U32( &pAgentCtx->statistics.otaPacketsProcessed, 1U );
 
-            /* Reset the momentum counter since we received a good block. */
-            otaAgent.requestMomentum = 0;
-            /* We're actively receiving a file so update the job status as needed. */
-            err = otaControlInterface.updateJobStatus( &otaAgent, JobStatusInProgress, JobReasonReceiving, 0 );
+            /* Sample the round trip time of the request and reset the momentum counter and backoff since we
+             * received a good block. */
+            adaptRequestTimeoutOnBlock( pAgentCtx );
+            pAgentCtx->requestMomentum = 0;
+            pAgentCtx->retryDelayMs = 0;
+
+            if( pAgentCtx->fileContext.blocksRemaining == otaconfigENDGAME_NUM_BLOCKS )
+            {
+                LogInfo( ( "Requesting the last blocks with shorter timeouts: Blocks remaining=%u",
+                           pAgentCtx->fileContext.blocksRemaining ) );
+            }
+
+            /* We're actively receiving a file so update the job status as needed. The update is
+             * published after the event, off the path of the blocks. */
+            if( progressReportDue( pAgentCtx ) == true )
+            {
+                pAgentCtx->progressStatusPending = true;
+            }
         }
 
-        if( otaAgent.numOfBlocksToReceive > 1U )
+        if( ( pAgentCtx->numOfBlocksToReceive > 1U ) && ( pAgentCtx->fastRetransmitPending == false ) )
         {
-            otaAgent.numOfBlocksToReceive--;
+            pAgentCtx->numOfBlocksToReceive--;
         }
         else
         {
+            if( pAgentCtx->fastRetransmitPending == true )
+            {
+                /* Blocks past a missing one arrived, request it again without waiting for the timer. */
+                LogInfo( ( "Requesting a missing block again: Block index=%u",
+                           pAgentCtx->nextMissingBlock ) );
+                pAgentCtx->fastRetransmitPending = false;
+            }
+
             /* Start the request timer. */
-            ( void ) otaAgent.pOtaInterface->os.timer.start( OtaRequestTimer,
-                                                             "OtaRequestTimer",
-                                                             otaconfigFILE_REQUEST_WAIT_MS,
-                                                             otaTimerCallback );
+            ( void ) pAgentCtx->pOtaInterface->os.timer.start( pAgentCtx->pOtaInterface->os.timer.pTimerContext,
+                                                               OtaRequestTimer,
+                                                               "OtaRequestTimer",
+                                                               fileBlockRequestTimeout( pAgentCtx ),
+                                                               otaTimerCallback,
+                                                               pAgentCtx );
 
             eventMsg.eventId = OtaAgentEventRequestFileBlock;
 
-            if( OTA_SignalEvent( &eventMsg ) == false )
+            if( OTA_SignalEventCtx( pAgentCtx, &eventMsg ) == false )
             {
                 LogWarn( ( "Failed to trigger requesting the next block: Unable to signal event: "
                            "event=%d",
@@ -1231,7 +1780,7 @@ static OtaErr_t processDataHandler( const OtaEventData_t * pEventData )
     }
 
     /* Application callback for event processed. */
-    otaAgent.OtaAppCallback( OtaJobEventProcessed, ( const void * ) pEventData );
+    notifyEventProcessed( pAgentCtx, pEventData );
 
     if( err != OtaErrNone )
     {
@@ -1242,33 +1791,35 @@ static OtaErr_t processDataHandler( const OtaEventData_t * pEventData )
     return err;
 }
 
-static OtaErr_t closeFileHandler( const OtaEventData_t * pEventData )
+static OtaErr_t closeFileHandler( OtaAgentContext_t * pAgentCtx,
+                                  const OtaEventData_t * pEventData )
 {
     ( void ) pEventData;
 
     LogInfo( ( "Closing file: "
                "file index=%u",
-               otaAgent.fileIndex ) );
+               pAgentCtx->fileIndex ) );
 
-    ( void ) otaClose( &( otaAgent.fileContext ) );
+    ( void ) otaClose( pAgentCtx, &( pAgentCtx->fileContext ) );
 
     return OtaErrNone;
 }
 
-static OtaErr_t userAbortHandler( const OtaEventData_t * pEventData )
+static OtaErr_t userAbortHandler( OtaAgentContext_t * pAgentCtx,
+                                  const OtaEventData_t * pEventData )
 {
     OtaErr_t err = OtaErrNone;
 
     ( void ) pEventData;
 
     /* If we have active Job abort it and close the file. */
-    if( strlen( ( const char * ) otaAgent.pActiveJobName ) > 0u )
+    if( strlen( ( const char * ) pAgentCtx->pActiveJobName ) > 0u )
     {
-        err = setImageStateWithReason( OtaImageStateAborted, ( uint32_t ) OtaErrUserAbort );
+        err = setImageStateWithReason( pAgentCtx, OtaImageStateAborted, ( uint32_t ) OtaErrUserAbort );
 
         if( err == OtaErrNone )
         {
-            ( void ) otaClose( &( otaAgent.fileContext ) );
+            ( void ) otaClose( pAgentCtx, &( pAgentCtx->fileContext ) );
         }
     }
     else
@@ -1279,23 +1830,31 @@ static OtaErr_t userAbortHandler( const OtaEventData_t * pEventData )
     return err;
 }
 
-static OtaErr_t shutdownHandler( const OtaEventData_t * pEventData )
+static OtaErr_t shutdownHandler( OtaAgentContext_t * pAgentCtx,
+                                 const OtaEventData_t * pEventData )
 {
     ( void ) pEventData;
 
     LogInfo( ( "OTA Agent is shutting down." ) );
 
     /* If we're here, we're shutting down the OTA agent. Free up all resources and quit. */
-    agentShutdownCleanup();
+    agentShutdownCleanup( pAgentCtx );
+
+    /* Hand back the buffers of the events the shutdown overtook. */
+    drainEventQueue( pAgentCtx );
 
-    /* Clear the entire agent context. This includes the OTA agent state. */
-    ( void ) memset( &otaAgent, 0, sizeof( otaAgent ) );
+    /* Clear the entire agent context. This includes the OTA agent state. OTA_Shutdown
+     * is woken up once the stopped state is stored and the agent is done with the
+     * context. */
+    ( void ) memset( pAgentCtx, 0, sizeof( *pAgentCtx ) );
 
     return OtaErrNone;
 }
 
-static OtaErr_t suspendHandler( const OtaEventData_t * pEventData )
+static OtaErr_t suspendHandler( OtaAgentContext_t * pAgentCtx,
+                                const OtaEventData_t * pEventData )
 {
+    ( void ) pAgentCtx;
     ( void ) pEventData;
 
     /* Log the state change to suspended state.*/
@@ -1304,7 +1863,8 @@ static OtaErr_t suspendHandler( const OtaEventData_t * pEventData )
     return OtaErrNone;
 }
 
-static OtaErr_t resumeHandler( const OtaEventData_t * pEventData )
+static OtaErr_t resumeHandler( OtaAgentContext_t * pAgentCtx,
+                               const OtaEventData_t * pEventData )
 {
     OtaEventMsg_t eventMsg = { 0 };
 
@@ -1315,34 +1875,130 @@ static OtaErr_t resumeHandler( const OtaEventData_t * pEventData )
      */
     eventMsg.eventId = OtaAgentEventRequestJobDocument;
 
-    return ( OTA_SignalEvent( &eventMsg ) == true ) ? OtaErrNone : OtaErrSignalEventFailed;
+    return ( OTA_SignalEventCtx( pAgentCtx, &eventMsg ) == true ) ? OtaErrNone : OtaErrSignalEventFailed;
+}
+
+static OtaErr_t resumeJobHandler( OtaAgentContext_t * pAgentCtx,
+                                  const OtaEventData_t * pEventData )
+{
+    OtaErr_t retVal = OtaErrNone;
+    OtaOsStatus_t osErr = OtaOsSuccess;
+    OtaEventMsg_t eventMsg = { 0 };
+
+    ( void ) pEventData;
+
+    /* Devices that lost the connection together get it back together. Replace a pending
+     * job request with one after a random backoff. */
+    ( void ) pAgentCtx->pOtaInterface->os.timer.stop( pAgentCtx->pOtaInterface->os.timer.pTimerContext,
+                                                      OtaRequestTimer );
+
+    osErr = pAgentCtx->pOtaInterface->os.timer.start( pAgentCtx->pOtaInterface->os.timer.pTimerContext,
+                                                      OtaRequestTimer,
+                                                      "OtaRequestTimer",
+                                                      retryDelay( pAgentCtx, OTA_ATOMIC_LOAD_RELAXED_U32( &pAgentCtx->requestBackoff.baseMs ) ),
+                                                      otaTimerCallback,
+                                                      pAgentCtx );
+
+    if( osErr != OtaOsSuccess )
+    {
+        /* Without the timer the job is requested right away. */
+        eventMsg.eventId = OtaAgentEventRequestJobDocument;
+
+        if( OTA_SignalEventCtx( pAgentCtx, &eventMsg ) == false )
+        {
+            retVal = OtaErrSignalEventFailed;
+        }
+    }
+
+    return retVal;
 }
 
-static OtaErr_t jobNotificationHandler( const OtaEventData_t * pEventData )
+static OtaErr_t resumeFileHandler( OtaAgentContext_t * pAgentCtx,
+                                   const OtaEventData_t * pEventData )
 {
+    OtaErr_t retVal = OtaErrNone;
+    OtaOsStatus_t osErr = OtaOsSuccess;
     OtaEventMsg_t eventMsg = { 0 };
+    uint32_t delayMs = OTA_ATOMIC_LOAD_RELAXED_U32( &pAgentCtx->requestBackoff.startDelayMaxMs );
 
     ( void ) pEventData;
 
+    /* Draw the job start delay again, or a random backoff if there is none, and replace the
+     * pending one with it. */
+    if( delayMs > 0U )
+    {
+        delayMs = 1U + ( randomNumber( pAgentCtx ) % delayMs );
+    }
+    else
+    {
+        delayMs = retryDelay( pAgentCtx, OTA_ATOMIC_LOAD_RELAXED_U32( &pAgentCtx->requestBackoff.baseMs ) );
+    }
+
+    ( void ) pAgentCtx->pOtaInterface->os.timer.stop( pAgentCtx->pOtaInterface->os.timer.pTimerContext,
+                                                      OtaRequestTimer );
+
+    osErr = pAgentCtx->pOtaInterface->os.timer.start( pAgentCtx->pOtaInterface->os.timer.pTimerContext,
+                                                      OtaRequestTimer,
+                                                      "OtaRequestTimer",
+                                                      delayMs,
+                                                      otaTimerCallback,
+                                                      pAgentCtx );
+
+    if( osErr != OtaOsSuccess )
+    {
+        /* Without the timer the file is created right away. */
+        eventMsg.eventId = OtaAgentEventCreateFile;
+
+        if( OTA_SignalEventCtx( pAgentCtx, &eventMsg ) == false )
+        {
+            retVal = OtaErrSignalEventFailed;
+        }
+    }
+
+    return retVal;
+}
+
+static OtaErr_t resumeDataHandler( OtaAgentContext_t * pAgentCtx,
+                                   const OtaEventData_t * pEventData )
+{
+    /* The requests that went unanswered were lost with the connection, the server did not
+     * time out. Start over without momentum, so that the first request after the connection
+     * is back is sent right away with the usual timeout. */
+    pAgentCtx->requestMomentum = 0;
+    pAgentCtx->retryDelayMs = 0;
+
+    return requestDataHandler( pAgentCtx, pEventData );
+}
+
+static OtaErr_t jobNotificationHandler( OtaAgentContext_t * pAgentCtx,
+                                        const OtaEventData_t * pEventData )
+{
+    OtaEventMsg_t eventMsg = { 0 };
+
+    /* The new job document is requested again below, so this one is done with. */
+    notifyEventProcessed( pAgentCtx, pEventData );
+
     /* Stop the request timer. */
-    ( void ) otaAgent.pOtaInterface->os.timer.stop( OtaRequestTimer );
+    ( void ) pAgentCtx->pOtaInterface->os.timer.stop( pAgentCtx->pOtaInterface->os.timer.pTimerContext,
+                                                      OtaRequestTimer );
 
     /* Abort the current job. */
-    ( void ) otaAgent.pOtaInterface->pal.setPlatformImageState( &( otaAgent.fileContext ), OtaImageStateAborted );
-    ( void ) otaClose( &( otaAgent.fileContext ) );
+    ( void ) pAgentCtx->pOtaInterface->pal.setPlatformImageState( &( pAgentCtx->fileContext ), OtaImageStateAborted );
+    ( void ) otaClose( pAgentCtx, &( pAgentCtx->fileContext ) );
 
     /* Clear the active job name as its no longer required. */
-    ( void ) memset( otaAgent.pActiveJobName, 0, OTA_JOB_ID_MAX_SIZE );
+    ( void ) memset( pAgentCtx->pActiveJobName, 0, OTA_JOB_ID_MAX_SIZE );
 
     /*
      * Send signal to request next OTA job document from service.
      */
     eventMsg.eventId = OtaAgentEventRequestJobDocument;
 
-    return ( OTA_SignalEvent( &eventMsg ) == true ) ? OtaErrNone : OtaErrSignalEventFailed;
+    return ( OTA_SignalEventCtx( pAgentCtx, &eventMsg ) == true ) ? OtaErrNone : OtaErrSignalEventFailed;
 }
 
-static void freeFileContextMem( OtaFileContext_t * const pFileContext )
+static void freeFileContextMem( OtaAgentContext_t * pAgentCtx,
+                                OtaFileContext_t * const pFileContext )
 {
     assert( pFileContext != NULL );
 
@@ -1355,7 +2011,7 @@ static void freeFileContextMem( OtaFileContext_t * const pFileContext )
         }
         else
         {
-            otaAgent.pOtaInterface->os.mem.free( pFileContext->pFilePath );
+            pAgentCtx->pOtaInterface->os.mem.free( pFileContext->pFilePath );
             pFileContext->pFilePath = NULL;
         }
     }
@@ -1369,7 +2025,7 @@ static void freeFileContextMem( OtaFileContext_t * const pFileContext )
         }
         else
         {
-            otaAgent.pOtaInterface->os.mem.free( pFileContext->pCertFilepath );
+            pAgentCtx->pOtaInterface->os.mem.free( pFileContext->pCertFilepath );
             pFileContext->pCertFilepath = NULL;
         }
     }
@@ -1383,7 +2039,7 @@ static void freeFileContextMem( OtaFileContext_t * const pFileContext )
         }
         else
         {
-            otaAgent.pOtaInterface->os.mem.free( pFileContext->pStreamName );
+            pAgentCtx->pOtaInterface->os.mem.free( pFileContext->pStreamName );
             pFileContext->pStreamName = NULL;
         }
     }
@@ -1397,7 +2053,7 @@ static void freeFileContextMem( OtaFileContext_t * const pFileContext )
         }
         else
         {
-            otaAgent.pOtaInterface->os.mem.free( pFileContext->pRxBlockBitmap );
+            pAgentCtx->pOtaInterface->os.mem.free( pFileContext->pRxBlockBitmap );
             pFileContext->pRxBlockBitmap = NULL;
         }
     }
@@ -1411,7 +2067,7 @@ static void freeFileContextMem( OtaFileContext_t * const pFileContext )
         }
         else
         {
-            otaAgent.pOtaInterface->os.mem.free( pFileContext->pUpdateUrlPath );
+            pAgentCtx->pOtaInterface->os.mem.free( pFileContext->pUpdateUrlPath );
             pFileContext->pUpdateUrlPath = NULL;
         }
     }
@@ -1425,7 +2081,7 @@ static void freeFileContextMem( OtaFileContext_t * const pFileContext )
         }
         else
         {
-            otaAgent.pOtaInterface->os.mem.free( pFileContext->pAuthScheme );
+            pAgentCtx->pOtaInterface->os.mem.free( pFileContext->pAuthScheme );
             pFileContext->pAuthScheme = NULL;
         }
     }
@@ -1433,7 +2089,8 @@ static void freeFileContextMem( OtaFileContext_t * const pFileContext )
 
 /* Close an existing OTA file context and free its resources. */
 
-static bool otaClose( OtaFileContext_t * const pFileContext )
+static bool otaClose( OtaAgentContext_t * pAgentCtx,
+                      OtaFileContext_t * const pFileContext )
 {
     bool result = false;
 
@@ -1442,9 +2099,9 @@ static bool otaClose( OtaFileContext_t * const pFileContext )
                 ( void * ) pFileContext ) );
 
     /* Cleanup related to selected protocol. */
-    if( otaDataInterface.cleanup != NULL )
+    if( pAgentCtx->dataInterface.cleanup != NULL )
     {
-        ( void ) otaDataInterface.cleanup( &otaAgent );
+        ( void ) pAgentCtx->dataInterface.cleanup( pAgentCtx );
     }
 
     if( pFileContext != NULL )
@@ -1452,9 +2109,9 @@ static bool otaClose( OtaFileContext_t * const pFileContext )
         /*
          * Abort any active file access and release the file resource, if needed.
          */
-        ( void ) otaAgent.pOtaInterface->pal.abort( pFileContext );
+        ( void ) pAgentCtx->pOtaInterface->pal.abort( pFileContext );
 
-        freeFileContextMem( &( otaAgent.fileContext ) );
+        freeFileContextMem( pAgentCtx, &( pAgentCtx->fileContext ) );
 
         result = true;
     }
@@ -1479,7 +2136,11 @@ static DocParseErr_t validateJSON( const char * pJson,
     /* Check if the JSON document is valid*/
     if( err == DocParseErrNone )
     {
-        result = JSON_Validate( pJson, ( size_t ) messageLength );
+        #if ( otaconfigFAST_JSON_VALIDATION == 1U )
+            result = jsonValidate( pJson, ( size_t ) messageLength );
+        #else
+            result = JSON_Validate( pJson, ( size_t ) messageLength );
+        #endif
 
         if( result != JSONSuccess )
         {
@@ -1541,7 +2202,8 @@ static DocParseErr_t decodeAndStoreKey( const char * pValueInJson,
 
 /* Extract the value from json and store it into the allocated memory. */
 
-static DocParseErr_t extractAndStoreArray( const char * pKey,
+static DocParseErr_t extractAndStoreArray( OtaAgentContext_t * pAgentCtx,
+                                           const char * pKey,
                                            const char * pValueInJson,
                                            size_t valueLength,
                                            void * pParamAdd,
@@ -1559,11 +2221,11 @@ static DocParseErr_t extractAndStoreArray( const char * pKey,
         /* Free previously allocated buffer. */
         if( *pCharPtr != NULL )
         {
-            otaAgent.pOtaInterface->os.mem.free( *pCharPtr );
+            pAgentCtx->pOtaInterface->os.mem.free( *pCharPtr );
         }
 
         /* Malloc memory for a copy of the value string plus a zero terminator. */
-        *pCharPtr = otaAgent.pOtaInterface->os.mem.malloc( valueLength + 1U );
+        *pCharPtr = pAgentCtx->pOtaInterface->os.mem.malloc( valueLength + 1U );
 
         if( *pCharPtr == NULL )
         {
@@ -1608,7 +2270,8 @@ static DocParseErr_t extractAndStoreArray( const char * pKey,
 
 /* Store the parameter from the json to the offset specified by the document model. */
 
-static DocParseErr_t extractParameter( JsonDocParam_t docParam,
+static DocParseErr_t extractParameter( OtaAgentContext_t * pAgentCtx,
+                                       JsonDocParam_t docParam,
                                        void * pContextBase,
                                        const char * pValueInJson,
                                        size_t valueLength )
@@ -1625,7 +2288,7 @@ static DocParseErr_t extractParameter( JsonDocParam_t docParam,
 
     if( ( ModelParamTypeStringCopy == docParam.modelParamType ) || ( ModelParamTypeArrayCopy == docParam.modelParamType ) )
     {
-        err = extractAndStoreArray( docParam.pSrcKey, pValueInJson, valueLength, pParamAdd, pParamSizeAdd );
+        err = extractAndStoreArray( pAgentCtx, docParam.pSrcKey, pValueInJson, valueLength, pParamAdd, pParamSizeAdd );
     }
     else if( ModelParamTypeUInt32 == docParam.modelParamType )
     {
@@ -1705,7 +2368,8 @@ static DocParseErr_t verifyRequiredParamsExtracted( const JsonDocParam_t * pMode
 
 /* Extract the desired fields from the JSON document based on the specified document model. */
 
-static DocParseErr_t parseJSONbyModel( const char * pJson,
+static DocParseErr_t parseJSONbyModel( OtaAgentContext_t * pAgentCtx,
+                                       const char * pJson,
                                        uint32_t messageLength,
                                        JsonDocModel_t * pDocModel )
 {
@@ -1756,7 +2420,8 @@ static DocParseErr_t parseJSONbyModel( const char * pJson,
             }
             else
             {
-                err = extractParameter( pModelParam[ paramIndex ],
+                err = extractParameter( pAgentCtx,
+                                        pModelParam[ paramIndex ],
                                         pDocModel->contextBase,
                                         pValueInJson,
                                         valueLength );
@@ -1852,7 +2517,8 @@ static DocParseErr_t initDocModel( JsonDocModel_t * pDocModel,
 /*
  * Validate the version of the update received.
  */
-static OtaErr_t validateUpdateVersion( const OtaFileContext_t * pFileContext )
+static OtaErr_t validateUpdateVersion( OtaAgentContext_t * pAgentCtx,
+                                       const OtaFileContext_t * pFileContext )
 {
     OtaErr_t err = OtaErrNone;
     AppVersion32_t newVersion;
@@ -1860,7 +2526,7 @@ static OtaErr_t validateUpdateVersion( const OtaFileContext_t * pFileContext )
     ( void ) newVersion; /* For suppressing compiler-warning: unused variable. */
 
     /* Only check for versions if the target is self */
-    if( otaAgent.serverFileID == 0U )
+    if( pAgentCtx->serverFileID == 0U )
     {
         /* Check if version reported is the same as the running version. */
         if( pFileContext->updaterVersion == appFirmwareVersion.u.unsignedVersion32 )
@@ -1899,13 +2565,18 @@ static OtaErr_t validateUpdateVersion( const OtaFileContext_t * pFileContext )
 }
 
 /* If there is an error in parsing the json, check if it can be handled by external callback. */
-static OtaJobParseErr_t handleCustomJob( const char * pJson,
+static OtaJobParseErr_t handleCustomJob( OtaAgentContext_t * pAgentCtx,
+                                         const char * pJson,
                                          uint32_t messageLength )
 {
     OtaErr_t otaErr = OtaErrNone;
     OtaJobParseErr_t err = OtaJobParseErrUnknown;
     OtaJobDocument_t jobDoc = { 0 };
 
+    #if ( otaconfigCUSTOM_JOB_DOC_INDEX == 1U )
+        OtaJobDocIndexStatus_t indexStatus;
+    #endif
+
     jobDoc.parseErr = OtaJobParseErrUnknown;
 
     /* If this is a valid custom job, extract job document and job ID data from the JSON payload.*/
@@ -1925,9 +2596,26 @@ static OtaJobParseErr_t handleCustomJob( const char * pJson,
                                              &jobDoc.jobIdLength,
                                              NULL ) )
         {
+            #if ( otaconfigCUSTOM_JOB_DOC_INDEX == 1U )
+                /* Hand the application the index of the message so it does not
+                 * need to search the whole document again for each field. */
+                indexStatus = jsonIndexBuild( &pAgentCtx->jobDocIndex, pJson, ( size_t ) messageLength );
+
+                if( ( indexStatus == OtaJobDocIndexSuccess ) || ( indexStatus == OtaJobDocIndexFull ) )
+                {
+                    jobDoc.pJobDocIndex = &pAgentCtx->jobDocIndex;
+                }
+                else
+                {
+                    LogWarn( ( "Could not index the custom job document: "
+                               "OtaJobDocIndexStatus_t=%d",
+                               indexStatus ) );
+                }
+            #endif
+
             /* We have an unknown job parser error. Check to see if we can pass control
              * to a callback for parsing */
-            otaAgent.OtaAppCallback( OtaJobEventParseCustomJob, &jobDoc );
+            pAgentCtx->OtaAppCallback( OtaJobEventParseCustomJob, &jobDoc );
         }
         else
         {
@@ -1943,11 +2631,11 @@ static OtaJobParseErr_t handleCustomJob( const char * pJson,
 
     if( jobDoc.parseErr == OtaJobParseErrNone )
     {
-        ( void ) memcpy( otaAgent.pActiveJobName, jobDoc.pJobId, jobDoc.jobIdLength );
-        otaErr = otaControlInterface.updateJobStatus( &otaAgent,
-                                                      jobDoc.status,
-                                                      jobDoc.reason,
-                                                      jobDoc.subReason );
+        ( void ) memcpy( pAgentCtx->pActiveJobName, jobDoc.pJobId, jobDoc.jobIdLength );
+        otaErr = pAgentCtx->controlInterface.updateJobStatus( pAgentCtx,
+                                                              jobDoc.status,
+                                                              jobDoc.reason,
+                                                              jobDoc.subReason );
 
         /* Log the error.*/
         if( otaErr != OtaErrNone )
@@ -1959,7 +2647,7 @@ static OtaJobParseErr_t handleCustomJob( const char * pJson,
         LogInfo( ( "Job document parsed from external callback" ) );
 
         /* We don't need the job name memory anymore since we're done with this job. */
-        ( void ) memset( otaAgent.pActiveJobName, 0, OTA_JOB_ID_MAX_SIZE );
+        ( void ) memset( pAgentCtx->pActiveJobName, 0, OTA_JOB_ID_MAX_SIZE );
     }
     else
     {
@@ -1975,7 +2663,8 @@ static OtaJobParseErr_t handleCustomJob( const char * pJson,
 
 /* Check if the incoming job document is not conflicting with current job status. */
 
-static OtaJobParseErr_t verifyActiveJobStatus( OtaFileContext_t * pFileContext,
+static OtaJobParseErr_t verifyActiveJobStatus( OtaAgentContext_t * pAgentCtx,
+                                               OtaFileContext_t * pFileContext,
                                                OtaFileContext_t ** pFinalFile,
                                                bool * pUpdateJob )
 {
@@ -1984,16 +2673,16 @@ static OtaJobParseErr_t verifyActiveJobStatus( OtaFileContext_t * pFileContext,
     if( pFileContext->pJobName != NULL )
     {
         /* pFileContext->pJobName is guaranteed to be zero terminated. */
-        if( strcmp( ( char * ) otaAgent.pActiveJobName, ( char * ) pFileContext->pJobName ) != 0 )
+        if( strcmp( ( char * ) pAgentCtx->pActiveJobName, ( char * ) pFileContext->pJobName ) != 0 )
         {
             LogInfo( ( "New job document received, aborting current job." ) );
 
             /* Abort the current job. */
-            ( void ) otaAgent.pOtaInterface->pal.setPlatformImageState( &( otaAgent.fileContext ), OtaImageStateAborted );
-            ( void ) otaClose( &( otaAgent.fileContext ) );
+            ( void ) pAgentCtx->pOtaInterface->pal.setPlatformImageState( &( pAgentCtx->fileContext ), OtaImageStateAborted );
+            ( void ) otaClose( pAgentCtx, &( pAgentCtx->fileContext ) );
 
             /* Set new active job name. */
-            ( void ) memcpy( otaAgent.pActiveJobName, pFileContext->pJobName, strlen( ( const char * ) pFileContext->pJobName ) );
+            ( void ) memcpy( pAgentCtx->pActiveJobName, pFileContext->pJobName, strlen( ( const char * ) pFileContext->pJobName ) );
 
             err = OtaJobParseErrNone;
         }
@@ -2003,23 +2692,23 @@ static OtaJobParseErr_t verifyActiveJobStatus( OtaFileContext_t * pFileContext,
             LogInfo( ( "New job document ID is identical to the current job: "
                        "Updating the URL based on the new job document." ) );
 
-            if( otaAgent.fileContext.pUpdateUrlPath != NULL )
+            if( pAgentCtx->fileContext.pUpdateUrlPath != NULL )
             {
-                if( otaAgent.fileContext.updateUrlMaxSize == 0u )
+                if( pAgentCtx->fileContext.updateUrlMaxSize == 0u )
                 {
                     /* The buffer is allocated by us, free first then update. */
-                    otaAgent.pOtaInterface->os.mem.free( otaAgent.fileContext.pUpdateUrlPath );
-                    otaAgent.fileContext.pUpdateUrlPath = pFileContext->pUpdateUrlPath;
+                    pAgentCtx->pOtaInterface->os.mem.free( pAgentCtx->fileContext.pUpdateUrlPath );
+                    pAgentCtx->fileContext.pUpdateUrlPath = pFileContext->pUpdateUrlPath;
                     pFileContext->pUpdateUrlPath = NULL;
                 }
                 else
                 {
                     /* The buffer is provided by user, directly copy the new url to it. */
-                    ( void ) memcpy( otaAgent.fileContext.pUpdateUrlPath, pFileContext->pUpdateUrlPath, otaAgent.fileContext.updateUrlMaxSize );
+                    ( void ) memcpy( pAgentCtx->fileContext.pUpdateUrlPath, pFileContext->pUpdateUrlPath, pAgentCtx->fileContext.updateUrlMaxSize );
                 }
             }
 
-            *pFinalFile = &( otaAgent.fileContext );
+            *pFinalFile = &( pAgentCtx->fileContext );
             *pUpdateJob = true;
 
             err = OtaJobParseErrUpdateCurrentJob;
@@ -2037,7 +2726,8 @@ static OtaJobParseErr_t verifyActiveJobStatus( OtaFileContext_t * pFileContext,
 }
 
 /* Validate update version when receiving job doc in self test state. */
-static void handleSelfTestJobDoc( OtaFileContext_t * pFileContext )
+static void handleSelfTestJobDoc( OtaAgentContext_t * pAgentCtx,
+                                  OtaFileContext_t * pFileContext )
 {
     OtaErr_t otaErr = OtaErrNone;
     OtaErr_t errVersionCheck = OtaErrUninitialized;
@@ -2045,7 +2735,7 @@ static void handleSelfTestJobDoc( OtaFileContext_t * pFileContext )
     LogInfo( ( "In self test mode." ) );
 
     /* Validate version of the update received.*/
-    errVersionCheck = validateUpdateVersion( pFileContext );
+    errVersionCheck = validateUpdateVersion( pAgentCtx, pFileContext );
 
     /* MISRA rule 14.3 requires controlling expressions to be not invariant. otaconfigAllowDowngrade is
      * one of the OTA library configuration and it's set to 0 when running the static analysis. But
@@ -2060,9 +2750,9 @@ static void handleSelfTestJobDoc( OtaFileContext_t * pFileContext )
          * Set image state accordingly and update job status with self test identifier.
          */
         LogInfo( ( "Image version is valid: Begin testing file: File ID=%d",
-                   otaAgent.serverFileID ) );
+                   pAgentCtx->serverFileID ) );
 
-        otaErr = setImageStateWithReason( OtaImageStateTesting, ( uint32_t ) errVersionCheck );
+        otaErr = setImageStateWithReason( pAgentCtx, OtaImageStateTesting, ( uint32_t ) errVersionCheck );
 
         if( otaErr != OtaErrNone )
         {
@@ -2074,7 +2764,7 @@ static void handleSelfTestJobDoc( OtaFileContext_t * pFileContext )
         LogWarn( ( "New image is being rejected: Application version of the new image is invalid: "
                    "OtaErr_t=%s", OTA_Err_strerror( errVersionCheck ) ) );
 
-        otaErr = setImageStateWithReason( OtaImageStateRejected, ( uint32_t ) errVersionCheck );
+        otaErr = setImageStateWithReason( pAgentCtx, OtaImageStateRejected, ( uint32_t ) errVersionCheck );
 
         if( otaErr != OtaErrNone )
         {
@@ -2082,17 +2772,18 @@ static void handleSelfTestJobDoc( OtaFileContext_t * pFileContext )
         }
 
         /* Application callback for self-test failure.*/
-        otaAgent.OtaAppCallback( OtaJobEventSelfTestFailed, NULL );
+        pAgentCtx->OtaAppCallback( OtaJobEventSelfTestFailed, NULL );
 
         /* Handle self-test failure in the platform specific implementation,
          * example, reset the device in case of firmware upgrade. */
-        ( void ) otaAgent.pOtaInterface->pal.reset( &( otaAgent.fileContext ) );
+        ( void ) pAgentCtx->pOtaInterface->pal.reset( &( pAgentCtx->fileContext ) );
     }
 }
 
 /* Check if all the file context params are valid and initialize resources for the job transfer */
 
-static OtaJobParseErr_t validateAndStartJob( OtaFileContext_t * pFileContext,
+static OtaJobParseErr_t validateAndStartJob( OtaAgentContext_t * pAgentCtx,
+                                             OtaFileContext_t * pFileContext,
                                              OtaFileContext_t ** pFinalFile,
                                              bool * pUpdateJob )
 {
@@ -2106,18 +2797,18 @@ static OtaJobParseErr_t validateAndStartJob( OtaFileContext_t * pFileContext,
     }
     /* If there's an active job, verify that it's the same as what's being reported now. */
     /* We already checked for missing parameters so we SHOULD have a job name in the context. */
-    else if( strlen( ( const char * ) otaAgent.pActiveJobName ) > 0u )
+    else if( strlen( ( const char * ) pAgentCtx->pActiveJobName ) > 0u )
     {
-        err = verifyActiveJobStatus( pFileContext, pFinalFile, pUpdateJob );
+        err = verifyActiveJobStatus( pAgentCtx, pFileContext, pFinalFile, pUpdateJob );
     }
     else
     {
         /* Assume control of the job name from the context. */
-        ( void ) memcpy( otaAgent.pActiveJobName, pFileContext->pJobName, strlen( ( const char * ) pFileContext->pJobName ) );
+        ( void ) memcpy( pAgentCtx->pActiveJobName, pFileContext->pJobName, strlen( ( const char * ) pFileContext->pJobName ) );
     }
 
     /* Store the File ID received in the job. */
-    otaAgent.serverFileID = pFileContext->serverFileID;
+    pAgentCtx->serverFileID = pFileContext->serverFileID;
 
     if( err == OtaJobParseErrNone )
     {
@@ -2131,7 +2822,7 @@ static OtaJobParseErr_t validateAndStartJob( OtaFileContext_t * pFileContext,
          */
         if( pFileContext->isInSelfTest == true )
         {
-            handleSelfTestJobDoc( pFileContext );
+            handleSelfTestJobDoc( pAgentCtx, pFileContext );
         }
         else
         {
@@ -2159,7 +2850,8 @@ static OtaJobParseErr_t validateAndStartJob( OtaFileContext_t * pFileContext,
 }
 
 /* This function is called only if there is an error with the job parsing. */
-static void handleJobParsingError( const OtaFileContext_t * pFileContext,
+static void handleJobParsingError( OtaAgentContext_t * pAgentCtx,
+                                   const OtaFileContext_t * pFileContext,
                                    OtaJobParseErr_t err )
 {
     OtaErr_t otaErr = OtaErrNone;
@@ -2192,12 +2884,12 @@ static void handleJobParsingError( const OtaFileContext_t * pFileContext,
                         OTA_JobParse_strerror( err ), ( const char * ) pFileContext->pJobName ) );
 
             /* Assume control of the job name from the context. */
-            ( void ) memcpy( otaAgent.pActiveJobName, pFileContext->pJobName, OTA_JOB_ID_MAX_SIZE );
+            ( void ) memcpy( pAgentCtx->pActiveJobName, pFileContext->pJobName, OTA_JOB_ID_MAX_SIZE );
 
-            otaErr = otaControlInterface.updateJobStatus( &otaAgent,
-                                                          JobStatusFailedWithVal,
-                                                          ( int32_t ) OtaErrJobParserError,
-                                                          ( int32_t ) err );
+            otaErr = pAgentCtx->controlInterface.updateJobStatus( pAgentCtx,
+                                                                  JobStatusFailedWithVal,
+                                                                  ( int32_t ) OtaErrJobParserError,
+                                                                  ( int32_t ) err );
 
             if( otaErr != OtaErrNone )
             {
@@ -2206,7 +2898,7 @@ static void handleJobParsingError( const OtaFileContext_t * pFileContext,
             }
 
             /* We don't need the job name memory anymore since we're done with this job. */
-            ( void ) memset( otaAgent.pActiveJobName, 0, OTA_JOB_ID_MAX_SIZE );
+            ( void ) memset( pAgentCtx->pActiveJobName, 0, OTA_JOB_ID_MAX_SIZE );
 
             break;
     }
@@ -2244,14 +2936,15 @@ static const JsonDocParam_t otaJobDocModelParamStructure[ OTA_NUM_JOB_PARAMS ] =
  * OTA context if valid otherwise return NULL.
  */
 
-static OtaFileContext_t * parseJobDoc( const char * pJson,
+static OtaFileContext_t * parseJobDoc( OtaAgentContext_t * pAgentCtx,
+                                       const char * pJson,
                                        uint32_t messageLength,
                                        bool * pUpdateJob )
 {
     OtaJobParseErr_t err = OtaJobParseErrUnknown;
     DocParseErr_t parseError = DocParseErrNone;
     OtaFileContext_t * pFinalFile = NULL;
-    OtaFileContext_t * pFileContext = &( otaAgent.fileContext );
+    OtaFileContext_t * pFileContext = &( pAgentCtx->fileContext );
     JsonDocModel_t otaJobDocModel;
 
     parseError = initDocModel( &otaJobDocModel,
@@ -2266,15 +2959,15 @@ static OtaFileContext_t * parseJobDoc( const char * pJson,
     }
     else
     {
-        parseError = parseJSONbyModel( pJson, messageLength, &otaJobDocModel );
+        parseError = parseJSONbyModel( pAgentCtx, pJson, messageLength, &otaJobDocModel );
 
         if( parseError == DocParseErrNone )
         {
-            err = validateAndStartJob( pFileContext, &pFinalFile, pUpdateJob );
+            err = validateAndStartJob( pAgentCtx, pFileContext, &pFinalFile, pUpdateJob );
         }
         else
         {
-            err = handleCustomJob( pJson, messageLength );
+            err = handleCustomJob( pAgentCtx, pJson, messageLength );
         }
     }
 
@@ -2287,14 +2980,14 @@ static OtaFileContext_t * parseJobDoc( const char * pJson,
     else
     {
         /* Handle job parsing error. */
-        handleJobParsingError( pFileContext, err );
+        handleJobParsingError( pAgentCtx, pFileContext, err );
     }
 
     /* If we failed, close the open files. */
     if( pFinalFile == NULL )
     {
         /* Close any open files. */
-        ( void ) otaClose( &( otaAgent.fileContext ) );
+        ( void ) otaClose( pAgentCtx, &( pAgentCtx->fileContext ) );
     }
 
     /* Return pointer to populated file context or NULL if it failed. */
@@ -2302,7 +2995,8 @@ static OtaFileContext_t * parseJobDoc( const char * pJson,
 }
 
 /* Called to update the filecontext structure from the job. */
-static OtaFileContext_t * getFileContextFromJob( const char * pRawMsg,
+static OtaFileContext_t * getFileContextFromJob( OtaAgentContext_t * pAgentCtx,
+                                                 const char * pRawMsg,
                                                  uint32_t messageLength )
 {
     uint32_t index;
@@ -2316,14 +3010,14 @@ static OtaFileContext_t * getFileContextFromJob( const char * pRawMsg,
 
     /* Populate an OTA file context from the OTA job document. */
 
-    pUpdateFile = parseJobDoc( pRawMsg, messageLength, &updateJob );
+    pUpdateFile = parseJobDoc( pAgentCtx, pRawMsg, messageLength, &updateJob );
 
     if( updateJob == true )
     {
         LogInfo( ( "Job document for receiving an update received." ) );
     }
 
-    if( ( updateJob == false ) && ( pUpdateFile != NULL ) && ( platformInSelftest() == false ) )
+    if( ( updateJob == false ) && ( pUpdateFile != NULL ) && ( platformInSelftest( pAgentCtx ) == false ) )
     {
         /* Calculate how many bytes we need in our bitmap for tracking received blocks.
          * The below calculation requires power of 2 page sizes. */
@@ -2335,10 +3029,10 @@ static OtaFileContext_t * getFileContextFromJob( const char * pRawMsg,
             if( pUpdateFile->pRxBlockBitmap != NULL )
             {
                 /* Free any previously allocated bitmap. */
-                otaAgent.pOtaInterface->os.mem.free( pUpdateFile->pRxBlockBitmap );
+                pAgentCtx->pOtaInterface->os.mem.free( pUpdateFile->pRxBlockBitmap );
             }
 
-            pUpdateFile->pRxBlockBitmap = ( uint8_t * ) otaAgent.pOtaInterface->os.mem.malloc( bitmapLen );
+            pUpdateFile->pRxBlockBitmap = ( uint8_t * ) pAgentCtx->pOtaInterface->os.mem.malloc( bitmapLen );
         }
         else
         {
@@ -2369,20 +3063,33 @@ static OtaFileContext_t * getFileContextFromJob( const char * pRawMsg,
 
             pUpdateFile->blocksRemaining = numBlocks; /* Initialize our blocks remaining counter. */
 
+            /* Look for gaps from the first block. */
+            pAgentCtx->nextMissingBlock = 0;
+            pAgentCtx->blocksPastGap = 0;
+            pAgentCtx->gapRetransmitted = false;
+            pAgentCtx->fastRetransmitPending = false;
+            pAgentCtx->retransmitNumBlocks = 0;
+
+            /* Report the progress relative to the start of the download. */
+            pAgentCtx->progressReportPercent = 0;
+            pAgentCtx->progressStatusPending = false;
+            pAgentCtx->progressReportTimeMs = ( pAgentCtx->pOtaInterface->os.timer.getTimeMs != NULL ) ?
+                                              pAgentCtx->pOtaInterface->os.timer.getTimeMs() : 0U;
+
             /* Create/Open the OTA file on the file system. */
-            palStatus = otaAgent.pOtaInterface->pal.createFile( pUpdateFile );
+            palStatus = pAgentCtx->pOtaInterface->pal.createFile( pUpdateFile );
 
             if( OTA_PAL_MAIN_ERR( palStatus ) != OtaPalSuccess )
             {
-                err = setImageStateWithReason( OtaImageStateAborted, palStatus );
-                ( void ) otaClose( pUpdateFile ); /* Ignore false result since we're setting the pointer to null on the next line. */
+                err = setImageStateWithReason( pAgentCtx, OtaImageStateAborted, palStatus );
+                ( void ) otaClose( pAgentCtx, pUpdateFile ); /* Ignore false result since we're setting the pointer to null on the next line. */
                 pUpdateFile = NULL;
             }
         }
         else
         {
             /* Can't receive the image without enough memory. */
-            ( void ) otaClose( pUpdateFile );
+            ( void ) otaClose( pAgentCtx, pUpdateFile );
             pUpdateFile = NULL;
         }
     }
@@ -2426,7 +3133,8 @@ static bool validateDataBlock( const OtaFileContext_t * pFileContext,
 
 /* Validate the incoming data block and store it in the file context. */
 
-static IngestResult_t processDataBlock( OtaFileContext_t * pFileContext,
+static IngestResult_t processDataBlock( OtaAgentContext_t * pAgentCtx,
+                                        OtaFileContext_t * pFileContext,
                                         uint32_t uBlockIndex,
                                         uint32_t uBlockSize,
                                         OtaPalStatus_t * pCloseResult,
@@ -2469,10 +3177,10 @@ static IngestResult_t processDataBlock( OtaFileContext_t * pFileContext,
     {
         if( pFileContext->pFile != NULL )
         {
-            int32_t iBytesWritten = otaAgent.pOtaInterface->pal.writeBlock( pFileContext,
-                                                                            ( uBlockIndex * OTA_FILE_BLOCK_SIZE ),
-                                                                            pPayload,
-                                                                            uBlockSize );
+            int32_t iBytesWritten = pAgentCtx->pOtaInterface->pal.writeBlock( pFileContext,
+                                                                              ( uBlockIndex * OTA_FILE_BLOCK_SIZE ),
+                                                                              pPayload,
+                                                                              uBlockSize );
 
             if( iBytesWritten < 0 )
             {
@@ -2486,6 +3194,7 @@ static IngestResult_t processDataBlock( OtaFileContext_t * pFileContext,
                 pFileContext->pRxBlockBitmap[ byte ] &= ( uint8_t ) ~bitMask;
                 pFileContext->blocksRemaining--;
                 eIngestResult = IngestResultAccepted_Continue;
+                pAgentCtx->fastRetransmitPending = detectBlockGap( pAgentCtx, pFileContext, uBlockIndex );
                 *pCloseResult = OTA_PAL_COMBINE_ERR( OtaPalSuccess, 0 );
             }
         }
@@ -2500,7 +3209,8 @@ static IngestResult_t processDataBlock( OtaFileContext_t * pFileContext,
 }
 
 /* Decode and store the incoming data block. */
-static IngestResult_t decodeAndStoreDataBlock( OtaFileContext_t * pFileContext,
+static IngestResult_t decodeAndStoreDataBlock( OtaAgentContext_t * pAgentCtx,
+                                               OtaFileContext_t * pFileContext,
                                                const uint8_t * pRawMsg,
                                                uint32_t messageSize,
                                                uint8_t ** pPayload,
@@ -2516,19 +3226,21 @@ static IngestResult_t decodeAndStoreDataBlock( OtaFileContext_t * pFileContext,
     /* If we are expecting a data block, allocate space for it. */
     if( ( pFileContext->pRxBlockBitmap != NULL ) && ( pFileContext->blocksRemaining > 0U ) )
     {
-        ( void ) otaAgent.pOtaInterface->os.timer.start( OtaRequestTimer,
-                                                         "OtaRequestTimer",
-                                                         otaconfigFILE_REQUEST_WAIT_MS,
-                                                         otaTimerCallback );
+        ( void ) pAgentCtx->pOtaInterface->os.timer.start( pAgentCtx->pOtaInterface->os.timer.pTimerContext,
+                                                           OtaRequestTimer,
+                                                           "OtaRequestTimer",
+                                                           fileBlockRequestTimeout( pAgentCtx ),
+                                                           otaTimerCallback,
+                                                           pAgentCtx );
 
-        if( otaAgent.fileContext.decodeMemMaxSize != 0U )
+        if( pAgentCtx->fileContext.decodeMemMaxSize != 0U )
         {
-            *pPayload = otaAgent.fileContext.pDecodeMem;
-            payloadSize = otaAgent.fileContext.decodeMemMaxSize;
+            *pPayload = pAgentCtx->fileContext.pDecodeMem;
+            payloadSize = pAgentCtx->fileContext.decodeMemMaxSize;
         }
         else
         {
-            *pPayload = otaAgent.pOtaInterface->os.mem.malloc( 1UL << otaconfigLOG2_FILE_BLOCK_SIZE );
+            *pPayload = pAgentCtx->pOtaInterface->os.mem.malloc( 1UL << otaconfigLOG2_FILE_BLOCK_SIZE );
 
             if( *pPayload != NULL )
             {
@@ -2545,7 +3257,8 @@ static IngestResult_t decodeAndStoreDataBlock( OtaFileContext_t * pFileContext,
     if( payloadSize > 0u )
     {
         /* Decode the file block received. */
-        if( OtaErrNone != otaDataInterface.decodeFileBlock(
+        if( OtaErrNone != pAgentCtx->dataInterface.decodeFileBlock(
+                pAgentCtx,
                 pRawMsg,
                 messageSize,
                 &lFileId,
@@ -2576,7 +3289,8 @@ static IngestResult_t decodeAndStoreDataBlock( OtaFileContext_t * pFileContext,
 
 /* Free the resources allocated for data ingestion and close the file handle. */
 
-static IngestResult_t ingestDataBlockCleanup( OtaFileContext_t * pFileContext,
+static IngestResult_t ingestDataBlockCleanup( OtaAgentContext_t * pAgentCtx,
+                                              OtaFileContext_t * pFileContext,
                                               OtaPalStatus_t * pCloseResult )
 {
     IngestResult_t eIngestResult = IngestResultAccepted_Continue;
@@ -2590,19 +3304,20 @@ static IngestResult_t ingestDataBlockCleanup( OtaFileContext_t * pFileContext,
         LogInfo( ( "Received final block of the update." ) );
 
         /* Stop the request timer. */
-        ( void ) otaAgent.pOtaInterface->os.timer.stop( OtaRequestTimer );
+        ( void ) pAgentCtx->pOtaInterface->os.timer.stop( pAgentCtx->pOtaInterface->os.timer.pTimerContext,
+                                                          OtaRequestTimer );
 
         /* Free the bitmap now that we're done with the download. */
         if( ( pFileContext->pRxBlockBitmap != NULL ) && ( pFileContext->blockBitmapMaxSize == 0u ) )
         {
             /* Free any previously allocated bitmap. */
-            otaAgent.pOtaInterface->os.mem.free( pFileContext->pRxBlockBitmap );
+            pAgentCtx->pOtaInterface->os.mem.free( pFileContext->pRxBlockBitmap );
             pFileContext->pRxBlockBitmap = NULL;
         }
 
         if( pFileContext->pFile != NULL )
         {
-            *pCloseResult = otaAgent.pOtaInterface->pal.closeFile( pFileContext );
+            *pCloseResult = pAgentCtx->pOtaInterface->pal.closeFile( pFileContext );
             otaPalMainErr = OTA_PAL_MAIN_ERR( *pCloseResult );
             otaPalSubErr = OTA_PAL_SUB_ERR( *pCloseResult );
 
@@ -2645,7 +3360,8 @@ static IngestResult_t ingestDataBlockCleanup( OtaFileContext_t * pFileContext,
 
 /* Called when the OTA agent receives a file data block message. */
 
-static IngestResult_t ingestDataBlock( OtaFileContext_t * pFileContext,
+static IngestResult_t ingestDataBlock( OtaAgentContext_t * pAgentCtx,
+                                       OtaFileContext_t * pFileContext,
                                        const uint8_t * pRawMsg,
                                        uint32_t messageSize,
                                        OtaPalStatus_t * pCloseResult )
@@ -2663,25 +3379,25 @@ static IngestResult_t ingestDataBlock( OtaFileContext_t * pFileContext,
 
     /* Decode the received data block. */
     /* If we have a block bitmap available then process the message. */
-    eIngestResult = decodeAndStoreDataBlock( pFileContext, pRawMsg, messageSize, &pPayload, &uBlockSize, &uBlockIndex );
+    eIngestResult = decodeAndStoreDataBlock( pAgentCtx, pFileContext, pRawMsg, messageSize, &pPayload, &uBlockSize, &uBlockIndex );
 
     /* Validate the data block and process it to store the information.*/
     if( eIngestResult == IngestResultUninitialized )
     {
-        eIngestResult = processDataBlock( pFileContext, uBlockIndex, uBlockSize, pCloseResult, pPayload );
+        eIngestResult = processDataBlock( pAgentCtx, pFileContext, uBlockIndex, uBlockSize, pCloseResult, pPayload );
     }
 
     /* If the ingestion is complete close the file and cleanup.*/
     if( eIngestResult == IngestResultAccepted_Continue )
     {
-        eIngestResult = ingestDataBlockCleanup( pFileContext, pCloseResult );
+        eIngestResult = ingestDataBlockCleanup( pAgentCtx, pFileContext, pCloseResult );
     }
 
     /* Free the payload if it's dynamically allocated by us. */
-    if( ( otaAgent.fileContext.decodeMemMaxSize == 0u ) &&
+    if( ( pAgentCtx->fileContext.decodeMemMaxSize == 0u ) &&
         ( pPayload != NULL ) )
     {
-        otaAgent.pOtaInterface->os.mem.free( pPayload );
+        pAgentCtx->pOtaInterface->os.mem.free( pPayload );
     }
 
     return eIngestResult;
@@ -2690,22 +3406,22 @@ static IngestResult_t ingestDataBlock( OtaFileContext_t * pFileContext,
 /*
  * Clean up after the OTA process is done. Possibly free memory for re-use.
  */
-static void agentShutdownCleanup( void )
+static void agentShutdownCleanup( OtaAgentContext_t * pAgentCtx )
 {
     uint32_t index;
 
-    otaAgent.state = OtaAgentStateShuttingDown;
+    OTA_ATOMIC_STORE_U32( &pAgentCtx->state, OtaAgentStateShuttingDown );
 
     /* Control plane cleanup related to selected protocol. */
-    if( otaControlInterface.cleanup != NULL )
+    if( pAgentCtx->controlInterface.cleanup != NULL )
     {
-        ( void ) otaControlInterface.cleanup( &otaAgent );
+        ( void ) pAgentCtx->controlInterface.cleanup( pAgentCtx );
     }
 
     /* Data plane cleanup related to selected protocol. */
-    if( otaDataInterface.cleanup != NULL )
+    if( pAgentCtx->dataInterface.cleanup != NULL )
     {
-        ( void ) otaDataInterface.cleanup( &otaAgent );
+        ( void ) pAgentCtx->dataInterface.cleanup( pAgentCtx );
     }
 
     /*
@@ -2713,25 +3429,31 @@ static void agentShutdownCleanup( void )
      */
     for( index = 0; index < OTA_MAX_FILES; index++ )
     {
-        ( void ) otaClose( &( otaAgent.fileContext ) );
+        ( void ) otaClose( pAgentCtx, &( pAgentCtx->fileContext ) );
     }
 
     /*
      * Clear active job name.
      */
-    ( void ) memset( otaAgent.pActiveJobName, 0, OTA_JOB_ID_MAX_SIZE );
+    ( void ) memset( pAgentCtx->pActiveJobName, 0, OTA_JOB_ID_MAX_SIZE );
 }
 
 /*
  * Handle any events that were unexpected in the current state.
  */
-static void handleUnexpectedEvents( const OtaEventMsg_t * pEventMsg )
+static void handleUnexpectedEvents( OtaAgentContext_t * pAgentCtx,
+                                    const OtaEventMsg_t * pEventMsg )
 {
-    LogError( ( "Received unexpected event: "
-                "Current state=[%s]"
-                ", Event received=[%s]",
-                pOtaAgentStateStrings[ otaAgent.state ],
-                pOtaEventStrings[ pEventMsg->eventId ] ) );
+    /* The connection up event is signaled in every state, and only handled by the states that
+     * hold back requests while the connection is down. */
+    if( pEventMsg->eventId != OtaAgentEventConnectionUp )
+    {
+        LogError( ( "Received unexpected event: "
+                    "Current state=[%s]"
+                    ", Event received=[%s]",
+                    pOtaAgentStateStrings[ pAgentCtx->state ],
+                    pOtaEventStrings[ pEventMsg->eventId ] ) );
+    }
 
     /* Perform any cleanup operations required for specific unhandled events.*/
     switch( pEventMsg->eventId )
@@ -2739,17 +3461,17 @@ static void handleUnexpectedEvents( const OtaEventMsg_t * pEventMsg )
         case OtaAgentEventReceivedJobDocument:
 
             /* Let the application know to release buffer.*/
-            otaAgent.OtaAppCallback( OtaJobEventProcessed, ( const void * ) pEventMsg->pEventData );
+            notifyEventProcessed( pAgentCtx, pEventMsg->pEventData );
 
             break;
 
         case OtaAgentEventReceivedFileBlock:
 
             /* Let the application know to release buffer.*/
-            otaAgent.OtaAppCallback( OtaJobEventProcessed, ( const void * ) pEventMsg->pEventData );
+            notifyEventProcessed( pAgentCtx, pEventMsg->pEventData );
 
             /* File block was not processed, increment the statistics. */
-            otaAgent.statistics.otaPacketsDropped++;
+            ( void ) OTA_ATOMIC_ADD_RELAXED_U32( &pAgentCtx->statistics.otaPacketsDropped, 1U );
 
             break;
 
@@ -2760,253 +3482,1031 @@ static void handleUnexpectedEvents( const OtaEventMsg_t * pEventMsg )
     }
 }
 
-/*
- * Execute the handler for selected index from the transition table.
- */
-static void executeHandler( uint32_t index,
+static void notifyEventProcessed( OtaAgentContext_t * pAgentCtx,
+                                  const OtaEventData_t * pEventData )
+{
+    pAgentCtx->OtaAppCallback( OtaJobEventProcessed, ( const void * ) pEventData );
+
+    releaseEventBuffer( pEventData );
+}
+
+#if ( otaconfigEVENT_BUFFER_POOL_SIZE > 0U )
+    static uint32_t eventBufferIndex( const OtaEventData_t * pEventData )
+    {
+        uint32_t i = 0;
+
+        while( ( i < otaconfigEVENT_BUFFER_POOL_SIZE ) && ( pEventData != &otaEventBufferPool[ i ] ) )
+        {
+            i++;
+        }
+
+        return i;
+    }
+#endif /* if ( otaconfigEVENT_BUFFER_POOL_SIZE > 0U ) */
+
+static void drainEventQueue( OtaAgentContext_t * pAgentCtx )
+{
+    const OtaEventInterface_t * pEventInterface = &pAgentCtx->pOtaInterface->os.event;
+    OtaEventMsg_t eventMsg = { 0 };
+
+    /* Only wait for the events that are already queued. */
+    while( pEventInterface->recv( pEventInterface->pEventContext,
+                                  &eventMsg,
+                                  OTA_EVENT_DRAIN_TIMEOUT_MS ) == OtaOsSuccess )
+    {
+        if( ( eventMsg.eventId == OtaAgentEventReceivedJobDocument ) ||
+            ( eventMsg.eventId == OtaAgentEventReceivedFileBlock ) )
+        {
+            notifyEventProcessed( pAgentCtx, eventMsg.pEventData );
+        }
+    }
+}
+
+static void releaseEventBuffer( const OtaEventData_t * pEventData )
+{
+    #if ( otaconfigEVENT_BUFFER_POOL_SIZE > 0U )
+        uint32_t i = eventBufferIndex( pEventData );
+        uint32_t refs = 0;
+        bool released = false;
+
+        if( i < otaconfigEVENT_BUFFER_POOL_SIZE )
+        {
+            refs = OTA_ATOMIC_LOAD_U32( &otaEventBufferRefs[ i ] );
+
+            /* Drop one reference, never going below zero. On failure refs is
+             * reloaded and the count is checked again. */
+            while( ( refs > 0U ) && ( released == false ) )
+            {
+                /* A reference can only be retained by its holder, so when the
+                 * count is one this caller holds the last reference. The buffer
+                 * is marked free before it can be handed out again. */
+                if( refs == 1U )
+                {
+                    otaEventBufferPool[ i ].bufferUsed = false;
+                }
+
+                released = OTA_ATOMIC_COMPARE_AND_SWAP_U32( &otaEventBufferRefs[ i ], &refs, refs - 1U );
+            }
+
+            if( released == false )
+            {
+                LogError( ( "Failed to release event buffer: Buffer is not in use." ) );
+            }
+        }
+    #else /* if ( otaconfigEVENT_BUFFER_POOL_SIZE > 0U ) */
+        ( void ) pEventData;
+    #endif /* if ( otaconfigEVENT_BUFFER_POOL_SIZE > 0U ) */
+}
+
+static bool isControlEvent( OtaEvent_t eventId )
+{
+    bool control = false;
+
+    switch( eventId )
+    {
+        case OtaAgentEventStart:
+        case OtaAgentEventSuspend:
+        case OtaAgentEventResume:
+        case OtaAgentEventUserAbort:
+        case OtaAgentEventShutdown:
+        case OtaAgentEventConnectionUp:
+            control = true;
+            break;
+
+        default:
+            /* Timer and data events. */
+            break;
+    }
+
+    return control;
+}
+
+static bool coalesceEvent( OtaAgentContext_t * pAgentCtx,
+                           OtaEvent_t eventId )
+{
+    uint32_t * pPending = NULL;
+    uint32_t expected = 0;
+    OtaState_t state = OtaAgentStateNoTransition;
+    bool coalesced = false;
+
+    if( eventId == OtaAgentEventRequestTimer )
+    {
+        pPending = &pAgentCtx->requestTimerPending;
+
+        /* The state is stored by the agent task, while events are signaled from any task. */
+        state = OTA_ATOMIC_LOAD_U32( &pAgentCtx->state );
+
+        if( ( OTA_ATOMIC_LOAD_U32( &pAgentCtx->requestFileBlockPending ) != 0U ) &&
+            ( ( state == OtaAgentStateRequestingFileBlock ) ||
+              ( state == OtaAgentStateWaitingForFileBlock ) ) )
+        {
+            coalesced = true;
+        }
+    }
+    else if( eventId == OtaAgentEventRequestFileBlock )
+    {
+        pPending = &pAgentCtx->requestFileBlockPending;
+    }
+    else if( isControlEvent( eventId ) == true )
+    {
+        /* Counted before it is queued, so it is never received uncounted. */
+        ( void ) OTA_ATOMIC_ADD_U32( &pAgentCtx->controlEventsPending, 1U );
+    }
+    else
+    {
+        /* Other events are always queued. */
+    }
+
+    if( ( pPending != NULL ) && ( coalesced == false ) )
+    {
+        coalesced = ( OTA_ATOMIC_COMPARE_AND_SWAP_U32( pPending, &expected, 1U ) == false );
+    }
+
+    if( coalesced == true )
+    {
+        ( void ) OTA_ATOMIC_ADD_RELAXED_U32( &pAgentCtx->statistics.otaEventsCoalesced, 1U );
+
+        LogDebug( ( "Coalesced event with a pending request: "
+                    "event=%d",
+                    eventId ) );
+    }
+
+    return coalesced;
+}
+
+static void clearPendingEvent( OtaAgentContext_t * pAgentCtx,
+                               OtaEvent_t eventId )
+{
+    if( eventId == OtaAgentEventRequestTimer )
+    {
+        OTA_ATOMIC_STORE_U32( &pAgentCtx->requestTimerPending, 0U );
+    }
+    else if( eventId == OtaAgentEventRequestFileBlock )
+    {
+        OTA_ATOMIC_STORE_U32( &pAgentCtx->requestFileBlockPending, 0U );
+    }
+    else if( isControlEvent( eventId ) == true )
+    {
+        ( void ) OTA_ATOMIC_SUB_U32( &pAgentCtx->controlEventsPending, 1U );
+    }
+    else
+    {
+        /* Other events are not marked. */
+    }
+}
+
+static void resetStatistics( OtaAgentContext_t * pAgentCtx )
+{
+    OtaStatisticsCounters_t * pCounters = &pAgentCtx->statistics;
+    uint32_t sequence = 0;
+
+    /* Make the sequence odd, once any other reset has made it even again. */
+    do
+    {
+        sequence = OTA_ATOMIC_LOAD_RELAXED_U32( &pCounters->sequence ) & ~1U;
+    } while( OTA_ATOMIC_COMPARE_AND_SWAP_U32( &pCounters->sequence, &sequence, sequence + 1U ) == false );
+
+    OTA_ATOMIC_FENCE_RELEASE();
+
+    OTA_ATOMIC_STORE_RELAXED_U32( &pCounters->otaPacketsQueued, 0U );
+    OTA_ATOMIC_STORE_RELAXED_U32( &pCounters->otaPacketsRejected, 0U );
+    OTA_ATOMIC_STORE_RELAXED_U32( &pCounters->otaBuffersExhausted, 0U );
+    OTA_ATOMIC_STORE_RELAXED_U32( &pCounters->otaEventsCoalesced, 0U );
+    OTA_ATOMIC_STORE_RELAXED_U32( &pCounters->otaPacketsProcessed, 0U );
+    OTA_ATOMIC_STORE_RELAXED_U32( &pCounters->otaPacketsDropped, 0U );
+    OTA_ATOMIC_STORE_RELAXED_U32( &pCounters->otaRequestsDeferred, 0U );
+
+    OTA_ATOMIC_STORE_U32( &pCounters->sequence, sequence + 2U );
+}
+
+static bool holdBackFileBlockRequest( void )
+{
+    bool holdBack = false;
+
+    #if ( otaconfigEVENT_BUFFER_BACKPRESSURE == 1U ) && ( otaconfigEVENT_BUFFER_POOL_SIZE > 0U )
+        uint32_t i = 0;
+
+        holdBack = true;
+
+        for( i = 0; ( i < otaconfigEVENT_BUFFER_POOL_SIZE ) && ( holdBack == true ); i++ )
+        {
+            if( OTA_ATOMIC_LOAD_U32( &otaEventBufferRefs[ i ] ) == 0U )
+            {
+                holdBack = false;
+            }
+        }
+    #endif
+
+    return holdBack;
+}
+
+static void adaptRequestTimeoutOnRequest( OtaAgentContext_t * pAgentCtx )
+{
+    const OtaGetTimeMs_t getTimeMs = pAgentCtx->pOtaInterface->os.timer.getTimeMs;
+
+    if( getTimeMs != NULL )
+    {
+        if( pAgentCtx->requestMomentum > 0U )
+        {
+            /* The previous request timed out. Back off, and do not sample the repeated request.
+             * The bounded timeout is small enough to be doubled. */
+            pAgentCtx->requestTimeoutMs = boundRequestTimeout( pAgentCtx->requestTimeoutMs * 2U );
+            pAgentCtx->rttSamplePending = false;
+        }
+        else
+        {
+            pAgentCtx->requestSentTimeMs = getTimeMs();
+            pAgentCtx->rttSamplePending = true;
+        }
+    }
+}
+
+static void adaptRequestTimeoutOnBlock( OtaAgentContext_t * pAgentCtx )
+{
+    const OtaGetTimeMs_t getTimeMs = pAgentCtx->pOtaInterface->os.timer.getTimeMs;
+    uint32_t rttMs = 0;
+    uint32_t errorMs = 0;
+
+    if( ( getTimeMs != NULL ) && ( pAgentCtx->rttSamplePending == true ) )
+    {
+        pAgentCtx->rttSamplePending = false;
+
+        /* Unsigned subtraction handles the time wrapping around. */
+        rttMs = getTimeMs() - pAgentCtx->requestSentTimeMs;
+
+        /* Keep the sample non-zero, as a zero smoothed RTT means no sample yet, and small
+         * enough that the timeout below cannot overflow. */
+        if( rttMs == 0U )
+        {
+            rttMs = 1U;
+        }
+        else if( rttMs > otaconfigFILE_REQUEST_WAIT_MAX_MS )
+        {
+            rttMs = otaconfigFILE_REQUEST_WAIT_MAX_MS;
+        }
+        else
+        {
+            /* Sample within range. */
+        }
+
+        if( pAgentCtx->smoothedRttMs == 0U )
+        {
+            /* First sample. */
+            pAgentCtx->smoothedRttMs = rttMs;
+            pAgentCtx->rttVariationMs = rttMs / 2U;
+        }
+        else
+        {
+            /* RTTVAR = 3/4 RTTVAR + 1/4 |SRTT - R| and SRTT = 7/8 SRTT + 1/8 R, as in RFC 6298. */
+            errorMs = ( rttMs > pAgentCtx->smoothedRttMs ) ? ( rttMs - pAgentCtx->smoothedRttMs ) :
+                      ( pAgentCtx->smoothedRttMs - rttMs );
+            pAgentCtx->rttVariationMs = pAgentCtx->rttVariationMs - ( pAgentCtx->rttVariationMs / 4U ) + ( errorMs / 4U );
+            pAgentCtx->smoothedRttMs = pAgentCtx->smoothedRttMs - ( pAgentCtx->smoothedRttMs / 8U ) + ( rttMs / 8U );
+        }
+
+        pAgentCtx->requestTimeoutMs = boundRequestTimeout( pAgentCtx->smoothedRttMs + ( 4U * pAgentCtx->rttVariationMs ) );
+
+        LogDebug( ( "Adapted file block request timeout: "
+                    "rtt=%ums, srtt=%ums, rttvar=%ums, timeout=%ums",
+                    ( unsigned int ) rttMs,
+                    ( unsigned int ) pAgentCtx->smoothedRttMs,
+                    ( unsigned int ) pAgentCtx->rttVariationMs,
+                    ( unsigned int ) pAgentCtx->requestTimeoutMs ) );
+    }
+}
+
+static uint32_t boundRequestTimeout( uint32_t timeoutMs )
+{
+    uint32_t boundedMs = timeoutMs;
+
+    if( boundedMs < otaconfigFILE_REQUEST_WAIT_MIN_MS )
+    {
+        boundedMs = otaconfigFILE_REQUEST_WAIT_MIN_MS;
+    }
+    else if( boundedMs > otaconfigFILE_REQUEST_WAIT_MAX_MS )
+    {
+        boundedMs = otaconfigFILE_REQUEST_WAIT_MAX_MS;
+    }
+    else
+    {
+        /* Timeout within bounds. */
+    }
+
+    return boundedMs;
+}
+
+static uint32_t fileBlockRequestTimeout( const OtaAgentContext_t * pAgentCtx )
+{
+    uint32_t timeoutMs = pAgentCtx->requestTimeoutMs;
+
+    #if ( otaconfigENDGAME_NUM_BLOCKS > 0U )
+        if( pAgentCtx->fileContext.blocksRemaining <= otaconfigENDGAME_NUM_BLOCKS )
+        {
+            /* Halve the timeout, without going below the lower bound unless it already is. */
+            if( ( timeoutMs / 2U ) >= otaconfigFILE_REQUEST_WAIT_MIN_MS )
+            {
+                timeoutMs /= 2U;
+            }
+            else if( timeoutMs > otaconfigFILE_REQUEST_WAIT_MIN_MS )
+            {
+                timeoutMs = otaconfigFILE_REQUEST_WAIT_MIN_MS;
+            }
+            else
+            {
+                /* Already at or below the lower bound. */
+            }
+        }
+    #endif
+
+    return timeoutMs;
+}
+
+static bool detectBlockGap( OtaAgentContext_t * pAgentCtx,
+                            const OtaFileContext_t * pFileContext,
+                            uint32_t uBlockIndex )
+{
+    bool gap = false;
+
+    #if ( otaconfigFAST_RETRANSMIT_THRESHOLD > 0U )
+        uint32_t numBlocks = ( pFileContext->fileSize + ( OTA_FILE_BLOCK_SIZE - 1U ) ) >> otaconfigLOG2_FILE_BLOCK_SIZE;
+        uint32_t block = 0;
+
+        /* Move past the blocks received since the last call, each gap gets its own count and retransmit. */
+        while( ( pAgentCtx->nextMissingBlock < numBlocks ) &&
+               ( ( pFileContext->pRxBlockBitmap[ pAgentCtx->nextMissingBlock >> LOG2_BITS_PER_BYTE ] &
+                   ( uint8_t ) ( 1U << ( pAgentCtx->nextMissingBlock % BITS_PER_BYTE ) ) ) == 0U ) )
+        {
+            pAgentCtx->nextMissingBlock++;
+            pAgentCtx->blocksPastGap = 0;
+            pAgentCtx->gapRetransmitted = false;
+        }
+
+        if( ( uBlockIndex > pAgentCtx->nextMissingBlock ) && ( pAgentCtx->gapRetransmitted == false ) )
+        {
+            pAgentCtx->blocksPastGap++;
+
+            if( pAgentCtx->blocksPastGap >= otaconfigFAST_RETRANSMIT_THRESHOLD )
+            {
+                pAgentCtx->gapRetransmitted = true;
+                gap = true;
+
+                /* The streaming service sends the lowest missing blocks first, so
+                 * asking for this many gets exactly the blocks of the gap. */
+                pAgentCtx->retransmitNumBlocks = 0;
+
+                for( block = pAgentCtx->nextMissingBlock; block < uBlockIndex; block++ )
+                {
+                    if( ( pFileContext->pRxBlockBitmap[ block >> LOG2_BITS_PER_BYTE ] &
+                          ( uint8_t ) ( 1U << ( block % BITS_PER_BYTE ) ) ) != 0U )
+                    {
+                        pAgentCtx->retransmitNumBlocks++;
+                    }
+                }
+            }
+        }
+    #else
+        ( void ) pAgentCtx;
+        ( void ) pFileContext;
+        ( void ) uBlockIndex;
+    #endif /* if ( otaconfigFAST_RETRANSMIT_THRESHOLD > 0U ) */
+
+    return gap;
+}
+
+static void seedRandom( OtaAgentContext_t * pAgentCtx )
+{
+    const OtaGetTimeMs_t getTimeMs = pAgentCtx->pOtaInterface->os.timer.getTimeMs;
+    uint32_t seed = 2166136261U;
+    uint32_t i = 0;
+
+    /* FNV-1a hash of the Thing name. */
+    for( i = 0; pAgentCtx->pThingName[ i ] != 0U; i++ )
+    {
+        seed = ( seed ^ pAgentCtx->pThingName[ i ] ) * 16777619U;
+    }
+
+    if( getTimeMs != NULL )
+    {
+        seed ^= getTimeMs();
+    }
+
+    /* The generator must not start from zero. */
+    pAgentCtx->randomState = ( seed != 0U ) ? seed : 0x9E3779B9U;
+}
+
+static uint32_t randomNumber( OtaAgentContext_t * pAgentCtx )
+{
+    uint32_t x = pAgentCtx->randomState;
+
+    /* Xorshift generator, enough to spread out the waits of devices. */
+    x ^= x << 13U;
+    x ^= x >> 17U;
+    x ^= x << 5U;
+    pAgentCtx->randomState = x;
+
+    return x;
+}
+
+static uint32_t retryDelay( OtaAgentContext_t * pAgentCtx,
+                            uint32_t baseMs )
+{
+    uint32_t maxMs = OTA_ATOMIC_LOAD_RELAXED_U32( &pAgentCtx->requestBackoff.maxMs );
+    uint32_t upperMs = pAgentCtx->retryDelayMs;
+    uint32_t delayMs = baseMs;
+
+    /* Decorrelated jitter: wait between the base and three times the previous wait. */
+    if( upperMs < baseMs )
+    {
+        upperMs = baseMs;
+    }
+
+    upperMs = ( upperMs > ( maxMs / 3U ) ) ? maxMs : ( upperMs * 3U );
+
+    if( upperMs > baseMs )
+    {
+        delayMs = baseMs + ( randomNumber( pAgentCtx ) % ( upperMs - baseMs ) );
+    }
+
+    pAgentCtx->retryDelayMs = delayMs;
+
+    LogDebug( ( "Retrying request after a random backoff: Delay=%ums",
+                ( unsigned int ) delayMs ) );
+
+    return delayMs;
+}
+
+static bool progressReportDue( OtaAgentContext_t * pAgentCtx )
+{
+    const OtaGetTimeMs_t getTimeMs = pAgentCtx->pOtaInterface->os.timer.getTimeMs;
+    const OtaFileContext_t * pFileContext = &( pAgentCtx->fileContext );
+    uint32_t numBlocks = 0;
+    uint32_t percent = 0;
+    uint32_t nowMs = 0;
+    uint32_t elapsedMs = 0;
+    bool stepReached = false;
+    bool reportDue = false;
+
+    /* The block bitmap limits the number of blocks, so the product cannot overflow. */
+    numBlocks = ( pFileContext->fileSize + ( OTA_FILE_BLOCK_SIZE - 1U ) ) >> otaconfigLOG2_FILE_BLOCK_SIZE;
+
+    if( numBlocks > 0U )
+    {
+        percent = ( ( numBlocks - pFileContext->blocksRemaining ) * 100U ) / numBlocks;
+    }
+
+    #if ( otaconfigPROGRESS_PERCENT_STEP > 0U )
+        stepReached = ( ( percent / otaconfigPROGRESS_PERCENT_STEP ) !=
+                        ( pAgentCtx->progressReportPercent / otaconfigPROGRESS_PERCENT_STEP ) );
+    #endif
+
+    if( getTimeMs != NULL )
+    {
+        nowMs = getTimeMs();
+
+        /* Unsigned subtraction handles the time wrapping around. */
+        elapsedMs = nowMs - pAgentCtx->progressReportTimeMs;
+
+        if( elapsedMs >= otaconfigPROGRESS_MIN_INTERVAL_MS )
+        {
+            reportDue = ( stepReached == true ) || ( elapsedMs >= otaconfigPROGRESS_MAX_INTERVAL_MS );
+        }
+    }
+    else
+    {
+        /* Without a clock only the percentage steps apply. */
+        reportDue = stepReached;
+    }
+
+    if( reportDue == true )
+    {
+        pAgentCtx->progressReportTimeMs = nowMs;
+        pAgentCtx->progressReportPercent = percent;
+    }
+
+    return reportDue;
+}
+
+static void flushJobStatusOutbox( OtaAgentContext_t * pAgentCtx )
+{
+    OtaErr_t err = OtaErrNone;
+
+    if( ( pAgentCtx->progressStatusPending == true ) &&
+        ( OTA_ATOMIC_LOAD_U32( &pAgentCtx->connectionDown ) == 0U ) )
+    {
+        pAgentCtx->progressStatusPending = false;
+
+        /* Progress is stale once the file is no longer being received. */
+        if( ( pAgentCtx->state == OtaAgentStateWaitingForFileBlock ) ||
+            ( pAgentCtx->state == OtaAgentStateRequestingFileBlock ) )
+        {
+            err = pAgentCtx->controlInterface.updateJobStatus( pAgentCtx, JobStatusInProgress, JobReasonReceiving, 0 );
+
+            if( err != OtaErrNone )
+            {
+                LogError( ( "Failed to update job status: updateJobStatus returned error: OtaErr_t=%s",
+                            OTA_Err_strerror( err ) ) );
+            }
+        }
+    }
+}
+
+static bool heldBackByConnection( const OtaAgentContext_t * pAgentCtx,
+                                  OtaEvent_t eventId )
+{
+    bool heldBack = false;
+
+    if( ( ( eventId == OtaAgentEventRequestTimer ) || ( eventId == OtaAgentEventRequestFileBlock ) ) &&
+        ( OTA_ATOMIC_LOAD_U32( &pAgentCtx->connectionDown ) != 0U ) )
+    {
+        LogDebug( ( "Held back request until the connection is up: "
+                    "event=%d",
+                    eventId ) );
+
+        heldBack = true;
+    }
+
+    return heldBack;
+}
+
+/*
+ * Execute the handler for selected index from the transition table.
+ */
+static void executeHandler( OtaAgentContext_t * pAgentCtx,
+                            uint32_t index,
                             const OtaEventMsg_t * const pEventMsg )
 {
     OtaErr_t err = OtaErrNone;
 
-    assert( otaTransitionTable[ index ].handler != NULL );
+    assert( otaTransitionTable[ index ].handler != NULL );
+
+    err = otaTransitionTable[ index ].handler( pAgentCtx, pEventMsg->pEventData );
+
+    if( err == OtaErrNone )
+    {
+        LogDebug( ( "Executing handler for state transition: " ) );
+
+        /*
+         * Update the current state in OTA agent context.
+         */
+        OTA_ATOMIC_STORE_U32( &pAgentCtx->state, otaTransitionTable[ index ].nextState );
+    }
+    else
+    {
+        LogError( ( "Failed to execute state transition handler: "
+                    "Handler returned error: OtaErr_t=%s",
+                    OTA_Err_strerror( err ) ) );
+    }
+
+    LogInfo( ( "Current State=[%s]"
+               ", Event=[%s]"
+               ", New state=[%s]",
+               pOtaAgentStateStrings[ pAgentCtx->state ],
+               pOtaEventStrings[ pEventMsg->eventId ],
+               pOtaAgentStateStrings[ otaTransitionTable[ index ].nextState ] ) );
+}
+
+static void buildDispatchTable( void )
+{
+    uint32_t i = 0;
+    uint32_t index = 0;
+    uint32_t state = 0;
+    uint32_t event = 0;
+
+    /* The entries are stored as uint8_t. */
+    assert( otaTransitionTableLength <= ( uint32_t ) UINT8_MAX );
+
+    /* The table is shared by all agent contexts, so once it is built agents
+     * that are running are never exposed to writes. First calls of OTA_InitCtx
+     * that run at the same time may both build it, writing the same values. */
+    if( OTA_ATOMIC_LOAD_U32( &otaDispatchTableBuilt ) == 0U )
+    {
+        for( state = 0; state < ( uint32_t ) OtaAgentStateAll; state++ )
+        {
+            for( event = 0; event < ( uint32_t ) OtaAgentEventMax; event++ )
+            {
+                index = otaTransitionTableLength;
+
+                /* The first matching row wins, the same as a linear search from the top. */
+                for( i = 0; ( i < otaTransitionTableLength ) && ( index == otaTransitionTableLength ); i++ )
+                {
+                    if( ( ( uint32_t ) otaTransitionTable[ i ].eventId == event ) &&
+                        ( ( ( uint32_t ) otaTransitionTable[ i ].currentState == state ) ||
+                          ( otaTransitionTable[ i ].currentState == OtaAgentStateAll ) ) )
+                    {
+                        index = i;
+                    }
+                }
+
+                otaDispatchTable[ state ][ event ] = ( uint8_t ) index;
+            }
+        }
+
+        OTA_ATOMIC_STORE_U32( &otaDispatchTableBuilt, 1U );
+    }
+}
+
+static uint32_t searchTransition( OtaAgentContext_t * pAgentCtx,
+                                  const OtaEventMsg_t * pEventMsg )
+{
+    uint32_t i = otaTransitionTableLength;
+
+    if( ( ( uint32_t ) pAgentCtx->state < ( uint32_t ) OtaAgentStateAll ) &&
+        ( ( uint32_t ) pEventMsg->eventId < ( uint32_t ) OtaAgentEventMax ) )
+    {
+        i = ( uint32_t ) otaDispatchTable[ pAgentCtx->state ][ pEventMsg->eventId ];
+    }
+
+    return i;
+}
+
+static void processOtaEvent( OtaAgentContext_t * pAgentCtx,
+                             const OtaEventMsg_t * pEventMsg )
+{
+    uint32_t i = 0;
+
+    /*
+     * Search transition index if available in the table.
+     */
+    i = searchTransition( pAgentCtx, pEventMsg );
+
+    if( i < otaTransitionTableLength )
+    {
+        LogDebug( ( "Found valid event handler for state transition: "
+                    "State=[%s], "
+                    "Event=[%s]",
+                    pOtaAgentStateStrings[ pAgentCtx->state ],
+                    pOtaEventStrings[ pEventMsg->eventId ] ) );
+
+        /*
+         * Execute the handler function.
+         */
+        executeHandler( pAgentCtx, i, pEventMsg );
+    }
+
+    if( i == otaTransitionTableLength )
+    {
+        /*
+         * Handle unexpected events.
+         */
+        handleUnexpectedEvents( pAgentCtx, pEventMsg );
+    }
+}
+
+static void receiveAndProcessOtaEvent( OtaAgentContext_t * pAgentCtx )
+{
+    OtaEventMsg_t eventMsgs[ otaconfigMAX_EVENT_BATCH_SIZE ];
+    OtaEventMsg_t deferredMsgs[ otaconfigMAX_EVENT_BATCH_SIZE ];
+    const OtaInterfaces_t * pOtaInterface = pAgentCtx->pOtaInterface;
+    OtaState_t initialState = pAgentCtx->state;
+    OtaOsStatus_t osStatus = OtaOsSuccess;
+    uint32_t timeoutMs = otaconfigAGENT_IDLE_PERIOD_MS;
+    uint32_t numEvents = 0;
+    uint32_t numDeferred = 0;
+    uint32_t numProcessed = 0;
+    uint32_t first = 0;
+    uint32_t i = 0;
+    bool endedEarly = false;
+
+    if( pAgentCtx->pOtaInterface == NULL )
+    {
+        LogError( ( "Failed to receive event: OS Interface not set" ) );
+    }
+    else
+    {
+        /*
+         * Take the events left by a batch that was ended early. The control
+         * event that ended it is already queued, so it is not waited for long.
+         */
+        numDeferred = pAgentCtx->numDeferredEvents;
+
+        if( numDeferred > 0U )
+        {
+            ( void ) memcpy( deferredMsgs, pAgentCtx->deferredEvents, numDeferred * sizeof( OtaEventMsg_t ) );
+            pAgentCtx->numDeferredEvents = 0;
+            timeoutMs = OTA_EVENT_DRAIN_TIMEOUT_MS;
+        }
+
+        /*
+         * Receive the next events from the OTA event queue to process.
+         */
+        if( pAgentCtx->pOtaInterface->os.event.recvBatch != NULL )
+        {
+            osStatus = pAgentCtx->pOtaInterface->os.event.recvBatch( pAgentCtx->pOtaInterface->os.event.pEventContext,
+                                                                     eventMsgs,
+                                                                     otaconfigMAX_EVENT_BATCH_SIZE,
+                                                                     &numEvents,
+                                                                     timeoutMs );
+
+            if( osStatus != OtaOsSuccess )
+            {
+                numEvents = 0;
+            }
+            else if( numEvents > otaconfigMAX_EVENT_BATCH_SIZE )
+            {
+                LogError( ( "Event interface returned more events than requested: "
+                            "numEvents=%u",
+                            ( unsigned int ) numEvents ) );
+                numEvents = otaconfigMAX_EVENT_BATCH_SIZE;
+            }
+            else
+            {
+                /* Batch received. */
+            }
+        }
+        else
+        {
+            osStatus = pAgentCtx->pOtaInterface->os.event.recv( pAgentCtx->pOtaInterface->os.event.pEventContext,
+                                                                &eventMsgs[ 0 ],
+                                                                timeoutMs );
+
+            if( osStatus == OtaOsSuccess )
+            {
+                numEvents = 1;
+            }
+        }
+
+        if( ( osStatus == OtaOsEventQueueReceiveTimeout ) && ( numDeferred == 0U ) )
+        {
+            agentIdleHook( pAgentCtx );
+        }
+
+        /* Control events at the head of the batch overtake the deferred events. */
+        while( ( first < numEvents ) && ( isControlEvent( eventMsgs[ first ].eventId ) == true ) )
+        {
+            handleReceivedEvent( pAgentCtx, &eventMsgs[ first ], ( numProcessed > 0U ) );
+            numProcessed++;
+            first++;
+        }
+
+        for( i = 0; i < numDeferred; i++ )
+        {
+            handleReceivedEvent( pAgentCtx, &deferredMsgs[ i ], ( numProcessed > 0U ) );
+            numProcessed++;
+        }
+
+        /* A batch is ended early at most every other call, so the deferred
+         * events always fit and every event is processed by the next call. */
+        for( i = first; ( i < numEvents ) && ( endedEarly == false ); i++ )
+        {
+            if( ( numDeferred == 0U ) &&
+                ( isControlEvent( eventMsgs[ i ].eventId ) == false ) &&
+                ( OTA_ATOMIC_LOAD_U32( &pAgentCtx->controlEventsPending ) != 0U ) )
+            {
+                endBatchEarly( pAgentCtx, &eventMsgs[ i ], numEvents - i );
+                endedEarly = true;
+            }
+            else
+            {
+                handleReceivedEvent( pAgentCtx, &eventMsgs[ i ], ( numProcessed > 0U ) );
+                numProcessed++;
+            }
+        }
+
+        /* Publish deferred job status updates between events. A pending block request
+         * goes first, the update is published after it. */
+        if( OTA_ATOMIC_LOAD_U32( &pAgentCtx->requestFileBlockPending ) == 0U )
+        {
+            flushJobStatusOutbox( pAgentCtx );
+        }
+
+        /* Wake up OTA_Shutdown once the agent has stopped and is done with its
+         * context. The shutdown cleared the context, so use the interfaces saved above. */
+        if( ( initialState != OtaAgentStateStopped ) &&
+            ( pAgentCtx->state == OtaAgentStateStopped ) &&
+            ( pOtaInterface->os.event.signalShutdown != NULL ) )
+        {
+            ( void ) pOtaInterface->os.event.signalShutdown( pOtaInterface->os.event.pEventContext );
+        }
+    }
+}
 
-    err = otaTransitionTable[ index ].handler( pEventMsg->pEventData );
+static void handleReceivedEvent( OtaAgentContext_t * pAgentCtx,
+                                 const OtaEventMsg_t * pEventMsg,
+                                 bool dropAfterShutdown )
+{
+    /* Allow the event to be signaled again from here on. */
+    clearPendingEvent( pAgentCtx, pEventMsg->eventId );
 
-    if( err == OtaErrNone )
+    /* Events that were batched behind a shutdown are dropped. The agent
+     * context, including the application callback, is already cleared,
+     * so only buffers from the event buffer pool can be handed back. */
+    if( ( dropAfterShutdown == true ) && ( pAgentCtx->state == OtaAgentStateStopped ) )
     {
-        LogDebug( ( "Executing handler for state transition: " ) );
-
-        /*
-         * Update the current state in OTA agent context.
-         */
-        otaAgent.state = otaTransitionTable[ index ].nextState;
+        releaseEventBuffer( pEventMsg->pEventData );
+    }
+    else if( heldBackByConnection( pAgentCtx, pEventMsg->eventId ) == true )
+    {
+        /* The connection up event sends the request again. */
     }
     else
     {
-        LogError( ( "Failed to execute state transition handler: "
-                    "Handler returned error: OtaErr_t=%s",
-                    OTA_Err_strerror( err ) ) );
+        processOtaEvent( pAgentCtx, pEventMsg );
     }
-
-    LogInfo( ( "Current State=[%s]"
-               ", Event=[%s]"
-               ", New state=[%s]",
-               pOtaAgentStateStrings[ otaAgent.state ],
-               pOtaEventStrings[ pEventMsg->eventId ],
-               pOtaAgentStateStrings[ otaTransitionTable[ index ].nextState ] ) );
 }
 
-static uint32_t searchTransition( const OtaEventMsg_t * pEventMsg )
+static void endBatchEarly( OtaAgentContext_t * pAgentCtx,
+                           const OtaEventMsg_t * pEventMsgs,
+                           uint32_t numEvents )
 {
-    uint32_t transitionTableLen = ( uint32_t ) ( sizeof( otaTransitionTable ) / sizeof( otaTransitionTable[ 0 ] ) );
     uint32_t i = 0;
 
-    for( i = 0; i < transitionTableLen; i++ )
+    LogDebug( ( "Ending event batch early for a control event: "
+                "deferred events=%u",
+                ( unsigned int ) numEvents ) );
+
+    for( i = 0; i < numEvents; i++ )
     {
-        if( ( ( otaTransitionTable[ i ].currentState == otaAgent.state ) ||
-              ( otaTransitionTable[ i ].currentState == OtaAgentStateAll ) ) &&
-            ( otaTransitionTable[ i ].eventId == pEventMsg->eventId ) )
+        /* Events left behind a shutdown are released right away, as the
+         * agent does not receive events once it has stopped. */
+        if( ( isControlEvent( pEventMsgs[ i ].eventId ) == true ) ||
+            ( pAgentCtx->state == OtaAgentStateStopped ) )
         {
-            break;
+            handleReceivedEvent( pAgentCtx, &pEventMsgs[ i ], true );
+        }
+        else
+        {
+            pAgentCtx->deferredEvents[ pAgentCtx->numDeferredEvents ] = pEventMsgs[ i ];
+            pAgentCtx->numDeferredEvents++;
         }
     }
-
-    return i;
 }
 
-static void receiveAndProcessOtaEvent( void )
+static void agentIdleHook( OtaAgentContext_t * pAgentCtx )
 {
-    OtaEventMsg_t eventMsg = { 0 };
-    uint32_t i = 0;
-    uint32_t transitionTableLen = ( uint32_t ) ( sizeof( otaTransitionTable ) / sizeof( otaTransitionTable[ 0 ] ) );
+    LogDebug( ( "OTA Agent is idle: "
+                "Running deferred work." ) );
 
-    if( otaAgent.pOtaInterface == NULL )
-    {
-        LogError( ( "Failed to receive event: OS Interface not set" ) );
-    }
-    else
-    {
-        /*
-         * Receive the next event from the OTA event queue to process.
-         */
-        if( otaAgent.pOtaInterface->os.event.recv( NULL, &eventMsg, 0 ) == OtaOsSuccess )
-        {
-            /*
-             * Search transition index if available in the table.
-             */
-            i = searchTransition( &eventMsg );
-
-            if( i < transitionTableLen )
-            {
-                LogDebug( ( "Found valid event handler for state transition: "
-                            "State=[%s], "
-                            "Event=[%s]",
-                            pOtaAgentStateStrings[ otaAgent.state ],
-                            pOtaEventStrings[ eventMsg.eventId ] ) );
-
-                /*
-                 * Execute the handler function.
-                 */
-                executeHandler( i, &eventMsg );
-            }
-
-            if( i == transitionTableLen )
-            {
-                /*
-                 * Handle unexpected events.
-                 */
-                handleUnexpectedEvents( &eventMsg );
-            }
-        }
-    }
+    flushJobStatusOutbox( pAgentCtx );
 }
 
-void OTA_EventProcessingTask( void * pUnused )
+void OTA_EventProcessingTaskCtx( OtaAgentContext_t * pAgentCtx )
 {
-    ( void ) pUnused;
+    assert( pAgentCtx != NULL );
 
     /*
      * OTA Agent is ready to receive and process events so update the state to ready.
      */
-    otaAgent.state = OtaAgentStateReady;
+    OTA_ATOMIC_STORE_U32( &pAgentCtx->state, OtaAgentStateReady );
 
-    while( otaAgent.state != OtaAgentStateStopped )
+    while( pAgentCtx->state != OtaAgentStateStopped )
     {
-        receiveAndProcessOtaEvent();
+        receiveAndProcessOtaEvent( pAgentCtx );
     }
 }
 
-bool OTA_SignalEvent( const OtaEventMsg_t * const pEventMsg )
+void OTA_EventProcessingTask( void * pUnused )
+{
+    ( void ) pUnused;
+
+    OTA_EventProcessingTaskCtx( &otaAgent );
+}
+
+bool OTA_SignalEventCtx( OtaAgentContext_t * pAgentCtx,
+                         const OtaEventMsg_t * const pEventMsg )
 {
     bool retVal = false;
     OtaOsStatus_t err = OtaOsSuccess;
 
-    /* Check if file block received and update statistics.*/
-    if( pEventMsg->eventId == OtaAgentEventReceivedFileBlock )
-    {
-        otaAgent.statistics.otaPacketsReceived++;
-    }
+    assert( pAgentCtx != NULL );
 
-    err = otaAgent.pOtaInterface->os.event.send( NULL, pEventMsg, 0 );
-
-    if( err == OtaOsSuccess )
+    if( coalesceEvent( pAgentCtx, pEventMsg->eventId ) == true )
     {
+        /* An equivalent event is already queued. */
         retVal = true;
-        LogDebug( ( "Added event message to OTA event queue." ) );
-
-        if( pEventMsg->eventId == OtaAgentEventReceivedFileBlock )
-        {
-            otaAgent.statistics.otaPacketsQueued++;
-        }
     }
     else
     {
-        retVal = false;
-        LogError( ( "Failed to add even message to OTA event queue: "
-                    "send returned error: "
-                    "OtaOsStatus_t=%s",
-                    OTA_OsStatus_strerror( err ) ) );
+        err = pAgentCtx->pOtaInterface->os.event.send( pAgentCtx->pOtaInterface->os.event.pEventContext,
+                                                       pEventMsg,
+                                                       0 );
+
+        if( err == OtaOsSuccess )
+        {
+            retVal = true;
+            LogDebug( ( "Added event message to OTA event queue." ) );
 
-        if( pEventMsg->eventId == OtaAgentEventReceivedFileBlock )
+            if( pEventMsg->eventId == OtaAgentEventReceivedFileBlock )
+            {
+                ( void ) OTA_ATOMIC_ADD_RELAXED_U32( &pAgentCtx->statistics.otaPacketsQueued, 1U );
+            }
+        }
+        else
         {
-            otaAgent.statistics.otaPacketsDropped++;
+            retVal = false;
+            LogError( ( "Failed to add even message to OTA event queue: "
+                        "send returned error: "
+                        "OtaOsStatus_t=%s",
+                        OTA_OsStatus_strerror( err ) ) );
+
+            clearPendingEvent( pAgentCtx, pEventMsg->eventId );
+
+            if( pEventMsg->eventId == OtaAgentEventReceivedFileBlock )
+            {
+                ( void ) OTA_ATOMIC_ADD_RELAXED_U32( &pAgentCtx->statistics.otaPacketsRejected, 1U );
+            }
         }
     }
 
     return retVal;
 }
 
-static void initializeAppBuffers( OtaAppBuffer_t * pOtaBuffer )
+bool OTA_SignalEvent( const OtaEventMsg_t * const pEventMsg )
+{
+    return OTA_SignalEventCtx( &otaAgent, pEventMsg );
+}
+
+static void initializeAppBuffers( OtaAgentContext_t * pAgentCtx,
+                                  OtaAppBuffer_t * pOtaBuffer )
 {
     /* Initialize update file path buffer from application buffer.*/
     if( ( pOtaBuffer->pUpdateFilePath != NULL ) && ( pOtaBuffer->updateFilePathsize > 0u ) )
     {
-        otaAgent.fileContext.pFilePath = pOtaBuffer->pUpdateFilePath;
-        otaAgent.fileContext.filePathMaxSize = pOtaBuffer->updateFilePathsize;
+        pAgentCtx->fileContext.pFilePath = pOtaBuffer->pUpdateFilePath;
+        pAgentCtx->fileContext.filePathMaxSize = pOtaBuffer->updateFilePathsize;
     }
     else
     {
-        otaAgent.fileContext.filePathMaxSize = 0;
+        pAgentCtx->fileContext.filePathMaxSize = 0;
     }
 
     /* Initialize certificate file path buffer from application buffer.*/
     if( ( pOtaBuffer->pCertFilePath != NULL ) && ( pOtaBuffer->certFilePathSize > 0u ) )
     {
-        otaAgent.fileContext.pCertFilepath = pOtaBuffer->pCertFilePath;
-        otaAgent.fileContext.certFilePathMaxSize = pOtaBuffer->certFilePathSize;
+        pAgentCtx->fileContext.pCertFilepath = pOtaBuffer->pCertFilePath;
+        pAgentCtx->fileContext.certFilePathMaxSize = pOtaBuffer->certFilePathSize;
     }
     else
     {
-        otaAgent.fileContext.certFilePathMaxSize = 0;
+        pAgentCtx->fileContext.certFilePathMaxSize = 0;
     }
 
     /* Initialize stream name buffer from application buffer.*/
     if( ( pOtaBuffer->pStreamName != NULL ) && ( pOtaBuffer->streamNameSize > 0u ) )
     {
-        otaAgent.fileContext.pStreamName = pOtaBuffer->pStreamName;
-        otaAgent.fileContext.streamNameMaxSize = pOtaBuffer->streamNameSize;
+        pAgentCtx->fileContext.pStreamName = pOtaBuffer->pStreamName;
+        pAgentCtx->fileContext.streamNameMaxSize = pOtaBuffer->streamNameSize;
     }
     else
     {
-        otaAgent.fileContext.streamNameMaxSize = 0;
+        pAgentCtx->fileContext.streamNameMaxSize = 0;
     }
 
     /* Initialize file bitmap buffer from application buffer.*/
     if( ( pOtaBuffer->pDecodeMemory != NULL ) && ( pOtaBuffer->decodeMemorySize > 0u ) )
     {
-        otaAgent.fileContext.pDecodeMem = pOtaBuffer->pDecodeMemory;
-        otaAgent.fileContext.decodeMemMaxSize = pOtaBuffer->decodeMemorySize;
+        pAgentCtx->fileContext.pDecodeMem = pOtaBuffer->pDecodeMemory;
+        pAgentCtx->fileContext.decodeMemMaxSize = pOtaBuffer->decodeMemorySize;
     }
     else
     {
-        otaAgent.fileContext.decodeMemMaxSize = 0;
+        pAgentCtx->fileContext.decodeMemMaxSize = 0;
     }
 
     /* Initialize file bitmap buffer from application buffer.*/
     if( ( pOtaBuffer->pFileBitmap != NULL ) && ( pOtaBuffer->fileBitmapSize > 0u ) )
     {
-        otaAgent.fileContext.pRxBlockBitmap = pOtaBuffer->pFileBitmap;
-        otaAgent.fileContext.blockBitmapMaxSize = pOtaBuffer->fileBitmapSize;
+        pAgentCtx->fileContext.pRxBlockBitmap = pOtaBuffer->pFileBitmap;
+        pAgentCtx->fileContext.blockBitmapMaxSize = pOtaBuffer->fileBitmapSize;
     }
     else
     {
-        otaAgent.fileContext.blockBitmapMaxSize = 0;
+        pAgentCtx->fileContext.blockBitmapMaxSize = 0;
     }
 
     /* Initialize url buffer from application buffer.*/
     if( ( pOtaBuffer->pUrl != NULL ) && ( pOtaBuffer->urlSize > 0u ) )
     {
-        otaAgent.fileContext.pUpdateUrlPath = pOtaBuffer->pUrl;
-        otaAgent.fileContext.updateUrlMaxSize = pOtaBuffer->urlSize;
+        pAgentCtx->fileContext.pUpdateUrlPath = pOtaBuffer->pUrl;
+        pAgentCtx->fileContext.updateUrlMaxSize = pOtaBuffer->urlSize;
     }
     else
     {
-        otaAgent.fileContext.updateUrlMaxSize = 0;
+        pAgentCtx->fileContext.updateUrlMaxSize = 0;
     }
 
     /* Initialize auth scheme buffer from application buffer.*/
     if( ( pOtaBuffer->pAuthScheme != NULL ) && ( pOtaBuffer->authSchemeSize > 0u ) )
     {
-        otaAgent.fileContext.pAuthScheme = pOtaBuffer->pAuthScheme;
-        otaAgent.fileContext.authSchemeMaxSize = pOtaBuffer->authSchemeSize;
+        pAgentCtx->fileContext.pAuthScheme = pOtaBuffer->pAuthScheme;
+        pAgentCtx->fileContext.authSchemeMaxSize = pOtaBuffer->authSchemeSize;
     }
     else
     {
-        otaAgent.fileContext.authSchemeMaxSize = 0;
+        pAgentCtx->fileContext.authSchemeMaxSize = 0;
     }
 }
 
-static void initializeLocalBuffers( void )
+static void initializeLocalBuffers( OtaAgentContext_t * pAgentCtx )
 {
     /* Initialize JOB Id buffer .*/
-    otaAgent.fileContext.pJobName = pJobNameBuffer;
-    otaAgent.fileContext.jobNameMaxSize = ( uint16_t ) sizeof( pJobNameBuffer );
+    pAgentCtx->fileContext.pJobName = pAgentCtx->pJobNameBuffer;
+    pAgentCtx->fileContext.jobNameMaxSize = ( uint16_t ) sizeof( pAgentCtx->pJobNameBuffer );
 
     /* Initialize protocol buffers .*/
-    otaAgent.fileContext.pProtocols = pProtocolBuffer;
-    otaAgent.fileContext.protocolMaxSize = ( uint16_t ) sizeof( pProtocolBuffer );
+    pAgentCtx->fileContext.pProtocols = pAgentCtx->pProtocolBuffer;
+    pAgentCtx->fileContext.protocolMaxSize = ( uint16_t ) sizeof( pAgentCtx->pProtocolBuffer );
 
-    otaAgent.fileContext.pSignature = &sig256Buffer;
+    pAgentCtx->fileContext.pSignature = &pAgentCtx->sig256Buffer;
 }
 
 /*
@@ -3017,10 +4517,11 @@ static void initializeLocalBuffers( void )
  * modify the existing OTA agent context. You must first call OTA_Shutdown()
  * successfully.
  */
-OtaErr_t OTA_Init( OtaAppBuffer_t * pOtaBuffer,
-                   OtaInterfaces_t * pOtaInterfaces,
-                   const uint8_t * pThingName,
-                   OtaAppCallback_t OtaAppCallback )
+OtaErr_t OTA_InitCtx( OtaAgentContext_t * pAgentCtx,
+                      OtaAppBuffer_t * pOtaBuffer,
+                      OtaInterfaces_t * pOtaInterfaces,
+                      const uint8_t * pThingName,
+                      OtaAppCallback_t OtaAppCallback )
 {
     /* Return value from this function */
     OtaErr_t returnStatus = OtaErrUninitialized;
@@ -3028,46 +4529,76 @@ OtaErr_t OTA_Init( OtaAppBuffer_t * pOtaBuffer,
     ( void ) pOtaEventStrings;      /* For suppressing compiler-warning: unused variable. */
     ( void ) pOtaAgentStateStrings; /* For suppressing compiler-warning: unused variable. */
 
-    /* If OTA agent is stopped then start running. */
-    if( otaAgent.state == OtaAgentStateStopped )
+    assert( pAgentCtx != NULL );
+
+    /* If OTA agent is stopped then start running. A zero-initialized context
+     * has no interfaces yet and is treated the same. */
+    if( ( pAgentCtx->state == OtaAgentStateStopped ) || ( pAgentCtx->pOtaInterface == NULL ) )
     {
         /*
          * Initialize the OTA control interface based on the application protocol
          * selected in library configuration.
          */
-        setControlInterface( &otaControlInterface );
+        setControlInterface( &pAgentCtx->controlInterface );
+
+        /*
+         * Expand the state transition table into the state and event dispatch table.
+         */
+        buildDispatchTable();
 
         /*
          * Reset all the statistics counters.
          */
-        otaAgent.statistics.otaPacketsReceived = 0;
-        otaAgent.statistics.otaPacketsDropped = 0;
-        otaAgent.statistics.otaPacketsQueued = 0;
-        otaAgent.statistics.otaPacketsProcessed = 0;
+        resetStatistics( pAgentCtx );
+
+        /*
+         * The event queue is created again below, so no events are pending.
+         */
+        pAgentCtx->requestTimerPending = 0;
+        pAgentCtx->requestFileBlockPending = 0;
+        pAgentCtx->controlEventsPending = 0;
+        pAgentCtx->numDeferredEvents = 0;
+        pAgentCtx->progressStatusPending = false;
+
+        /*
+         * Start with the defaults of the default context.
+         */
+        pAgentCtx->numOfBlocksToReceive = 1;
+        pAgentCtx->unsubscribeOnShutdown = 1;
+        pAgentCtx->requestTimeoutMs = otaconfigFILE_REQUEST_WAIT_MS;
+        pAgentCtx->requestBackoff.baseMs = otaconfigREQUEST_BACKOFF_BASE_MS;
+        pAgentCtx->requestBackoff.maxMs = otaconfigREQUEST_BACKOFF_MAX_MS;
+        pAgentCtx->requestBackoff.startDelayMaxMs = otaconfigJOB_START_DELAY_MAX_MS;
+        pAgentCtx->retryDelayMs = 0;
+
+        /*
+         * Topics of a previous run may name another Thing.
+         */
+        ( void ) memset( &pAgentCtx->mqttCache, 0, sizeof( pAgentCtx->mqttCache ) );
 
         /*
          * Initialize OTA interfaces in OTA Agent context..
          */
-        otaAgent.pOtaInterface = pOtaInterfaces;
+        pAgentCtx->pOtaInterface = pOtaInterfaces;
 
         /* Initialize application buffers. */
-        initializeAppBuffers( pOtaBuffer );
+        initializeAppBuffers( pAgentCtx, pOtaBuffer );
 
         /* Initialize local buffers. */
-        initializeLocalBuffers();
+        initializeLocalBuffers( pAgentCtx );
 
         /* Initialize ota application callback.*/
-        otaAgent.OtaAppCallback = OtaAppCallback;
+        pAgentCtx->OtaAppCallback = OtaAppCallback;
 
         /*
          * The current OTA image state as set by the OTA agent.
          */
-        otaAgent.imageState = OtaImageStateUnknown;
+        pAgentCtx->imageState = OtaImageStateUnknown;
 
         /*
          * Initialize OTA event interface.
          */
-        ( void ) otaAgent.pOtaInterface->os.event.init( NULL );
+        ( void ) pAgentCtx->pOtaInterface->os.event.init( pAgentCtx->pOtaInterface->os.event.pEventContext );
 
         if( pThingName == NULL )
         {
@@ -3083,7 +4614,8 @@ OtaErr_t OTA_Init( OtaAppBuffer_t * pOtaBuffer,
                  * Store the Thing name to be used for topics later. Include zero terminator
                  * when saving the Thing name.
                  */
-                ( void ) memcpy( otaAgent.pThingName, pThingName, strLength + 1UL );
+                ( void ) memcpy( pAgentCtx->pThingName, pThingName, strLength + 1UL );
+                seedRandom( pAgentCtx );
                 returnStatus = OtaErrNone;
             }
             else
@@ -3095,41 +4627,59 @@ OtaErr_t OTA_Init( OtaAppBuffer_t * pOtaBuffer,
         if( returnStatus == OtaErrNone )
         {
             /* OTA Task is not running yet so update the state to init directly in OTA context. */
-            otaAgent.state = OtaAgentStateInit;
+            pAgentCtx->state = OtaAgentStateInit;
         }
     }
     /* If OTA agent is already running, just reset the statistics. */
     else
     {
-        ( void ) memset( &otaAgent.statistics, 0, sizeof( otaAgent.statistics ) );
+        resetStatistics( pAgentCtx );
         returnStatus = OtaErrNone;
     }
 
     return returnStatus;
 }
 
+OtaErr_t OTA_Init( OtaAppBuffer_t * pOtaBuffer,
+                   OtaInterfaces_t * pOtaInterfaces,
+                   const uint8_t * pThingName,
+                   OtaAppCallback_t OtaAppCallback )
+{
+    return OTA_InitCtx( &otaAgent, pOtaBuffer, pOtaInterfaces, pThingName, OtaAppCallback );
+}
+
 /*
  * Public API to shutdown the OTA Agent.
  */
-OtaState_t OTA_Shutdown( uint32_t ticksToWait,
-                         uint8_t unsubscribeFlag )
+OtaState_t OTA_ShutdownCtx( OtaAgentContext_t * pAgentCtx,
+                            uint32_t timeoutMs,
+                            uint8_t unsubscribeFlag )
 {
     OtaEventMsg_t eventMsg = { 0 };
-    uint32_t ticks = ticksToWait;
+    const OtaInterfaces_t * pOtaInterface = NULL;
+    OtaState_t state = OtaAgentStateNoTransition;
+
+    assert( pAgentCtx != NULL );
+
+    /* The agent clears its context when it stops, so keep the interfaces. */
+    pOtaInterface = pAgentCtx->pOtaInterface;
+
+    /* The state is stored by the agent task. */
+    state = OTA_ATOMIC_LOAD_U32( &pAgentCtx->state );
 
-    LogDebug( ( "Number of ticks to idle while the OTA Agent shuts down: "
-                "ticks=%u",
-                ticks ) );
+    LogDebug( ( "Number of milliseconds to wait while the OTA Agent shuts down: "
+                "timeoutMs=%u",
+                timeoutMs ) );
 
-    if( otaAgent.state == OtaAgentStateInit )
+    if( state == OtaAgentStateInit )
     {
         /* When in init state, the OTA state machine is not running yet. So directly set state to
          * stopped. */
-        otaAgent.state = OtaAgentStateStopped;
+        OTA_ATOMIC_STORE_U32( &pAgentCtx->state, OtaAgentStateStopped );
     }
-    else if( ( otaAgent.state != OtaAgentStateStopped ) && ( otaAgent.state != OtaAgentStateShuttingDown ) ) /* LCOV_EXCL_BR_LINE */
+    else if( ( state != OtaAgentStateStopped ) && ( state != OtaAgentStateShuttingDown ) ) /* LCOV_EXCL_BR_LINE */
     {
-        otaAgent.unsubscribeOnShutdown = unsubscribeFlag;
+        pAgentCtx->unsubscribeOnShutdown = unsubscribeFlag;
 
         /*
          * Send shutdown signal to OTA Agent task.
@@ -3137,65 +4687,192 @@ OtaState_t OTA_Shutdown( uint32_t ticksToWait,
         eventMsg.eventId = OtaAgentEventShutdown;
 
         /* Send signal to OTA task. */
-        if( OTA_SignalEvent( &eventMsg ) == false )
+        if( OTA_SignalEventCtx( pAgentCtx, &eventMsg ) == false )
         {
             LogError( ( "Failed to signal the OTA Agent to shutdown: "
                         "OTA_SignalEvent returned false." ) );
         }
-        else
+        else if( ( timeoutMs > 0U ) && ( pOtaInterface->os.event.waitShutdown != NULL ) )
         {
             /*
              * Wait for the OTA agent to complete shutdown, if requested.
              */
-            while( ( ticks > 0U ) && ( otaAgent.state != OtaAgentStateStopped ) ) /* LCOV_EXCL_BR_LINE */
+            if( pOtaInterface->os.event.waitShutdown( pOtaInterface->os.event.pEventContext,
+                                                      timeoutMs ) != OtaOsSuccess )
             {
-                ticks--;
+                LogWarn( ( "OTA Agent did not shut down within the timeout: "
+                           "timeoutMs=%u",
+                           timeoutMs ) );
             }
         }
+        else
+        {
+            /* Not waiting for the agent. */
+        }
     }
     else
     {
         LogDebug( ( "Ignoring request to shutdown OTA Agent: "
                     "OTA Agent is already in state [%s]",
-                    pOtaAgentStateStrings[ otaAgent.state ] ) );
+                    pOtaAgentStateStrings[ state ] ) );
     }
 
-    LogDebug( ( "Number of ticks remaining when OTA Agent shutdown: "
-                "ticks=%u",
-                ticks ) );
+    return OTA_ATOMIC_LOAD_U32( &pAgentCtx->state );
+}
 
-    return otaAgent.state;
+OtaState_t OTA_Shutdown( uint32_t timeoutMs,
+                         uint8_t unsubscribeFlag )
+{
+    return OTA_ShutdownCtx( &otaAgent, timeoutMs, unsubscribeFlag );
 }
 
 /*
  * Return the current state of the OTA agent.
  */
+OtaState_t OTA_GetStateCtx( const OtaAgentContext_t * pAgentCtx )
+{
+    assert( pAgentCtx != NULL );
+
+    return pAgentCtx->state;
+}
+
 OtaState_t OTA_GetState( void )
 {
-    return otaAgent.state;
+    return OTA_GetStateCtx( &otaAgent );
 }
 
 /*
  * Return the details of the packets received.
  */
-OtaErr_t OTA_GetStatistics( OtaAgentStatistics_t * pStatistics )
+OtaErr_t OTA_GetStatisticsCtx( const OtaAgentContext_t * pAgentCtx,
+                               OtaAgentStatistics_t * pStatistics )
 {
     OtaErr_t err = OtaErrInvalidArg;
+    const OtaStatisticsCounters_t * pCounters = NULL;
+    uint32_t sequence = 0;
+    uint32_t packetsRejected = 0;
+    uint32_t packetsDropped = 0;
+    bool consistent = false;
+
+    assert( pAgentCtx != NULL );
+
+    pCounters = &pAgentCtx->statistics;
 
     if( pStatistics != NULL )
     {
-        *pStatistics = otaAgent.statistics;
+        /* Copy the counters until no reset overlapped the copy. */
+        while( consistent == false )
+        {
+            sequence = OTA_ATOMIC_LOAD_U32( &pCounters->sequence );
+
+            pStatistics->otaPacketsQueued = OTA_ATOMIC_LOAD_RELAXED_U32( &pCounters->otaPacketsQueued );
+            packetsRejected = OTA_ATOMIC_LOAD_RELAXED_U32( &pCounters->otaPacketsRejected );
+            pStatistics->otaBuffersExhausted = OTA_ATOMIC_LOAD_RELAXED_U32( &pCounters->otaBuffersExhausted );
+            pStatistics->otaEventsCoalesced = OTA_ATOMIC_LOAD_RELAXED_U32( &pCounters->otaEventsCoalesced );
+            pStatistics->otaPacketsProcessed = OTA_ATOMIC_LOAD_RELAXED_U32( &pCounters->otaPacketsProcessed );
+            packetsDropped = OTA_ATOMIC_LOAD_RELAXED_U32( &pCounters->otaPacketsDropped );
+            pStatistics->otaRequestsDeferred = OTA_ATOMIC_LOAD_RELAXED_U32( &pCounters->otaRequestsDeferred );
+
+            OTA_ATOMIC_FENCE_ACQUIRE();
+
+            consistent = ( ( sequence & 1U ) == 0U ) &&
+                         ( sequence == OTA_ATOMIC_LOAD_RELAXED_U32( &pCounters->sequence ) );
+        }
+
+        /* Every file block signaled is either queued or rejected, so the received
+         * count is derived from the two and always agrees with them. */
+        pStatistics->otaPacketsReceived = pStatistics->otaPacketsQueued + packetsRejected;
+        pStatistics->otaPacketsDropped = packetsRejected + packetsDropped;
+
         err = OtaErrNone;
     }
 
     return err;
 }
 
-OtaErr_t OTA_CheckForUpdate( void )
+OtaErr_t OTA_GetStatistics( OtaAgentStatistics_t * pStatistics )
+{
+    return OTA_GetStatisticsCtx( &otaAgent, pStatistics );
+}
+
+OtaEventData_t * OTA_EventBufferGetCtx( OtaAgentContext_t * pAgentCtx )
+{
+    OtaEventData_t * pEventData = NULL;
+
+    #if ( otaconfigEVENT_BUFFER_POOL_SIZE > 0U )
+        uint32_t i = 0;
+        uint32_t expected = 0;
+
+        for( i = 0; ( i < otaconfigEVENT_BUFFER_POOL_SIZE ) && ( pEventData == NULL ); i++ )
+        {
+            expected = 0;
+
+            if( OTA_ATOMIC_COMPARE_AND_SWAP_U32( &otaEventBufferRefs[ i ], &expected, 1U ) == true )
+            {
+                pEventData = &otaEventBufferPool[ i ];
+                pEventData->dataLength = 0;
+                pEventData->bufferUsed = true;
+            }
+        }
+    #endif /* if ( otaconfigEVENT_BUFFER_POOL_SIZE > 0U ) */
+
+    assert( pAgentCtx != NULL );
+
+    if( pEventData == NULL )
+    {
+        ( void ) OTA_ATOMIC_ADD_RELAXED_U32( &pAgentCtx->statistics.otaBuffersExhausted, 1U );
+
+        LogWarn( ( "Failed to get event buffer: No free buffer in the pool." ) );
+    }
+
+    return pEventData;
+}
+
+OtaEventData_t * OTA_EventBufferGet( void )
+{
+    return OTA_EventBufferGetCtx( &otaAgent );
+}
+
+void OTA_EventBufferRetain( OtaEventData_t * pEventData )
+{
+    #if ( otaconfigEVENT_BUFFER_POOL_SIZE > 0U )
+        uint32_t i = eventBufferIndex( pEventData );
+        uint32_t refs = 0;
+        bool retained = false;
+
+        if( i < otaconfigEVENT_BUFFER_POOL_SIZE )
+        {
+            refs = OTA_ATOMIC_LOAD_U32( &otaEventBufferRefs[ i ] );
+
+            /* A free buffer can not be retained, it could be handed out again
+             * at any time. On failure refs is reloaded and checked again. */
+            while( ( refs > 0U ) && ( retained == false ) )
+            {
+                retained = OTA_ATOMIC_COMPARE_AND_SWAP_U32( &otaEventBufferRefs[ i ], &refs, refs + 1U );
+            }
+        }
+
+        if( retained == false )
+        {
+            LogError( ( "Failed to retain event buffer: Buffer is not in use." ) );
+        }
+    #else /* if ( otaconfigEVENT_BUFFER_POOL_SIZE > 0U ) */
+        ( void ) pEventData;
+    #endif /* if ( otaconfigEVENT_BUFFER_POOL_SIZE > 0U ) */
+}
+
+void OTA_EventBufferRelease( OtaEventData_t * pEventData )
+{
+    releaseEventBuffer( pEventData );
+}
+
+OtaErr_t OTA_CheckForUpdateCtx( OtaAgentContext_t * pAgentCtx )
 {
     OtaErr_t retVal = OtaErrNone;
     OtaEventMsg_t eventMsg = { 0 };
 
+    assert( pAgentCtx != NULL );
+
     LogInfo( ( "Sending event to trigger checking for and update." ) );
 
     /*
@@ -3203,7 +4880,7 @@ OtaErr_t OTA_CheckForUpdate( void )
      */
     eventMsg.eventId = OtaAgentEventRequestJobDocument;
 
-    if( OTA_SignalEvent( &eventMsg ) == false )
+    if( OTA_SignalEventCtx( pAgentCtx, &eventMsg ) == false )
     {
         retVal = OtaErrSignalEventFailed;
     }
@@ -3214,23 +4891,30 @@ OtaErr_t OTA_CheckForUpdate( void )
     return retVal;
 }
 
+OtaErr_t OTA_CheckForUpdate( void )
+{
+    return OTA_CheckForUpdateCtx( &otaAgent );
+}
+
 /*
  * This should be called by the user application or the default OTA callback handler
  * after an OTA update is considered accepted. It simply calls the platform specific
  * code required to activate the received OTA update (usually just a device reset).
  */
-OtaErr_t OTA_ActivateNewImage( void )
+OtaErr_t OTA_ActivateNewImageCtx( OtaAgentContext_t * pAgentCtx )
 {
     OtaPalStatus_t palStatus = OTA_PAL_COMBINE_ERR( OtaPalActivateFailed, 0 );
 
+    assert( pAgentCtx != NULL );
+
     /*
      * Call platform specific code to activate the image. This should reset the device
      * and not return unless there is a problem within the PAL layer. If it does return,
      * output an error message. The device may need to be reset manually.
      */
-    if( ( otaAgent.pOtaInterface != NULL ) && ( otaAgent.pOtaInterface->pal.activate != NULL ) )
+    if( ( pAgentCtx->pOtaInterface != NULL ) && ( pAgentCtx->pOtaInterface->pal.activate != NULL ) )
     {
-        palStatus = otaAgent.pOtaInterface->pal.activate( &( otaAgent.fileContext ) );
+        palStatus = pAgentCtx->pOtaInterface->pal.activate( &( pAgentCtx->fileContext ) );
     }
 
     LogError( ( "Failed to activate new image: "
@@ -3242,6 +4926,11 @@ OtaErr_t OTA_ActivateNewImage( void )
     return OTA_PAL_MAIN_ERR( palStatus ) == OtaPalSuccess ? OtaErrNone : OtaErrActivateFailed;
 }
 
+OtaErr_t OTA_ActivateNewImage( void )
+{
+    return OTA_ActivateNewImageCtx( &otaAgent );
+}
+
 /*
  * Accept, reject or abort the OTA image transfer.
  *
@@ -3255,11 +4944,14 @@ OtaErr_t OTA_ActivateNewImage( void )
  * NOTE: This call may block due to the status update message.
  */
 
-OtaErr_t OTA_SetImageState( OtaImageState_t state )
+OtaErr_t OTA_SetImageStateCtx( OtaAgentContext_t * pAgentCtx,
+                               OtaImageState_t state )
 {
     OtaErr_t err = OtaErrUninitialized;
     OtaEventMsg_t eventMsg = { 0 };
 
+    assert( pAgentCtx != NULL );
+
     switch( state )
     {
         case OtaImageStateAborted:
@@ -3267,9 +4959,9 @@ OtaErr_t OTA_SetImageState( OtaImageState_t state )
             eventMsg.eventId = OtaAgentEventUserAbort;
 
             /*
-             * Send the event, otaAgent.imageState will be set later when the event is processed.
+             * Send the event, pAgentCtx->imageState will be set later when the event is processed.
              */
-            err = ( OTA_SignalEvent( &eventMsg ) == true ) ? OtaErrNone : OtaErrSignalEventFailed;
+            err = ( OTA_SignalEventCtx( pAgentCtx, &eventMsg ) == true ) ? OtaErrNone : OtaErrSignalEventFailed;
 
             break;
 
@@ -3278,7 +4970,7 @@ OtaErr_t OTA_SetImageState( OtaImageState_t state )
             /*
              * Set the image state as rejected.
              */
-            err = setImageStateWithReason( state, 0U );
+            err = setImageStateWithReason( pAgentCtx, state, 0U );
 
             break;
 
@@ -3287,7 +4979,7 @@ OtaErr_t OTA_SetImageState( OtaImageState_t state )
             /*
              * Set the image state as accepted.
              */
-            err = setImageStateWithReason( state, 0U );
+            err = setImageStateWithReason( pAgentCtx, state, 0U );
 
             break;
 
@@ -3309,33 +5001,48 @@ OtaErr_t OTA_SetImageState( OtaImageState_t state )
     return err;
 }
 
-OtaImageState_t OTA_GetImageState( void )
+OtaErr_t OTA_SetImageState( OtaImageState_t state )
+{
+    return OTA_SetImageStateCtx( &otaAgent, state );
+}
+
+OtaImageState_t OTA_GetImageStateCtx( const OtaAgentContext_t * pAgentCtx )
 {
+    assert( pAgentCtx != NULL );
+
     /*
      * Return the current OTA image state.
      */
-    return otaAgent.imageState;
+    return pAgentCtx->imageState;
+}
+
+OtaImageState_t OTA_GetImageState( void )
+{
+    return OTA_GetImageStateCtx( &otaAgent );
 }
 
 /*
  * Suspend OTA Agent task.
  */
-OtaErr_t OTA_Suspend( void )
+OtaErr_t OTA_SuspendCtx( OtaAgentContext_t * pAgentCtx )
 {
     OtaErr_t err = OtaErrUninitialized;
     OtaEventMsg_t eventMsg = { 0 };
 
+    assert( pAgentCtx != NULL );
+
     /* Check if OTA Agent is running. */
-    if( otaAgent.state != OtaAgentStateStopped )
+    if( pAgentCtx->state != OtaAgentStateStopped )
     {
         /* Stop the request timer. */
-        ( void ) otaAgent.pOtaInterface->os.timer.stop( OtaRequestTimer );
+        ( void ) pAgentCtx->pOtaInterface->os.timer.stop( pAgentCtx->pOtaInterface->os.timer.pTimerContext,
+                                                          OtaRequestTimer );
 
         /*
          * Send event to OTA agent task.
          */
         eventMsg.eventId = OtaAgentEventSuspend;
-        err = ( OTA_SignalEvent( &eventMsg ) == true ) ? OtaErrNone : OtaErrSignalEventFailed;
+        err = ( OTA_SignalEventCtx( pAgentCtx, &eventMsg ) == true ) ? OtaErrNone : OtaErrSignalEventFailed;
     }
     else
     {
@@ -3350,22 +5057,29 @@ OtaErr_t OTA_Suspend( void )
     return err;
 }
 
+OtaErr_t OTA_Suspend( void )
+{
+    return OTA_SuspendCtx( &otaAgent );
+}
+
 /*
  * Resume OTA Agent task.
  */
-OtaErr_t OTA_Resume( void )
+OtaErr_t OTA_ResumeCtx( OtaAgentContext_t * pAgentCtx )
 {
     OtaErr_t err = OtaErrUninitialized;
     OtaEventMsg_t eventMsg = { 0 };
 
+    assert( pAgentCtx != NULL );
+
     /* Check if OTA Agent is running. */
-    if( otaAgent.state != OtaAgentStateStopped )
+    if( pAgentCtx->state != OtaAgentStateStopped )
     {
         /*
          * Send event to OTA agent task.
          */
         eventMsg.eventId = OtaAgentEventResume;
-        err = ( OTA_SignalEvent( &eventMsg ) == true ) ? OtaErrNone : OtaErrSignalEventFailed;
+        err = ( OTA_SignalEventCtx( pAgentCtx, &eventMsg ) == true ) ? OtaErrNone : OtaErrSignalEventFailed;
     }
     else
     {
@@ -3380,6 +5094,83 @@ OtaErr_t OTA_Resume( void )
     return err;
 }
 
+OtaErr_t OTA_Resume( void )
+{
+    return OTA_ResumeCtx( &otaAgent );
+}
+
+OtaErr_t OTA_SetRequestBackoffCtx( OtaAgentContext_t * pAgentCtx,
+                                   const OtaRequestBackoff_t * pBackoff )
+{
+    OtaErr_t err = OtaErrInvalidArg;
+
+    assert( pAgentCtx != NULL );
+
+    if( ( pBackoff != NULL ) && ( pBackoff->baseMs > 0U ) && ( pBackoff->maxMs >= pBackoff->baseMs ) )
+    {
+        /* The agent task reads each value on its own, so the values are stored one by one. */
+        OTA_ATOMIC_STORE_RELAXED_U32( &pAgentCtx->requestBackoff.baseMs, pBackoff->baseMs );
+        OTA_ATOMIC_STORE_RELAXED_U32( &pAgentCtx->requestBackoff.maxMs, pBackoff->maxMs );
+        OTA_ATOMIC_STORE_RELAXED_U32( &pAgentCtx->requestBackoff.startDelayMaxMs, pBackoff->startDelayMaxMs );
+
+        err = OtaErrNone;
+    }
+    else
+    {
+        LogError( ( "Failed to set request backoff: Invalid backoff." ) );
+    }
+
+    return err;
+}
+
+OtaErr_t OTA_SetRequestBackoff( const OtaRequestBackoff_t * pBackoff )
+{
+    return OTA_SetRequestBackoffCtx( &otaAgent, pBackoff );
+}
+
+OtaErr_t OTA_NotifyConnectionStateCtx( OtaAgentContext_t * pAgentCtx,
+                                       OtaConnectionState_t state )
+{
+    OtaErr_t err = OtaErrInvalidArg;
+    OtaEventMsg_t eventMsg = { 0 };
+
+    assert( pAgentCtx != NULL );
+
+    if( ( state == OtaConnectionDown ) || ( state == OtaConnectionUp ) )
+    {
+        /* The broker may have dropped the subscriptions with the connection, so the agent
+         * task subscribes again once it sees the new generation. */
+        ( void ) OTA_ATOMIC_ADD_U32( &pAgentCtx->connectionGeneration, 1U );
+        OTA_ATOMIC_STORE_U32( &pAgentCtx->connectionDown, ( state == OtaConnectionDown ) ? 1U : 0U );
+
+        LogInfo( ( "Connection is %s.", ( state == OtaConnectionUp ) ? "up" : "down" ) );
+
+        err = OtaErrNone;
+
+        /* Requests held back while the connection was down are sent again right away. The
+         * agent task drops the event in the states without held back requests. */
+        eventMsg.eventId = OtaAgentEventConnectionUp;
+
+        if( ( state == OtaConnectionUp ) &&
+            ( OTA_ATOMIC_LOAD_U32( &pAgentCtx->state ) != OtaAgentStateStopped ) &&
+            ( OTA_SignalEventCtx( pAgentCtx, &eventMsg ) == false ) )
+        {
+            err = OtaErrSignalEventFailed;
+        }
+    }
+    else
+    {
+        LogError( ( "Failed to notify connection state: Invalid state: state=%d", state ) );
+    }
+
+    return err;
+}
+
+OtaErr_t OTA_NotifyConnectionState( OtaConnectionState_t state )
+{
+    return OTA_NotifyConnectionStateCtx( &otaAgent, state );
+}
+
 /*-----------------------------------------------------------*/
 
 const char * OTA_Err_strerror( OtaErr_t err )
@@ -3480,6 +5271,10 @@ const char * OTA_Err_strerror( OtaErr_t err )
             str = "OtaErrActivateFailed";
             break;
 
+        case OtaErrFailedToDecodeJson:
+            str = "OtaErrFailedToDecodeJson";
+            break;
+
         default:
             str = "InvalidErrorCode";
             break;
@@ -3584,6 +5379,14 @@ const char * OTA_OsStatus_strerror( OtaOsStatus_t status )
             str = "OtaOsTimerDeleteFailed";
             break;
 
+        case OtaOsShutdownWaitFailed:
+            str = "OtaOsShutdownWaitFailed";
+            break;
+
+        case OtaOsEventQueueReceiveTimeout:
+            str = "OtaOsEventQueueReceiveTimeout";
+            break;
+
         default:
             str = "InvalidErrorCode";
             break;
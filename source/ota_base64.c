@@ -27,6 +27,7 @@
 
 #include "ota_base64_private.h"
 #include <assert.h>
+#include <stdbool.h>
 
 /**
  * @brief Number to represent both line feed and carriage return symbols in the
@@ -106,6 +107,34 @@
  */
 #define BASE64_INDEX_VALUE_UPPER_BOUND           63U
 
+/**
+ * @brief Number of Base64 symbols decoded per iteration of the block decoder.
+ */
+#define NUM_SYMBOLS_PER_BLOCK                    16U
+
+/**
+ * @brief Number of octets produced from NUM_SYMBOLS_PER_BLOCK symbols.
+ */
+#define NUM_OCTETS_PER_BLOCK                     12U
+
+/**
+ * @brief Number of symbols packed into one 64 bit word by the block decoder.
+ */
+#define NUM_SYMBOLS_PER_WORD                     8U
+
+/**
+ * @brief Number of octets held in one word of eight packed sextets.
+ */
+#define NUM_OCTETS_PER_WORD                      6U
+
+/**
+ * @brief Bits that are only set in pBase64SymbolToIndexMap values that are not Base64 digits.
+ *
+ * All digits are in the range 0-63 and every formatting or invalid value is in the range 64-67,
+ * so a block of symbols only holds digits if none of its indices has one of these bits set.
+ */
+#define NON_DIGIT_INDEX_MASK                     0xC0U
+
 /**
  * @brief This table takes is indexed by an Ascii character and returns the respective Base64 index.
  *        The Ascii character used to index into this table is assumed to represent a symbol in a
@@ -401,6 +430,90 @@ static Base64Status_t decodeBase64IndexBuffer( uint32_t * pBase64IndexBuffer,
     return returnVal;
 }
 
+/**
+ * @brief         Decode the leading run of Base64 digits in blocks of
+ *                NUM_SYMBOLS_PER_BLOCK symbols.
+ *
+ *                Each block is looked up without any per symbol branches,
+ *                checked once for symbols that are not digits and then
+ *                converted to octets with two 64 bit words. Decoding stops at
+ *                the first block that holds whitespace, newlines, padding or
+ *                invalid symbols, does not fit into pDest, or is incomplete;
+ *                the validating decoder takes over from there. Since a block
+ *                is always four complete quads of digits, the output is the
+ *                same as the validating decoder would produce.
+ *
+ * @param[out]    pDest Pointer to a buffer for storing the decoded result.
+ * @param[in]     destLen Length of the pDest buffer.
+ * @param[in]     pEncodedData Pointer to the Base64 encoded data.
+ * @param[in]     encodedLen Length of the pEncodedData buffer.
+ * @param[out]    pOutputLen Number of octets written to pDest.
+ *
+ * @return        Number of encoded symbols that were decoded.
+ */
+static size_t decodeBase64Blocks( uint8_t * pDest,
+                                  const size_t destLen,
+                                  const uint8_t * pEncodedData,
+                                  const size_t encodedLen,
+                                  size_t * pOutputLen )
+{
+    size_t numSymbolsDecoded = 0;
+    size_t outputLen = 0;
+    uint64_t words[ 2 ];
+    uint8_t combinedIndex;
+    uint8_t base64Index;
+    uint32_t word;
+    uint32_t i;
+    bool allDigits = true;
+
+    assert( pDest != NULL );
+    assert( pEncodedData != NULL );
+    assert( pOutputLen != NULL );
+
+    while( ( allDigits == true ) &&
+           ( ( encodedLen - numSymbolsDecoded ) >= NUM_SYMBOLS_PER_BLOCK ) &&
+           ( ( destLen - outputLen ) >= NUM_OCTETS_PER_BLOCK ) )
+    {
+        combinedIndex = 0U;
+
+        for( word = 0U; word < 2U; word++ )
+        {
+            words[ word ] = 0U;
+
+            for( i = 0U; i < NUM_SYMBOLS_PER_WORD; i++ )
+            {
+                base64Index = pBase64SymbolToIndexMap[ pEncodedData[ numSymbolsDecoded + ( word * NUM_SYMBOLS_PER_WORD ) + i ] ];
+                combinedIndex |= base64Index;
+                words[ word ] = ( words[ word ] << SEXTET_SIZE ) | base64Index;
+            }
+        }
+
+        if( ( combinedIndex & NON_DIGIT_INDEX_MASK ) != 0U )
+        {
+            allDigits = false;
+        }
+        else
+        {
+            /* Each word holds 48 bits of decoded data, most significant octet first. */
+            for( word = 0U; word < 2U; word++ )
+            {
+                for( i = 0U; i < NUM_OCTETS_PER_WORD; i++ )
+                {
+                    pDest[ outputLen + ( word * NUM_OCTETS_PER_WORD ) + i ] =
+                        ( uint8_t ) ( ( words[ word ] >> ( ( NUM_OCTETS_PER_WORD - 1U - i ) * SIZE_OF_ONE_OCTET ) ) & 0xFFU );
+                }
+            }
+
+            numSymbolsDecoded += NUM_SYMBOLS_PER_BLOCK;
+            outputLen += NUM_OCTETS_PER_BLOCK;
+        }
+    }
+
+    *pOutputLen = outputLen;
+
+    return numSymbolsDecoded;
+}
+
 /**
  * @brief Decode Base64 encoded data.
  *
@@ -441,6 +554,17 @@ Base64Status_t base64Decode( uint8_t * pDest,
         returnVal = Base64InvalidInputSize;
     }
 
+    /* Decode the leading run of plain Base64 digits in blocks. The loop below continues with the
+     * same state it would have had after decoding these symbols one at a time. */
+    if( returnVal == Base64Success )
+    {
+        pCurrBase64Symbol += decodeBase64Blocks( pDest,
+                                                 destLen,
+                                                 pEncodedData,
+                                                 encodedLen,
+                                                 &outputLen );
+    }
+
     /* This loop will decode the first (encodedLen - (encodedLen % 4)) amount of data. */
     while( ( returnVal == Base64Success ) &&
            ( pCurrBase64Symbol < ( pEncodedData + encodedLen ) ) )
@@ -514,3 +638,74 @@ Base64Status_t base64Decode( uint8_t * pDest,
 }
 
 /*-----------------------------------------------------------*/
+
+/**
+ * @brief Encode binary data with Base64, including padding.
+ *
+ * @param[out] pDest Pointer to a buffer for storing the encoded result.
+ * @param[in]  destLen Length of the pDest buffer.
+ * @param[out] pResultLen Pointer to the length of the encoded result.
+ * @param[in]  pData Pointer to the data to encode.
+ * @param[in]  dataLen Length of the pData buffer.
+ *
+ * @return     One of the following:
+ *             - #Base64Success if the data was encoded.
+ *             - #Base64NullPointerInput if a pointer parameter is NULL.
+ *             - #Base64InvalidBufferSize if pDest is too small.
+ */
+Base64Status_t base64Encode( uint8_t * pDest,
+                             const size_t destLen,
+                             size_t * pResultLen,
+                             const uint8_t * pData,
+                             const size_t dataLen )
+{
+    static const char pBase64Symbols[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    Base64Status_t returnVal = Base64Success;
+    size_t inputLen = 0;
+    size_t outputLen = 0;
+    uint32_t octets;
+    size_t remaining;
+
+    if( ( pDest == NULL ) || ( pResultLen == NULL ) || ( ( pData == NULL ) && ( dataLen != 0U ) ) )
+    {
+        returnVal = Base64NullPointerInput;
+    }
+    else if( destLen < ( ( ( dataLen + 2U ) / 3U ) * MAX_NUM_BASE64_DATA ) )
+    {
+        returnVal = Base64InvalidBufferSize;
+    }
+    else
+    {
+        while( inputLen < dataLen )
+        {
+            remaining = dataLen - inputLen;
+
+            /* Place up to three octets in the 24 least significant bits, missing octets are zero. */
+            octets = ( uint32_t ) pData[ inputLen ] << SIZE_OF_TWO_OCTETS;
+
+            if( remaining > 1U )
+            {
+                octets |= ( uint32_t ) pData[ inputLen + 1U ] << SIZE_OF_ONE_OCTET;
+            }
+
+            if( remaining > 2U )
+            {
+                octets |= ( uint32_t ) pData[ inputLen + 2U ];
+            }
+
+            pDest[ outputLen ] = ( uint8_t ) pBase64Symbols[ ( octets >> ( 3 * SEXTET_SIZE ) ) & BASE64_INDEX_VALUE_UPPER_BOUND ];
+            pDest[ outputLen + 1U ] = ( uint8_t ) pBase64Symbols[ ( octets >> ( 2 * SEXTET_SIZE ) ) & BASE64_INDEX_VALUE_UPPER_BOUND ];
+            pDest[ outputLen + 2U ] = ( remaining > 1U ) ? ( uint8_t ) pBase64Symbols[ ( octets >> SEXTET_SIZE ) & BASE64_INDEX_VALUE_UPPER_BOUND ] : ( uint8_t ) '=';
+            pDest[ outputLen + 3U ] = ( remaining > 2U ) ? ( uint8_t ) pBase64Symbols[ octets & BASE64_INDEX_VALUE_UPPER_BOUND ] : ( uint8_t ) '=';
+
+            inputLen += ( remaining > 3U ) ? 3U : remaining;
+            outputLen += MAX_NUM_BASE64_DATA;
+        }
+
+        *pResultLen = outputLen;
+    }
+
+    return returnVal;
+}
+
+/*-----------------------------------------------------------*/
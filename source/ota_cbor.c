@@ -216,46 +216,40 @@ bool OTA_CBOR_Decode_GetStreamResponseMessage( const uint8_t * pMessageBuffer,
 }
 
 /**
- * @brief Create an encoded Get Stream Request message for the AWS IoT OTA
- * service. The service allows block count or block bitmap to be requested,
- * but not both.
+ * @brief Encode the leading members of a Get Stream Request message, which
+ * are the same for every request of a file.
  *
- * @param[in,out] pMessageBuffer Buffer to store the encoded message.
- * @param[in] messageBufferSize Size of the buffer to store the encoded message.
- * @param[out] pEncodedMessageSize Size of the final encoded message.
+ * The map is left open. Complete the message with
+ * OTA_CBOR_Encode_GetStreamRequestBlocks.
+ *
+ * @param[in,out] pMessageBuffer Buffer to store the encoded prefix.
+ * @param[in] messageBufferSize Size of the buffer to store the encoded prefix.
+ * @param[out] pEncodedPrefixSize Size of the encoded prefix.
  * @param[in] pClientToken Client token in the encoded message.
  * @param[in] fileId Value of file id in the encoded message.
  * @param[in] blockSize Value of block size in the encoded message.
- * @param[in] blockOffset Value of block offset in the encoded message.
- * @param[in] pBlockBitmap bitmap in the encoded message.
- * @param[in] blockBitmapSize Size of the provided bitmap buffer.
- * @param[in] numOfBlocksRequested number of blocks to request in the encoded message.
  *
  * @return TRUE when success, otherwise FALSE.
  */
-bool OTA_CBOR_Encode_GetStreamRequestMessage( uint8_t * pMessageBuffer,
-                                              size_t messageBufferSize,
-                                              size_t * pEncodedMessageSize,
-                                              const char * pClientToken,
-                                              int32_t fileId,
-                                              int32_t blockSize,
-                                              int32_t blockOffset,
-                                              uint8_t * pBlockBitmap,
-                                              size_t blockBitmapSize,
-                                              int32_t numOfBlocksRequested )
+bool OTA_CBOR_Encode_GetStreamRequestPrefix( uint8_t * pMessageBuffer,
+                                             size_t messageBufferSize,
+                                             size_t * pEncodedPrefixSize,
+                                             const char * pClientToken,
+                                             int32_t fileId,
+                                             int32_t blockSize )
 {
     CborError cborResult = CborNoError;
     CborEncoder cborEncoder, cborMapEncoder;
 
     if( ( pMessageBuffer == NULL ) ||
-        ( pEncodedMessageSize == NULL ) ||
-        ( pClientToken == NULL ) ||
-        ( pBlockBitmap == NULL ) )
+        ( pEncodedPrefixSize == NULL ) ||
+        ( pClientToken == NULL ) )
     {
         cborResult = CborUnknownError;
     }
 
-    /* Initialize the CBOR encoder. */
+    /* Initialize the CBOR encoder. The map has a definite length, so its
+     * header is complete before any member is encoded. */
     if( CborNoError == cborResult )
     {
         cbor_encoder_init( &cborEncoder,
@@ -306,29 +300,85 @@ bool OTA_CBOR_Encode_GetStreamRequestMessage( uint8_t * pMessageBuffer,
                                       blockSize );
     }
 
+    /* Get the encoded size. The map encoder holds the write position. */
+    if( CborNoError == cborResult )
+    {
+        *pEncodedPrefixSize = cbor_encoder_get_buffer_size( &cborMapEncoder,
+                                                            pMessageBuffer );
+    }
+
+    return CborNoError == cborResult;
+}
+
+/**
+ * @brief Complete a Get Stream Request message by appending the members that
+ * select the blocks to an encoded prefix.
+ *
+ * @param[in,out] pMessageBuffer Buffer holding the prefix from
+ * OTA_CBOR_Encode_GetStreamRequestPrefix.
+ * @param[in] messageBufferSize Size of the buffer to store the encoded message.
+ * @param[in] prefixSize Size of the prefix at the start of the buffer.
+ * @param[out] pEncodedMessageSize Size of the final encoded message.
+ * @param[in] blockOffset Value of block offset in the encoded message.
+ * @param[in] pBlockBitmap bitmap in the encoded message.
+ * @param[in] blockBitmapSize Size of the provided bitmap buffer.
+ * @param[in] numOfBlocksRequested number of blocks to request in the encoded message.
+ *
+ * @return TRUE when success, otherwise FALSE.
+ */
+bool OTA_CBOR_Encode_GetStreamRequestBlocks( uint8_t * pMessageBuffer,
+                                             size_t messageBufferSize,
+                                             size_t prefixSize,
+                                             size_t * pEncodedMessageSize,
+                                             int32_t blockOffset,
+                                             const uint8_t * pBlockBitmap,
+                                             size_t blockBitmapSize,
+                                             int32_t numOfBlocksRequested )
+{
+    CborError cborResult = CborNoError;
+    CborEncoder cborEncoder;
+
+    if( ( pMessageBuffer == NULL ) ||
+        ( pEncodedMessageSize == NULL ) ||
+        ( pBlockBitmap == NULL ) ||
+        ( prefixSize > messageBufferSize ) )
+    {
+        cborResult = CborUnknownError;
+    }
+
+    /* The remaining members of the open map are encoded as a sequence of
+     * items after the prefix. */
+    if( CborNoError == cborResult )
+    {
+        cbor_encoder_init( &cborEncoder,
+                           &pMessageBuffer[ prefixSize ],
+                           messageBufferSize - prefixSize,
+                           0 );
+    }
+
     /* Encode the block offset key and value. */
     if( CborNoError == cborResult )
     {
-        cborResult = cbor_encode_text_stringz( &cborMapEncoder,
+        cborResult = cbor_encode_text_stringz( &cborEncoder,
                                                OTA_CBOR_BLOCKOFFSET_KEY );
     }
 
     if( CborNoError == cborResult )
     {
-        cborResult = cbor_encode_int( &cborMapEncoder,
+        cborResult = cbor_encode_int( &cborEncoder,
                                       blockOffset );
     }
 
     /* Encode the block bitmap key and value. */
     if( CborNoError == cborResult )
     {
-        cborResult = cbor_encode_text_stringz( &cborMapEncoder,
+        cborResult = cbor_encode_text_stringz( &cborEncoder,
                                                OTA_CBOR_BLOCKBITMAP_KEY );
     }
 
     if( CborNoError == cborResult )
     {
-        cborResult = cbor_encode_byte_string( &cborMapEncoder,
+        cborResult = cbor_encode_byte_string( &cborEncoder,
                                               pBlockBitmap,
                                               blockBitmapSize );
     }
@@ -336,29 +386,77 @@ bool OTA_CBOR_Encode_GetStreamRequestMessage( uint8_t * pMessageBuffer,
     /* Encode the number of blocks requested key and value. */
     if( CborNoError == cborResult )
     {
-        cborResult = cbor_encode_text_stringz( &cborMapEncoder,
+        cborResult = cbor_encode_text_stringz( &cborEncoder,
                                                OTA_CBOR_NUMBEROFBLOCKS_KEY );
     }
 
     if( CborNoError == cborResult )
     {
-        cborResult = cbor_encode_int( &cborMapEncoder,
+        cborResult = cbor_encode_int( &cborEncoder,
                                       numOfBlocksRequested );
     }
 
-    /* Close the encoder. */
+    /* Get the encoded size. */
     if( CborNoError == cborResult )
     {
-        cborResult = cbor_encoder_close_container_checked( &cborEncoder,
-                                                           &cborMapEncoder );
+        *pEncodedMessageSize = prefixSize +
+                               cbor_encoder_get_buffer_size( &cborEncoder,
+                                                             &pMessageBuffer[ prefixSize ] );
     }
 
-    /* Get the encoded size. */
-    if( CborNoError == cborResult )
+    return CborNoError == cborResult;
+}
+
+/**
+ * @brief Create an encoded Get Stream Request message for the AWS IoT OTA
+ * service. The service allows block count or block bitmap to be requested,
+ * but not both.
+ *
+ * @param[in,out] pMessageBuffer Buffer to store the encoded message.
+ * @param[in] messageBufferSize Size of the buffer to store the encoded message.
+ * @param[out] pEncodedMessageSize Size of the final encoded message.
+ * @param[in] pClientToken Client token in the encoded message.
+ * @param[in] fileId Value of file id in the encoded message.
+ * @param[in] blockSize Value of block size in the encoded message.
+ * @param[in] blockOffset Value of block offset in the encoded message.
+ * @param[in] pBlockBitmap bitmap in the encoded message.
+ * @param[in] blockBitmapSize Size of the provided bitmap buffer.
+ * @param[in] numOfBlocksRequested number of blocks to request in the encoded message.
+ *
+ * @return TRUE when success, otherwise FALSE.
+ */
+bool OTA_CBOR_Encode_GetStreamRequestMessage( uint8_t * pMessageBuffer,
+                                              size_t messageBufferSize,
+                                              size_t * pEncodedMessageSize,
+                                              const char * pClientToken,
+                                              int32_t fileId,
+                                              int32_t blockSize,
+                                              int32_t blockOffset,
+                                              uint8_t * pBlockBitmap,
+                                              size_t blockBitmapSize,
+                                              int32_t numOfBlocksRequested )
+{
+    bool result = false;
+    size_t prefixSize = 0;
+
+    result = OTA_CBOR_Encode_GetStreamRequestPrefix( pMessageBuffer,
+                                                     messageBufferSize,
+                                                     &prefixSize,
+                                                     pClientToken,
+                                                     fileId,
+                                                     blockSize );
+
+    if( result == true )
     {
-        *pEncodedMessageSize = cbor_encoder_get_buffer_size( &cborEncoder,
-                                                             pMessageBuffer );
+        result = OTA_CBOR_Encode_GetStreamRequestBlocks( pMessageBuffer,
+                                                         messageBufferSize,
+                                                         prefixSize,
+                                                         pEncodedMessageSize,
+                                                         blockOffset,
+                                                         pBlockBitmap,
+                                                         blockBitmapSize,
+                                                         numOfBlocksRequested );
     }
 
-    return CborNoError == cborResult;
+    return result;
 }
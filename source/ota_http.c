@@ -35,12 +35,6 @@
 #include "ota_private.h"
 #include "ota_http_private.h"
 
-/**
- * @brief Track the current block for HTTP requests
- *
- */
-static uint32_t currBlock;
-
 /*
  * Init file transfer by initializing the http module with the pre-signed url.
  */
@@ -59,6 +53,9 @@ OtaErr_t initFileTransfer_Http( OtaAgentContext_t * pAgentCtx )
     /* Get pre-signed URL from pAgentCtx. */
     pURL = ( char * ) fileContext->pUpdateUrlPath;
 
+    /* The download starts from the first block. */
+    pAgentCtx->httpCurrentBlock = 0;
+
     /* Connect to the HTTP server and initialize download information. */
     httpStatus = pAgentCtx->pOtaInterface->http.init( pURL );
 
@@ -91,7 +88,7 @@ OtaErr_t requestDataBlock_Http( OtaAgentContext_t * pAgentCtx )
     fileContext = &( pAgentCtx->fileContext );
 
     /* Calculate ranges. */
-    rangeStart = currBlock * OTA_FILE_BLOCK_SIZE;
+    rangeStart = pAgentCtx->httpCurrentBlock * OTA_FILE_BLOCK_SIZE;
 
     if( fileContext->blocksRemaining == 1U )
     {
@@ -119,7 +116,8 @@ OtaErr_t requestDataBlock_Http( OtaAgentContext_t * pAgentCtx )
  * HTTP file block does not need to decode the block, only increment
  * number of blocks received.
  */
-OtaErr_t decodeFileBlock_Http( const uint8_t * pMessageBuffer,
+OtaErr_t decodeFileBlock_Http( OtaAgentContext_t * pAgentCtx,
+                               const uint8_t * pMessageBuffer,
                                size_t messageSize,
                                int32_t * pFileId,
                                int32_t * pBlockId,
@@ -129,7 +127,7 @@ OtaErr_t decodeFileBlock_Http( const uint8_t * pMessageBuffer,
 {
     OtaErr_t err = OtaErrNone;
 
-    assert( pMessageBuffer != NULL && pFileId != NULL && pBlockId != NULL &&
+    assert( pAgentCtx != NULL && pMessageBuffer != NULL && pFileId != NULL && pBlockId != NULL &&
             pBlockSize != NULL && pPayload != NULL && pPayloadSize != NULL );
 
     if( messageSize > OTA_FILE_BLOCK_SIZE )
@@ -141,7 +139,7 @@ OtaErr_t decodeFileBlock_Http( const uint8_t * pMessageBuffer,
     else
     {
         *pFileId = 0;
-        *pBlockId = ( int32_t ) currBlock;
+        *pBlockId = ( int32_t ) pAgentCtx->httpCurrentBlock;
         *pBlockSize = ( int32_t ) messageSize;
 
         /* The data received over HTTP does not require any decoding. */
@@ -150,7 +148,7 @@ OtaErr_t decodeFileBlock_Http( const uint8_t * pMessageBuffer,
         *pPayloadSize = messageSize;
 
         /* Current block is processed, set the file block to next. */
-        currBlock++;
+        pAgentCtx->httpCurrentBlock++;
     }
 
     return err;
@@ -166,9 +164,6 @@ OtaErr_t cleanupData_Http( const OtaAgentContext_t * pAgentCtx )
     assert( pAgentCtx != NULL && pAgentCtx->pOtaInterface != NULL );
     httpStatus = pAgentCtx->pOtaInterface->http.deinit();
 
-    /* Reset currBlock. */
-    currBlock = 0;
-
     return ( httpStatus == OtaHttpSuccess ) ? OtaErrNone : OtaErrCleanupDataFailed;
 }
 
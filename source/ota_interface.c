@@ -42,6 +42,14 @@
     #include "ota_http_private.h"
 #endif
 
+/* File block decoder for the MQTT stream payload format. */
+
+#if ( otaconfigMQTT_JSON_STREAM_PAYLOAD == 1U )
+    #define OTA_MQTT_DECODE_FILE_BLOCK    decodeFileBlockJson_Mqtt
+#else
+    #define OTA_MQTT_DECODE_FILE_BLOCK    decodeFileBlock_Mqtt
+#endif
+
 /* Check for invalid data interface configurations. */
 
 #if !( configENABLED_DATA_PROTOCOLS & configOTA_PRIMARY_DATA_PROTOCOL )
@@ -90,7 +98,7 @@ OtaErr_t setDataInterface( OtaDataInterface_t * pDataInterface,
         {
             pDataInterface->initFileTransfer = initFileTransfer_Mqtt;
             pDataInterface->requestFileBlock = requestFileBlock_Mqtt;
-            pDataInterface->decodeFileBlock = decodeFileBlock_Mqtt;
+            pDataInterface->decodeFileBlock = OTA_MQTT_DECODE_FILE_BLOCK;
             pDataInterface->cleanup = cleanupData_Mqtt;
             err = OtaErrNone;
         }
@@ -111,7 +119,7 @@ OtaErr_t setDataInterface( OtaDataInterface_t * pDataInterface,
             {
                 pDataInterface->initFileTransfer = initFileTransfer_Mqtt;
                 pDataInterface->requestFileBlock = requestFileBlock_Mqtt;
-                pDataInterface->decodeFileBlock = decodeFileBlock_Mqtt;
+                pDataInterface->decodeFileBlock = OTA_MQTT_DECODE_FILE_BLOCK;
                 pDataInterface->cleanup = cleanupData_Mqtt;
                 err = OtaErrNone;
             }
@@ -136,7 +144,7 @@ OtaErr_t setDataInterface( OtaDataInterface_t * pDataInterface,
             {
                 pDataInterface->initFileTransfer = initFileTransfer_Mqtt;
                 pDataInterface->requestFileBlock = requestFileBlock_Mqtt;
-                pDataInterface->decodeFileBlock = decodeFileBlock_Mqtt;
+                pDataInterface->decodeFileBlock = OTA_MQTT_DECODE_FILE_BLOCK;
                 pDataInterface->cleanup = cleanupData_Mqtt;
                 err = OtaErrNone;
             }
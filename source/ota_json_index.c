@@ -0,0 +1,1351 @@
+/*
+ * AWS IoT Over-the-air Update v2.0.0 (Release Candidate)
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file ota_json_index.c
+ * @brief Key path index of JSON job documents.
+ */
+
+/* Standard library includes. */
+#include <string.h>
+#include <assert.h>
+
+/* OTA includes. */
+#include "ota_json_index_private.h"
+
+/* JSON library includes. */
+#include "core_json.h"
+
+/**
+ * @brief FNV-1a 32 bit offset basis.
+ */
+#define FNV_OFFSET_BASIS           2166136261UL
+
+/**
+ * @brief FNV-1a 32 bit prime.
+ */
+#define FNV_PRIME                  16777619UL
+
+/**
+ * @brief Number of hash buckets in the index.
+ */
+#define JSON_INDEX_NUM_BUCKETS     ( 2U * otaconfigMAX_JOB_DOC_INDEX_ENTRIES )
+
+/**
+ * @brief Marker on the object stack for an object whose members are not indexed.
+ */
+#define JSON_INDEX_NOT_INDEXED     ( 0xFFFEU )
+
+/**
+ * @brief Separator between keys of a key path.
+ */
+#define JSON_INDEX_SEPARATOR       '.'
+
+/**
+ * @brief Maximum nesting accepted by jsonValidate, the same as coreJSON.
+ */
+#ifndef JSON_MAX_DEPTH
+    #define JSON_MAX_DEPTH         32
+#endif
+
+/**
+ * @brief Number of bytes classified at once when scanning strings.
+ */
+#define JSON_WORD_SIZE             ( sizeof( uint64_t ) )
+
+/**
+ * @brief A word with every byte set to 0x01.
+ */
+#define JSON_WORD_ONES             ( ( ~( uint64_t ) 0U ) / 0xFFU )
+
+/**
+ * @brief A word with every byte set to 0x80.
+ */
+#define JSON_WORD_HIGHS            ( JSON_WORD_ONES * 0x80U )
+
+/**
+ * @brief Length of a Unicode escape, e.g. \\u1234.
+ */
+#define JSON_HEX_ESCAPE_LENGTH     6U
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Continue an FNV-1a hash over a buffer.
+ *
+ * @param[in] hash Hash of the bytes before pBuf.
+ * @param[in] pBuf Bytes to add to the hash.
+ * @param[in] length Number of bytes in pBuf.
+ *
+ * @return The updated hash.
+ */
+static uint32_t hashBytes( uint32_t hash,
+                           const char * pBuf,
+                           size_t length );
+
+/**
+ * @brief Advance past JSON whitespace.
+ *
+ * @param[in] pJson The JSON document.
+ * @param[in] start Index to start from.
+ * @param[in] length Length of the document.
+ *
+ * @return Index of the first non whitespace character, or length.
+ */
+static size_t skipWhitespace( const char * pJson,
+                              size_t start,
+                              size_t length );
+
+/**
+ * @brief Advance past a string.
+ *
+ * @param[in] pJson The JSON document.
+ * @param[in,out] pIndex Index of the opening quote in, index after the closing quote out.
+ * @param[in] length Length of the document.
+ *
+ * @return true if the string is terminated.
+ */
+static bool skipString( const char * pJson,
+                        size_t * pIndex,
+                        size_t length );
+
+/**
+ * @brief Advance past an object or array including all nested values.
+ *
+ * @param[in] pJson The JSON document.
+ * @param[in,out] pIndex Index of the opening bracket in, index after the closing bracket out.
+ * @param[in] length Length of the document.
+ *
+ * @return true if the container is terminated.
+ */
+static bool skipContainer( const char * pJson,
+                           size_t * pIndex,
+                           size_t length );
+
+/**
+ * @brief Advance past a number, literal or any other unquoted scalar.
+ *
+ * @param[in] pJson The JSON document.
+ * @param[in,out] pIndex Index of the first character in, index after the scalar out.
+ * @param[in] length Length of the document.
+ *
+ * @return true if the scalar is not empty.
+ */
+static bool skipScalar( const char * pJson,
+                        size_t * pIndex,
+                        size_t length );
+
+/**
+ * @brief Record a member in the index and the hash table.
+ *
+ * @param[in,out] pIndex The index.
+ * @param[in] parent Entry of the enclosing object.
+ * @param[in] pKey Key of the member.
+ * @param[in] keyLength Length of the key.
+ *
+ * @return Entry number of the member or JSON_INDEX_NOT_INDEXED if there is no room.
+ */
+static uint16_t addEntry( OtaJobDocIndex_t * pIndex,
+                          uint16_t parent,
+                          const char * pKey,
+                          size_t keyLength );
+
+/**
+ * @brief Check that the full key path of an entry is the query.
+ *
+ * @param[in] pIndex The index.
+ * @param[in] entry Entry to check.
+ * @param[in] pKeyPath Dotted key path.
+ * @param[in] keyPathLength Length of the key path.
+ *
+ * @return true if the key path of the entry is the same as pKeyPath.
+ */
+static bool keyPathMatches( const OtaJobDocIndex_t * pIndex,
+                            uint16_t entry,
+                            const char * pKeyPath,
+                            size_t keyPathLength );
+
+
+/**
+ * @brief Check if any byte of a word needs a closer look inside a string.
+ *
+ * The bytes that do are quotes, backslashes, control characters and the
+ * bytes of multi-byte UTF-8 sequences. All others are plain string content.
+ *
+ * @param[in] word Eight bytes of the document.
+ *
+ * @return true if every byte is plain string content.
+ */
+static bool isPlainWord( uint64_t word );
+
+/**
+ * @brief Advance past plain string content, a word at a time.
+ *
+ * @param[in] pJson The JSON document.
+ * @param[in] start Index to start from.
+ * @param[in] length Length of the document.
+ *
+ * @return Index of the first byte that is not plain string content, or length.
+ */
+static size_t skipPlainBytes( const char * pJson,
+                              size_t start,
+                              size_t length );
+
+/**
+ * @brief Advance past a multi-byte UTF-8 sequence in its shortest form.
+ *
+ * @param[in] pJson The JSON document.
+ * @param[in,out] pIndex Index of the leading byte in, index after the sequence out.
+ * @param[in] length Length of the document.
+ *
+ * @return true if the sequence is valid.
+ */
+static bool validateUtf8( const char * pJson,
+                          size_t * pIndex,
+                          size_t length );
+
+/**
+ * @brief Advance past one \\uXXXX escape.
+ *
+ * @param[in] pJson The JSON document.
+ * @param[in,out] pIndex Index of the backslash in, index after the escape out.
+ * @param[in] length Length of the document.
+ * @param[out] pValue The escaped code unit.
+ *
+ * @return true if the escape is complete.
+ */
+static bool validateOneHexEscape( const char * pJson,
+                                  size_t * pIndex,
+                                  size_t length,
+                                  uint16_t * pValue );
+
+/**
+ * @brief Advance past an escape sequence.
+ *
+ * A high surrogate must be followed by an escaped low surrogate.
+ *
+ * @param[in] pJson The JSON document.
+ * @param[in,out] pIndex Index of the backslash in, index after the escape out.
+ * @param[in] length Length of the document.
+ *
+ * @return true if the escape is valid.
+ */
+static bool validateEscape( const char * pJson,
+                            size_t * pIndex,
+                            size_t length );
+
+/**
+ * @brief Advance past a string, checking escapes, control characters and UTF-8.
+ *
+ * @param[in] pJson The JSON document.
+ * @param[in,out] pIndex Index of the opening quote in, index after the closing quote out.
+ * @param[in] length Length of the document.
+ *
+ * @return true if the string is valid. pIndex is only updated if it is.
+ */
+static bool validateString( const char * pJson,
+                            size_t * pIndex,
+                            size_t length );
+
+/**
+ * @brief Advance past a run of decimal digits.
+ *
+ * @param[in] pJson The JSON document.
+ * @param[in,out] pIndex Index to start from in, index after the digits out.
+ * @param[in] length Length of the document.
+ *
+ * @return true if there was at least one digit.
+ */
+static bool validateDigits( const char * pJson,
+                            size_t * pIndex,
+                            size_t length );
+
+/**
+ * @brief Advance past a number.
+ *
+ * A fraction or exponent without digits is left for the caller to reject.
+ *
+ * @param[in] pJson The JSON document.
+ * @param[in,out] pIndex Index of the first character in, index after the number out.
+ * @param[in] length Length of the document.
+ *
+ * @return true if a number was found.
+ */
+static bool validateNumber( const char * pJson,
+                            size_t * pIndex,
+                            size_t length );
+
+/**
+ * @brief Advance past a string, number, true, false or null.
+ *
+ * @param[in] pJson The JSON document.
+ * @param[in,out] pIndex Index of the first character in, index after the scalar out.
+ * @param[in] length Length of the document.
+ *
+ * @return true if a scalar was found.
+ */
+static bool validateScalar( const char * pJson,
+                            size_t * pIndex,
+                            size_t length );
+
+/**
+ * @brief Advance past whitespace and a comma that is followed by another value.
+ *
+ * @param[in] pJson The JSON document.
+ * @param[in,out] pIndex Index to start from in, index of the next value or separator out.
+ * @param[in] length Length of the document.
+ *
+ * @return true if a comma was consumed.
+ */
+static bool validateSpaceAndComma( const char * pJson,
+                                   size_t * pIndex,
+                                   size_t length );
+
+/**
+ * @brief Advance past the scalar members of a container.
+ *
+ * Stops at a nested container, the closing bracket or the first error,
+ * which is then reported by validateCollection.
+ *
+ * @param[in] pJson The JSON document.
+ * @param[in,out] pIndex Index after the opening bracket in, index to continue from out.
+ * @param[in] length Length of the document.
+ * @param[in] mode The opening bracket of the container.
+ */
+static void validateScalars( const char * pJson,
+                             size_t * pIndex,
+                             size_t length,
+                             char mode );
+
+/**
+ * @brief Validate an object or array with everything nested inside it.
+ *
+ * @param[in] pJson The JSON document.
+ * @param[in,out] pIndex Index of the opening bracket in, index after the closing bracket out.
+ * @param[in] length Length of the document.
+ *
+ * @return JSONSuccess, JSONPartial, JSONIllegalDocument or JSONMaxDepthExceeded.
+ */
+static JSONStatus_t validateCollection( const char * pJson,
+                                        size_t * pIndex,
+                                        size_t length );
+/*-----------------------------------------------------------*/
+
+static uint32_t hashBytes( uint32_t hash,
+                           const char * pBuf,
+                           size_t length )
+{
+    uint32_t result = hash;
+    size_t i;
+
+    for( i = 0; i < length; i++ )
+    {
+        result ^= ( uint32_t ) ( uint8_t ) pBuf[ i ];
+        result *= FNV_PRIME;
+    }
+
+    return result;
+}
+
+static size_t skipWhitespace( const char * pJson,
+                              size_t start,
+                              size_t length )
+{
+    size_t i = start;
+
+    while( ( i < length ) &&
+           ( ( pJson[ i ] == ' ' ) || ( pJson[ i ] == '\t' ) ||
+             ( pJson[ i ] == '\n' ) || ( pJson[ i ] == '\r' ) ) )
+    {
+        i++;
+    }
+
+    return i;
+}
+
+static bool skipString( const char * pJson,
+                        size_t * pIndex,
+                        size_t length )
+{
+    size_t i = *pIndex + 1U;
+    bool terminated = false;
+
+    while( ( i < length ) && ( terminated == false ) )
+    {
+        i = skipPlainBytes( pJson, i, length );
+
+        if( i >= length )
+        {
+            /* Unterminated. */
+        }
+        else if( pJson[ i ] == '\\' )
+        {
+            /* Skip the escaped character, it can not end the string. */
+            i += 2U;
+        }
+        else if( pJson[ i ] == '"' )
+        {
+            terminated = true;
+            i++;
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    *pIndex = i;
+
+    return terminated;
+}
+
+static bool skipContainer( const char * pJson,
+                           size_t * pIndex,
+                           size_t length )
+{
+    size_t i = *pIndex;
+    size_t depth = 0;
+    bool terminated = false;
+    bool valid = true;
+
+    while( ( i < length ) && ( terminated == false ) && ( valid == true ) )
+    {
+        if( pJson[ i ] == '"' )
+        {
+            valid = skipString( pJson, &i, length );
+        }
+        else
+        {
+            if( ( pJson[ i ] == '{' ) || ( pJson[ i ] == '[' ) )
+            {
+                depth++;
+            }
+            else if( ( pJson[ i ] == '}' ) || ( pJson[ i ] == ']' ) )
+            {
+                depth--;
+                terminated = ( depth == 0U ) ? true : false;
+            }
+            else
+            {
+                /* Any other character does not change the nesting. */
+            }
+
+            i++;
+        }
+    }
+
+    *pIndex = i;
+
+    return terminated;
+}
+
+static bool skipScalar( const char * pJson,
+                        size_t * pIndex,
+                        size_t length )
+{
+    size_t start = *pIndex;
+    size_t i = start;
+
+    while( ( i < length ) &&
+           ( pJson[ i ] != ',' ) && ( pJson[ i ] != '}' ) && ( pJson[ i ] != ']' ) &&
+           ( pJson[ i ] != ' ' ) && ( pJson[ i ] != '\t' ) &&
+           ( pJson[ i ] != '\n' ) && ( pJson[ i ] != '\r' ) )
+    {
+        i++;
+    }
+
+    *pIndex = i;
+
+    return ( i > start ) ? true : false;
+}
+
+static uint16_t addEntry( OtaJobDocIndex_t * pIndex,
+                          uint16_t parent,
+                          const char * pKey,
+                          size_t keyLength )
+{
+    uint16_t entry = JSON_INDEX_NOT_INDEXED;
+    uint32_t hash = FNV_OFFSET_BASIS;
+    uint32_t bucket;
+    OtaJobDocIndexEntry_t * pEntry;
+
+    if( ( parent == JSON_INDEX_NOT_INDEXED ) ||
+        ( pIndex->numEntries >= otaconfigMAX_JOB_DOC_INDEX_ENTRIES ) )
+    {
+        pIndex->full = true;
+    }
+    else
+    {
+        if( parent != OTA_JOB_DOC_INDEX_NO_PARENT )
+        {
+            hash = hashBytes( pIndex->entries[ parent ].pathHash, ".", 1U );
+        }
+
+        hash = hashBytes( hash, pKey, keyLength );
+
+        entry = pIndex->numEntries;
+        pEntry = &pIndex->entries[ entry ];
+        pEntry->pKey = pKey;
+        pEntry->keyLength = keyLength;
+        pEntry->pathHash = hash;
+        pEntry->parent = parent;
+        pIndex->numEntries++;
+
+        /* There are twice as many buckets as entries so an empty one is always found. */
+        bucket = hash % JSON_INDEX_NUM_BUCKETS;
+
+        while( pIndex->buckets[ bucket ] != 0U )
+        {
+            bucket = ( bucket + 1U ) % JSON_INDEX_NUM_BUCKETS;
+        }
+
+        pIndex->buckets[ bucket ] = ( uint16_t ) ( entry + 1U );
+    }
+
+    return entry;
+}
+
+static bool keyPathMatches( const OtaJobDocIndex_t * pIndex,
+                            uint16_t entry,
+                            const char * pKeyPath,
+                            size_t keyPathLength )
+{
+    const OtaJobDocIndexEntry_t * pEntry;
+    uint16_t current = entry;
+    size_t remaining = keyPathLength;
+    bool match = true;
+
+    /* Compare the keys from the innermost member outwards against the end of the query. */
+    while( ( match == true ) && ( current != OTA_JOB_DOC_INDEX_NO_PARENT ) )
+    {
+        pEntry = &pIndex->entries[ current ];
+
+        if( ( pEntry->keyLength > remaining ) ||
+            ( memcmp( &pKeyPath[ remaining - pEntry->keyLength ], pEntry->pKey, pEntry->keyLength ) != 0 ) )
+        {
+            match = false;
+        }
+        else
+        {
+            remaining -= pEntry->keyLength;
+            current = pEntry->parent;
+
+            if( current != OTA_JOB_DOC_INDEX_NO_PARENT )
+            {
+                if( ( remaining == 0U ) || ( pKeyPath[ remaining - 1U ] != JSON_INDEX_SEPARATOR ) )
+                {
+                    match = false;
+                }
+                else
+                {
+                    remaining--;
+                }
+            }
+        }
+    }
+
+    return ( match == true ) && ( remaining == 0U );
+}
+
+static bool isPlainWord( uint64_t word )
+{
+    uint64_t quotes = word ^ ( JSON_WORD_ONES * ( uint64_t ) '"' );
+    uint64_t backslashes = word ^ ( JSON_WORD_ONES * ( uint64_t ) '\\' );
+    uint64_t special;
+
+    /* A byte is flagged in the high bit of its lane if it is zero after the
+     * XOR (a quote or backslash), below 0x20, or already has its high bit set. */
+    special = ( quotes - JSON_WORD_ONES ) & ~quotes;
+    special |= ( backslashes - JSON_WORD_ONES ) & ~backslashes;
+    special |= ( word - ( JSON_WORD_ONES * 0x20U ) ) & ~word;
+    special |= word;
+
+    return ( ( special & JSON_WORD_HIGHS ) == 0U ) ? true : false;
+}
+
+static size_t skipPlainBytes( const char * pJson,
+                              size_t start,
+                              size_t length )
+{
+    size_t i = start;
+    uint64_t word;
+    bool plain = true;
+
+    while( ( plain == true ) && ( ( length - i ) >= JSON_WORD_SIZE ) )
+    {
+        ( void ) memcpy( &word, &pJson[ i ], JSON_WORD_SIZE );
+        plain = isPlainWord( word );
+
+        if( plain == true )
+        {
+            i += JSON_WORD_SIZE;
+        }
+    }
+
+    /* Locate the byte that stopped the word scan, or finish the tail. */
+    while( ( i < length ) &&
+           ( pJson[ i ] != '"' ) && ( pJson[ i ] != '\\' ) &&
+           ( ( uint8_t ) pJson[ i ] >= 0x20U ) && ( ( uint8_t ) pJson[ i ] < 0x80U ) )
+    {
+        i++;
+    }
+
+    return i;
+}
+
+static bool validateUtf8( const char * pJson,
+                          size_t * pIndex,
+                          size_t length )
+{
+    size_t i = *pIndex;
+    uint8_t c = ( uint8_t ) pJson[ i ];
+    uint32_t value = 0;
+    uint32_t min = 0;
+    uint32_t max = 0;
+    size_t continuation = 0;
+    bool valid = false;
+
+    if( ( c >= 0xC2U ) && ( c <= 0xDFU ) )
+    {
+        continuation = 1U;
+        value = ( uint32_t ) c & 0x1FU;
+        min = 0x80U;
+        max = 0x7FFU;
+    }
+    else if( ( c >= 0xE0U ) && ( c <= 0xEFU ) )
+    {
+        continuation = 2U;
+        value = ( uint32_t ) c & 0x0FU;
+        min = 0x800U;
+        max = 0xFFFFU;
+    }
+    else if( ( c >= 0xF0U ) && ( c <= 0xF4U ) )
+    {
+        continuation = 3U;
+        value = ( uint32_t ) c & 0x07U;
+        min = 0x10000U;
+        max = 0x10FFFFU;
+    }
+    else
+    {
+        /* Not a leading byte. */
+    }
+
+    if( continuation > 0U )
+    {
+        valid = true;
+
+        while( ( valid == true ) && ( continuation > 0U ) )
+        {
+            i++;
+
+            if( ( i >= length ) || ( ( ( uint8_t ) pJson[ i ] & 0xC0U ) != 0x80U ) )
+            {
+                valid = false;
+            }
+            else
+            {
+                value = ( value << 6U ) | ( ( uint32_t ) ( uint8_t ) pJson[ i ] & 0x3FU );
+                continuation--;
+            }
+        }
+
+        /* Reject overlong forms and surrogates. */
+        if( ( valid == true ) &&
+            ( ( value < min ) || ( value > max ) || ( ( value >= 0xD800U ) && ( value <= 0xDFFFU ) ) ) )
+        {
+            valid = false;
+        }
+    }
+
+    if( valid == true )
+    {
+        *pIndex = i + 1U;
+    }
+
+    return valid;
+}
+
+static bool validateOneHexEscape( const char * pJson,
+                                  size_t * pIndex,
+                                  size_t length,
+                                  uint16_t * pValue )
+{
+    size_t i = *pIndex;
+    size_t end = i + JSON_HEX_ESCAPE_LENGTH;
+    uint16_t value = 0;
+    uint8_t c;
+    bool valid = false;
+
+    if( ( end > i ) && ( end < length ) && ( pJson[ i ] == '\\' ) && ( pJson[ i + 1U ] == 'u' ) )
+    {
+        valid = true;
+
+        for( i += 2U; ( valid == true ) && ( i < end ); i++ )
+        {
+            c = ( uint8_t ) pJson[ i ];
+
+            if( ( c >= ( uint8_t ) '0' ) && ( c <= ( uint8_t ) '9' ) )
+            {
+                value = ( uint16_t ) ( ( value << 4U ) | ( uint16_t ) ( c - ( uint8_t ) '0' ) );
+            }
+            else if( ( c >= ( uint8_t ) 'a' ) && ( c <= ( uint8_t ) 'f' ) )
+            {
+                value = ( uint16_t ) ( ( value << 4U ) | ( uint16_t ) ( c - ( uint8_t ) 'a' + 10U ) );
+            }
+            else if( ( c >= ( uint8_t ) 'A' ) && ( c <= ( uint8_t ) 'F' ) )
+            {
+                value = ( uint16_t ) ( ( value << 4U ) | ( uint16_t ) ( c - ( uint8_t ) 'A' + 10U ) );
+            }
+            else
+            {
+                valid = false;
+            }
+        }
+    }
+
+    if( valid == true )
+    {
+        *pIndex = end;
+        *pValue = value;
+    }
+
+    return valid;
+}
+
+static bool validateEscape( const char * pJson,
+                            size_t * pIndex,
+                            size_t length )
+{
+    size_t i = *pIndex;
+    uint16_t value = 0;
+    bool valid = false;
+
+    if( ( i + 1U ) < length )
+    {
+        switch( pJson[ i + 1U ] )
+        {
+            case 'u':
+
+                if( validateOneHexEscape( pJson, &i, length, &value ) == true )
+                {
+                    if( ( value >= 0xD800U ) && ( value <= 0xDBFFU ) )
+                    {
+                        /* A high surrogate must be followed by a low surrogate. */
+                        valid = ( validateOneHexEscape( pJson, &i, length, &value ) == true ) &&
+                                ( value >= 0xDC00U ) && ( value <= 0xDFFFU );
+                    }
+                    else
+                    {
+                        /* A low surrogate on its own is not valid. */
+                        valid = ( value < 0xDC00U ) || ( value > 0xDFFFU );
+                    }
+                }
+
+                break;
+
+            case '"':
+            case '\\':
+            case '/':
+            case 'b':
+            case 'f':
+            case 'n':
+            case 'r':
+            case 't':
+                i += 2U;
+                valid = true;
+                break;
+
+            default:
+
+                /* coreJSON also accepts an escaped control character. */
+                if( ( uint8_t ) pJson[ i + 1U ] < 0x20U )
+                {
+                    i += 2U;
+                    valid = true;
+                }
+
+                break;
+        }
+    }
+
+    if( valid == true )
+    {
+        *pIndex = i;
+    }
+
+    return valid;
+}
+
+static bool validateString( const char * pJson,
+                            size_t * pIndex,
+                            size_t length )
+{
+    size_t i = *pIndex;
+    bool valid = true;
+    bool terminated = false;
+
+    if( ( i < length ) && ( pJson[ i ] == '"' ) )
+    {
+        i++;
+
+        while( ( valid == true ) && ( terminated == false ) && ( i < length ) )
+        {
+            i = skipPlainBytes( pJson, i, length );
+
+            if( i >= length )
+            {
+                /* Unterminated. */
+            }
+            else if( pJson[ i ] == '"' )
+            {
+                terminated = true;
+                i++;
+            }
+            else if( pJson[ i ] == '\\' )
+            {
+                valid = validateEscape( pJson, &i, length );
+            }
+            else if( ( uint8_t ) pJson[ i ] < 0x20U )
+            {
+                /* An unescaped control character is not allowed. */
+                valid = false;
+            }
+            else
+            {
+                valid = validateUtf8( pJson, &i, length );
+            }
+        }
+    }
+
+    if( terminated == true )
+    {
+        *pIndex = i;
+    }
+
+    return terminated;
+}
+
+static bool validateDigits( const char * pJson,
+                            size_t * pIndex,
+                            size_t length )
+{
+    size_t start = *pIndex;
+    size_t i = start;
+
+    while( ( i < length ) && ( pJson[ i ] >= '0' ) && ( pJson[ i ] <= '9' ) )
+    {
+        i++;
+    }
+
+    *pIndex = i;
+
+    return ( i > start ) ? true : false;
+}
+
+static bool validateNumber( const char * pJson,
+                            size_t * pIndex,
+                            size_t length )
+{
+    size_t i = *pIndex;
+    size_t next = 0;
+    bool valid = false;
+
+    if( ( i < length ) && ( pJson[ i ] == '-' ) )
+    {
+        i++;
+    }
+
+    if( i < length )
+    {
+        /* A leading zero stands alone, digits after it are left for the
+         * caller to reject. */
+        if( pJson[ i ] == '0' )
+        {
+            valid = true;
+            i++;
+        }
+        else
+        {
+            valid = validateDigits( pJson, &i, length );
+        }
+    }
+
+    if( valid == true )
+    {
+        /* The fraction and exponent are only consumed if they have digits. */
+        if( ( i < length ) && ( pJson[ i ] == '.' ) )
+        {
+            next = i + 1U;
+
+            if( validateDigits( pJson, &next, length ) == true )
+            {
+                i = next;
+            }
+        }
+
+        if( ( i < length ) && ( ( pJson[ i ] == 'e' ) || ( pJson[ i ] == 'E' ) ) )
+        {
+            next = i + 1U;
+
+            if( ( next < length ) && ( ( pJson[ next ] == '-' ) || ( pJson[ next ] == '+' ) ) )
+            {
+                next++;
+            }
+
+            if( validateDigits( pJson, &next, length ) == true )
+            {
+                i = next;
+            }
+        }
+
+        *pIndex = i;
+    }
+
+    return valid;
+}
+
+static bool validateScalar( const char * pJson,
+                            size_t * pIndex,
+                            size_t length )
+{
+    static const char * const pLiterals[] = { "true", "false", "null" };
+    size_t i = *pIndex;
+    size_t literalLength = 0;
+    size_t n;
+    bool valid = false;
+
+    if( validateString( pJson, pIndex, length ) == true )
+    {
+        valid = true;
+    }
+    else
+    {
+        for( n = 0; ( valid == false ) && ( n < ( sizeof( pLiterals ) / sizeof( pLiterals[ 0 ] ) ) ); n++ )
+        {
+            literalLength = strlen( pLiterals[ n ] );
+
+            if( ( i < length ) && ( literalLength <= ( length - i ) ) &&
+                ( memcmp( &pJson[ i ], pLiterals[ n ], literalLength ) == 0 ) )
+            {
+                *pIndex = i + literalLength;
+                valid = true;
+            }
+        }
+
+        if( valid == false )
+        {
+            valid = validateNumber( pJson, pIndex, length );
+        }
+    }
+
+    return valid;
+}
+
+static bool validateSpaceAndComma( const char * pJson,
+                                   size_t * pIndex,
+                                   size_t length )
+{
+    size_t i;
+    bool comma = false;
+
+    *pIndex = skipWhitespace( pJson, *pIndex, length );
+    i = *pIndex;
+
+    if( ( i < length ) && ( pJson[ i ] == ',' ) )
+    {
+        i = skipWhitespace( pJson, i + 1U, length );
+
+        /* A comma before a closing bracket is left for the caller to reject. */
+        if( ( i < length ) && ( pJson[ i ] != '}' ) && ( pJson[ i ] != ']' ) )
+        {
+            comma = true;
+            *pIndex = i;
+        }
+    }
+
+    return comma;
+}
+
+static void validateScalars( const char * pJson,
+                             size_t * pIndex,
+                             size_t length,
+                             char mode )
+{
+    size_t i = skipWhitespace( pJson, *pIndex, length );
+    bool more = true;
+
+    *pIndex = i;
+
+    if( mode == '[' )
+    {
+        while( ( more == true ) && ( i < length ) )
+        {
+            more = ( validateScalar( pJson, &i, length ) == true ) &&
+                   ( validateSpaceAndComma( pJson, &i, length ) == true );
+        }
+
+        *pIndex = i;
+    }
+    else
+    {
+        /* The index only moves past complete members, or up to the value of
+         * a member that is a container. */
+        while( ( more == true ) && ( i < length ) )
+        {
+            more = validateString( pJson, &i, length );
+
+            if( more == true )
+            {
+                i = skipWhitespace( pJson, i, length );
+                more = ( i >= length ) || ( pJson[ i ] == ':' );
+            }
+
+            if( more == true )
+            {
+                i = skipWhitespace( pJson, i + 1U, length );
+
+                if( ( i < length ) && ( ( pJson[ i ] == '{' ) || ( pJson[ i ] == '[' ) ) )
+                {
+                    *pIndex = i;
+                    more = false;
+                }
+                else
+                {
+                    more = validateScalar( pJson, &i, length );
+
+                    if( more == true )
+                    {
+                        more = validateSpaceAndComma( pJson, &i, length );
+                        *pIndex = i;
+                    }
+                }
+            }
+        }
+    }
+}
+
+static JSONStatus_t validateCollection( const char * pJson,
+                                        size_t * pIndex,
+                                        size_t length )
+{
+    JSONStatus_t status = JSONPartial;
+    char stack[ JSON_MAX_DEPTH ];
+    int32_t depth = -1;
+    size_t i = *pIndex;
+    char c;
+
+    while( ( status == JSONPartial ) && ( i < length ) )
+    {
+        c = pJson[ i ];
+        i++;
+
+        if( ( c == '{' ) || ( c == '[' ) )
+        {
+            depth++;
+
+            if( depth >= ( int32_t ) JSON_MAX_DEPTH )
+            {
+                status = JSONMaxDepthExceeded;
+            }
+            else
+            {
+                stack[ depth ] = c;
+                validateScalars( pJson, &i, length, c );
+            }
+        }
+        else if( ( c == '}' ) || ( c == ']' ) )
+        {
+            if( ( depth < 0 ) || ( stack[ depth ] != ( ( c == '}' ) ? '{' : '[' ) ) )
+            {
+                status = JSONIllegalDocument;
+            }
+            else if( depth == 0 )
+            {
+                status = JSONSuccess;
+            }
+            else
+            {
+                depth--;
+
+                if( validateSpaceAndComma( pJson, &i, length ) == true )
+                {
+                    validateScalars( pJson, &i, length, stack[ depth ] );
+                }
+            }
+        }
+        else
+        {
+            status = JSONIllegalDocument;
+        }
+    }
+
+    if( status == JSONSuccess )
+    {
+        *pIndex = i;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+OtaJobDocIndexStatus_t jsonIndexBuild( OtaJobDocIndex_t * pIndex,
+                                       const char * pJson,
+                                       size_t jsonLength )
+{
+    OtaJobDocIndexStatus_t status = OtaJobDocIndexSuccess;
+    uint16_t objectStack[ OTA_JSON_INDEX_MAX_DEPTH ];
+    size_t depth = 0;
+    size_t i = 0;
+    size_t start = 0;
+    size_t keyStart = 0;
+    size_t valueLength = 0;
+    uint16_t entry = 0;
+    OtaJobDocIndexEntry_t * pEntry = NULL;
+
+    if( ( pIndex == NULL ) || ( pJson == NULL ) || ( jsonLength == 0U ) )
+    {
+        status = OtaJobDocIndexNullParameter;
+    }
+    else
+    {
+        ( void ) memset( pIndex, 0, sizeof( OtaJobDocIndex_t ) );
+
+        i = skipWhitespace( pJson, 0U, jsonLength );
+
+        if( ( i < jsonLength ) && ( pJson[ i ] == '{' ) )
+        {
+            objectStack[ 0 ] = OTA_JOB_DOC_INDEX_NO_PARENT;
+            depth = 1U;
+            i++;
+        }
+        else
+        {
+            status = OtaJobDocIndexMalformedDoc;
+        }
+    }
+
+    while( ( status == OtaJobDocIndexSuccess ) && ( depth > 0U ) )
+    {
+        i = skipWhitespace( pJson, i, jsonLength );
+
+        if( i >= jsonLength )
+        {
+            status = OtaJobDocIndexMalformedDoc;
+        }
+        else if( pJson[ i ] == ',' )
+        {
+            i++;
+        }
+        else if( pJson[ i ] == '}' )
+        {
+            /* The object is complete, its value now has a known length. */
+            entry = objectStack[ depth - 1U ];
+
+            if( ( entry != OTA_JOB_DOC_INDEX_NO_PARENT ) && ( entry != JSON_INDEX_NOT_INDEXED ) )
+            {
+                pEntry = &pIndex->entries[ entry ];
+                pEntry->valueLength = ( size_t ) ( &pJson[ i + 1U ] - pEntry->pValue );
+            }
+
+            depth--;
+            i++;
+        }
+        else if( pJson[ i ] == '"' )
+        {
+            keyStart = i + 1U;
+
+            if( skipString( pJson, &i, jsonLength ) == false )
+            {
+                status = OtaJobDocIndexMalformedDoc;
+            }
+            else
+            {
+                entry = addEntry( pIndex, objectStack[ depth - 1U ], &pJson[ keyStart ], i - keyStart - 1U );
+                i = skipWhitespace( pJson, i, jsonLength );
+
+                if( ( i < jsonLength ) && ( pJson[ i ] == ':' ) )
+                {
+                    i = skipWhitespace( pJson, i + 1U, jsonLength );
+                }
+                else
+                {
+                    status = OtaJobDocIndexMalformedDoc;
+                }
+            }
+
+            if( ( status == OtaJobDocIndexSuccess ) && ( i >= jsonLength ) )
+            {
+                status = OtaJobDocIndexMalformedDoc;
+            }
+
+            if( status == OtaJobDocIndexSuccess )
+            {
+                pEntry = ( entry != JSON_INDEX_NOT_INDEXED ) ? &pIndex->entries[ entry ] : NULL;
+                start = i;
+
+                if( ( pJson[ i ] == '{' ) && ( depth < OTA_JSON_INDEX_MAX_DEPTH ) )
+                {
+                    /* Descend into the object, the length is set when it is closed. */
+                    objectStack[ depth ] = entry;
+                    depth++;
+                    i++;
+                    valueLength = 0U;
+                }
+                else if( ( pJson[ i ] == '{' ) || ( pJson[ i ] == '[' ) )
+                {
+                    if( pJson[ i ] == '{' )
+                    {
+                        /* Too deep, the members of this object are not indexed. */
+                        pIndex->full = true;
+                    }
+
+                    status = ( skipContainer( pJson, &i, jsonLength ) == true ) ? OtaJobDocIndexSuccess : OtaJobDocIndexMalformedDoc;
+                    valueLength = i - start;
+                }
+                else if( pJson[ i ] == '"' )
+                {
+                    /* String values are reported without their quotes. */
+                    status = ( skipString( pJson, &i, jsonLength ) == true ) ? OtaJobDocIndexSuccess : OtaJobDocIndexMalformedDoc;
+                    start++;
+                    valueLength = i - start - 1U;
+                }
+                else
+                {
+                    status = ( skipScalar( pJson, &i, jsonLength ) == true ) ? OtaJobDocIndexSuccess : OtaJobDocIndexMalformedDoc;
+                    valueLength = i - start;
+                }
+
+                if( pEntry != NULL )
+                {
+                    pEntry->pValue = &pJson[ start ];
+                    pEntry->valueLength = valueLength;
+                }
+            }
+        }
+        else
+        {
+            status = OtaJobDocIndexMalformedDoc;
+        }
+    }
+
+    if( ( status == OtaJobDocIndexSuccess ) && ( pIndex->full == true ) )
+    {
+        status = OtaJobDocIndexFull;
+    }
+
+    return status;
+}
+
+OtaJobDocIndexStatus_t OTA_JobDocIndexLookup( const OtaJobDocIndex_t * pIndex,
+                                              const char * pKeyPath,
+                                              size_t keyPathLength,
+                                              const char ** ppValue,
+                                              size_t * pValueLength )
+{
+    OtaJobDocIndexStatus_t status = OtaJobDocIndexNotFound;
+    uint32_t hash;
+    uint32_t bucket;
+    uint32_t probes = 0;
+    uint16_t entry;
+
+    if( ( pIndex == NULL ) || ( pKeyPath == NULL ) || ( keyPathLength == 0U ) ||
+        ( ppValue == NULL ) || ( pValueLength == NULL ) )
+    {
+        status = OtaJobDocIndexNullParameter;
+    }
+    else
+    {
+        hash = hashBytes( FNV_OFFSET_BASIS, pKeyPath, keyPathLength );
+        bucket = hash % JSON_INDEX_NUM_BUCKETS;
+
+        while( ( status == OtaJobDocIndexNotFound ) &&
+               ( probes < JSON_INDEX_NUM_BUCKETS ) &&
+               ( pIndex->buckets[ bucket ] != 0U ) )
+        {
+            entry = ( uint16_t ) ( pIndex->buckets[ bucket ] - 1U );
+
+            if( ( pIndex->entries[ entry ].pathHash == hash ) &&
+                ( keyPathMatches( pIndex, entry, pKeyPath, keyPathLength ) == true ) )
+            {
+                *ppValue = pIndex->entries[ entry ].pValue;
+                *pValueLength = pIndex->entries[ entry ].valueLength;
+                status = OtaJobDocIndexSuccess;
+            }
+
+            bucket = ( bucket + 1U ) % JSON_INDEX_NUM_BUCKETS;
+            probes++;
+        }
+
+        if( ( status == OtaJobDocIndexNotFound ) && ( pIndex->full == true ) )
+        {
+            status = OtaJobDocIndexFull;
+        }
+    }
+
+    return status;
+}
+
+JSONStatus_t jsonValidate( const char * pJson,
+                           size_t length )
+{
+    JSONStatus_t status = JSONIllegalDocument;
+    size_t i = 0;
+
+    if( pJson == NULL )
+    {
+        status = JSONNullParameter;
+    }
+    else if( length == 0U )
+    {
+        status = JSONBadParameter;
+    }
+    else
+    {
+        i = skipWhitespace( pJson, 0U, length );
+
+        #ifndef JSON_VALIDATE_COLLECTIONS_ONLY
+            if( validateScalar( pJson, &i, length ) == true )
+            {
+                status = JSONSuccess;
+            }
+            else
+        #endif
+        {
+            status = validateCollection( pJson, &i, length );
+        }
+
+        if( status == JSONSuccess )
+        {
+            /* Only whitespace may follow the value. */
+            i = skipWhitespace( pJson, i, length );
+
+            if( i != length )
+            {
+                status = JSONIllegalDocument;
+            }
+        }
+    }
+
+    return status;
+}
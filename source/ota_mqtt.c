@@ -35,6 +35,8 @@
 #include "ota.h"
 #include "ota_private.h"
 #include "ota_cbor_private.h"
+#include "ota_base64_private.h"
+#include "ota_atomic_private.h"
 
 /* Private include. */
 #include "ota_mqtt_private.h"
@@ -61,15 +63,23 @@
 #define MQTT_API_STREAMS             "/streams/"                      /*!< Stream API identifier. */
 #define MQTT_API_DATA_CBOR           "/data/cbor"                     /*!< Stream API suffix. */
 #define MQTT_API_GET_CBOR            "/get/cbor"                      /*!< Stream API suffix. */
+#define MQTT_API_DATA_JSON           "/data/json"                     /*!< Stream API suffix. */
+#define MQTT_API_GET_JSON            "/get/json"                      /*!< Stream API suffix. */
+
+#if ( otaconfigMQTT_JSON_STREAM_PAYLOAD == 1U )
+    #define MQTT_API_DATA_STREAM     MQTT_API_DATA_JSON               /*!< Stream API suffix of the selected payload format. */
+    #define MQTT_API_GET_STREAM      MQTT_API_GET_JSON                /*!< Stream API suffix of the selected payload format. */
+#else
+    #define MQTT_API_DATA_STREAM     MQTT_API_DATA_CBOR               /*!< Stream API suffix of the selected payload format. */
+    #define MQTT_API_GET_STREAM      MQTT_API_GET_CBOR                /*!< Stream API suffix of the selected payload format. */
+#endif
 
 /* NOTE: The format specifiers in this string are placeholders only; the lengths of these
  * strings are used to calculate buffer sizes.
  */
 static const char pOtaJobsGetNextTopicTemplate[] = MQTT_API_THINGS "%s"MQTT_API_JOBS_NEXT_GET;                 /*!< Topic template to request next job. */
 static const char pOtaJobsNotifyNextTopicTemplate[] = MQTT_API_THINGS "%s"MQTT_API_JOBS_NOTIFY_NEXT;           /*!< Topic template to notify next . */
-static const char pOtaJobStatusTopicTemplate[] = MQTT_API_THINGS "%s"MQTT_API_JOBS "%s"MQTT_API_UPDATE;        /*!< Topic template to update the current job. */
-static const char pOtaStreamDataTopicTemplate[] = MQTT_API_THINGS "%s"MQTT_API_STREAMS "%s"MQTT_API_DATA_CBOR; /*!< Topic template to receive data over a stream. */
-static const char pOtaGetStreamTopicTemplate[] = MQTT_API_THINGS "%s"MQTT_API_STREAMS "%s"MQTT_API_GET_CBOR;   /*!< Topic template to request next data over a stream. */
+static const char pOtaStreamDataTopicTemplate[] = MQTT_API_THINGS "%s"MQTT_API_STREAMS "%s"MQTT_API_DATA_STREAM; /*!< Topic template to receive data over a stream. */
 
 static const char pOtaGetNextJobMsgTemplate[] = "{\"clientToken\":\"%u:%s\"}";                                 /*!< Used to specify client token id to authenticate job. */
 static const char pOtaStringReceive[] = "\"receive\"";                                                         /*!< Used to build the job receive template. */
@@ -120,7 +130,6 @@ static const char asciiDigits[] =
  * These are used to calculate the static size of buffers used to store MQTT
  * topic and message strings. Each length is in terms of bytes. */
 #define U32_MAX_LEN            10U                                              /*!< Maximum number of output digits of an unsigned long value. */
-#define JOB_NAME_MAX_LEN       128U                                             /*!< Maximum length of the name of job documents received from the server. */
 #define STREAM_NAME_MAX_LEN    44U                                              /*!< Maximum length for the name of MQTT streams. */
 #define NULL_CHAR_LEN          1U                                               /*!< Size of a single null character used to terminate topics and messages. */
 
@@ -130,18 +139,32 @@ static const char asciiDigits[] =
 #define TOPIC_PLUS_THINGNAME_LEN( topic )    ( CONST_STRLEN( topic ) + otaconfigMAX_THINGNAME_LEN + NULL_CHAR_LEN )              /*!< Calculate max buffer size based on topic template and thing name length. */
 #define TOPIC_GET_NEXT_BUFFER_SIZE       ( TOPIC_PLUS_THINGNAME_LEN( pOtaJobsGetNextTopicTemplate ) )                            /*!< Max buffer size for `jobs/$next/get` topic. */
 #define TOPIC_NOTIFY_NEXT_BUFFER_SIZE    ( TOPIC_PLUS_THINGNAME_LEN( pOtaJobsNotifyNextTopicTemplate ) )                         /*!< Max buffer size for `jobs/notify-next` topic. */
-#define TOPIC_JOB_STATUS_BUFFER_SIZE     ( TOPIC_PLUS_THINGNAME_LEN( pOtaJobStatusTopicTemplate ) + JOB_NAME_MAX_LEN )           /*!< Max buffer size for `jobs/<job_name>/update` topic. */
 #define TOPIC_STREAM_DATA_BUFFER_SIZE    ( TOPIC_PLUS_THINGNAME_LEN( pOtaStreamDataTopicTemplate ) + STREAM_NAME_MAX_LEN )       /*!< Max buffer size for `streams/<stream_name>/data/cbor` topic. */
-#define TOPIC_GET_STREAM_BUFFER_SIZE     ( TOPIC_PLUS_THINGNAME_LEN( pOtaGetStreamTopicTemplate ) + STREAM_NAME_MAX_LEN )        /*!< Max buffer size for `streams/<stream_name>/get/cbor` topic. */
 #define MSG_GET_NEXT_BUFFER_SIZE         ( TOPIC_PLUS_THINGNAME_LEN( pOtaGetNextJobMsgTemplate ) + U32_MAX_LEN )                 /*!< Max buffer size for message of `jobs/$next/get topic`. */
 
+/* Fields of a JSON stream response, tracked as a bitmap while decoding. */
+#define JSON_STREAM_KEY_FILE_ID       0x1U    /*!< "f" member was found. */
+#define JSON_STREAM_KEY_BLOCK_ID      0x2U    /*!< "i" member was found. */
+#define JSON_STREAM_KEY_BLOCK_SIZE    0x4U    /*!< "l" member was found. */
+#define JSON_STREAM_KEY_PAYLOAD       0x8U    /*!< "p" member was found. */
+#define JSON_STREAM_KEYS_ALL          0xFU    /*!< All members of a block were found. */
+
+
 /**
  * @brief Subscribe to the jobs notification topic (i.e. New file version available).
  *
  * @param[in] pAgentCtx Agent context which stores the thing details and mqtt interface.
  * @return OtaMqttStatus_t Result of the subscribe operation, OtaMqttSuccess if the operation is successful
  */
-static OtaMqttStatus_t subscribeToJobNotificationTopics( const OtaAgentContext_t * pAgentCtx );
+static OtaMqttStatus_t subscribeToJobNotificationTopics( OtaAgentContext_t * pAgentCtx );
+
+/**
+ * @brief Subscribe to the firmware update receive topic, unless it is already subscribed.
+ *
+ * @param[in] pAgentCtx Agent context which stores the thing details, the subscriptions and mqtt interface.
+ * @return OtaMqttStatus_t Result of the subscribe operation, OtaMqttSuccess if the operation is successful.
+ */
+static OtaMqttStatus_t subscribeToDataStream( OtaAgentContext_t * pAgentCtx );
 
 /**
  * @brief UnSubscribe from the firmware update receive topic.
@@ -173,6 +196,45 @@ static OtaMqttStatus_t publishStatusMessage( OtaAgentContext_t * pAgentCtx,
                                              uint32_t msgSize,
                                              uint8_t qos );
 
+/**
+ * @brief Build the job status topic of the active job into the MQTT cache.
+ *
+ * @param[in] pAgentCtx Agent context which provides the details for the thing and job.
+ */
+static void cacheJobStatusTopic( OtaAgentContext_t * pAgentCtx );
+
+/**
+ * @brief Check that the cached job status topic names the active job.
+ *
+ * @param[in] pAgentCtx Agent context which provides the details for the job.
+ * @return true if the cached topic can be published to, false if it must be built again.
+ */
+static bool jobStatusTopicIsCurrent( const OtaAgentContext_t * pAgentCtx );
+
+/**
+ * @brief Build the get stream topic and the stream request prefix of the current file into the
+ * MQTT cache.
+ *
+ * @param[in] pAgentCtx Agent context which provides the details for the thing and file.
+ * @return true if both were built, false if the prefix could not be encoded.
+ */
+static bool cacheStreamRequest( OtaAgentContext_t * pAgentCtx );
+
+/**
+ * @brief Forget the subscriptions made before the latest connection state notification.
+ *
+ * @param[in] pAgentCtx Agent context which stores the subscriptions.
+ */
+static void syncSubscriptions( OtaAgentContext_t * pAgentCtx );
+
+/**
+ * @brief Subscribe again to the topics of the download that were lost with the connection.
+ *
+ * @param[in] pAgentCtx Agent context which stores the subscriptions.
+ * @return OtaMqttStatus_t OtaMqttSuccess if all the topics are subscribed.
+ */
+static OtaMqttStatus_t restoreSubscriptions( OtaAgentContext_t * pAgentCtx );
+
 /**
  * @brief Populate the message buffer with the job status message.
  *
@@ -253,6 +315,101 @@ static size_t stringBuilderUInt32Hex( char * pBuffer,
                                       size_t bufferSizeBytes,
                                       uint32_t value );
 
+/**
+ * @brief Advance past JSON whitespace.
+ *
+ * @param[in] pJson The JSON text.
+ * @param[in] index Index to start at.
+ * @param[in] length Length of the JSON text.
+ * @return size_t Index of the first character that is not whitespace, or length.
+ */
+static size_t skipJsonWhitespace( const char * pJson,
+                                  size_t index,
+                                  size_t length );
+
+/**
+ * @brief Advance to the closing quote of a JSON string.
+ *
+ * @param[in] pJson The JSON text.
+ * @param[in] index Index of the first character after the opening quote.
+ * @param[in] length Length of the JSON text.
+ * @return size_t Index of the closing quote, or length.
+ */
+static size_t skipJsonString( const char * pJson,
+                              size_t index,
+                              size_t length );
+
+/**
+ * @brief Decode the Base64 text of a JSON string that contains escapes.
+ *
+ * The escapes are resolved and the Base64 symbols are decoded four at a time.
+ * Escaped line breaks are skipped like base64Decode skips them.
+ *
+ * @param[in] pJson The JSON text.
+ * @param[in] start Index of the first character of the string.
+ * @param[in] end Index of the closing quote of the string.
+ * @param[out] pDest Buffer to place the decoded data in.
+ * @param[in,out] pDestSize Size of pDest in, length of the decoded data out.
+ * @return bool true if the string is valid escaped Base64 that fits in pDest.
+ */
+static bool decodeEscapedJsonBase64( const char * pJson,
+                                     size_t start,
+                                     size_t end,
+                                     uint8_t * pDest,
+                                     size_t * pDestSize );
+
+/**
+ * @brief Map the single character key of a JSON stream response member to its field bit.
+ *
+ * @param[in] key The key character.
+ * @return uint32_t The JSON_STREAM_KEY_* bit, or 0 if the member is not a block field.
+ */
+static uint32_t jsonStreamKey( char key );
+
+#if ( otaconfigMQTT_JSON_STREAM_PAYLOAD == 1U )
+
+/**
+ * @brief Build the leading members of the JSON get stream request message.
+ *
+ * This is the JSON counterpart of OTA_CBOR_Encode_GetStreamRequestPrefix. The
+ * prefix ends inside the string of the Base64 encoded block bitmap.
+ *
+ * @param[out] pMessageBuffer Buffer to place the prefix in.
+ * @param[in] messageBufferSize Size of the buffer pointed to by pMessageBuffer.
+ * @param[out] pEncodedPrefixSize Length of the prefix.
+ * @param[in] fileId The server file ID.
+ * @param[in] blockSize The size of the requested blocks.
+ */
+    static void encodeStreamRequestPrefixJson( char * pMessageBuffer,
+                                               size_t messageBufferSize,
+                                               size_t * pEncodedPrefixSize,
+                                               uint32_t fileId,
+                                               uint32_t blockSize );
+
+/**
+ * @brief Complete the JSON get stream request message after its prefix.
+ *
+ * This is the JSON counterpart of OTA_CBOR_Encode_GetStreamRequestBlocks.
+ * The block bitmap is sent Base64 encoded.
+ *
+ * @param[in,out] pMessageBuffer Buffer holding the prefix.
+ * @param[in] messageBufferSize Size of the buffer pointed to by pMessageBuffer.
+ * @param[in] prefixSize Length of the prefix at the start of the buffer.
+ * @param[out] pEncodedMessageSize Length of the message.
+ * @param[in] pBlockBitmap Bitmap of the blocks still to be received.
+ * @param[in] blockBitmapSize Size of the bitmap in bytes.
+ * @param[in] numOfBlocksRequested Number of blocks to request.
+ * @return true if the message was built, false if it did not fit the buffer.
+ */
+    static bool encodeStreamRequestBlocksJson( char * pMessageBuffer,
+                                               size_t messageBufferSize,
+                                               size_t prefixSize,
+                                               size_t * pEncodedMessageSize,
+                                               const uint8_t * pBlockBitmap,
+                                               size_t blockBitmapSize,
+                                               uint32_t numOfBlocksRequested );
+#endif
+
 static size_t stringBuilder( char * pBuffer,
                              size_t bufferSizeBytes,
                              const char * strings[] )
@@ -338,18 +495,281 @@ static size_t stringBuilderUInt32Hex( char * pBuffer,
     return size;
 }
 
+static size_t skipJsonWhitespace( const char * pJson,
+                                  size_t index,
+                                  size_t length )
+{
+    size_t i = index;
+
+    while( ( i < length ) &&
+           ( ( pJson[ i ] == ' ' ) || ( pJson[ i ] == '\t' ) || ( pJson[ i ] == '\n' ) || ( pJson[ i ] == '\r' ) ) )
+    {
+        i++;
+    }
+
+    return i;
+}
+
+static size_t skipJsonString( const char * pJson,
+                              size_t index,
+                              size_t length )
+{
+    size_t i = index;
+
+    while( ( i < length ) && ( pJson[ i ] != '"' ) )
+    {
+        /* Skip the escaped character, it can not end the string. */
+        i += ( pJson[ i ] == '\\' ) ? 2U : 1U;
+    }
+
+    return ( i < length ) ? i : length;
+}
+
+static bool decodeEscapedJsonBase64( const char * pJson,
+                                     size_t start,
+                                     size_t end,
+                                     uint8_t * pDest,
+                                     size_t * pDestSize )
+{
+    uint8_t group[ 4 ];
+    size_t numSymbols = 0;
+    size_t outputLen = 0;
+    size_t decodedLen = 0;
+    size_t i = start;
+    size_t digit = 0;
+    uint32_t code = 0;
+    char symbol = '\0';
+    bool valid = true;
+    bool padded = false;
+
+    while( ( valid == true ) && ( i < end ) )
+    {
+        symbol = pJson[ i ];
+        i++;
+
+        if( symbol == '\\' )
+        {
+            valid = ( i < end );
+            symbol = ( valid == true ) ? pJson[ i ] : '\0';
+            i++;
+
+            switch( symbol )
+            {
+                case '/':
+                case '\\':
+                case '"':
+                    /* The escaped character itself. */
+                    break;
+
+                case 'n':
+                    symbol = '\n';
+                    break;
+
+                case 'r':
+                    symbol = '\r';
+                    break;
+
+                case 'u':
+                    code = 0;
+
+                    for( digit = 0; ( valid == true ) && ( digit < 4U ); digit++ )
+                    {
+                        symbol = ( i < end ) ? pJson[ i ] : '\0';
+                        i++;
+
+                        if( ( symbol >= '0' ) && ( symbol <= '9' ) )
+                        {
+                            code = ( code << 4 ) + ( uint32_t ) ( symbol - '0' );
+                        }
+                        else if( ( symbol >= 'a' ) && ( symbol <= 'f' ) )
+                        {
+                            code = ( code << 4 ) + ( uint32_t ) ( symbol - 'a' ) + 10U;
+                        }
+                        else if( ( symbol >= 'A' ) && ( symbol <= 'F' ) )
+                        {
+                            code = ( code << 4 ) + ( uint32_t ) ( symbol - 'A' ) + 10U;
+                        }
+                        else
+                        {
+                            valid = false;
+                        }
+                    }
+
+                    /* Base64 symbols are ASCII. */
+                    valid = ( valid == true ) && ( code < 0x80U );
+                    symbol = ( char ) code;
+                    break;
+
+                default:
+
+                    /* Backspace, form feed, tab and unknown escapes are never
+                     * part of Base64 text. */
+                    valid = false;
+                    break;
+            }
+        }
+
+        if( ( valid == true ) && ( symbol != '\n' ) && ( symbol != '\r' ) )
+        {
+            /* Nothing may follow the padding. */
+            valid = ( padded == false );
+            group[ numSymbols ] = ( uint8_t ) symbol;
+            numSymbols++;
+        }
+
+        if( ( valid == true ) && ( numSymbols == sizeof( group ) ) )
+        {
+            valid = ( base64Decode( &pDest[ outputLen ],
+                                    *pDestSize - outputLen,
+                                    &decodedLen,
+                                    group,
+                                    numSymbols ) == Base64Success );
+            outputLen += decodedLen;
+            padded = ( group[ numSymbols - 1U ] == ( uint8_t ) '=' );
+            numSymbols = 0;
+        }
+    }
+
+    /* Base64 text without padding may end with a partial group. */
+    if( ( valid == true ) && ( numSymbols > 0U ) )
+    {
+        valid = ( base64Decode( &pDest[ outputLen ],
+                                *pDestSize - outputLen,
+                                &decodedLen,
+                                group,
+                                numSymbols ) == Base64Success );
+        outputLen += decodedLen;
+    }
+
+    if( valid == true )
+    {
+        *pDestSize = outputLen;
+    }
+
+    return valid;
+}
+
+static uint32_t jsonStreamKey( char key )
+{
+    uint32_t field = 0;
+
+    switch( key )
+    {
+        case 'f':
+            field = JSON_STREAM_KEY_FILE_ID;
+            break;
+
+        case 'i':
+            field = JSON_STREAM_KEY_BLOCK_ID;
+            break;
+
+        case 'l':
+            field = JSON_STREAM_KEY_BLOCK_SIZE;
+            break;
+
+        case 'p':
+            field = JSON_STREAM_KEY_PAYLOAD;
+            break;
+
+        default:
+            /* Not a block field. */
+            break;
+    }
+
+    return field;
+}
+
+#if ( otaconfigMQTT_JSON_STREAM_PAYLOAD == 1U )
+    static void encodeStreamRequestPrefixJson( char * pMessageBuffer,
+                                               size_t messageBufferSize,
+                                               size_t * pEncodedPrefixSize,
+                                               uint32_t fileId,
+                                               uint32_t blockSize )
+    {
+        char fileIdString[ U32_MAX_LEN + 1 ];
+        char blockSizeString[ U32_MAX_LEN + 1 ];
+
+        /* NULL-terminated list of JSON payload components. The Base64 bitmap
+         * and the closing members are appended after it. */
+        const char * pPayloadParts[] =
+        {
+            "{\"c\":\"" OTA_CLIENT_TOKEN "\",\"f\":",
+            NULL, /* File ID is not available at compile time, initialized below. */
+            ",\"l\":",
+            NULL, /* Block size is not available at compile time, initialized below. */
+            ",\"o\":0,\"b\":\"",
+            NULL
+        };
+
+        /* stringBuilderUInt32Decimal renders zero as an empty string. */
+        fileIdString[ 0 ] = '0';
+        fileIdString[ 1 ] = '\0';
+
+        if( fileId > 0U )
+        {
+            ( void ) stringBuilderUInt32Decimal( fileIdString, sizeof( fileIdString ), fileId );
+        }
+
+        ( void ) stringBuilderUInt32Decimal( blockSizeString, sizeof( blockSizeString ), blockSize );
+
+        pPayloadParts[ 1 ] = fileIdString;
+        pPayloadParts[ 3 ] = blockSizeString;
+
+        *pEncodedPrefixSize = stringBuilder( pMessageBuffer, messageBufferSize, pPayloadParts );
+    }
+
+    static bool encodeStreamRequestBlocksJson( char * pMessageBuffer,
+                                               size_t messageBufferSize,
+                                               size_t prefixSize,
+                                               size_t * pEncodedMessageSize,
+                                               const uint8_t * pBlockBitmap,
+                                               size_t blockBitmapSize,
+                                               uint32_t numOfBlocksRequested )
+    {
+        bool result = false;
+        char numBlocksString[ U32_MAX_LEN + 1 ];
+        size_t msgSize = prefixSize;
+        size_t bitmapEncodedSize = 0;
+
+        const char * pTrailerParts[] =
+        {
+            "\",\"n\":",
+            NULL, /* Number of blocks is not available at compile time, initialized below. */
+            "}",
+            NULL
+        };
+
+        ( void ) stringBuilderUInt32Decimal( numBlocksString, sizeof( numBlocksString ), numOfBlocksRequested );
+        pTrailerParts[ 1 ] = numBlocksString;
+
+        /* The bitmap is encoded in place after the prefix. */
+        if( base64Encode( ( uint8_t * ) &pMessageBuffer[ msgSize ],
+                          messageBufferSize - msgSize,
+                          &bitmapEncodedSize,
+                          pBlockBitmap,
+                          blockBitmapSize ) == Base64Success )
+        {
+            msgSize += bitmapEncodedSize;
+            msgSize += stringBuilder( &pMessageBuffer[ msgSize ], messageBufferSize - msgSize, pTrailerParts );
+            *pEncodedMessageSize = msgSize;
+            result = true;
+        }
+
+        return result;
+    }
+#endif /* if ( otaconfigMQTT_JSON_STREAM_PAYLOAD == 1U ) */
+
 /*
  * Subscribe to the OTA job notification topics.
  */
-static OtaMqttStatus_t subscribeToJobNotificationTopics( const OtaAgentContext_t * pAgentCtx )
+static OtaMqttStatus_t subscribeToJobNotificationTopics( OtaAgentContext_t * pAgentCtx )
 {
     OtaMqttStatus_t mqttStatus = OtaMqttSuccess;
 
     uint16_t topicLen = 0;
 
-    /* This buffer is used to store generated MQTT topics. The static size
-     * are calculated from the templates and the corresponding parameters. */
-    static char pJobTopicNotifyNext[ TOPIC_NOTIFY_NEXT_BUFFER_SIZE ];
+    /* The topic is built in the cache of the agent, which keeps it while it is subscribed. */
+    char * pJobTopicNotifyNext = NULL;
 
     /* NULL-terminated list of topic string components */
     const char * topicStringParts[] =
@@ -363,14 +783,15 @@ static OtaMqttStatus_t subscribeToJobNotificationTopics( const OtaAgentContext_t
     assert( pAgentCtx != NULL );
 
     topicStringParts[ 1 ] = ( const char * ) pAgentCtx->pThingName;
+    pJobTopicNotifyNext = pAgentCtx->mqttCache.pJobNotifyTopic;
 
     topicLen = ( uint16_t ) stringBuilder(
         pJobTopicNotifyNext,
-        sizeof( pJobTopicNotifyNext ),
+        sizeof( pAgentCtx->mqttCache.pJobNotifyTopic ),
         topicStringParts );
 
-    /* The buffer is static and the size is calculated to fit. */
-    assert( ( topicLen > 0U ) && ( topicLen < sizeof( pJobTopicNotifyNext ) ) );
+    /* The size of the buffer is calculated to fit. */
+    assert( ( topicLen > 0U ) && ( topicLen < TOPIC_NOTIFY_NEXT_BUFFER_SIZE ) );
 
     mqttStatus = pAgentCtx->pOtaInterface->mqtt.subscribe( pJobTopicNotifyNext,
                                                            topicLen,
@@ -393,6 +814,92 @@ static OtaMqttStatus_t subscribeToJobNotificationTopics( const OtaAgentContext_t
     return mqttStatus;
 }
 
+/*
+ * Subscribe to the OTA data stream topic.
+ */
+static OtaMqttStatus_t subscribeToDataStream( OtaAgentContext_t * pAgentCtx )
+{
+    OtaMqttStatus_t mqttStatus = OtaMqttSuccess;
+
+    /* This buffer is used to store the generated MQTT topic. The static size
+     * is calculated from the template and the corresponding parameters. */
+    char pRxStreamTopic[ TOPIC_STREAM_DATA_BUFFER_SIZE ];
+    uint16_t topicLen = 0;
+    const OtaFileContext_t * pFileContext = NULL;
+    OtaMqttCache_t * pCache = NULL;
+
+    /* NULL-terminated list of topic string parts. */
+    const char * pTopicParts[] =
+    {
+        MQTT_API_THINGS,
+        NULL, /* Thing Name not available at compile time, initialized below. */
+        MQTT_API_STREAMS,
+        NULL, /* Stream Name not available at compile time, initialized below. */
+        MQTT_API_DATA_STREAM,
+        NULL
+    };
+
+    assert( pAgentCtx != NULL );
+
+    pFileContext = &( pAgentCtx->fileContext );
+
+    pTopicParts[ 1 ] = ( const char * ) pAgentCtx->pThingName;
+    pTopicParts[ 3 ] = ( const char * ) pFileContext->pStreamName;
+
+    topicLen = ( uint16_t ) stringBuilder(
+        pRxStreamTopic,
+        sizeof( pRxStreamTopic ),
+        pTopicParts );
+
+    /* The buffer is static and the size is calculated to fit. */
+    assert( ( topicLen > 0U ) && ( topicLen < sizeof( pRxStreamTopic ) ) );
+
+    syncSubscriptions( pAgentCtx );
+    pCache = &( pAgentCtx->mqttCache );
+
+    /* Files of the same stream share the topic, which only needs to be subscribed once per
+     * connection. */
+    if( ( pCache->dataStreamTopicLen == topicLen ) &&
+        ( memcmp( pCache->pDataStreamTopic, pRxStreamTopic, topicLen ) == 0 ) )
+    {
+        LogDebug( ( "Already subscribed to the OTA data stream topic: "
+                    "topic=%s",
+                    pRxStreamTopic ) );
+    }
+    else
+    {
+        /* The MQTT client may keep the topic while it is subscribed, so it is passed from the
+         * cache of the agent. */
+        assert( topicLen < sizeof( pCache->pDataStreamTopic ) );
+        ( void ) memcpy( pCache->pDataStreamTopic, pRxStreamTopic, ( size_t ) topicLen + 1U );
+        pCache->dataStreamTopicLen = 0U;
+
+        mqttStatus = pAgentCtx->pOtaInterface->mqtt.subscribe( pCache->pDataStreamTopic,
+                                                               topicLen,
+                                                               0 );
+
+        if( mqttStatus == OtaMqttSuccess )
+        {
+            pCache->dataStreamTopicLen = topicLen;
+
+            LogDebug( ( "Subscribed to the OTA data stream topic: "
+                        "topic=%s",
+                        pRxStreamTopic ) );
+        }
+        else
+        {
+            LogError( ( "Failed to subscribe to MQTT topic: "
+                        "subscribe returned error: "
+                        "OtaMqttStatus_t=%s"
+                        ", topic=%s",
+                        OTA_MQTT_strerror( mqttStatus ),
+                        pRxStreamTopic ) );
+        }
+    }
+
+    return mqttStatus;
+}
+
 /*
  * UnSubscribe from the OTA data stream topic.
  */
@@ -413,7 +920,7 @@ static OtaMqttStatus_t unsubscribeFromDataStream( const OtaAgentContext_t * pAge
         NULL, /* Thing Name not available at compile time, initialized below. */
         MQTT_API_STREAMS,
         NULL, /* Stream Name not available at compile time, initialized below. */
-        MQTT_API_DATA_CBOR,
+        MQTT_API_DATA_STREAM,
         NULL
     };
 
@@ -520,46 +1027,27 @@ static OtaMqttStatus_t publishStatusMessage( OtaAgentContext_t * pAgentCtx,
                                              uint8_t qos )
 {
     OtaMqttStatus_t mqttStatus = OtaMqttSuccess;
-    size_t topicLen = 0;
-
-    /* This buffer is used to store the generated MQTT topic. The static size
-     * is calculated from the template and the corresponding parameters. */
-    char pTopicBuffer[ TOPIC_JOB_STATUS_BUFFER_SIZE ];
-    /* NULL-terminated list of topic string parts. */
-    const char * topicStringParts[] =
-    {
-        MQTT_API_THINGS,
-        NULL, /* Thing Name not available at compile time, initialized below. */
-        MQTT_API_JOBS,
-        NULL, /* Active Job Name not available at compile time, initialized below. */
-        MQTT_API_UPDATE,
-        NULL
-    };
+    const OtaMqttCache_t * pCache = NULL;
 
     assert( pAgentCtx != NULL );
     /* pMsg is a static buffer of size "OTA_STATUS_MSG_MAX_SIZE". */
     assert( pMsg != NULL );
 
-    /* Build the dynamic job status topic . */
-
-    topicStringParts[ 1 ] = ( const char * ) pAgentCtx->pThingName;
-    topicStringParts[ 3 ] = ( const char * ) pAgentCtx->pActiveJobName;
+    /* The topic is built once per job, status updates of the same job reuse it. */
+    if( jobStatusTopicIsCurrent( pAgentCtx ) == false )
+    {
+        cacheJobStatusTopic( pAgentCtx );
+    }
 
-    topicLen = stringBuilder(
-        pTopicBuffer,
-        sizeof( pTopicBuffer ),
-        topicStringParts );
-
-    /* The buffer is static and the size is calculated to fit. */
-    assert( ( topicLen > 0U ) && ( topicLen < sizeof( pTopicBuffer ) ) );
+    pCache = &( pAgentCtx->mqttCache );
 
     /* Publish the status message. */
     LogDebug( ( "Attempting to publish MQTT status message: "
                 "message=%s",
                 pMsg ) );
 
-    mqttStatus = pAgentCtx->pOtaInterface->mqtt.publish( pTopicBuffer,
-                                                         ( uint16_t ) topicLen,
+    mqttStatus = pAgentCtx->pOtaInterface->mqtt.publish( pCache->pJobStatusTopic,
+                                                         pCache->jobStatusTopicLen,
                                                          &pMsg[ 0 ],
                                                          msgSize,
                                                          qos );
@@ -568,7 +1056,7 @@ static OtaMqttStatus_t publishStatusMessage( OtaAgentContext_t * pAgentCtx,
     {
         LogDebug( ( "Published to MQTT topic: "
                     "topic=%s",
-                    pTopicBuffer ) );
+                    pCache->pJobStatusTopic ) );
     }
     else
     {
@@ -577,7 +1065,147 @@ static OtaMqttStatus_t publishStatusMessage( OtaAgentContext_t * pAgentCtx,
                     "OtaMqttStatus_t=%s"
                     ", topic=%s",
                     OTA_MQTT_strerror( mqttStatus ),
-                    pTopicBuffer ) );
+                    pCache->pJobStatusTopic ) );
+    }
+
+    return mqttStatus;
+}
+
+static void cacheJobStatusTopic( OtaAgentContext_t * pAgentCtx )
+{
+    OtaMqttCache_t * pCache = &( pAgentCtx->mqttCache );
+    size_t topicLen = 0;
+
+    /* NULL-terminated list of topic string parts. */
+    const char * topicStringParts[] =
+    {
+        MQTT_API_THINGS,
+        NULL, /* Thing Name not available at compile time, initialized below. */
+        MQTT_API_JOBS,
+        NULL, /* Active Job Name not available at compile time, initialized below. */
+        MQTT_API_UPDATE,
+        NULL
+    };
+
+    topicStringParts[ 1 ] = ( const char * ) pAgentCtx->pThingName;
+    topicStringParts[ 3 ] = ( const char * ) pAgentCtx->pActiveJobName;
+
+    topicLen = stringBuilder(
+        pCache->pJobStatusTopic,
+        sizeof( pCache->pJobStatusTopic ),
+        topicStringParts );
+
+    /* The buffer size is calculated to fit. */
+    assert( ( topicLen > 0U ) && ( topicLen < sizeof( pCache->pJobStatusTopic ) ) );
+
+    pCache->jobStatusTopicLen = ( uint16_t ) topicLen;
+    pCache->jobNameOffset = ( uint16_t ) ( CONST_STRLEN( MQTT_API_THINGS ) +
+                                           strlen( ( const char * ) pAgentCtx->pThingName ) +
+                                           CONST_STRLEN( MQTT_API_JOBS ) );
+}
+
+static bool jobStatusTopicIsCurrent( const OtaAgentContext_t * pAgentCtx )
+{
+    const OtaMqttCache_t * pCache = &( pAgentCtx->mqttCache );
+    size_t jobNameLen = strlen( ( const char * ) pAgentCtx->pActiveJobName );
+    bool isCurrent = false;
+
+    /* The Thing name only changes with the agent, which clears the cache. */
+    if( ( pCache->jobStatusTopicLen > 0U ) &&
+        ( ( ( size_t ) pCache->jobNameOffset + jobNameLen + CONST_STRLEN( MQTT_API_UPDATE ) ) == pCache->jobStatusTopicLen ) )
+    {
+        isCurrent = ( memcmp( &pCache->pJobStatusTopic[ pCache->jobNameOffset ],
+                              pAgentCtx->pActiveJobName,
+                              jobNameLen ) == 0 );
+    }
+
+    return isCurrent;
+}
+
+static bool cacheStreamRequest( OtaAgentContext_t * pAgentCtx )
+{
+    OtaMqttCache_t * pCache = &( pAgentCtx->mqttCache );
+    const OtaFileContext_t * pFileContext = &( pAgentCtx->fileContext );
+    size_t topicLen = 0;
+    size_t prefixSize = 0;
+    bool encodeRet = false;
+
+    /* NULL-terminated list of topic string parts. */
+    const char * pTopicParts[] =
+    {
+        MQTT_API_THINGS,
+        NULL, /* Thing Name not available at compile time, initialized below. */
+        MQTT_API_STREAMS,
+        NULL, /* Stream Name not available at compile time, initialized below. */
+        MQTT_API_GET_STREAM,
+        NULL
+    };
+
+    pTopicParts[ 1 ] = ( const char * ) pAgentCtx->pThingName;
+    pTopicParts[ 3 ] = ( const char * ) pFileContext->pStreamName;
+
+    topicLen = stringBuilder(
+        pCache->pGetStreamTopic,
+        sizeof( pCache->pGetStreamTopic ),
+        pTopicParts );
+
+    /* The buffer size is calculated to fit. */
+    assert( ( topicLen > 0U ) && ( topicLen < sizeof( pCache->pGetStreamTopic ) ) );
+
+    pCache->getStreamTopicLen = ( uint16_t ) topicLen;
+
+    /* The client token, file ID and block size are the same for every request of the file. */
+    #if ( otaconfigMQTT_JSON_STREAM_PAYLOAD == 1U )
+        encodeStreamRequestPrefixJson( ( char * ) pCache->pStreamRequestPrefix,
+                                       sizeof( pCache->pStreamRequestPrefix ),
+                                       &prefixSize,
+                                       pFileContext->serverFileID,
+                                       OTA_FILE_BLOCK_SIZE );
+        encodeRet = true;
+    #else
+        encodeRet = OTA_CBOR_Encode_GetStreamRequestPrefix( pCache->pStreamRequestPrefix,
+                                                            sizeof( pCache->pStreamRequestPrefix ),
+                                                            &prefixSize,
+                                                            OTA_CLIENT_TOKEN,
+                                                            ( int32_t ) pFileContext->serverFileID,
+                                                            ( int32_t ) OTA_FILE_BLOCK_SIZE );
+    #endif
+
+    pCache->streamRequestPrefixLen = ( encodeRet == true ) ? ( uint16_t ) prefixSize : 0U;
+
+    return encodeRet;
+}
+
+static void syncSubscriptions( OtaAgentContext_t * pAgentCtx )
+{
+    OtaMqttCache_t * pCache = &( pAgentCtx->mqttCache );
+    uint32_t generation = OTA_ATOMIC_LOAD_U32( &pAgentCtx->connectionGeneration );
+
+    /* The broker may have dropped the subscriptions with the connection. */
+    if( generation != pCache->subscriptionGeneration )
+    {
+        pCache->jobTopicsSubscribed = false;
+        pCache->dataStreamTopicLen = 0U;
+        pCache->subscriptionGeneration = generation;
+    }
+}
+
+static OtaMqttStatus_t restoreSubscriptions( OtaAgentContext_t * pAgentCtx )
+{
+    OtaMqttStatus_t mqttStatus = OtaMqttSuccess;
+
+    syncSubscriptions( pAgentCtx );
+
+    /* Job notifications, such as a cancelled job, are also expected during the download. */
+    if( pAgentCtx->mqttCache.jobTopicsSubscribed == false )
+    {
+        mqttStatus = subscribeToJobNotificationTopics( pAgentCtx );
+        pAgentCtx->mqttCache.jobTopicsSubscribed = ( mqttStatus == OtaMqttSuccess );
+    }
+
+    if( ( mqttStatus == OtaMqttSuccess ) && ( pAgentCtx->mqttCache.dataStreamTopicLen == 0U ) )
+    {
+        mqttStatus = subscribeToDataStream( pAgentCtx );
     }
 
     return mqttStatus;
@@ -617,25 +1245,29 @@ static uint32_t buildStatusMessageReceiving( char * pMsgBuffer,
     numBlocks = ( pOTAFileCtx->fileSize + ( OTA_FILE_BLOCK_SIZE - 1U ) ) >> otaconfigLOG2_FILE_BLOCK_SIZE;
     received = numBlocks - pOTAFileCtx->blocksRemaining;
 
-    /* Output a status update once in a while. */
-    if( ( received % otaconfigOTA_UPDATE_STATUS_FREQUENCY ) == 0U )
-    {
-        payloadStringParts[ 0 ] = pOtaJobStatusStrings[ status ];
-        payloadStringParts[ 3 ] = receivedString;
-        payloadStringParts[ 5 ] = numBlocksString;
+    /* The agent decides how often the progress is reported. */
+    payloadStringParts[ 0 ] = pOtaJobStatusStrings[ status ];
+    payloadStringParts[ 3 ] = receivedString;
+    payloadStringParts[ 5 ] = numBlocksString;
+
+    /* stringBuilderUInt32Decimal renders zero as an empty string. */
+    receivedString[ 0 ] = '0';
+    receivedString[ 1 ] = '\0';
 
+    if( received > 0U )
+    {
         ( void ) stringBuilderUInt32Decimal( receivedString, sizeof( receivedString ), received );
-        ( void ) stringBuilderUInt32Decimal( numBlocksString, sizeof( numBlocksString ), received );
+    }
 
+    ( void ) stringBuilderUInt32Decimal( numBlocksString, sizeof( numBlocksString ), numBlocks );
 
-        msgSize = ( uint32_t ) stringBuilder(
-            pMsgBuffer,
-            msgBufferSize,
-            payloadStringParts );
+    msgSize = ( uint32_t ) stringBuilder(
+        pMsgBuffer,
+        msgBufferSize,
+        payloadStringParts );
 
-        /* The buffer is static and the size is calculated to fit. */
-        assert( ( msgSize > 0U ) && ( msgSize < msgBufferSize ) );
-    }
+    /* The buffer is static and the size is calculated to fit. */
+    assert( ( msgSize > 0U ) && ( msgSize < msgBufferSize ) );
 
     return msgSize;
 }
@@ -815,7 +1447,7 @@ OtaErr_t requestJob_Mqtt( OtaAgentContext_t * pAgentCtx )
      * how many requests have been made. */
     char pMsg[ MSG_GET_NEXT_BUFFER_SIZE ];
 
-    static uint32_t reqCounter = 0;
+    uint32_t reqCounter = 0;
     OtaErr_t otaError = OtaErrRequestJobFailed;
     OtaMqttStatus_t mqttStatus = OtaMqttSuccess;
     uint32_t msgSize = 0;
@@ -848,10 +1480,19 @@ OtaErr_t requestJob_Mqtt( OtaAgentContext_t * pAgentCtx )
     pPayloadParts[ 1 ] = reqCounterString;
     pPayloadParts[ 3 ] = ( const char * ) pAgentCtx->pThingName;
 
+    /* Each agent counts its own requests. */
+    reqCounter = pAgentCtx->mqttCache.jobRequestCounter;
     ( void ) stringBuilderUInt32Decimal( reqCounterString, sizeof( reqCounterString ), reqCounter );
 
-    /* Subscribe to the OTA job notification topic. */
-    mqttStatus = subscribeToJobNotificationTopics( pAgentCtx );
+    /* Subscribe to the OTA job notification topic, unless it is already subscribed on this
+     * connection. */
+    syncSubscriptions( pAgentCtx );
+
+    if( pAgentCtx->mqttCache.jobTopicsSubscribed == false )
+    {
+        mqttStatus = subscribeToJobNotificationTopics( pAgentCtx );
+        pAgentCtx->mqttCache.jobTopicsSubscribed = ( mqttStatus == OtaMqttSuccess );
+    }
 
     if( mqttStatus == OtaMqttSuccess )
     {
@@ -865,7 +1506,7 @@ OtaErr_t requestJob_Mqtt( OtaAgentContext_t * pAgentCtx )
         /* The buffer is static and the size is calculated to fit. */
         assert( ( msgSize > 0U ) && ( msgSize < sizeof( pMsg ) ) );
 
-        reqCounter++;
+        pAgentCtx->mqttCache.jobRequestCounter = reqCounter + 1U;
 
         topicLen = ( uint16_t ) stringBuilder(
             pJobTopic,
@@ -971,58 +1612,24 @@ OtaErr_t updateJobStatus_Mqtt( OtaAgentContext_t * pAgentCtx,
 OtaErr_t initFileTransfer_Mqtt( OtaAgentContext_t * pAgentCtx )
 {
     OtaErr_t result = OtaErrInitFileTransferFailed;
-    OtaMqttStatus_t mqttStatus = OtaMqttSuccess;
-
-    /* This buffer is used to store the generated MQTT topic. The static size
-     * is calculated from the template and the corresponding parameters. */
-    static char pRxStreamTopic[ TOPIC_STREAM_DATA_BUFFER_SIZE ]; /*!< Buffer to store the topic generated for requesting data stream. */
-    uint16_t topicLen = 0;
-    const OtaFileContext_t * pFileContext = NULL;
-
-    /* NULL-terminated list of topic string parts. */
-    const char * pTopicParts[] =
-    {
-        MQTT_API_THINGS,
-        NULL, /* Thing Name not available at compile time, initialized below. */
-        MQTT_API_STREAMS,
-        NULL, /* Stream Name not available at compile time, initialized below. */
-        MQTT_API_DATA_CBOR,
-        NULL
-    };
 
     assert( pAgentCtx != NULL );
 
-    pFileContext = &( pAgentCtx->fileContext );
-    pTopicParts[ 1 ] = ( const char * ) pAgentCtx->pThingName;
-    pTopicParts[ 3 ] = ( const char * ) pFileContext->pStreamName;
+    /* Build the topics and the request prefix of the job once, so that block requests and status
+     * updates do not have to. A prefix that fails to encode is reported by the block request. */
+    ( void ) cacheStreamRequest( pAgentCtx );
+    cacheJobStatusTopic( pAgentCtx );
 
-    topicLen = ( uint16_t ) stringBuilder(
-        pRxStreamTopic,
-        sizeof( pRxStreamTopic ),
-        pTopicParts );
-
-    /* The buffer is static and the size is calculated to fit. */
-    assert( ( topicLen > 0U ) && ( topicLen < sizeof( pRxStreamTopic ) ) );
-
-    mqttStatus = pAgentCtx->pOtaInterface->mqtt.subscribe( pRxStreamTopic,
-                                                           topicLen,
-                                                           0 );
-
-    if( mqttStatus == OtaMqttSuccess )
+    /* The cleanup of a closed file unsubscribes from the data stream if the agent unsubscribes on
+     * cleanup. The record of the subscription is then not trusted for the next file. */
+    if( pAgentCtx->unsubscribeOnShutdown != 0U )
     {
-        LogDebug( ( "Subscribed to the OTA data stream topic: "
-                    "topic=%s",
-                    pRxStreamTopic ) );
-        result = OtaErrNone;
+        pAgentCtx->mqttCache.dataStreamTopicLen = 0U;
     }
-    else
+
+    if( subscribeToDataStream( pAgentCtx ) == OtaMqttSuccess )
     {
-        LogError( ( "Failed to subscribe to MQTT topic: "
-                    "subscribe returned error: "
-                    "OtaMqttStatus_t=%s"
-                    ", topic=%s",
-                    OTA_MQTT_strerror( mqttStatus ),
-                    pRxStreamTopic ) );
+        result = OtaErrNone;
     }
 
     return result;
@@ -1036,71 +1643,95 @@ OtaErr_t requestFileBlock_Mqtt( OtaAgentContext_t * pAgentCtx )
     OtaErr_t result = OtaErrRequestFileBlockFailed;
     OtaMqttStatus_t mqttStatus = OtaMqttSuccess;
     size_t msgSizeFromStream = 0;
-    uint32_t blockSize = OTA_FILE_BLOCK_SIZE;
     uint32_t numBlocks = 0;
     uint32_t bitmapLen = 0;
+    uint32_t numBlocksToRequest = otaconfigMAX_NUM_BLOCKS_REQUEST;
     uint32_t msgSizeToPublish = 0;
-    uint32_t topicLen = 0;
-    bool cborEncodeRet = false;
+    bool encodeRet = false;
     char pMsg[ OTA_REQUEST_MSG_MAX_SIZE ];
-
-    /* This buffer is used to store the generated MQTT topic. The static size
-     * is calculated from the template and the corresponding parameters. */
-    char pTopicBuffer[ TOPIC_GET_STREAM_BUFFER_SIZE ];
     const OtaFileContext_t * pFileContext = NULL;
-
-    /* NULL-terminated list of topic string parts. */
-    const char * pTopicParts[] =
-    {
-        MQTT_API_THINGS,
-        NULL, /* Thing Name not available at compile time, initialized below. */
-        MQTT_API_STREAMS,
-        NULL, /* Stream Name not available at compile time, initialized below. */
-        MQTT_API_GET_CBOR,
-        NULL
-    };
+    const OtaMqttCache_t * pCache = NULL;
 
     assert( pAgentCtx != NULL );
 
     /* Get the current file context. */
     pFileContext = &( pAgentCtx->fileContext );
+    pCache = &( pAgentCtx->mqttCache );
 
-    pTopicParts[ 1 ] = ( const char * ) pAgentCtx->pThingName;
-    pTopicParts[ 3 ] = ( const char * ) pFileContext->pStreamName;
+    /* In the endgame of the download, request exactly the missing blocks so that the
+     * last of them ends the request. */
+    if( ( pFileContext->blocksRemaining > 0U ) &&
+        ( pFileContext->blocksRemaining <= otaconfigENDGAME_NUM_BLOCKS ) &&
+        ( pFileContext->blocksRemaining < numBlocksToRequest ) )
+    {
+        numBlocksToRequest = pFileContext->blocksRemaining;
+    }
+
+    /* Right after a gap, only the blocks missing before the last block received
+     * are requested again. The blocks after it are still on their way. */
+    if( ( pAgentCtx->retransmitNumBlocks > 0U ) &&
+        ( pAgentCtx->retransmitNumBlocks < numBlocksToRequest ) )
+    {
+        numBlocksToRequest = pAgentCtx->retransmitNumBlocks;
+    }
 
     /* Reset number of blocks requested. */
-    pAgentCtx->numOfBlocksToReceive = otaconfigMAX_NUM_BLOCKS_REQUEST;
+    pAgentCtx->numOfBlocksToReceive = numBlocksToRequest;
 
     numBlocks = ( pFileContext->fileSize + ( OTA_FILE_BLOCK_SIZE - 1U ) ) >> otaconfigLOG2_FILE_BLOCK_SIZE;
     bitmapLen = ( numBlocks + ( BITS_PER_BYTE - 1U ) ) >> LOG2_BITS_PER_BYTE;
 
-    cborEncodeRet = OTA_CBOR_Encode_GetStreamRequestMessage( ( uint8_t * ) pMsg,
-                                                             sizeof( pMsg ),
-                                                             &msgSizeFromStream,
-                                                             OTA_CLIENT_TOKEN,
-                                                             ( int32_t ) pFileContext->serverFileID,
-                                                             ( int32_t ) blockSize,
-                                                             0,
-                                                             pFileContext->pRxBlockBitmap,
-                                                             bitmapLen,
-                                                             ( int32_t ) otaconfigMAX_NUM_BLOCKS_REQUEST );
-
-    if( cborEncodeRet == true )
+    /* The topic and the prefix are normally built when the file transfer is initialized. */
+    if( ( pCache->getStreamTopicLen > 0U ) && ( pCache->streamRequestPrefixLen > 0U ) )
     {
-        msgSizeToPublish = ( uint32_t ) msgSizeFromStream;
+        encodeRet = true;
+    }
+    else
+    {
+        encodeRet = cacheStreamRequest( pAgentCtx );
+    }
 
-        /* Try to build the dynamic data REQUEST topic to publish to. */
+    /* Only the block bitmap and count change from one request to the next. */
+    if( encodeRet == true )
+    {
+        ( void ) memcpy( pMsg, pCache->pStreamRequestPrefix, pCache->streamRequestPrefixLen );
+
+        #if ( otaconfigMQTT_JSON_STREAM_PAYLOAD == 1U )
+            encodeRet = encodeStreamRequestBlocksJson( pMsg,
+                                                       sizeof( pMsg ),
+                                                       pCache->streamRequestPrefixLen,
+                                                       &msgSizeFromStream,
+                                                       pFileContext->pRxBlockBitmap,
+                                                       bitmapLen,
+                                                       numBlocksToRequest );
+        #else
+            encodeRet = OTA_CBOR_Encode_GetStreamRequestBlocks( ( uint8_t * ) pMsg,
+                                                                sizeof( pMsg ),
+                                                                pCache->streamRequestPrefixLen,
+                                                                &msgSizeFromStream,
+                                                                0,
+                                                                pFileContext->pRxBlockBitmap,
+                                                                bitmapLen,
+                                                                ( int32_t ) numBlocksToRequest );
+        #endif
+    }
 
-        topicLen = ( uint32_t ) stringBuilder(
-            pTopicBuffer,
-            sizeof( pTopicBuffer ),
-            pTopicParts );
+    /* The blocks could not be received on topics that were lost with the connection. */
+    mqttStatus = restoreSubscriptions( pAgentCtx );
 
-        /* The buffer is static and the size is calculated to fit. */
-        assert( ( topicLen > 0U ) && ( topicLen < sizeof( pTopicBuffer ) ) );
+    if( mqttStatus != OtaMqttSuccess )
+    {
+        LogError( ( "Failed to request file blocks: "
+                    "Subscriptions could not be restored: "
+                    "OtaMqttStatus_t=%s",
+                    OTA_MQTT_strerror( mqttStatus ) ) );
+    }
+    else if( encodeRet == true )
+    {
+        msgSizeToPublish = ( uint32_t ) msgSizeFromStream;
 
-        mqttStatus = pAgentCtx->pOtaInterface->mqtt.publish( pTopicBuffer,
-                                                             ( uint16_t ) topicLen,
+        mqttStatus = pAgentCtx->pOtaInterface->mqtt.publish( pCache->pGetStreamTopic,
+                                                             pCache->getStreamTopicLen,
                                                              &pMsg[ 0 ],
                                                              msgSizeToPublish,
                                                              0 );
@@ -1109,7 +1740,7 @@ OtaErr_t requestFileBlock_Mqtt( OtaAgentContext_t * pAgentCtx )
         {
             LogInfo( ( "Published to MQTT topic to request the next block: "
                        "topic=%s",
-                       pTopicBuffer ) );
+                       pCache->pGetStreamTopic ) );
             result = OtaErrNone;
         }
         else
@@ -1122,9 +1753,11 @@ OtaErr_t requestFileBlock_Mqtt( OtaAgentContext_t * pAgentCtx )
     }
     else
     {
-        result = OtaErrFailedToEncodeCbor;
-        LogError( ( "Failed to CBOR encode stream request message: "
-                    "OTA_CBOR_Encode_GetStreamRequestMessage returned error." ) );
+        /* A JSON request that could not be encoded is reported as a failed request. */
+        #if ( otaconfigMQTT_JSON_STREAM_PAYLOAD != 1U )
+            result = OtaErrFailedToEncodeCbor;
+        #endif
+        LogError( ( "Failed to encode stream request message." ) );
     }
 
     return result;
@@ -1133,7 +1766,8 @@ OtaErr_t requestFileBlock_Mqtt( OtaAgentContext_t * pAgentCtx )
 /*
  * Decode a cbor encoded fileblock received from streaming service.
  */
-OtaErr_t decodeFileBlock_Mqtt( const uint8_t * pMessageBuffer,
+OtaErr_t decodeFileBlock_Mqtt( OtaAgentContext_t * pAgentCtx,
+                               const uint8_t * pMessageBuffer,
                                size_t messageSize,
                                int32_t * pFileId,
                                int32_t * pBlockId,
@@ -1144,6 +1778,8 @@ OtaErr_t decodeFileBlock_Mqtt( const uint8_t * pMessageBuffer,
     OtaErr_t result = OtaErrFailedToDecodeCbor;
     bool cborDecodeRet = false;
 
+    ( void ) pAgentCtx;
+
     /* Decode the CBOR content. */
     cborDecodeRet = OTA_CBOR_Decode_GetStreamResponseMessage( pMessageBuffer,
                                                               messageSize,
@@ -1169,6 +1805,156 @@ OtaErr_t decodeFileBlock_Mqtt( const uint8_t * pMessageBuffer,
     return result;
 }
 
+/*
+ * Decode a JSON encoded fileblock received from streaming service.
+ */
+OtaErr_t decodeFileBlockJson_Mqtt( OtaAgentContext_t * pAgentCtx,
+                                   const uint8_t * pMessageBuffer,
+                                   size_t messageSize,
+                                   int32_t * pFileId,
+                                   int32_t * pBlockId,
+                                   int32_t * pBlockSize,
+                                   uint8_t ** pPayload,
+                                   size_t * pPayloadSize )
+{
+    OtaErr_t result = OtaErrFailedToDecodeJson;
+    const char * pJson = ( const char * ) pMessageBuffer;
+    size_t index = 0;
+    size_t keyStart = 0;
+    size_t valueStart = 0;
+    uint32_t value = 0;
+    uint32_t key = 0;
+    uint32_t keysFound = 0;
+    int32_t * pTarget = NULL;
+    bool valid = false;
+    bool done = false;
+
+    ( void ) pAgentCtx;
+
+    assert( ( pMessageBuffer != NULL ) && ( pFileId != NULL ) && ( pBlockId != NULL ) &&
+            ( pBlockSize != NULL ) && ( pPayload != NULL ) && ( *pPayload != NULL ) &&
+            ( pPayloadSize != NULL ) );
+
+    index = skipJsonWhitespace( pJson, index, messageSize );
+    valid = ( index < messageSize ) && ( pJson[ index ] == '{' );
+    index++;
+
+    /* A single pass over the members of a flat object. Block fields are
+     * stored as they are found and the payload is decoded straight into the
+     * caller's buffer. */
+    while( ( valid == true ) && ( done == false ) )
+    {
+        /* Key. Escaped keys are never used by the streaming service, so an
+         * escaped key is never a block field. */
+        index = skipJsonWhitespace( pJson, index, messageSize );
+        valid = ( index < messageSize ) && ( pJson[ index ] == '"' );
+        index++;
+        keyStart = index;
+        index = skipJsonString( pJson, index, messageSize );
+        valid = ( valid == true ) && ( index < messageSize ) && ( pJson[ index ] == '"' );
+        key = ( ( index - keyStart ) == 1U ) ? jsonStreamKey( pJson[ keyStart ] ) : 0U;
+        index++;
+
+        /* A block field may only appear once. */
+        valid = ( valid == true ) && ( ( keysFound & key ) == 0U );
+        keysFound |= key;
+
+        if( valid == true )
+        {
+            index = skipJsonWhitespace( pJson, index, messageSize );
+            valid = ( index < messageSize ) && ( pJson[ index ] == ':' );
+            index = skipJsonWhitespace( pJson, index + 1U, messageSize );
+            valid = ( valid == true ) && ( index < messageSize );
+        }
+
+        if( valid == true )
+        {
+            pTarget = ( key == JSON_STREAM_KEY_FILE_ID ) ? pFileId :
+                      ( key == JSON_STREAM_KEY_BLOCK_ID ) ? pBlockId :
+                      ( key == JSON_STREAM_KEY_BLOCK_SIZE ) ? pBlockSize : NULL;
+
+            if( pTarget != NULL )
+            {
+                /* Block fields are non-negative and never exceed 31 bits. */
+                value = 0;
+                valueStart = index;
+
+                while( ( valid == true ) && ( index < messageSize ) &&
+                       ( pJson[ index ] >= '0' ) && ( pJson[ index ] <= '9' ) )
+                {
+                    valid = ( value <= ( ( ( uint32_t ) INT32_MAX - 9U ) / 10U ) );
+                    value = ( value * 10U ) + ( uint32_t ) ( pJson[ index ] - '0' );
+                    index++;
+                }
+
+                valid = ( valid == true ) && ( index > valueStart );
+                *pTarget = ( int32_t ) value;
+            }
+            else if( pJson[ index ] == '"' )
+            {
+                valueStart = index + 1U;
+                index = skipJsonString( pJson, valueStart, messageSize );
+                valid = ( index < messageSize ) && ( pJson[ index ] == '"' );
+
+                if( ( valid == true ) && ( key == JSON_STREAM_KEY_PAYLOAD ) &&
+                    ( memchr( &pJson[ valueStart ], ( int ) '\\', index - valueStart ) != NULL ) )
+                {
+                    /* Some serializers escape the slashes of the Base64 text. */
+                    valid = decodeEscapedJsonBase64( pJson, valueStart, index, *pPayload, pPayloadSize );
+                }
+                else if( ( valid == true ) && ( key == JSON_STREAM_KEY_PAYLOAD ) )
+                {
+                    valid = ( base64Decode( *pPayload,
+                                            *pPayloadSize,
+                                            pPayloadSize,
+                                            ( const uint8_t * ) &pJson[ valueStart ],
+                                            index - valueStart ) == Base64Success );
+                }
+                else
+                {
+                    /* Not the payload, or not a valid string. */
+                }
+
+                index++;
+            }
+            else
+            {
+                /* The payload must be a string. Other members may be any
+                 * scalar, nested values are not part of a block. */
+                valid = ( key != JSON_STREAM_KEY_PAYLOAD );
+
+                while( ( index < messageSize ) && ( pJson[ index ] != ',' ) && ( pJson[ index ] != '}' ) &&
+                       ( pJson[ index ] != '{' ) && ( pJson[ index ] != '[' ) && ( pJson[ index ] != '"' ) )
+                {
+                    index++;
+                }
+            }
+        }
+
+        if( valid == true )
+        {
+            index = skipJsonWhitespace( pJson, index, messageSize );
+            valid = ( index < messageSize ) && ( ( pJson[ index ] == ',' ) || ( pJson[ index ] == '}' ) );
+            done = ( valid == true ) && ( pJson[ index ] == '}' );
+            index++;
+        }
+    }
+
+    if( ( valid == true ) && ( keysFound == JSON_STREAM_KEYS_ALL ) )
+    {
+        result = OtaErrNone;
+    }
+    else
+    {
+        LogError( ( "Failed to decode MQTT file block: "
+                    "Invalid JSON stream response: "
+                    "keysFound=0x%x",
+                    ( unsigned int ) keysFound ) );
+    }
+
+    return result;
+}
+
 /*
  * Perform any cleanup operations required for control plane.
  */
@@ -1179,7 +1965,10 @@ OtaErr_t cleanupControl_Mqtt( const OtaAgentContext_t * pAgentCtx )
 
     assert( pAgentCtx != NULL );
 
-    if( pAgentCtx->unsubscribeOnShutdown != 0U )
+    /* Only unsubscribe from topics the agent is subscribed to. The control plane is only cleaned
+     * up when the agent shuts down, and OTA_Init clears the records before the agent runs again. */
+    if( ( pAgentCtx->unsubscribeOnShutdown != 0U ) &&
+        ( pAgentCtx->mqttCache.jobTopicsSubscribed == true ) )
     {
         /* Unsubscribe from job notification topics. */
         mqttStatus = unsubscribeFromJobNotificationTopic( pAgentCtx );
@@ -1207,7 +1996,9 @@ OtaErr_t cleanupData_Mqtt( const OtaAgentContext_t * pAgentCtx )
 
     assert( pAgentCtx != NULL );
 
-    if( pAgentCtx->unsubscribeOnShutdown != 0U )
+    /* Skip the unsubscribe if no data stream was subscribed since the agent started. */
+    if( ( pAgentCtx->unsubscribeOnShutdown != 0U ) &&
+        ( pAgentCtx->mqttCache.dataStreamTopicLen != 0U ) )
     {
         /* Unsubscribe from data stream topics. */
         mqttStatus = unsubscribeFromDataStream( pAgentCtx );
@@ -28,8 +28,10 @@
 
 /* FreeRTOS includes. */
 #include "FreeRTOS.h"
+#include "task.h"
 #include "timers.h"
 #include "queue.h"
+#include "semphr.h"
 
 /* OTA OS POSIX Interface Includes.*/
 #include "ota_os_freertos.h"
@@ -51,16 +53,24 @@ static StaticQueue_t staticQueue;
 /* The queue control handle.  .*/
 static QueueHandle_t otaEventQueue;
 
-/* OTA App Timer callback.*/
-static OtaTimerCallback_t otaTimerCallback;
+/* The semaphore control structure for the shutdown signal.*/
+static StaticSemaphore_t staticShutdownSemaphore;
 
-/* OTA Timer handles.*/
-static TimerHandle_t otaTimer[ OtaNumOfTimers ];
+/* The shutdown signal, given once the OTA agent has shut down.*/
+static SemaphoreHandle_t otaShutdownSemaphore;
 
-/* OTA Timer callbacks.*/
-static void requestTimerCallback( TimerHandle_t T );
-static void selfTestTimerCallback( TimerHandle_t T );
-void ( * timerCallback[ OtaNumOfTimers ] )( TimerHandle_t T ) = { requestTimerCallback, selfTestTimerCallback };
+/* OTA Timers of the agents that do not provide a timer context.*/
+static OtaTimerContext_t otaDefaultTimerContext;
+
+/* OTA Timeout in ticks, at least one tick for any timeout.*/
+static TickType_t msToTicks( uint32_t timeoutMs );
+
+/* OTA Timer callback, run by the FreeRTOS timer service task.*/
+static void timerCallback( TimerHandle_t T );
+
+/* OTA Timer of the given ID in a timer context.*/
+static OtaFreeRTOSTimer_t * otaTimer( OtaTimerContext_t * pTimerCtx,
+                                      OtaTimerId_t otaTimerId );
 
 OtaOsStatus_t OtaInitEvent_FreeRTOS( OtaEventContext_t * pEventCtx )
 {
@@ -84,6 +94,9 @@ OtaOsStatus_t OtaInitEvent_FreeRTOS( OtaEventContext_t * pEventCtx )
     }
     else
     {
+        /* Recreate the shutdown signal so it is not set until the agent shuts down again.*/
+        otaShutdownSemaphore = xSemaphoreCreateBinaryStatic( &staticShutdownSemaphore );
+
         LogDebug( ( "OTA Event Queue created." ) );
     }
 
@@ -131,9 +144,9 @@ OtaOsStatus_t OtaReceiveEvent_FreeRTOS( OtaEventContext_t * pEventCtx,
     uint8_t buff[ sizeof( OtaEventMsg_t ) ];
 
     ( void ) pEventCtx;
-    ( void ) timeout;
 
-    retVal = xQueueReceive( otaEventQueue, &buff, portMAX_DELAY );
+    /* A zero timeout blocks until an event is received.*/
+    retVal = xQueueReceive( otaEventQueue, &buff, ( timeout == 0U ) ? portMAX_DELAY : msToTicks( timeout ) );
 
     if( retVal == pdTRUE )
     {
@@ -141,6 +154,12 @@ OtaOsStatus_t OtaReceiveEvent_FreeRTOS( OtaEventContext_t * pEventCtx,
         memcpy( pEventMsg, buff, MAX_MSG_SIZE );
         LogDebug( ( "OTA Event received" ) );
     }
+    else if( timeout != 0U )
+    {
+        otaOsStatus = OtaOsEventQueueReceiveTimeout;
+
+        LogDebug( ( "No OTA Event received within %u ms.", ( unsigned int ) timeout ) );
+    }
     else
     {
         otaOsStatus = OtaOsEventQueueReceiveFailed;
@@ -171,63 +190,115 @@ OtaOsStatus_t OtaDeinitEvent_FreeRTOS( OtaEventContext_t * pEventCtx )
     return otaOsStatus;
 }
 
-static void selfTestTimerCallback( TimerHandle_t T )
+OtaOsStatus_t OtaSignalShutdown_FreeRTOS( OtaEventContext_t * pEventCtx )
 {
-    ( void ) T;
+    ( void ) pEventCtx;
 
-    LogDebug( ( "Self-test expired within %ums\r\n",
-                otaconfigSELF_TEST_RESPONSE_WAIT_MS ) );
+    ( void ) xSemaphoreGive( otaShutdownSemaphore );
 
-    if( otaTimerCallback != NULL )
+    LogDebug( ( "OTA Agent shutdown signaled." ) );
+
+    return OtaOsSuccess;
+}
+
+OtaOsStatus_t OtaWaitShutdown_FreeRTOS( OtaEventContext_t * pEventCtx,
+                                        uint32_t timeout )
+{
+    OtaOsStatus_t otaOsStatus = OtaOsSuccess;
+
+    ( void ) pEventCtx;
+
+    if( xSemaphoreTake( otaShutdownSemaphore, msToTicks( timeout ) ) == pdTRUE )
     {
-        otaTimerCallback( OtaSelfTestTimer );
+        /* Leave the signal set for any other waiting task.*/
+        ( void ) xSemaphoreGive( otaShutdownSemaphore );
     }
     else
     {
-        LogWarn( ( "Self-test timer event unhandled.\r\n" ) );
+        otaOsStatus = OtaOsShutdownWaitFailed;
+
+        LogError( ( "Failed to wait for the OTA Agent to shut down: "
+                    "xSemaphoreTake returned error: "
+                    "OtaOsStatus_t=%i ",
+                    otaOsStatus ) );
     }
+
+    return otaOsStatus;
+}
+
+static TickType_t msToTicks( uint32_t timeoutMs )
+{
+    TickType_t ticks = pdMS_TO_TICKS( timeoutMs );
+
+    /* pdMS_TO_TICKS rounds down, to zero for timeouts shorter than a tick. A zero
+     * tick wait would not block at all and timers need a period of at least one. */
+    if( ticks == 0U )
+    {
+        ticks = 1U;
+    }
+
+    return ticks;
 }
 
-static void requestTimerCallback( TimerHandle_t T )
+static void timerCallback( TimerHandle_t T )
 {
-    ( void ) T;
+    /* The FreeRTOS timer ID points to the OTA timer that owns the handle. */
+    OtaFreeRTOSTimer_t * pTimer = ( OtaFreeRTOSTimer_t * ) pvTimerGetTimerID( T );
 
-    LogDebug( ( "Request timer expired in %ums \r\n",
-                otaconfigFILE_REQUEST_WAIT_MS ) );
+    LogDebug( ( "OTA Timer expired for Timerid=%i.", pTimer->timerId ) );
 
-    if( otaTimerCallback != NULL )
+    if( pTimer->callback != NULL )
     {
-        otaTimerCallback( OtaRequestTimer );
+        pTimer->callback( pTimer->timerId, pTimer->pCallbackContext );
     }
     else
     {
-        LogWarn( ( "Request timer event unhandled.\r\n" ) );
+        LogWarn( ( "OTA Timer event unhandled for Timerid=%i.", pTimer->timerId ) );
     }
 }
 
-OtaOsStatus_t OtaStartTimer_FreeRTOS( OtaTimerId_t otaTimerId,
+static OtaFreeRTOSTimer_t * otaTimer( OtaTimerContext_t * pTimerCtx,
+                                      OtaTimerId_t otaTimerId )
+{
+    OtaTimerContext_t * pContext = ( pTimerCtx != NULL ) ? pTimerCtx : &otaDefaultTimerContext;
+
+    return &pContext->timers[ otaTimerId ];
+}
+
+OtaOsStatus_t OtaStartTimer_FreeRTOS( OtaTimerContext_t * pTimerCtx,
+                                      OtaTimerId_t otaTimerId,
                                       const char * const pTimerName,
                                       const uint32_t timeout,
-                                      OtaTimerCallback_t callback )
+                                      OtaTimerCallback_t callback,
+                                      void * pCallbackContext )
 {
     OtaOsStatus_t otaOsStatus = OtaOsSuccess;
     BaseType_t retVal = pdFALSE;
+    OtaFreeRTOSTimer_t * pTimer = NULL;
+    TickType_t period = msToTicks( timeout );
 
     configASSERT( callback != NULL );
     configASSERT( pTimerName != NULL );
     configASSERT( ( otaTimerId >= OtaRequestTimer ) && ( otaTimerId < OtaNumOfTimers ) );
 
+    pTimer = otaTimer( pTimerCtx, otaTimerId );
+
+    /* Set OTA lib callback. */
+    pTimer->callback = callback;
+    pTimer->pCallbackContext = pCallbackContext;
+    pTimer->timerId = otaTimerId;
+
     /* If timer is not created.*/
-    if( otaTimer[ otaTimerId ] == NULL )
+    if( pTimer->timer == NULL )
     {
         /* Create the timer. */
-        otaTimer[ otaTimerId ] = xTimerCreate( pTimerName,
-                                               pdMS_TO_TICKS( timeout ),
-                                               pdFALSE,
-                                               NULL,
-                                               timerCallback[ otaTimerId ] );
+        pTimer->timer = xTimerCreate( pTimerName,
+                                      period,
+                                      pdFALSE,
+                                      pTimer,
+                                      timerCallback );
 
-        if( otaTimer[ otaTimerId ] == NULL )
+        if( pTimer->timer == NULL )
         {
             otaOsStatus = OtaOsTimerCreateFailed;
 
@@ -241,7 +312,7 @@ OtaOsStatus_t OtaStartTimer_FreeRTOS( OtaTimerId_t otaTimerId,
             LogDebug( ( "OTA Timer created." ) );
 
             /* Start the timer. */
-            retVal = xTimerStart( otaTimer[ otaTimerId ], portMAX_DELAY );
+            retVal = xTimerStart( pTimer->timer, portMAX_DELAY );
 
             if( retVal == pdTRUE )
             {
@@ -258,8 +329,8 @@ OtaOsStatus_t OtaStartTimer_FreeRTOS( OtaTimerId_t otaTimerId,
     }
     else
     {
-        /* Reset the timer. */
-        retVal = xTimerReset( otaTimer[ otaTimerId ], portMAX_DELAY );
+        /* Restart the timer with the new timeout. */
+        retVal = xTimerChangePeriod( pTimer->timer, period, portMAX_DELAY );
 
         if( retVal == pdTRUE )
         {
@@ -279,17 +350,21 @@ OtaOsStatus_t OtaStartTimer_FreeRTOS( OtaTimerId_t otaTimerId,
     return otaOsStatus;
 }
 
-OtaOsStatus_t OtaStopTimer_FreeRTOS( OtaTimerId_t otaTimerId )
+OtaOsStatus_t OtaStopTimer_FreeRTOS( OtaTimerContext_t * pTimerCtx,
+                                     OtaTimerId_t otaTimerId )
 {
     OtaOsStatus_t otaOsStatus = OtaOsSuccess;
     BaseType_t retVal = pdFALSE;
+    OtaFreeRTOSTimer_t * pTimer = NULL;
 
     configASSERT( ( otaTimerId >= OtaRequestTimer ) && ( otaTimerId < OtaNumOfTimers ) );
 
-    if( otaTimer[ otaTimerId ] != NULL )
+    pTimer = otaTimer( pTimerCtx, otaTimerId );
+
+    if( pTimer->timer != NULL )
     {
         /* Stop the timer. */
-        retVal = xTimerStop( otaTimer[ otaTimerId ], portMAX_DELAY );
+        retVal = xTimerStop( pTimer->timer, portMAX_DELAY );
 
         if( retVal == pdTRUE )
         {
@@ -313,21 +388,25 @@ OtaOsStatus_t OtaStopTimer_FreeRTOS( OtaTimerId_t otaTimerId )
     return otaOsStatus;
 }
 
-OtaOsStatus_t OtaDeleteTimer_FreeRTOS( OtaTimerId_t otaTimerId )
+OtaOsStatus_t OtaDeleteTimer_FreeRTOS( OtaTimerContext_t * pTimerCtx,
+                                       OtaTimerId_t otaTimerId )
 {
     OtaOsStatus_t otaOsStatus = OtaOsSuccess;
     BaseType_t retVal = pdFALSE;
+    OtaFreeRTOSTimer_t * pTimer = NULL;
 
     configASSERT( ( otaTimerId >= OtaRequestTimer ) && ( otaTimerId < OtaNumOfTimers ) );
 
-    if( otaTimer[ otaTimerId ] != NULL )
+    pTimer = otaTimer( pTimerCtx, otaTimerId );
+
+    if( pTimer->timer != NULL )
     {
         /* Delete the timer. */
-        retVal = xTimerDelete( otaTimer[ otaTimerId ], portMAX_DELAY );
+        retVal = xTimerDelete( pTimer->timer, portMAX_DELAY );
 
         if( retVal == pdTRUE )
         {
-            otaTimer[ otaTimerId ] = NULL;
+            pTimer->timer = NULL;
             LogDebug( ( "OTA Timer deleted." ) );
         }
         else
@@ -350,6 +429,12 @@ OtaOsStatus_t OtaDeleteTimer_FreeRTOS( OtaTimerId_t otaTimerId )
     return otaOsStatus;
 }
 
+uint32_t OtaGetTimeMs_FreeRTOS( void )
+{
+    /* portTICK_PERIOD_MS is zero for tick rates above 1000 Hz, so scale by the rate instead. */
+    return ( uint32_t ) ( ( ( uint64_t ) xTaskGetTickCount() * 1000U ) / ( uint64_t ) configTICK_RATE_HZ );
+}
+
 void * Malloc_FreeRTOS( size_t size )
 {
     return pvPortMalloc( size );
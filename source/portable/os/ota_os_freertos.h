@@ -32,9 +32,31 @@
 /* Standard library include. */
 #include <stdint.h>
 
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "timers.h"
+
 /* OTA library interface include. */
 #include "ota_os_interface.h"
 
+/* OTA Timer, a FreeRTOS software timer with its OTA callback.*/
+typedef struct OtaFreeRTOSTimer
+{
+    TimerHandle_t timer;         /* FreeRTOS timer handle, NULL until the timer is first started. */
+    OtaTimerCallback_t callback; /* Callback invoked when the timer expires. */
+    void * pCallbackContext;     /* Context passed to the callback. */
+    OtaTimerId_t timerId;        /* Timer ID passed to the callback. */
+} OtaFreeRTOSTimer_t;
+
+/**
+ * @brief The timers of one OTA agent. Must be zero-initialized before first use. A NULL
+ * timer context selects a default one shared by all agents that do not set their own.
+ */
+struct OtaTimerContext
+{
+    OtaFreeRTOSTimer_t timers[ OtaNumOfTimers ]; /* One timer per timer ID. */
+};
+
 /**
  * @brief Initialize the OTA events.
  *
@@ -72,9 +94,12 @@ OtaOsStatus_t OtaSendEvent_FreeRTOS( OtaEventContext_t * pEventCtx,
  *
  * @param[pEventMsg]     Pointer to store message.
  *
- * @param[timeout]       The maximum amount of time the task should block.
+ * @param[timeout]       The maximum amount of time (msec) the task should block.
+ *                       Zero blocks until an event is received.
  *
- * @return               OtaOsStatus_t, OtaOsSuccess if success , other error code on failure.
+ * @return               OtaOsStatus_t, OtaOsSuccess if success,
+ *                       OtaOsEventQueueReceiveTimeout if the timeout expired first,
+ *                       other error code on failure.
  */
 OtaOsStatus_t OtaReceiveEvent_FreeRTOS( OtaEventContext_t * pEventCtx,
                                         void * pEventMsg,
@@ -92,48 +117,95 @@ OtaOsStatus_t OtaReceiveEvent_FreeRTOS( OtaEventContext_t * pEventCtx,
  */
 OtaOsStatus_t OtaDeinitEvent_FreeRTOS( OtaEventContext_t * pEventCtx );
 
+/**
+ * @brief Signal that the OTA agent has shut down.
+ *
+ * This function gives a binary semaphore that stays set until
+ * OtaInitEvent_FreeRTOS is called again.
+ *
+ * @param[pEventCtx]     Pointer to the OTA event context.
+ *
+ * @return               OtaOsStatus_t, OtaOsSuccess if success , other error code on failure.
+ */
+OtaOsStatus_t OtaSignalShutdown_FreeRTOS( OtaEventContext_t * pEventCtx );
+
+/**
+ * @brief Wait for the OTA agent to shut down.
+ *
+ * @param[pEventCtx]     Pointer to the OTA event context.
+ *
+ * @param[timeout]       The maximum amount of time (msec) the task should block.
+ *
+ * @return               OtaOsStatus_t, OtaOsSuccess if the agent has shut down,
+ *                       OtaOsShutdownWaitFailed if the timeout expired first.
+ */
+OtaOsStatus_t OtaWaitShutdown_FreeRTOS( OtaEventContext_t * pEventCtx,
+                                        uint32_t timeout );
+
 
 /**
  * @brief Start timer.
  *
  * This function starts the timer or resets it if it is already started on FreeRTOS platforms.
+ * Callbacks are invoked from the FreeRTOS timer service task.
+ *
+ * @param[pTimerCtx]        Pointer to the OTA timer context.
  *
  * @param[otaTimerId]       Timer ID of type otaTimerId_t.
  *
  * @param[pTimerName]       Timer name.
  *
- * @param[timeout]          Timeout for the timer.
+ * @param[timeout]          Timeout for the timer in milliseconds.
  *
  * @param[callback]         Callback to be called when timer expires.
  *
+ * @param[pCallbackContext] Context pointer to pass to the callback.
+ *
  * @return                  OtaOsStatus_t, OtaOsSuccess if success , other error code on failure.
  */
-OtaOsStatus_t OtaStartTimer_FreeRTOS( OtaTimerId_t otaTimerId,
+OtaOsStatus_t OtaStartTimer_FreeRTOS( OtaTimerContext_t * pTimerCtx,
+                                      OtaTimerId_t otaTimerId,
                                       const char * const pTimerName,
                                       const uint32_t timeout,
-                                      OtaTimerCallback_t callback );
+                                      OtaTimerCallback_t callback,
+                                      void * pCallbackContext );
 
 /**
  * @brief Stop timer.
  *
  * This function stops the timer on FreeRTOS platforms.
  *
+ * @param[pTimerCtx]      Pointer to the OTA timer context.
+ *
  * @param[otaTimerId]     Timer ID of type otaTimerId_t.
  *
  * @return                OtaOsStatus_t, OtaOsSuccess if success , other error code on failure.
  */
-OtaOsStatus_t OtaStopTimer_FreeRTOS( OtaTimerId_t otaTimerId );
+OtaOsStatus_t OtaStopTimer_FreeRTOS( OtaTimerContext_t * pTimerCtx,
+                                     OtaTimerId_t otaTimerId );
 
 /**
  * @brief Delete a timer.
  *
  * This function deletes a timer for POSIX platforms.
  *
+ * @param[pTimerCtx]        Pointer to the OTA timer context.
+ *
  * @param[otaTimerId]       Timer ID of type otaTimerId_t.
  *
  * @return                  OtaOsStatus_t, OtaOsSuccess if success , other error code on failure.
  */
-OtaOsStatus_t OtaDeleteTimer_FreeRTOS( OtaTimerId_t otaTimerId );
+OtaOsStatus_t OtaDeleteTimer_FreeRTOS( OtaTimerContext_t * pTimerCtx,
+                                       OtaTimerId_t otaTimerId );
+
+/**
+ * @brief Get the current time.
+ *
+ * This function returns the time in milliseconds since the FreeRTOS scheduler started.
+ *
+ * @return                  Current time in milliseconds.
+ */
+uint32_t OtaGetTimeMs_FreeRTOS( void );
 
 /**
  * @brief Allocate memory.
@@ -26,20 +26,17 @@
  */
 
 /* Standard Includes.*/
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
-
-/* MISRA rule 21.5 prohibits the use of signal.h because of undefined behavior. However, this
- * implementation is on POSIX, which has well defined behavior. We're using the timer functionality
- * from POSIX so we deviate from this rule. */
-/* coverity[misra_c_2012_rule_21_5_violation] */
-#include <signal.h>
 #include <errno.h>
 
 /* Posix includes. */
 #include <sys/types.h>
+#include <unistd.h>
 #include <mqueue.h>
+#include <pthread.h>
 
 /* OTA OS POSIX Interface Includes.*/
 #include "ota_os_posix.h"
@@ -52,30 +49,78 @@
 #define MAX_MESSAGES      10
 #define MAX_MSG_SIZE      sizeof( OtaEventMsg_t )
 
-static void requestTimerCallback( union sigval arg );
-static void selfTestTimerCallback( union sigval arg );
+/* OTA Event ring index mask.*/
+#define OTA_EVENT_RING_MASK     ( OTA_EVENT_RING_SIZE - 1U )
 
-static OtaTimerCallback_t otaTimerCallback;
+/* The ring positions wrap around the lanes with a mask. */
+#if ( ( OTA_EVENT_RING_SIZE == 0U ) || ( ( OTA_EVENT_RING_SIZE & OTA_EVENT_RING_MASK ) != 0U ) )
+    #error "OTA_EVENT_RING_SIZE must be a power of two."
+#endif
 
-/* OTA Event queue attributes.*/
-static mqd_t otaEventQueue;
+/* OTA Timer wheel slot mask.*/
+#define OTA_TIMER_WHEEL_MASK    ( OTA_TIMER_WHEEL_SIZE - 1U )
 
-/* OTA Timer handles.*/
-static timer_t otaTimers[ OtaNumOfTimers ];
-static timer_t * pOtaTimers[ OtaNumOfTimers ] = { 0 };
+/* The wheel ticks wrap around the slots with a mask. */
+#if ( ( OTA_TIMER_WHEEL_SIZE == 0U ) || ( ( OTA_TIMER_WHEEL_SIZE & OTA_TIMER_WHEEL_MASK ) != 0U ) )
+    #error "OTA_TIMER_WHEEL_SIZE must be a power of two."
+#endif
 
-/* OTA Timer callbacks.*/
-static void ( * timerCallback[ OtaNumOfTimers ] )( union sigval arg ) = { requestTimerCallback, selfTestTimerCallback };
+/* OTA Timer wheel, shared by the timers of all OTA agents in the process.*/
+typedef struct OtaTimerWheel
+{
+    OtaWheelTimer_t * slots[ OTA_TIMER_WHEEL_SIZE ]; /* Running timers, hashed by expiry tick. */
+    uint64_t currentTick;                            /* Last tick processed by the service thread. */
+    uint32_t armedCount;                             /* Number of timers on the wheel. */
+    bool running;                                    /* Whether the service thread was started. */
+    pthread_mutex_t lock;                            /* Protects the wheel and the timers on it. */
+    pthread_cond_t wakeup;                           /* Signaled when the first timer is put on the wheel. */
+} OtaTimerWheel_t;
+
+static OtaEventContext_t * eventContext( OtaEventContext_t * pEventCtx );
+static OtaEventLane_t eventLane( OtaEvent_t eventId );
+static bool eventRingPush( OtaEventRing_t * pRing,
+                           const OtaEventMsg_t * pEventMsg );
+static bool eventRingPop( OtaEventRing_t * pRing,
+                          OtaEventMsg_t * pEventMsg );
+static void deadlineAfter( clockid_t clock,
+                           uint32_t timeout,
+                           struct timespec * pDeadline );
+static bool shutdownSignalReset( OtaShutdownSignal_t * pSignal );
+static uint64_t monotonicTimeMs( void );
+static void timerWheelCreate( void );
+static void * timerWheelTask( void * pArgs );
+static void timerWheelAdvance( void );
+static void timerWheelInsert( OtaWheelTimer_t * pTimer );
+static void timerWheelRemove( OtaWheelTimer_t * pTimer );
+static OtaWheelTimer_t * wheelTimer( OtaTimerContext_t * pTimerCtx,
+                                     OtaTimerId_t otaTimerId );
+
+/* OTA Events of the agents that do not provide an event context.*/
+static OtaEventContext_t otaDefaultEventContext;
+
+/* OTA Timer wheel and its service thread, started with the first timer.*/
+static pthread_once_t otaTimerWheelOnce = PTHREAD_ONCE_INIT;
+static OtaTimerWheel_t otaTimerWheel;
+
+/* OTA Timers of the agents that do not provide a timer context.*/
+static OtaTimerContext_t otaDefaultTimerContext;
 
 OtaOsStatus_t Posix_OtaInitEvent( OtaEventContext_t * pEventCtx )
 {
     OtaOsStatus_t otaOsStatus = OtaOsSuccess;
+    OtaEventContext_t * pContext = eventContext( pEventCtx );
     struct mq_attr attr;
 
-    ( void ) pEventCtx;
+    /* Name the queue after the process and the context, so every agent gets its own.*/
+    ( void ) snprintf( pContext->queueName,
+                       sizeof( pContext->queueName ),
+                       "%s-%ld-%lx",
+                       OTA_QUEUE_NAME,
+                       ( long ) getpid(),
+                       ( unsigned long ) ( uintptr_t ) pContext );
 
     /* Unlink the event queue.*/
-    ( void ) mq_unlink( OTA_QUEUE_NAME );
+    ( void ) mq_unlink( pContext->queueName );
 
     /* Initialize queue attributes.*/
     attr.mq_flags = 0;
@@ -90,9 +135,9 @@ OtaOsStatus_t Posix_OtaInitEvent( OtaEventContext_t * pEventCtx )
      * flags are from standard linux header, and this is the normal way of using them. Hence we
      * silence the warning here. */
     /* coverity[misra_c_2012_rule_10_1_violation] */
-    otaEventQueue = mq_open( OTA_QUEUE_NAME, O_CREAT | O_RDWR, S_IRWXU, &attr );
+    pContext->queue = mq_open( pContext->queueName, O_CREAT | O_RDWR, S_IRWXU, &attr );
 
-    if( otaEventQueue == -1 )
+    if( pContext->queue == ( mqd_t ) -1 )
     {
         otaOsStatus = OtaOsEventQueueCreateFailed;
 
@@ -103,6 +148,17 @@ OtaOsStatus_t Posix_OtaInitEvent( OtaEventContext_t * pEventCtx )
                     otaOsStatus,
                     strerror( errno ) ) );
     }
+    else if( shutdownSignalReset( &pContext->shutdown ) == false )
+    {
+        otaOsStatus = OtaOsEventQueueCreateFailed;
+        ( void ) mq_close( pContext->queue );
+        ( void ) mq_unlink( pContext->queueName );
+
+        LogError( ( "Failed to create OTA Event Queue: "
+                    "Shutdown signal could not be created: "
+                    "OtaOsStatus_t=%i",
+                    otaOsStatus ) );
+    }
     else
     {
         LogDebug( ( "OTA Event Queue created." ) );
@@ -116,14 +172,16 @@ OtaOsStatus_t Posix_OtaSendEvent( OtaEventContext_t * pEventCtx,
                                   unsigned int timeout )
 {
     OtaOsStatus_t otaOsStatus = OtaOsSuccess;
+    OtaEventLane_t lane = eventLane( ( ( const OtaEventMsg_t * ) pEventMsg )->eventId );
+    mqd_t queue = eventContext( pEventCtx )->queue;
 
-    ( void ) pEventCtx;
     ( void ) timeout;
 
-    /* Send the event to OTA event queue.*/
+    /* Send the event to OTA event queue. The queue delivers higher priorities
+     * first, so the control lane gets the highest one.*/
     errno = 0;
 
-    if( mq_send( otaEventQueue, pEventMsg, MAX_MSG_SIZE, 0 ) == -1 )
+    if( mq_send( queue, pEventMsg, MAX_MSG_SIZE, ( unsigned int ) OtaNumOfEventLanes - 1U - ( unsigned int ) lane ) == -1 )
     {
         otaOsStatus = OtaOsEventQueueSendFailed;
 
@@ -149,14 +207,31 @@ OtaOsStatus_t Posix_OtaReceiveEvent( OtaEventContext_t * pEventCtx,
     OtaOsStatus_t otaOsStatus = OtaOsSuccess;
     char * pDst = pEventMsg;
     char buff[ MAX_MSG_SIZE ];
-
-    ( void ) pEventCtx;
-    ( void ) timeout;
+    struct timespec deadline;
+    ssize_t received = 0;
+    mqd_t queue = eventContext( pEventCtx )->queue;
 
     /* Receive the next event from OTA event queue.*/
     errno = 0;
 
-    if( mq_receive( otaEventQueue, buff, sizeof( buff ), NULL ) == -1 )
+    if( timeout == 0U )
+    {
+        received = mq_receive( queue, buff, sizeof( buff ), NULL );
+    }
+    else
+    {
+        /* The message queue measures its timeout on the realtime clock.*/
+        deadlineAfter( CLOCK_REALTIME, timeout, &deadline );
+        received = mq_timedreceive( queue, buff, sizeof( buff ), NULL, &deadline );
+    }
+
+    if( ( received == -1 ) && ( errno == ETIMEDOUT ) )
+    {
+        otaOsStatus = OtaOsEventQueueReceiveTimeout;
+
+        LogDebug( ( "No OTA Event received within %u ms.", ( unsigned int ) timeout ) );
+    }
+    else if( received == -1 )
     {
         otaOsStatus = OtaOsEventQueueReceiveFailed;
 
@@ -181,13 +256,19 @@ OtaOsStatus_t Posix_OtaReceiveEvent( OtaEventContext_t * pEventCtx,
 OtaOsStatus_t Posix_OtaDeinitEvent( OtaEventContext_t * pEventCtx )
 {
     OtaOsStatus_t otaOsStatus = OtaOsSuccess;
+    OtaEventContext_t * pContext = eventContext( pEventCtx );
 
-    ( void ) pEventCtx;
+    /* Close and remove the event queue. A context that was never initialized
+     * has no queue name, and the queue of a deleted one is -1.*/
+    if( pContext->queueName[ 0 ] != '\0' )
+    {
+        ( void ) mq_close( pContext->queue );
+        pContext->queue = ( mqd_t ) -1;
+    }
 
-    /* Remove the event queue.*/
     errno = 0;
 
-    if( mq_unlink( OTA_QUEUE_NAME ) == -1 )
+    if( mq_unlink( pContext->queueName ) == -1 )
     {
         otaOsStatus = OtaOsEventQueueDeleteFailed;
 
@@ -206,196 +287,759 @@ OtaOsStatus_t Posix_OtaDeinitEvent( OtaEventContext_t * pEventCtx )
     return otaOsStatus;
 }
 
-static void selfTestTimerCallback( union sigval arg )
+static OtaEventContext_t * eventContext( OtaEventContext_t * pEventCtx )
 {
-    ( void ) arg;
+    return ( pEventCtx != NULL ) ? pEventCtx : &otaDefaultEventContext;
+}
 
-    LogDebug( ( "Self-test expired within %ums\r\n",
-                otaconfigSELF_TEST_RESPONSE_WAIT_MS ) );
+static OtaEventLane_t eventLane( OtaEvent_t eventId )
+{
+    OtaEventLane_t lane = OtaEventLaneData;
 
-    if( otaTimerCallback != NULL )
+    switch( eventId )
     {
-        otaTimerCallback( OtaSelfTestTimer );
+        case OtaAgentEventStart:
+        case OtaAgentEventSuspend:
+        case OtaAgentEventResume:
+        case OtaAgentEventUserAbort:
+        case OtaAgentEventShutdown:
+        case OtaAgentEventConnectionUp:
+            lane = OtaEventLaneControl;
+            break;
+
+        case OtaAgentEventRequestTimer:
+            lane = OtaEventLaneTimer;
+            break;
+
+        default:
+            /* All other events carry or request data. */
+            break;
+    }
+
+    return lane;
+}
+
+/* The event ring uses the GCC/Clang __atomic builtins. A producer claims a
+ * slot in the lane of its event by advancing the tail with a compare-and-swap,
+ * copies its event in and then publishes the slot by advancing its sequence.
+ * The consumer only takes the lock when every lane is empty, and producers
+ * only take it to wake the consumer when it has said it is idle. */
+static bool eventRingPush( OtaEventRing_t * pRing,
+                           const OtaEventMsg_t * pEventMsg )
+{
+    OtaEventRingLane_t * pLane = &pRing->lanes[ eventLane( pEventMsg->eventId ) ];
+    OtaEventRingSlot_t * pSlot = NULL;
+    uint32_t pos = __atomic_load_n( &pLane->tail, __ATOMIC_RELAXED );
+    uint32_t sequence = 0;
+    bool claimed = false;
+    bool full = false;
+
+    while( ( claimed == false ) && ( full == false ) )
+    {
+        pSlot = &pLane->slots[ pos & OTA_EVENT_RING_MASK ];
+        sequence = __atomic_load_n( &pSlot->sequence, __ATOMIC_ACQUIRE );
+
+        if( sequence == pos )
+        {
+            /* The slot is free, try to claim it. On failure pos is reloaded. */
+            claimed = __atomic_compare_exchange_n( &pLane->tail, &pos, pos + 1U, false,
+                                                   __ATOMIC_RELAXED, __ATOMIC_RELAXED );
+        }
+        else if( ( int32_t ) ( sequence - pos ) < 0 )
+        {
+            /* The slot still holds the event from one lap earlier. */
+            full = true;
+        }
+        else
+        {
+            /* Another producer claimed this position first. */
+            pos = __atomic_load_n( &pLane->tail, __ATOMIC_RELAXED );
+        }
+    }
+
+    if( claimed == true )
+    {
+        ( void ) memcpy( &pSlot->eventMsg, pEventMsg, sizeof( OtaEventMsg_t ) );
+        __atomic_store_n( &pSlot->sequence, pos + 1U, __ATOMIC_RELEASE );
+
+        /* Pairs with the fence in Posix_OtaReceiveEventRing, so either the
+         * consumer sees this event or this producer sees it idle. */
+        __atomic_thread_fence( __ATOMIC_SEQ_CST );
+
+        if( __atomic_load_n( &pRing->consumerIdle, __ATOMIC_RELAXED ) != 0U )
+        {
+            ( void ) pthread_mutex_lock( &pRing->lock );
+            ( void ) pthread_cond_signal( &pRing->wakeup );
+            ( void ) pthread_mutex_unlock( &pRing->lock );
+        }
+    }
+
+    return claimed;
+}
+
+static bool eventRingPop( OtaEventRing_t * pRing,
+                          OtaEventMsg_t * pEventMsg )
+{
+    OtaEventRingLane_t * pLane = NULL;
+    OtaEventRingSlot_t * pSlot = NULL;
+    uint32_t lane = 0;
+    bool popped = false;
+
+    /* Strict priority: a lane is only read when all lanes above it are empty. */
+    for( lane = 0; ( lane < ( uint32_t ) OtaNumOfEventLanes ) && ( popped == false ); lane++ )
+    {
+        pLane = &pRing->lanes[ lane ];
+        pSlot = &pLane->slots[ pLane->head & OTA_EVENT_RING_MASK ];
+
+        if( __atomic_load_n( &pSlot->sequence, __ATOMIC_ACQUIRE ) == ( pLane->head + 1U ) )
+        {
+            ( void ) memcpy( pEventMsg, &pSlot->eventMsg, sizeof( OtaEventMsg_t ) );
+
+            /* Hand the slot back to producers for the next lap. */
+            __atomic_store_n( &pSlot->sequence, pLane->head + OTA_EVENT_RING_SIZE, __ATOMIC_RELEASE );
+            pLane->head++;
+            popped = true;
+        }
+    }
+
+    return popped;
+}
+
+OtaOsStatus_t Posix_OtaInitEventRing( OtaEventContext_t * pEventCtx )
+{
+    OtaOsStatus_t otaOsStatus = OtaOsSuccess;
+    OtaEventRing_t * pRing = &eventContext( pEventCtx )->ring;
+    pthread_condattr_t condAttr;
+    uint32_t lane = 0;
+    uint32_t i = 0;
+
+    for( lane = 0; lane < ( uint32_t ) OtaNumOfEventLanes; lane++ )
+    {
+        for( i = 0; i < OTA_EVENT_RING_SIZE; i++ )
+        {
+            pRing->lanes[ lane ].slots[ i ].sequence = i;
+        }
+
+        pRing->lanes[ lane ].tail = 0;
+        pRing->lanes[ lane ].head = 0;
+    }
+
+    pRing->consumerIdle = 0;
+
+    if( pRing->initialized == false )
+    {
+        /* Receive timeouts are measured on the monotonic clock.*/
+        ( void ) pthread_condattr_init( &condAttr );
+        ( void ) pthread_condattr_setclock( &condAttr, CLOCK_MONOTONIC );
+
+        if( pthread_mutex_init( &pRing->lock, NULL ) != 0 )
+        {
+            otaOsStatus = OtaOsEventQueueCreateFailed;
+        }
+        else if( pthread_cond_init( &pRing->wakeup, &condAttr ) != 0 )
+        {
+            ( void ) pthread_mutex_destroy( &pRing->lock );
+            otaOsStatus = OtaOsEventQueueCreateFailed;
+        }
+        else
+        {
+            pRing->initialized = true;
+        }
+
+        ( void ) pthread_condattr_destroy( &condAttr );
+    }
+
+    if( ( otaOsStatus == OtaOsSuccess ) &&
+        ( shutdownSignalReset( &eventContext( pEventCtx )->shutdown ) == false ) )
+    {
+        otaOsStatus = OtaOsEventQueueCreateFailed;
+    }
+
+    if( otaOsStatus != OtaOsSuccess )
+    {
+        LogError( ( "Failed to create OTA Event ring: "
+                    "OtaOsStatus_t=%i",
+                    otaOsStatus ) );
     }
     else
     {
-        LogWarn( ( "Self-test timer event unhandled.\r\n" ) );
+        LogDebug( ( "OTA Event ring created." ) );
     }
+
+    return otaOsStatus;
 }
 
-static void requestTimerCallback( union sigval arg )
+OtaOsStatus_t Posix_OtaSendEventRing( OtaEventContext_t * pEventCtx,
+                                      const void * pEventMsg,
+                                      unsigned int timeout )
 {
-    ( void ) arg;
+    OtaOsStatus_t otaOsStatus = OtaOsSuccess;
+    OtaEventRing_t * pRing = &eventContext( pEventCtx )->ring;
 
-    LogDebug( ( "Request timer expired in %ums \r\n",
-                otaconfigFILE_REQUEST_WAIT_MS ) );
+    ( void ) timeout;
 
-    if( otaTimerCallback != NULL )
+    if( eventRingPush( pRing, ( const OtaEventMsg_t * ) pEventMsg ) == false )
     {
-        otaTimerCallback( OtaRequestTimer );
+        otaOsStatus = OtaOsEventQueueSendFailed;
+
+        LogError( ( "Failed to send event to OTA Event ring: "
+                    "Lane is full: "
+                    "OtaOsStatus_t=%i",
+                    otaOsStatus ) );
     }
     else
     {
-        LogWarn( ( "Request timer event unhandled.\r\n" ) );
+        LogDebug( ( "OTA Event Sent." ) );
     }
+
+    return otaOsStatus;
 }
 
-OtaOsStatus_t Posix_OtaStartTimer( OtaTimerId_t otaTimerId,
-                                   const char * const pTimerName,
-                                   const uint32_t timeout,
-                                   OtaTimerCallback_t callback )
+OtaOsStatus_t Posix_OtaReceiveEventRing( OtaEventContext_t * pEventCtx,
+                                         void * pEventMsg,
+                                         uint32_t timeout )
 {
     OtaOsStatus_t otaOsStatus = OtaOsSuccess;
+    OtaEventRing_t * pRing = &eventContext( pEventCtx )->ring;
+    OtaEventMsg_t * pDst = pEventMsg;
+    struct timespec deadline;
+    int waitStatus = 0;
 
-    /* Create the timer structures. */
-    struct sigevent sgEvent;
-    struct itimerspec timerAttr;
+    if( eventRingPop( pRing, pDst ) == false )
+    {
+        deadlineAfter( CLOCK_MONOTONIC, timeout, &deadline );
 
-    ( void ) pTimerName;
+        ( void ) pthread_mutex_lock( &pRing->lock );
+
+        __atomic_store_n( &pRing->consumerIdle, 1U, __ATOMIC_RELAXED );
+        __atomic_thread_fence( __ATOMIC_SEQ_CST );
+
+        while( ( waitStatus == 0 ) && ( eventRingPop( pRing, pDst ) == false ) )
+        {
+            if( timeout == 0U )
+            {
+                waitStatus = pthread_cond_wait( &pRing->wakeup, &pRing->lock );
+            }
+            else
+            {
+                waitStatus = pthread_cond_timedwait( &pRing->wakeup, &pRing->lock, &deadline );
+            }
+        }
+
+        __atomic_store_n( &pRing->consumerIdle, 0U, __ATOMIC_RELAXED );
+
+        ( void ) pthread_mutex_unlock( &pRing->lock );
+    }
+
+    if( waitStatus == ETIMEDOUT )
+    {
+        otaOsStatus = OtaOsEventQueueReceiveTimeout;
+
+        LogDebug( ( "No OTA Event received within %u ms.", ( unsigned int ) timeout ) );
+    }
+    else if( waitStatus != 0 )
+    {
+        otaOsStatus = OtaOsEventQueueReceiveFailed;
+
+        LogError( ( "Failed to receive OTA Event: "
+                    "pthread_cond_wait returned error: "
+                    "OtaOsStatus_t=%i "
+                    ",error=%s",
+                    otaOsStatus,
+                    strerror( waitStatus ) ) );
+    }
+    else
+    {
+        LogDebug( ( "OTA Event received." ) );
+    }
+
+    return otaOsStatus;
+}
+
+OtaOsStatus_t Posix_OtaReceiveEventBatchRing( OtaEventContext_t * pEventCtx,
+                                              void * pEventMsgs,
+                                              uint32_t maxEvents,
+                                              uint32_t * pNumEvents,
+                                              uint32_t timeout )
+{
+    OtaOsStatus_t otaOsStatus = OtaOsSuccess;
+    OtaEventRing_t * pRing = &eventContext( pEventCtx )->ring;
+    OtaEventMsg_t * pDst = pEventMsgs;
+    uint32_t numEvents = 0;
+
+    *pNumEvents = 0;
+
+    if( maxEvents == 0U )
+    {
+        otaOsStatus = OtaOsEventQueueReceiveFailed;
+
+        LogError( ( "Failed to receive OTA Events: "
+                    "maxEvents is zero: "
+                    "OtaOsStatus_t=%i",
+                    otaOsStatus ) );
+    }
+    else
+    {
+        /* Wait for the first event, then take what is already pending. */
+        otaOsStatus = Posix_OtaReceiveEventRing( pEventCtx, &pDst[ 0 ], timeout );
+    }
+
+    if( otaOsStatus == OtaOsSuccess )
+    {
+        numEvents = 1;
+
+        while( ( numEvents < maxEvents ) && ( eventRingPop( pRing, &pDst[ numEvents ] ) == true ) )
+        {
+            numEvents++;
+        }
+
+        *pNumEvents = numEvents;
+    }
+
+    return otaOsStatus;
+}
+
+OtaOsStatus_t Posix_OtaDeinitEventRing( OtaEventContext_t * pEventCtx )
+{
+    OtaOsStatus_t otaOsStatus = OtaOsSuccess;
+    OtaEventRing_t * pRing = &eventContext( pEventCtx )->ring;
 
-    /* clear everything in the structures. */
-    ( void ) memset( &sgEvent, 0, sizeof( struct sigevent ) );
-    ( void ) memset( &timerAttr, 0, sizeof( struct itimerspec ) );
+    if( pRing->initialized == false )
+    {
+        otaOsStatus = OtaOsEventQueueDeleteFailed;
+
+        LogError( ( "Failed to delete OTA Event ring: "
+                    "Ring is not initialized: "
+                    "OtaOsStatus_t=%i",
+                    otaOsStatus ) );
+    }
+    else
+    {
+        ( void ) pthread_cond_destroy( &pRing->wakeup );
+        ( void ) pthread_mutex_destroy( &pRing->lock );
+        pRing->initialized = false;
 
-    /* Set attributes. */
-    sgEvent.sigev_notify = SIGEV_THREAD;
-    sgEvent.sigev_value.sival_ptr = otaTimers[ otaTimerId ];
-    sgEvent.sigev_notify_function = timerCallback[ otaTimerId ];
+        LogDebug( ( "OTA Event ring deleted." ) );
+    }
 
-    /* Set OTA lib callback. */
-    otaTimerCallback = callback;
+    return otaOsStatus;
+}
 
-    /* Set timeout attributes.*/
-    timerAttr.it_value.tv_sec = ( time_t ) timeout / 1000;
+static void deadlineAfter( clockid_t clock,
+                           uint32_t timeout,
+                           struct timespec * pDeadline )
+{
+    /* Convert the timeout in milliseconds to an absolute time on the clock.*/
+    ( void ) clock_gettime( clock, pDeadline );
+    pDeadline->tv_sec += ( time_t ) ( timeout / 1000U );
+    pDeadline->tv_nsec += ( long ) ( timeout % 1000U ) * 1000000L;
 
-    /* Create timer if required.*/
-    if( pOtaTimers[ otaTimerId ] == NULL )
+    if( pDeadline->tv_nsec >= 1000000000L )
     {
-        errno = 0;
+        pDeadline->tv_sec++;
+        pDeadline->tv_nsec -= 1000000000L;
+    }
+}
 
-        if( timer_create( CLOCK_REALTIME, &sgEvent, &otaTimers[ otaTimerId ] ) == -1 )
+static bool shutdownSignalReset( OtaShutdownSignal_t * pSignal )
+{
+    pthread_condattr_t condAttr;
+
+    /* The signal is created with the events of its context and kept when they
+     * are deleted, so OTA_Shutdown can still wait on it.*/
+    if( pSignal->initialized == false )
+    {
+        /* Wait timeouts are measured on the monotonic clock.*/
+        ( void ) pthread_condattr_init( &condAttr );
+        ( void ) pthread_condattr_setclock( &condAttr, CLOCK_MONOTONIC );
+
+        if( pthread_mutex_init( &pSignal->lock, NULL ) != 0 )
+        {
+            /* Not created. */
+        }
+        else if( pthread_cond_init( &pSignal->done, &condAttr ) != 0 )
         {
-            otaOsStatus = OtaOsTimerCreateFailed;
-
-            LogError( ( "Failed to create OTA timer: "
-                        "timer_create returned error: "
-                        "OtaOsStatus_t=%i "
-                        ",errno=%s",
-                        otaOsStatus,
-                        strerror( errno ) ) );
+            ( void ) pthread_mutex_destroy( &pSignal->lock );
         }
         else
         {
-            pOtaTimers[ otaTimerId ] = &otaTimers[ otaTimerId ];
+            pSignal->initialized = true;
         }
+
+        ( void ) pthread_condattr_destroy( &condAttr );
     }
 
-    /* Set timeout.*/
-    if( pOtaTimers[ otaTimerId ] != NULL )
+    if( pSignal->initialized == true )
     {
-        errno = 0;
+        ( void ) pthread_mutex_lock( &pSignal->lock );
+        pSignal->signaled = false;
+        ( void ) pthread_mutex_unlock( &pSignal->lock );
+    }
+
+    return pSignal->initialized;
+}
+
+OtaOsStatus_t Posix_OtaSignalShutdown( OtaEventContext_t * pEventCtx )
+{
+    OtaShutdownSignal_t * pSignal = &eventContext( pEventCtx )->shutdown;
 
-        if( timer_settime( otaTimers[ otaTimerId ], 0, &timerAttr, NULL ) == -1 )
+    /* The signal is created before the agent runs, nobody waits otherwise. */
+    if( pSignal->initialized == true )
+    {
+        ( void ) pthread_mutex_lock( &pSignal->lock );
+        pSignal->signaled = true;
+        ( void ) pthread_cond_broadcast( &pSignal->done );
+        ( void ) pthread_mutex_unlock( &pSignal->lock );
+
+        LogDebug( ( "OTA Agent shutdown signaled." ) );
+    }
+
+    return OtaOsSuccess;
+}
+
+OtaOsStatus_t Posix_OtaWaitShutdown( OtaEventContext_t * pEventCtx,
+                                     uint32_t timeout )
+{
+    OtaOsStatus_t otaOsStatus = OtaOsShutdownWaitFailed;
+    OtaShutdownSignal_t * pSignal = &eventContext( pEventCtx )->shutdown;
+    struct timespec deadline;
+    int waitStatus = 0;
+
+    if( pSignal->initialized == true )
+    {
+        deadlineAfter( CLOCK_MONOTONIC, timeout, &deadline );
+
+        ( void ) pthread_mutex_lock( &pSignal->lock );
+
+        while( ( pSignal->signaled == false ) && ( waitStatus == 0 ) )
         {
-            otaOsStatus = OtaOsTimerStartFailed;
-
-            LogError( ( "Failed to set OTA timer timeout: "
-                        "timer_settime returned error: "
-                        "OtaOsStatus_t=%i "
-                        ",errno=%s",
-                        otaOsStatus,
-                        strerror( errno ) ) );
+            waitStatus = pthread_cond_timedwait( &pSignal->done, &pSignal->lock, &deadline );
         }
-        else
+
+        if( pSignal->signaled == true )
         {
-            LogDebug( ( "OTA Timer started." ) );
+            otaOsStatus = OtaOsSuccess;
         }
+
+        ( void ) pthread_mutex_unlock( &pSignal->lock );
+    }
+
+    if( otaOsStatus != OtaOsSuccess )
+    {
+        LogError( ( "Failed to wait for the OTA Agent to shut down: "
+                    "pthread_cond_timedwait returned error: "
+                    "OtaOsStatus_t=%i "
+                    ",errno=%s",
+                    otaOsStatus,
+                    strerror( waitStatus ) ) );
     }
 
     return otaOsStatus;
 }
 
-OtaOsStatus_t Posix_OtaStopTimer( OtaTimerId_t otaTimerId )
+static uint64_t monotonicTimeMs( void )
 {
-    OtaOsStatus_t otaOsStatus = OtaOsSuccess;
+    struct timespec now;
 
-    /* Create the timer structures. */
-    struct itimerspec timerAttr;
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &now );
 
-    /* clear everything in the structures. */
-    ( void ) memset( &timerAttr, 0, sizeof( struct itimerspec ) );
+    return ( ( uint64_t ) now.tv_sec * 1000U ) + ( ( uint64_t ) now.tv_nsec / 1000000U );
+}
 
-    /* Clear the timeout. */
-    timerAttr.it_value.tv_sec = 0;
+static void timerWheelCreate( void )
+{
+    pthread_condattr_t condAttr;
+    pthread_attr_t threadAttr;
+    pthread_t thread;
+
+    ( void ) pthread_mutex_init( &otaTimerWheel.lock, NULL );
+    ( void ) pthread_condattr_init( &condAttr );
+    ( void ) pthread_condattr_setclock( &condAttr, CLOCK_MONOTONIC );
+    ( void ) pthread_cond_init( &otaTimerWheel.wakeup, &condAttr );
+    ( void ) pthread_condattr_destroy( &condAttr );
+
+    otaTimerWheel.currentTick = monotonicTimeMs() / OTA_TIMER_WHEEL_TICK_MS;
+
+    /* The service thread runs for the lifetime of the process.*/
+    ( void ) pthread_attr_init( &threadAttr );
+    ( void ) pthread_attr_setdetachstate( &threadAttr, PTHREAD_CREATE_DETACHED );
+    otaTimerWheel.running = ( pthread_create( &thread, &threadAttr, timerWheelTask, NULL ) == 0 );
+    ( void ) pthread_attr_destroy( &threadAttr );
+}
 
-    if( pOtaTimers[ otaTimerId ] != NULL )
-    {
-        /* Stop the timer*/
-        errno = 0;
+static void * timerWheelTask( void * pArgs )
+{
+    struct timespec deadline;
+    uint64_t nextTickMs = 0;
+
+    ( void ) pArgs;
+
+    ( void ) pthread_mutex_lock( &otaTimerWheel.lock );
 
-        if( timer_settime( otaTimers[ otaTimerId ], 0, &timerAttr, NULL ) == -1 )
+    while( true )
+    {
+        /* Sleep until a timer is started, then wake up once per tick while any is running.*/
+        if( otaTimerWheel.armedCount == 0U )
         {
-            otaOsStatus = OtaOsTimerStopFailed;
-
-            LogError( ( "Failed to stop OTA timer: "
-                        "timer_settime returned error: "
-                        "OtaOsStatus_t=%i "
-                        ",errno=%s",
-                        otaOsStatus,
-                        strerror( errno ) ) );
+            ( void ) pthread_cond_wait( &otaTimerWheel.wakeup, &otaTimerWheel.lock );
         }
         else
         {
-            LogDebug( ( "OTA Timer Stopped for Timerid=%i.", otaTimerId ) );
+            nextTickMs = ( otaTimerWheel.currentTick + 1U ) * OTA_TIMER_WHEEL_TICK_MS;
+            deadline.tv_sec = ( time_t ) ( nextTickMs / 1000U );
+            deadline.tv_nsec = ( long ) ( nextTickMs % 1000U ) * 1000000L;
+
+            ( void ) pthread_cond_timedwait( &otaTimerWheel.wakeup, &otaTimerWheel.lock, &deadline );
         }
+
+        timerWheelAdvance();
+    }
+
+    return NULL;
+}
+
+static void timerWheelAdvance( void )
+{
+    uint64_t nowTick = monotonicTimeMs() / OTA_TIMER_WHEEL_TICK_MS;
+    uint64_t tick = otaTimerWheel.currentTick;
+    uint32_t slotsLeft = OTA_TIMER_WHEEL_SIZE;
+    OtaWheelTimer_t * pTimer = NULL;
+    OtaTimerCallback_t callback = NULL;
+    void * pCallbackContext = NULL;
+    OtaTimerId_t timerId = OtaRequestTimer;
+
+    /* Visit the slots of the ticks that passed, each at most once if the thread fell a turn behind.*/
+    while( ( tick < nowTick ) && ( slotsLeft > 0U ) )
+    {
+        tick++;
+        slotsLeft--;
+        pTimer = otaTimerWheel.slots[ tick & OTA_TIMER_WHEEL_MASK ];
+
+        while( pTimer != NULL )
+        {
+            if( pTimer->expiryTick <= nowTick )
+            {
+                timerWheelRemove( pTimer );
+
+                callback = pTimer->callback;
+                pCallbackContext = pTimer->pCallbackContext;
+                timerId = pTimer->timerId;
+
+                /* Invoke the callback unlocked so that it may start and stop timers.*/
+                ( void ) pthread_mutex_unlock( &otaTimerWheel.lock );
+
+                LogDebug( ( "OTA Timer expired for Timerid=%i.", timerId ) );
+
+                if( callback != NULL )
+                {
+                    callback( timerId, pCallbackContext );
+                }
+                else
+                {
+                    LogWarn( ( "OTA Timer event unhandled for Timerid=%i.", timerId ) );
+                }
+
+                ( void ) pthread_mutex_lock( &otaTimerWheel.lock );
+
+                /* The slot may have changed while unlocked, scan it again.*/
+                pTimer = otaTimerWheel.slots[ tick & OTA_TIMER_WHEEL_MASK ];
+            }
+            else
+            {
+                pTimer = pTimer->pNext;
+            }
+        }
+    }
+
+    otaTimerWheel.currentTick = nowTick;
+}
+
+static void timerWheelInsert( OtaWheelTimer_t * pTimer )
+{
+    OtaWheelTimer_t ** ppSlot = &otaTimerWheel.slots[ pTimer->expiryTick & OTA_TIMER_WHEEL_MASK ];
+
+    pTimer->pPrev = NULL;
+    pTimer->pNext = *ppSlot;
+
+    if( *ppSlot != NULL )
+    {
+        ( *ppSlot )->pPrev = pTimer;
+    }
+
+    *ppSlot = pTimer;
+    pTimer->armed = true;
+    otaTimerWheel.armedCount++;
+}
+
+static void timerWheelRemove( OtaWheelTimer_t * pTimer )
+{
+    if( pTimer->pPrev != NULL )
+    {
+        pTimer->pPrev->pNext = pTimer->pNext;
     }
     else
     {
-        LogWarn( ( "OTA Timer handle NULL for Timerid=%i, can't stop.", otaTimerId ) );
+        otaTimerWheel.slots[ pTimer->expiryTick & OTA_TIMER_WHEEL_MASK ] = pTimer->pNext;
+    }
 
-        otaOsStatus = OtaOsTimerStopFailed;
+    if( pTimer->pNext != NULL )
+    {
+        pTimer->pNext->pPrev = pTimer->pPrev;
     }
 
-    return otaOsStatus;
+    pTimer->pNext = NULL;
+    pTimer->pPrev = NULL;
+    pTimer->armed = false;
+    otaTimerWheel.armedCount--;
 }
 
-OtaOsStatus_t Posix_OtaDeleteTimer( OtaTimerId_t otaTimerId )
+static OtaWheelTimer_t * wheelTimer( OtaTimerContext_t * pTimerCtx,
+                                     OtaTimerId_t otaTimerId )
+{
+    OtaTimerContext_t * pContext = ( pTimerCtx != NULL ) ? pTimerCtx : &otaDefaultTimerContext;
+
+    return &pContext->timers[ otaTimerId ];
+}
+
+OtaOsStatus_t Posix_OtaStartTimer( OtaTimerContext_t * pTimerCtx,
+                                   OtaTimerId_t otaTimerId,
+                                   const char * const pTimerName,
+                                   const uint32_t timeout,
+                                   OtaTimerCallback_t callback,
+                                   void * pCallbackContext )
 {
     OtaOsStatus_t otaOsStatus = OtaOsSuccess;
+    OtaWheelTimer_t * pTimer = wheelTimer( pTimerCtx, otaTimerId );
 
-    if( pOtaTimers[ otaTimerId ] != NULL )
+    ( void ) pTimerName;
+
+    ( void ) pthread_once( &otaTimerWheelOnce, timerWheelCreate );
+
+    if( otaTimerWheel.running == false )
     {
-        /* Delete the timer*/
-        errno = 0;
+        otaOsStatus = OtaOsTimerCreateFailed;
 
-        if( timer_delete( otaTimers[ otaTimerId ] ) == -1 )
+        LogError( ( "Failed to create OTA timer: "
+                    "timer wheel service thread is not running: "
+                    "OtaOsStatus_t=%i",
+                    otaOsStatus ) );
+    }
+    else
+    {
+        ( void ) pthread_mutex_lock( &otaTimerWheel.lock );
+
+        if( pTimer->armed == true )
         {
-            otaOsStatus = OtaOsTimerDeleteFailed;
-
-            LogError( ( "Failed to delete OTA timer: "
-                        "timer_delete returned error: "
-                        "OtaOsStatus_t=%i "
-                        ",errno=%s",
-                        otaOsStatus,
-                        strerror( errno ) ) );
+            timerWheelRemove( pTimer );
         }
-        else
-        {
-            LogDebug( ( "OTA Timer deleted." ) );
 
-            pOtaTimers[ otaTimerId ] = NULL;
+        pTimer->callback = callback;
+        pTimer->pCallbackContext = pCallbackContext;
+        pTimer->timerId = otaTimerId;
+        pTimer->created = true;
+
+        /* Expire on the first tick after the timeout, as the current time is rounded down to
+         * whole milliseconds. A zero timeout leaves the timer disarmed.*/
+        if( timeout > 0U )
+        {
+            pTimer->expiryTick = ( ( monotonicTimeMs() + timeout ) / OTA_TIMER_WHEEL_TICK_MS ) + 1U;
+            timerWheelInsert( pTimer );
+
+            /* Wake the service thread up if it was waiting for a first timer.*/
+            if( otaTimerWheel.armedCount == 1U )
+            {
+                ( void ) pthread_cond_signal( &otaTimerWheel.wakeup );
+            }
         }
+
+        ( void ) pthread_mutex_unlock( &otaTimerWheel.lock );
+
+        LogDebug( ( "OTA Timer started." ) );
+    }
+
+    return otaOsStatus;
+}
+
+OtaOsStatus_t Posix_OtaStopTimer( OtaTimerContext_t * pTimerCtx,
+                                  OtaTimerId_t otaTimerId )
+{
+    OtaOsStatus_t otaOsStatus = OtaOsSuccess;
+    OtaWheelTimer_t * pTimer = wheelTimer( pTimerCtx, otaTimerId );
+
+    ( void ) pthread_once( &otaTimerWheelOnce, timerWheelCreate );
+
+    ( void ) pthread_mutex_lock( &otaTimerWheel.lock );
+
+    if( pTimer->created == false )
+    {
+        otaOsStatus = OtaOsTimerStopFailed;
+    }
+    else if( pTimer->armed == true )
+    {
+        timerWheelRemove( pTimer );
     }
     else
     {
-        LogWarn( ( "OTA Timer handle NULL for Timerid=%i, can't delete.", otaTimerId ) );
+        /* The timer already expired or was stopped. */
+    }
+
+    ( void ) pthread_mutex_unlock( &otaTimerWheel.lock );
+
+    if( otaOsStatus == OtaOsSuccess )
+    {
+        LogDebug( ( "OTA Timer Stopped for Timerid=%i.", otaTimerId ) );
+    }
+    else
+    {
+        LogWarn( ( "OTA Timer not created for Timerid=%i, can't stop.", otaTimerId ) );
+    }
+
+    return otaOsStatus;
+}
+
+OtaOsStatus_t Posix_OtaDeleteTimer( OtaTimerContext_t * pTimerCtx,
+                                    OtaTimerId_t otaTimerId )
+{
+    OtaOsStatus_t otaOsStatus = OtaOsSuccess;
+    OtaWheelTimer_t * pTimer = wheelTimer( pTimerCtx, otaTimerId );
+
+    ( void ) pthread_once( &otaTimerWheelOnce, timerWheelCreate );
 
+    ( void ) pthread_mutex_lock( &otaTimerWheel.lock );
+
+    if( pTimer->created == false )
+    {
         otaOsStatus = OtaOsTimerDeleteFailed;
     }
+    else
+    {
+        if( pTimer->armed == true )
+        {
+            timerWheelRemove( pTimer );
+        }
+
+        pTimer->created = false;
+    }
+
+    ( void ) pthread_mutex_unlock( &otaTimerWheel.lock );
+
+    if( otaOsStatus == OtaOsSuccess )
+    {
+        LogDebug( ( "OTA Timer deleted." ) );
+    }
+    else
+    {
+        LogWarn( ( "OTA Timer not created for Timerid=%i, can't delete.", otaTimerId ) );
+    }
 
     return otaOsStatus;
 }
 
+uint32_t Posix_OtaGetTimeMs( void )
+{
+    return ( uint32_t ) monotonicTimeMs();
+}
+
 void * STDC_Malloc( size_t size )
 {
     /* Use standard C malloc.*/
@@ -31,21 +31,124 @@
 
 /* Standard library include. */
 #include <stdint.h>
+#include <stdbool.h>
 #include <time.h>
 
+/* Posix includes. */
+#include <pthread.h>
+
+/* Posix includes. */
+#include <mqueue.h>
+
 /* OTA library interface include. */
 #include "ota_os_interface.h"
 
+/* OTA library private include for the event message. */
+#include "ota_private.h"
+
+/**
+ * @brief Number of events each lane of the OTA Event ring holds. Must be a power of two.
+ */
+#ifndef OTA_EVENT_RING_SIZE
+    #define OTA_EVENT_RING_SIZE    16U
+#endif
+
+/**
+ * @brief Size of the OTA Event queue name buffer, enough for the prefix, a process ID and an address.
+ */
+#define OTA_QUEUE_NAME_LENGTH    64U
+
+/**
+ * @brief Number of slots in the OTA timer wheel. Must be a power of two.
+ */
+#ifndef OTA_TIMER_WHEEL_SIZE
+    #define OTA_TIMER_WHEEL_SIZE    64U
+#endif
+
+/**
+ * @brief Resolution of the OTA timer wheel in milliseconds. Timers expire at most one tick late.
+ */
+#ifndef OTA_TIMER_WHEEL_TICK_MS
+    #define OTA_TIMER_WHEEL_TICK_MS    10U
+#endif
+
+/* OTA Event ring slot.*/
+typedef struct OtaEventRingSlot
+{
+    uint32_t sequence;      /* Ring position the slot is free for, or that position + 1 once it holds its event. */
+    OtaEventMsg_t eventMsg; /* The event. */
+} OtaEventRingSlot_t;
+
+/* OTA Event ring lane, a bounded queue with many producers and one consumer.*/
+typedef struct OtaEventRingLane
+{
+    OtaEventRingSlot_t slots[ OTA_EVENT_RING_SIZE ]; /* Event slots. */
+    uint32_t tail;                                   /* Next position to be claimed by a producer. */
+    uint32_t head;                                   /* Next position to be read, only used by the consumer. */
+} OtaEventRingLane_t;
+
+/* OTA Event ring, one lane per event priority.*/
+typedef struct OtaEventRing
+{
+    OtaEventRingLane_t lanes[ OtaNumOfEventLanes ]; /* Lanes, highest priority first. */
+    uint32_t consumerIdle;                          /* Non-zero while the consumer waits for an event. */
+    bool initialized;                               /* Whether the lock and condition are initialized. */
+    pthread_mutex_t lock;                           /* Protects the consumer going to sleep. */
+    pthread_cond_t wakeup;                          /* Signaled when an event is pushed to an idle consumer. */
+} OtaEventRing_t;
+
+/* OTA Agent shutdown signal.*/
+typedef struct OtaShutdownSignal
+{
+    bool initialized;     /* Whether the lock and condition are initialized. */
+    bool signaled;        /* Whether the agent has shut down since the events were initialized. */
+    pthread_mutex_t lock; /* Protects signaled. */
+    pthread_cond_t done;  /* Broadcast when the agent has shut down, waited on with the monotonic clock. */
+} OtaShutdownSignal_t;
+
+/**
+ * @brief The events of one OTA agent. Must be zero-initialized before first use. A NULL
+ * event context selects a default one shared by all agents that do not set their own.
+ */
+struct OtaEventContext
+{
+    OtaEventRing_t ring;                     /* Event ring used by the Posix_Ota*EventRing functions. */
+    OtaShutdownSignal_t shutdown;            /* Signaled once the agent has shut down. */
+    char queueName[ OTA_QUEUE_NAME_LENGTH ]; /* Name of the message queue of the context, unique in the system. */
+    mqd_t queue;                             /* Message queue used by the other Posix_Ota*Event functions. */
+};
+
+/* OTA Timer, an entry on the timer wheel.*/
+typedef struct OtaWheelTimer
+{
+    struct OtaWheelTimer * pNext; /* Next timer in the same wheel slot. */
+    struct OtaWheelTimer * pPrev; /* Previous timer in the same wheel slot. */
+    uint64_t expiryTick;          /* Wheel tick at which the timer expires. */
+    OtaTimerCallback_t callback;  /* Callback invoked when the timer expires. */
+    void * pCallbackContext;      /* Context passed to the callback. */
+    OtaTimerId_t timerId;         /* Timer ID passed to the callback. */
+    bool created;                 /* Whether the timer was started and not deleted since. */
+    bool armed;                   /* Whether the timer is on the wheel. */
+} OtaWheelTimer_t;
+
+/**
+ * @brief The timers of one OTA agent. Must be zero-initialized before first use. A NULL
+ * timer context selects a default one shared by all agents that do not set their own.
+ *
+ * The timers of all contexts run on one timer wheel and service thread for the
+ * process. Each timer is owned by its context, only the wheel is shared.
+ */
 struct OtaTimerContext
 {
-    timer_t timer;
-    OtaTimerId_t timerId;
+    OtaWheelTimer_t timers[ OtaNumOfTimers ]; /* One timer per timer ID. */
 };
 
 /**
  * @brief Initialize the OTA events.
  *
  * This function initializes the OTA events mechanism for POSIX platforms.
+ * Each event context gets its own message queue, named after the process ID
+ * and the address of the context.
  *
  * @param[pEventCtx]     Pointer to the OTA event context.
  *
@@ -57,6 +160,8 @@ OtaOsStatus_t Posix_OtaInitEvent( OtaEventContext_t * pEventCtx );
  * @brief Sends an OTA event.
  *
  * This function sends an event to OTA library event handler for POSIX platforms.
+ * The message priority is taken from the OtaEventLane_t of the event, so the
+ * receiver gets control events before timer events before data events.
  *
  * @param[pEventCtx]     Pointer to the OTA event context.
  *
@@ -79,9 +184,12 @@ OtaOsStatus_t Posix_OtaSendEvent( OtaEventContext_t * pEventCtx,
  *
  * @param[pEventMsg]     Pointer to store message.
  *
- * @param[timeout]       The maximum amount of time the task should block.
+ * @param[timeout]       The maximum amount of time (msec) the task should block.
+ *                       Zero blocks until an event is received.
  *
- * @return               OtaOsStatus_t, OtaOsSuccess if success , other error code on failure.
+ * @return               OtaOsStatus_t, OtaOsSuccess if success,
+ *                       OtaOsEventQueueReceiveTimeout if the timeout expired first,
+ *                       other error code on failure.
  */
 OtaOsStatus_t Posix_OtaReceiveEvent( OtaEventContext_t * pEventCtx,
                                      void * pEventMsg,
@@ -99,48 +207,193 @@ OtaOsStatus_t Posix_OtaReceiveEvent( OtaEventContext_t * pEventCtx,
  */
 OtaOsStatus_t Posix_OtaDeinitEvent( OtaEventContext_t * pEventCtx );
 
+/**
+ * @brief Initialize the OTA events ring.
+ *
+ * This function initializes an in-process alternative to the POSIX message queue
+ * events. The ring has a lane of OTA_EVENT_RING_SIZE events for each OtaEventLane_t,
+ * has no system-wide name and sends an event without a system call unless the
+ * receiver is waiting. Use it by setting the Posix_Ota*EventRing functions in
+ * OtaEventInterface_t. Each event context has its own ring.
+ *
+ * @param[pEventCtx]     Pointer to the OTA event context.
+ *
+ * @return               OtaOsStatus_t, OtaOsSuccess if success , other error code on failure.
+ */
+OtaOsStatus_t Posix_OtaInitEventRing( OtaEventContext_t * pEventCtx );
+
+/**
+ * @brief Sends an OTA event through the events ring.
+ *
+ * This function can be called from any number of threads. It does not block and
+ * fails if the lane of the event is full.
+ *
+ * @param[pEventCtx]     Pointer to the OTA event context.
+ *
+ * @param[pEventMsg]     Event to be sent to the OTA handler.
+ *
+ * @param[timeout]       Unused.
+ *
+ * @return               OtaOsStatus_t, OtaOsSuccess if success , other error code on failure.
+ */
+OtaOsStatus_t Posix_OtaSendEventRing( OtaEventContext_t * pEventCtx,
+                                      const void * pEventMsg,
+                                      unsigned int timeout );
+
+/**
+ * @brief Receive an OTA event from the events ring.
+ *
+ * This function must only be called from the OTA agent task. It blocks until an
+ * event is available or the timeout expires, and returns the oldest event of the
+ * highest priority lane that is not empty.
+ *
+ * @param[pEventCtx]     Pointer to the OTA event context.
+ *
+ * @param[pEventMsg]     Pointer to store message.
+ *
+ * @param[timeout]       The maximum amount of time (msec) the task should block.
+ *                       Zero blocks until an event is received.
+ *
+ * @return               OtaOsStatus_t, OtaOsSuccess if success,
+ *                       OtaOsEventQueueReceiveTimeout if the timeout expired first,
+ *                       other error code on failure.
+ */
+OtaOsStatus_t Posix_OtaReceiveEventRing( OtaEventContext_t * pEventCtx,
+                                         void * pEventMsg,
+                                         uint32_t timeout );
+
+/**
+ * @brief Receive a batch of OTA events from the events ring.
+ *
+ * This function must only be called from the OTA agent task. It blocks until an
+ * event is available and then also takes up to maxEvents - 1 events that are
+ * already pending, in the order Posix_OtaReceiveEventRing would return them.
+ *
+ * @param[pEventCtx]     Pointer to the OTA event context.
+ *
+ * @param[pEventMsgs]    Array of maxEvents messages to store the events in.
+ *
+ * @param[maxEvents]     The maximum number of events to receive.
+ *
+ * @param[pNumEvents]    Set to the number of events received.
+ *
+ * @param[timeout]       The maximum amount of time (msec) the task should block.
+ *                       Zero blocks until an event is received.
+ *
+ * @return               OtaOsStatus_t, OtaOsSuccess if success,
+ *                       OtaOsEventQueueReceiveTimeout if the timeout expired first,
+ *                       other error code on failure.
+ */
+OtaOsStatus_t Posix_OtaReceiveEventBatchRing( OtaEventContext_t * pEventCtx,
+                                              void * pEventMsgs,
+                                              uint32_t maxEvents,
+                                              uint32_t * pNumEvents,
+                                              uint32_t timeout );
+
+/**
+ * @brief Deinitialize the OTA events ring.
+ *
+ * @param[pEventCtx]     Pointer to the OTA event context.
+ *
+ * @return               OtaOsStatus_t, OtaOsSuccess if success , other error code on failure.
+ */
+OtaOsStatus_t Posix_OtaDeinitEventRing( OtaEventContext_t * pEventCtx );
+
+/**
+ * @brief Signal that the OTA agent has shut down.
+ *
+ * This function wakes up every task waiting in Posix_OtaWaitShutdown on the
+ * same event context. The signal of the context is created and cleared by
+ * Posix_OtaInitEvent and Posix_OtaInitEventRing.
+ *
+ * @param[pEventCtx]     Pointer to the OTA event context.
+ *
+ * @return               OtaOsStatus_t, OtaOsSuccess if success , other error code on failure.
+ */
+OtaOsStatus_t Posix_OtaSignalShutdown( OtaEventContext_t * pEventCtx );
+
+/**
+ * @brief Wait for the OTA agent to shut down.
+ *
+ * This function blocks on a condition variable until Posix_OtaSignalShutdown
+ * is called or the timeout expires. The timeout is measured on CLOCK_MONOTONIC.
+ *
+ * @param[pEventCtx]     Pointer to the OTA event context.
+ *
+ * @param[timeout]       The maximum amount of time (msec) to wait.
+ *
+ * @return               OtaOsStatus_t, OtaOsSuccess if the agent has shut down,
+ *                       OtaOsShutdownWaitFailed if the timeout expired first.
+ */
+OtaOsStatus_t Posix_OtaWaitShutdown( OtaEventContext_t * pEventCtx,
+                                     uint32_t timeout );
+
 
 /**
  * @brief Start timer.
  *
  * This function starts the timer or resets it if it is already started for POSIX platforms.
+ * All timers are kept on a single timer wheel, which a service thread advances on
+ * CLOCK_MONOTONIC every OTA_TIMER_WHEEL_TICK_MS while any timer is running. Callbacks
+ * are invoked from that thread.
+ *
+ * @param[pTimerCtx]        Pointer to the OTA timer context.
  *
  * @param[otaTimerId]       Timer ID of type otaTimerId_t.
  *
  * @param[pTimerName]       Timer name.
  *
- * @param[timeout]          Timeout for the timer.
+ * @param[timeout]          Timeout for the timer in milliseconds.
  *
  * @param[callback]         Callback to be called when timer expires.
  *
+ * @param[pCallbackContext] Context pointer to pass to the callback.
+ *
  * @return                  OtaOsStatus_t, OtaOsSuccess if success , other error code on failure.
  */
-OtaOsStatus_t Posix_OtaStartTimer( OtaTimerId_t otaTimerId,
+OtaOsStatus_t Posix_OtaStartTimer( OtaTimerContext_t * pTimerCtx,
+                                   OtaTimerId_t otaTimerId,
                                    const char * const pTimerName,
                                    const uint32_t timeout,
-                                   OtaTimerCallback_t callback );
+                                   OtaTimerCallback_t callback,
+                                   void * pCallbackContext );
 
 /**
  * @brief Stop timer.
  *
  * This function stops the timer fro POSIX platforms.
  *
+ * @param[pTimerCtx]      Pointer to the OTA timer context.
+ *
  * @param[otaTimerId]     Timer ID of type otaTimerId_t.
  *
  * @return                OtaOsStatus_t, OtaOsSuccess if success , other error code on failure.
  */
-OtaOsStatus_t Posix_OtaStopTimer( OtaTimerId_t otaTimerId );
+OtaOsStatus_t Posix_OtaStopTimer( OtaTimerContext_t * pTimerCtx,
+                                  OtaTimerId_t otaTimerId );
 
 /**
  * @brief Delete a timer.
  *
  * This function deletes a timer for POSIX platforms.
  *
+ * @param[pTimerCtx]        Pointer to the OTA timer context.
+ *
  * @param[otaTimerId]       Timer ID of type otaTimerId_t.
  *
  * @return                  OtaOsStatus_t, OtaOsSuccess if success , other error code on failure.
  */
-OtaOsStatus_t Posix_OtaDeleteTimer( OtaTimerId_t otaTimerId );
+OtaOsStatus_t Posix_OtaDeleteTimer( OtaTimerContext_t * pTimerCtx,
+                                    OtaTimerId_t otaTimerId );
+
+/**
+ * @brief Get the current time.
+ *
+ * This function returns the time in milliseconds on CLOCK_MONOTONIC for POSIX platforms.
+ *
+ * @return                  Current time in milliseconds.
+ */
+uint32_t Posix_OtaGetTimeMs( void );
 
 /**
  * @brief Allocate memory.
@@ -140,6 +140,24 @@
 #define BASE64_INVALID_DATA_PADDING_AT_MIDDLE_ENCODED                 "Rk9P=QkFS"
 #define BASE64_INVALID_DATA_PADDING_AT_MIDDLE_ENCODED_LEN             ( sizeof( BASE64_INVALID_DATA_PADDING_AT_MIDDLE_ENCODED ) - 1U )
 
+/* Encoded data that is long enough to be decoded in blocks of sixteen symbols before the
+ * remaining symbols and the padding are decoded one at a time. */
+#define BASE64_VALID_DATA_LONG_ENCODED                                "VGhlIHF1aWNrIGJyb3duIGZveCBqdW1wcyBvdmVyIHRoZSBsYXp5IGRvZy4="
+#define BASE64_VALID_DATA_LONG_ENCODED_LEN                            ( sizeof( BASE64_VALID_DATA_LONG_ENCODED ) - 1U )
+#define BASE64_VALID_DATA_LONG_DECODED                                "The quick brown fox jumps over the lazy dog."
+#define BASE64_VALID_DATA_LONG_DECODED_LEN                            ( sizeof( BASE64_VALID_DATA_LONG_DECODED ) - 1U )
+
+/* The long encoded data split into lines, so the block decoder has to stop at the newlines. */
+#define BASE64_VALID_DATA_LONG_CRLF_ENCODED                           "VGhlIHF1aWNrIGJyb3du\r\nIGZveCBqdW1wcyBvdmVy\r\nIHRoZSBsYXp5IGRvZy4="
+#define BASE64_VALID_DATA_LONG_CRLF_ENCODED_LEN                       ( sizeof( BASE64_VALID_DATA_LONG_CRLF_ENCODED ) - 1U )
+
+/* The long encoded data with an invalid symbol inside of the first block of sixteen symbols. */
+#define BASE64_INVALID_DATA_LONG_ENCODED                              "VGhlI*F1aWNrIGJyb3duIGZveCBqdW1wcyBvdmVyIHRoZSBsYXp5IGRvZy4="
+#define BASE64_INVALID_DATA_LONG_ENCODED_LEN                          ( sizeof( BASE64_INVALID_DATA_LONG_ENCODED ) - 1U )
+
+/* Buffer size that is large enough to hold the result of decoding the long test strings. */
+#define BASE64_LONG_TEST_DECODING_BUFFER_SIZE                         64
+
 /* ============================   UNITY FIXTURES ============================ */
 
 void setUp( void )
@@ -655,4 +673,170 @@ void test_OTA_base64Decode_InvalidPaddingPlacement( void )
     TEST_ASSERT_EQUAL_INT( Base64InvalidSymbolOrdering, result );
 }
 
+/**
+ * @brief Test that base64Decode decodes data that is long enough to be decoded
+ *        in blocks, including when the blocks are interrupted by newlines.
+ */
+void test_OTA_base64Decode_ValidLongData( void )
+{
+    uint8_t pDecodedResultBuffer[ BASE64_LONG_TEST_DECODING_BUFFER_SIZE ] = { 0 };
+    size_t resultLen = 0;
+    int result = 0;
+
+    result = base64Decode( pDecodedResultBuffer,
+                           BASE64_LONG_TEST_DECODING_BUFFER_SIZE,
+                           &resultLen,
+                           ( const uint8_t * ) BASE64_VALID_DATA_LONG_ENCODED,
+                           BASE64_VALID_DATA_LONG_ENCODED_LEN );
+
+    TEST_ASSERT_EQUAL_INT( Base64Success, result );
+    TEST_ASSERT_EQUAL_INT( BASE64_VALID_DATA_LONG_DECODED_LEN, resultLen );
+    TEST_ASSERT_EQUAL_STRING_LEN( BASE64_VALID_DATA_LONG_DECODED, pDecodedResultBuffer, resultLen );
+
+    resultLen = 0;
+    memset( pDecodedResultBuffer, '\0', sizeof( pDecodedResultBuffer ) );
+    result = base64Decode( pDecodedResultBuffer,
+                           BASE64_LONG_TEST_DECODING_BUFFER_SIZE,
+                           &resultLen,
+                           ( const uint8_t * ) BASE64_VALID_DATA_LONG_CRLF_ENCODED,
+                           BASE64_VALID_DATA_LONG_CRLF_ENCODED_LEN );
+
+    TEST_ASSERT_EQUAL_INT( Base64Success, result );
+    TEST_ASSERT_EQUAL_INT( BASE64_VALID_DATA_LONG_DECODED_LEN, resultLen );
+    TEST_ASSERT_EQUAL_STRING_LEN( BASE64_VALID_DATA_LONG_DECODED, pDecodedResultBuffer, resultLen );
+}
+
+/**
+ * @brief Test that base64Decode reports errors in data that is long enough to
+ *        be decoded in blocks the same way as in short data.
+ */
+void test_OTA_base64Decode_InvalidLongData( void )
+{
+    uint8_t pDecodedResultBuffer[ BASE64_LONG_TEST_DECODING_BUFFER_SIZE ] = { 0 };
+    size_t resultLen = 0;
+    int result = 0;
+
+    /* Test for an invalid symbol inside of a block. */
+    result = base64Decode( pDecodedResultBuffer,
+                           BASE64_LONG_TEST_DECODING_BUFFER_SIZE,
+                           &resultLen,
+                           ( const uint8_t * ) BASE64_INVALID_DATA_LONG_ENCODED,
+                           BASE64_INVALID_DATA_LONG_ENCODED_LEN );
+    TEST_ASSERT_EQUAL_INT( Base64InvalidSymbol, result );
+
+    /* Test for a destination buffer that is too small for the whole decoded data. */
+    result = base64Decode( pDecodedResultBuffer,
+                           BASE64_VALID_DATA_LONG_DECODED_LEN - 1U,
+                           &resultLen,
+                           ( const uint8_t * ) BASE64_VALID_DATA_LONG_ENCODED,
+                           BASE64_VALID_DATA_LONG_ENCODED_LEN );
+    TEST_ASSERT_EQUAL_INT( Base64InvalidBufferSize, result );
+
+    /* Test for a destination buffer that is too small for the first block. */
+    result = base64Decode( pDecodedResultBuffer,
+                           2U,
+                           &resultLen,
+                           ( const uint8_t * ) BASE64_VALID_DATA_LONG_ENCODED,
+                           BASE64_VALID_DATA_LONG_ENCODED_LEN );
+    TEST_ASSERT_EQUAL_INT( Base64InvalidBufferSize, result );
+}
+
+/**
+ * @brief Test that base64Encode produces padded Base64 that round trips through base64Decode.
+ */
+void test_OTA_base64Encode_ValidData( void )
+{
+    uint8_t pEncodedResultBuffer[ BASE64_LONG_TEST_DECODING_BUFFER_SIZE ] = { 0 };
+    size_t resultLen = 0;
+    int result = 0;
+
+    /* Test encoding with two padding symbols. */
+    result = base64Encode( pEncodedResultBuffer,
+                           BASE64_LONG_TEST_DECODING_BUFFER_SIZE,
+                           &resultLen,
+                           ( const uint8_t * ) BASE64_VALID_DATA_TWO_PADDING_DECODED,
+                           BASE64_VALID_DATA_TWO_PADDING_DECODED_LEN );
+    TEST_ASSERT_EQUAL_INT( Base64Success, result );
+    TEST_ASSERT_EQUAL_INT( BASE64_VALID_DATA_TWO_PADDING_ENCODED_LEN, resultLen );
+    TEST_ASSERT_EQUAL_STRING_LEN( BASE64_VALID_DATA_TWO_PADDING_ENCODED, pEncodedResultBuffer, resultLen );
+
+    /* Test encoding with one padding symbol. */
+    result = base64Encode( pEncodedResultBuffer,
+                           BASE64_LONG_TEST_DECODING_BUFFER_SIZE,
+                           &resultLen,
+                           ( const uint8_t * ) BASE64_VALID_DATA_ONE_PADDING_DECODED,
+                           BASE64_VALID_DATA_ONE_PADDING_DECODED_LEN );
+    TEST_ASSERT_EQUAL_INT( Base64Success, result );
+    TEST_ASSERT_EQUAL_INT( BASE64_VALID_DATA_ONE_PADDING_ENCODED_LEN, resultLen );
+    TEST_ASSERT_EQUAL_STRING_LEN( BASE64_VALID_DATA_ONE_PADDING_ENCODED, pEncodedResultBuffer, resultLen );
+
+    /* Test encoding without padding symbols into a buffer of the exact size. */
+    result = base64Encode( pEncodedResultBuffer,
+                           BASE64_VALID_DATA_ZERO_PADDING_ENCODED_LEN,
+                           &resultLen,
+                           ( const uint8_t * ) BASE64_VALID_DATA_ZERO_PADDING_DECODED,
+                           BASE64_VALID_DATA_ZERO_PADDING_DECODED_LEN );
+    TEST_ASSERT_EQUAL_INT( Base64Success, result );
+    TEST_ASSERT_EQUAL_INT( BASE64_VALID_DATA_ZERO_PADDING_ENCODED_LEN, resultLen );
+    TEST_ASSERT_EQUAL_STRING_LEN( BASE64_VALID_DATA_ZERO_PADDING_ENCODED, pEncodedResultBuffer, resultLen );
+
+    /* Test encoding long data. */
+    result = base64Encode( pEncodedResultBuffer,
+                           BASE64_LONG_TEST_DECODING_BUFFER_SIZE,
+                           &resultLen,
+                           ( const uint8_t * ) BASE64_VALID_DATA_LONG_DECODED,
+                           BASE64_VALID_DATA_LONG_DECODED_LEN );
+    TEST_ASSERT_EQUAL_INT( Base64Success, result );
+    TEST_ASSERT_EQUAL_INT( BASE64_VALID_DATA_LONG_ENCODED_LEN, resultLen );
+    TEST_ASSERT_EQUAL_STRING_LEN( BASE64_VALID_DATA_LONG_ENCODED, pEncodedResultBuffer, resultLen );
+
+    /* Test encoding no data. */
+    result = base64Encode( pEncodedResultBuffer,
+                           BASE64_LONG_TEST_DECODING_BUFFER_SIZE,
+                           &resultLen,
+                           NULL,
+                           0U );
+    TEST_ASSERT_EQUAL_INT( Base64Success, result );
+    TEST_ASSERT_EQUAL_INT( 0, resultLen );
+}
+
+/**
+ * @brief Test that base64Encode rejects invalid parameters.
+ */
+void test_OTA_base64Encode_InvalidParameters( void )
+{
+    uint8_t pEncodedResultBuffer[ BASE64_LONG_TEST_DECODING_BUFFER_SIZE ] = { 0 };
+    size_t resultLen = 0;
+    int result = 0;
+
+    result = base64Encode( NULL,
+                           BASE64_LONG_TEST_DECODING_BUFFER_SIZE,
+                           &resultLen,
+                           ( const uint8_t * ) BASE64_VALID_DATA_DECODED,
+                           BASE64_VALID_DATA_DECODED_LEN );
+    TEST_ASSERT_EQUAL_INT( Base64NullPointerInput, result );
+
+    result = base64Encode( pEncodedResultBuffer,
+                           BASE64_LONG_TEST_DECODING_BUFFER_SIZE,
+                           NULL,
+                           ( const uint8_t * ) BASE64_VALID_DATA_DECODED,
+                           BASE64_VALID_DATA_DECODED_LEN );
+    TEST_ASSERT_EQUAL_INT( Base64NullPointerInput, result );
+
+    result = base64Encode( pEncodedResultBuffer,
+                           BASE64_LONG_TEST_DECODING_BUFFER_SIZE,
+                           &resultLen,
+                           NULL,
+                           BASE64_VALID_DATA_DECODED_LEN );
+    TEST_ASSERT_EQUAL_INT( Base64NullPointerInput, result );
+
+    /* Test for a destination buffer that is one symbol too small. */
+    result = base64Encode( pEncodedResultBuffer,
+                           BASE64_VALID_DATA_ENCODED_LEN - 1U,
+                           &resultLen,
+                           ( const uint8_t * ) BASE64_VALID_DATA_DECODED,
+                           BASE64_VALID_DATA_DECODED_LEN );
+    TEST_ASSERT_EQUAL_INT( Base64InvalidBufferSize, result );
+}
+
 /* ========================================================================== */
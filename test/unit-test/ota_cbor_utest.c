@@ -85,6 +85,86 @@ void test_OTA_CborEncodeStreamRequest()
     }
 }
 
+/**
+ * @brief Test that a message encoded from a prefix and the block members is
+ * the same as a message encoded at once.
+ */
+void test_OTA_CborEncodeStreamRequestFromPrefix()
+{
+    uint8_t cborWork[ CBOR_TEST_MESSAGE_BUFFER_SIZE ];
+    uint8_t expectedData[ CBOR_TEST_MESSAGE_BUFFER_SIZE ];
+    size_t expectedSize = 0;
+    size_t prefixSize = 0;
+    size_t encodedSize = 0;
+    uint32_t bitmap = CBOR_TEST_BITMAP_VALUE;
+    bool result = false;
+
+    result = OTA_CBOR_Encode_GetStreamRequestMessage( expectedData,
+                                                      sizeof( expectedData ),
+                                                      &expectedSize,
+                                                      CBOR_TEST_CLIENTTOKEN_VALUE,
+                                                      1,
+                                                      OTA_FILE_BLOCK_SIZE,
+                                                      0,
+                                                      ( uint8_t * ) &bitmap,
+                                                      sizeof( bitmap ),
+                                                      otaconfigMAX_NUM_BLOCKS_REQUEST );
+    TEST_ASSERT_TRUE( result );
+
+    result = OTA_CBOR_Encode_GetStreamRequestPrefix( cborWork,
+                                                     sizeof( cborWork ),
+                                                     &prefixSize,
+                                                     CBOR_TEST_CLIENTTOKEN_VALUE,
+                                                     1,
+                                                     OTA_FILE_BLOCK_SIZE );
+    TEST_ASSERT_TRUE( result );
+    TEST_ASSERT_LESS_THAN( expectedSize, prefixSize );
+
+    /* The prefix can be completed any number of times. */
+    result = OTA_CBOR_Encode_GetStreamRequestBlocks( cborWork,
+                                                     sizeof( cborWork ),
+                                                     prefixSize,
+                                                     &encodedSize,
+                                                     0,
+                                                     ( uint8_t * ) &bitmap,
+                                                     sizeof( bitmap ),
+                                                     1 );
+    TEST_ASSERT_TRUE( result );
+
+    result = OTA_CBOR_Encode_GetStreamRequestBlocks( cborWork,
+                                                     sizeof( cborWork ),
+                                                     prefixSize,
+                                                     &encodedSize,
+                                                     0,
+                                                     ( uint8_t * ) &bitmap,
+                                                     sizeof( bitmap ),
+                                                     otaconfigMAX_NUM_BLOCKS_REQUEST );
+    TEST_ASSERT_TRUE( result );
+    TEST_ASSERT_EQUAL( expectedSize, encodedSize );
+    TEST_ASSERT_EQUAL_MEMORY( expectedData, cborWork, expectedSize );
+
+    /* The block members need the bitmap and must fit after the prefix. */
+    result = OTA_CBOR_Encode_GetStreamRequestBlocks( cborWork,
+                                                     sizeof( cborWork ),
+                                                     prefixSize,
+                                                     &encodedSize,
+                                                     0,
+                                                     NULL,
+                                                     sizeof( bitmap ),
+                                                     otaconfigMAX_NUM_BLOCKS_REQUEST );
+    TEST_ASSERT_FALSE( result );
+
+    result = OTA_CBOR_Encode_GetStreamRequestBlocks( cborWork,
+                                                     prefixSize,
+                                                     prefixSize + 1U,
+                                                     &encodedSize,
+                                                     0,
+                                                     ( uint8_t * ) &bitmap,
+                                                     sizeof( bitmap ),
+                                                     otaconfigMAX_NUM_BLOCKS_REQUEST );
+    TEST_ASSERT_FALSE( result );
+}
+
 /**
  * @brief Test OTA_CBOR_Decode_GetStreamResponseMessage() decodes a message correctly.
  *
@@ -31,8 +31,14 @@
 /* Enable both MQTT and HTTP in unit tests. */
 #define configENABLED_DATA_PROTOCOLS            ( OTA_DATA_OVER_MQTT | OTA_DATA_OVER_HTTP )
 
-/* Call status update for every block that we received so that we can hit some internal routines. */
-#define otaconfigOTA_UPDATE_STATUS_FREQUENCY    2
+/* Report progress for every block that we received so that we can hit some internal routines.
+ * The intervals only apply in tests that provide a clock. */
+#define otaconfigPROGRESS_MIN_INTERVAL_MS       100U
+#define otaconfigPROGRESS_MAX_INTERVAL_MS       1000U
+#define otaconfigPROGRESS_PERCENT_STEP          1U
+
+/* Index custom job documents so that the indexing path is covered. */
+#define otaconfigCUSTOM_JOB_DOC_INDEX           1U
 
 /* Lower request momentum so that retry fails faster. */
 #define otaconfigMAX_NUM_REQUEST_MOMENTUM       3
@@ -40,6 +46,13 @@
 /* Use larger number of blocks per mqtt request to increase branch coverage. */
 #define otaconfigMAX_NUM_BLOCKS_REQUEST         4
 
+/* Use a small event buffer pool with backpressure so that exhaustion is easy to test. */
+#define otaconfigEVENT_BUFFER_POOL_SIZE         2U
+#define otaconfigEVENT_BUFFER_BACKPRESSURE      1U
+
+/* Wake the agent up periodically so that the idle path is exercised. */
+#define otaconfigAGENT_IDLE_PERIOD_MS           10U
+
 #define LOG_LEVEL_ERROR                         0
 #define LOG_LEVEL_WARN                          1
 #define LOG_LEVEL_INFO                          2
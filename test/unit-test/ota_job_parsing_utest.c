@@ -97,7 +97,7 @@ void setUp( void )
     otaAgent.pOtaInterface = &otaInterfaces;
 
     /* Initialize OTA local static buffer. */
-    initializeLocalBuffers();
+    initializeLocalBuffers( &otaAgent );
 }
 
 void tearDown( void )
@@ -112,7 +112,7 @@ void tearDown( void )
 void test_OTA_JobParsing_Valid_Parse_Job_Doc( void )
 {
     bool updateJob;
-    OtaFileContext_t * pFileContext = parseJobDoc( JOB_PARSING_VALID_JSON, JOB_PARSING_VALID_JSON_LENGTH, &updateJob );
+    OtaFileContext_t * pFileContext = parseJobDoc( &otaAgent, JOB_PARSING_VALID_JSON, JOB_PARSING_VALID_JSON_LENGTH, &updateJob );
 
     TEST_ASSERT_NOT_NULL( pFileContext );
 }
@@ -130,7 +130,7 @@ void test_OTA_JobParsing_Valid_JSON( void )
                         &otaAgent.fileContext,
                         sizeof( OtaFileContext_t ),
                         OTA_NUM_JOB_PARAMS );
-    err = parseJSONbyModel( JOB_PARSING_VALID_JSON, JOB_PARSING_VALID_JSON_LENGTH, &otaJobDocModel );
+    err = parseJSONbyModel( &otaAgent, JOB_PARSING_VALID_JSON, JOB_PARSING_VALID_JSON_LENGTH, &otaJobDocModel );
 
     TEST_ASSERT_EQUAL( DocParseErrNone, err );
 }
@@ -150,22 +150,22 @@ void test_OTA_JobParsing_Invalid_JSON( void )
                         sizeof( OtaFileContext_t ),
                         OTA_NUM_JOB_PARAMS );
 
-    err = parseJSONbyModel( JOB_PARSING_MALFORMED_JSON, JOB_PARSING_MALFORMED_JSON_LENGTH, &otaJobDocModel );
+    err = parseJSONbyModel( &otaAgent, JOB_PARSING_MALFORMED_JSON, JOB_PARSING_MALFORMED_JSON_LENGTH, &otaJobDocModel );
     TEST_ASSERT_EQUAL( DocParseErr_InvalidJSONBuffer, err );
 
-    err = parseJSONbyModel( NULL, 0, &otaJobDocModel );
+    err = parseJSONbyModel( &otaAgent, NULL, 0, &otaJobDocModel );
     TEST_ASSERT_EQUAL( DocParseErrNullDocPointer, err );
 
     memcpy( &otaJobDocModelCopy, &otaJobDocModel, sizeof( JsonDocModel_t ) );
-    err = parseJSONbyModel( JOB_PARSING_INVALID_JSON_MISSING_JOBID, JOB_PARSING_INVALID_JSON_MISSING_JOBID_LENGTH, &otaJobDocModelCopy );
+    err = parseJSONbyModel( &otaAgent, JOB_PARSING_INVALID_JSON_MISSING_JOBID, JOB_PARSING_INVALID_JSON_MISSING_JOBID_LENGTH, &otaJobDocModelCopy );
     TEST_ASSERT_EQUAL( DocParseErrMalformedDoc, err );
 
     memcpy( &otaJobDocModelCopy, &otaJobDocModel, sizeof( JsonDocModel_t ) );
-    err = parseJSONbyModel( JOB_PARSING_INVALID_JSON_INVALID_BASE64KEY, JOB_PARSING_INVALID_JSON_INVALID_BASE64KEY_LENGTH, &otaJobDocModelCopy );
+    err = parseJSONbyModel( &otaAgent, JOB_PARSING_INVALID_JSON_INVALID_BASE64KEY, JOB_PARSING_INVALID_JSON_INVALID_BASE64KEY_LENGTH, &otaJobDocModelCopy );
     TEST_ASSERT_EQUAL( DocParseErrBase64Decode, err );
 
     memcpy( &otaJobDocModelCopy, &otaJobDocModel, sizeof( JsonDocModel_t ) );
-    err = parseJSONbyModel( JOB_PARSING_INVALID_JSON_INVALID_NUMERIC, JOB_PARSING_INVALID_JSON_INVALID_NUMERIC_LENGTH, &otaJobDocModelCopy );
+    err = parseJSONbyModel( &otaAgent, JOB_PARSING_INVALID_JSON_INVALID_NUMERIC, JOB_PARSING_INVALID_JSON_INVALID_NUMERIC_LENGTH, &otaJobDocModelCopy );
     TEST_ASSERT_EQUAL( DocParseErrInvalidNumChar, err );
 }
 
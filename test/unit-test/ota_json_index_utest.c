@@ -0,0 +1,322 @@
+/*
+ * AWS IoT Over-the-air Update v2.0.0 (Release Candidate)
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file ota_json_index_utest.c
+ * @brief Unit tests for functions in ota_json_index.c
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include "unity.h"
+
+/* For accessing OTA private functions and error codes. */
+#include "ota_json_index_private.h"
+
+/* Testing Constants. */
+
+/* A custom job message as received from the job service. */
+#define JSON_CUSTOM_JOB_MSG                                                        \
+    "{\"clientToken\":\"0:testclient\",\"timestamp\":1602795143,"                  \
+    "\"execution\":{\"jobId\":\"custom-job-1\",\"status\":\"QUEUED\","             \
+    "\"statusDetails\":{},\"queuedAt\":1602795128,\"versionNumber\":1,"            \
+    "\"jobDocument\":{\"operation\":\"reboot\",\"delay\" : 30 ,"                   \
+    "\"targets\":[\"a\",{\"b\":\"}\"}],\"escaped\":\"x\\\"y\"}}}"
+#define JSON_CUSTOM_JOB_MSG_LEN    ( sizeof( JSON_CUSTOM_JOB_MSG ) - 1U )
+
+/* A document with objects nested deeper than the index follows. */
+#define JSON_DEEP_MSG              "{\"a\":{\"b\":{\"c\":{\"d\":{\"e\":{\"f\":{\"g\":{\"h\":{\"i\":1}}}}}}}},\"z\":2}"
+#define JSON_DEEP_MSG_LEN          ( sizeof( JSON_DEEP_MSG ) - 1U )
+
+/* Number of random mutations of the job message checked against JSON_Validate. */
+#define JSON_VALIDATE_NUM_MUTATIONS    20000U
+
+/* Size of the buffer for a document with more members than the index holds. */
+#define JSON_LARGE_MSG_SIZE        ( 16U * ( otaconfigMAX_JOB_DOC_INDEX_ENTRIES + 1U ) + 2U )
+
+static OtaJobDocIndex_t jobDocIndex;
+
+/* ============================   UNITY FIXTURES ============================ */
+
+void setUp( void )
+{
+    ( void ) memset( &jobDocIndex, 0, sizeof( jobDocIndex ) );
+}
+
+void tearDown( void )
+{
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Look up a key and check the value span.
+ */
+static void lookupAndCheck( const char * pKeyPath,
+                            const char * pExpectedValue )
+{
+    const char * pValue = NULL;
+    size_t valueLength = 0;
+
+    TEST_ASSERT_EQUAL( OtaJobDocIndexSuccess,
+                       OTA_JobDocIndexLookup( &jobDocIndex,
+                                              pKeyPath,
+                                              strlen( pKeyPath ),
+                                              &pValue,
+                                              &valueLength ) );
+    TEST_ASSERT_EQUAL( strlen( pExpectedValue ), valueLength );
+    TEST_ASSERT_EQUAL_STRING_LEN( pExpectedValue, pValue, valueLength );
+}
+
+/**
+ * @brief Test that every member of a job message can be looked up by its key path.
+ */
+void test_OTA_jsonIndex_LookupNestedKeys( void )
+{
+    TEST_ASSERT_EQUAL( OtaJobDocIndexSuccess,
+                       jsonIndexBuild( &jobDocIndex, JSON_CUSTOM_JOB_MSG, JSON_CUSTOM_JOB_MSG_LEN ) );
+
+    lookupAndCheck( "clientToken", "0:testclient" );
+    lookupAndCheck( "timestamp", "1602795143" );
+    lookupAndCheck( "execution.jobId", "custom-job-1" );
+    lookupAndCheck( "execution.statusDetails", "{}" );
+    lookupAndCheck( "execution.jobDocument.operation", "reboot" );
+    lookupAndCheck( "execution.jobDocument.delay", "30" );
+    lookupAndCheck( "execution.jobDocument.targets", "[\"a\",{\"b\":\"}\"}]" );
+    lookupAndCheck( "execution.jobDocument.escaped", "x\\\"y" );
+    lookupAndCheck( "execution.jobDocument",
+                    "{\"operation\":\"reboot\",\"delay\" : 30 ,"
+                    "\"targets\":[\"a\",{\"b\":\"}\"}],\"escaped\":\"x\\\"y\"}" );
+}
+
+/**
+ * @brief Test that keys are only found at their full path.
+ */
+void test_OTA_jsonIndex_LookupNotFound( void )
+{
+    const char * pValue = NULL;
+    size_t valueLength = 0;
+
+    TEST_ASSERT_EQUAL( OtaJobDocIndexSuccess,
+                       jsonIndexBuild( &jobDocIndex, JSON_CUSTOM_JOB_MSG, JSON_CUSTOM_JOB_MSG_LEN ) );
+
+    TEST_ASSERT_EQUAL( OtaJobDocIndexNotFound,
+                       OTA_JobDocIndexLookup( &jobDocIndex, "jobId", strlen( "jobId" ), &pValue, &valueLength ) );
+    TEST_ASSERT_EQUAL( OtaJobDocIndexNotFound,
+                       OTA_JobDocIndexLookup( &jobDocIndex, "jobDocument.operation", strlen( "jobDocument.operation" ), &pValue, &valueLength ) );
+    TEST_ASSERT_EQUAL( OtaJobDocIndexNotFound,
+                       OTA_JobDocIndexLookup( &jobDocIndex, "execution.jobDocument.targets.b", strlen( "execution.jobDocument.targets.b" ), &pValue, &valueLength ) );
+    TEST_ASSERT_EQUAL( OtaJobDocIndexNotFound,
+                       OTA_JobDocIndexLookup( &jobDocIndex, "executionXjobId", strlen( "executionXjobId" ), &pValue, &valueLength ) );
+}
+
+/**
+ * @brief Test the parameter checks of the lookup.
+ */
+void test_OTA_jsonIndex_LookupNullParameters( void )
+{
+    const char * pValue = NULL;
+    size_t valueLength = 0;
+
+    TEST_ASSERT_EQUAL( OtaJobDocIndexNullParameter,
+                       OTA_JobDocIndexLookup( NULL, "a", 1U, &pValue, &valueLength ) );
+    TEST_ASSERT_EQUAL( OtaJobDocIndexNullParameter,
+                       OTA_JobDocIndexLookup( &jobDocIndex, NULL, 1U, &pValue, &valueLength ) );
+    TEST_ASSERT_EQUAL( OtaJobDocIndexNullParameter,
+                       OTA_JobDocIndexLookup( &jobDocIndex, "a", 0U, &pValue, &valueLength ) );
+    TEST_ASSERT_EQUAL( OtaJobDocIndexNullParameter,
+                       OTA_JobDocIndexLookup( &jobDocIndex, "a", 1U, NULL, &valueLength ) );
+    TEST_ASSERT_EQUAL( OtaJobDocIndexNullParameter,
+                       OTA_JobDocIndexLookup( &jobDocIndex, "a", 1U, &pValue, NULL ) );
+    TEST_ASSERT_EQUAL( OtaJobDocIndexNullParameter,
+                       jsonIndexBuild( NULL, JSON_DEEP_MSG, JSON_DEEP_MSG_LEN ) );
+    TEST_ASSERT_EQUAL( OtaJobDocIndexNullParameter,
+                       jsonIndexBuild( &jobDocIndex, NULL, JSON_DEEP_MSG_LEN ) );
+}
+
+/**
+ * @brief Test that documents which are not complete objects are rejected.
+ */
+void test_OTA_jsonIndex_MalformedDocuments( void )
+{
+    TEST_ASSERT_EQUAL( OtaJobDocIndexMalformedDoc, jsonIndexBuild( &jobDocIndex, "[1,2]", 5U ) );
+    TEST_ASSERT_EQUAL( OtaJobDocIndexMalformedDoc, jsonIndexBuild( &jobDocIndex, "   ", 3U ) );
+    TEST_ASSERT_EQUAL( OtaJobDocIndexMalformedDoc, jsonIndexBuild( &jobDocIndex, "{\"a\":1", 6U ) );
+    TEST_ASSERT_EQUAL( OtaJobDocIndexMalformedDoc, jsonIndexBuild( &jobDocIndex, "{\"a\" 1}", 7U ) );
+    TEST_ASSERT_EQUAL( OtaJobDocIndexMalformedDoc, jsonIndexBuild( &jobDocIndex, "{\"a:1}", 6U ) );
+    TEST_ASSERT_EQUAL( OtaJobDocIndexMalformedDoc, jsonIndexBuild( &jobDocIndex, "{\"a\":[1}", 8U ) );
+    TEST_ASSERT_EQUAL( OtaJobDocIndexMalformedDoc, jsonIndexBuild( &jobDocIndex, "{\"a\":}", 6U ) );
+    TEST_ASSERT_EQUAL( OtaJobDocIndexMalformedDoc, jsonIndexBuild( &jobDocIndex, "{1:2}", 5U ) );
+}
+
+/**
+ * @brief Test that objects nested too deep are kept as a single value.
+ */
+void test_OTA_jsonIndex_NestingTooDeep( void )
+{
+    const char * pValue = NULL;
+    size_t valueLength = 0;
+
+    TEST_ASSERT_EQUAL( OtaJobDocIndexFull,
+                       jsonIndexBuild( &jobDocIndex, JSON_DEEP_MSG, JSON_DEEP_MSG_LEN ) );
+
+    lookupAndCheck( "z", "2" );
+    lookupAndCheck( "a.b.c.d.e.f.g.h", "{\"i\":1}" );
+    TEST_ASSERT_EQUAL( OtaJobDocIndexFull,
+                       OTA_JobDocIndexLookup( &jobDocIndex, "a.b.c.d.e.f.g.h.i", strlen( "a.b.c.d.e.f.g.h.i" ), &pValue, &valueLength ) );
+}
+
+/**
+ * @brief Test that a document with more members than entries is partially indexed.
+ */
+void test_OTA_jsonIndex_TooManyMembers( void )
+{
+    char json[ JSON_LARGE_MSG_SIZE ];
+    char key[ 16 ];
+    size_t length = 0;
+    uint32_t i;
+    const char * pValue = NULL;
+    size_t valueLength = 0;
+
+    json[ length++ ] = '{';
+
+    for( i = 0; i <= otaconfigMAX_JOB_DOC_INDEX_ENTRIES; i++ )
+    {
+        length += ( size_t ) snprintf( &json[ length ], sizeof( json ) - length, "%s\"k%u\":%u",
+                                       ( i == 0U ) ? "" : ",", ( unsigned ) i, ( unsigned ) i );
+    }
+
+    json[ length++ ] = '}';
+
+    TEST_ASSERT_EQUAL( OtaJobDocIndexFull, jsonIndexBuild( &jobDocIndex, json, length ) );
+    TEST_ASSERT_EQUAL( otaconfigMAX_JOB_DOC_INDEX_ENTRIES, jobDocIndex.numEntries );
+
+    lookupAndCheck( "k0", "0" );
+
+    ( void ) snprintf( key, sizeof( key ), "k%u", ( unsigned ) otaconfigMAX_JOB_DOC_INDEX_ENTRIES );
+    TEST_ASSERT_EQUAL( OtaJobDocIndexFull,
+                       OTA_JobDocIndexLookup( &jobDocIndex, key, strlen( key ), &pValue, &valueLength ) );
+}
+
+/**
+ * @brief Check that jsonValidate and JSON_Validate agree on a document.
+ */
+static void validateAndCompare( const char * pJson,
+                                size_t length )
+{
+    TEST_ASSERT_EQUAL( JSON_Validate( pJson, length ), jsonValidate( pJson, length ) );
+}
+
+/**
+ * @brief Test that jsonValidate gives the same result as JSON_Validate.
+ */
+void test_OTA_jsonValidate_MatchesJsonValidate( void )
+{
+    static const char * documents[] =
+    {
+        JSON_CUSTOM_JOB_MSG,
+        JSON_DEEP_MSG,
+        "{}",
+        "[]",
+        " { \"a\" : [ 1 , -2.5e+3 , true , false , null , \"x\" ] } ",
+        "\"scalar\"",
+        "-0.5E-7",
+        "true",
+        "{\"a\":1,}",
+        "[1,]",
+        "[1,",
+        "{\"a\":1",
+        "{\"a\":",
+        "{\"a\"",
+        "{\"a\" 1}",
+        "{1:2}",
+        "{{}}",
+        "{\"a\":{},{}}",
+        "[1 2]",
+        "[01]",
+        "[1.]",
+        "[1e]",
+        "[-]",
+        "[tru]",
+        "[truex]",
+        "{\"a\":1}}",
+        "{\"a\":1]",
+        "]",
+        "{\"a\":1} x",
+        "   ",
+        "{\"\\u00e9\\ud83d\\ude00\\n\\/\\\\\"}",
+        "{\"\\ud83d\"}",
+        "{\"\\ude00\"}",
+        "{\"\\u12\"}",
+        "{\"\\x\"}",
+        "{\"\t\"}",
+        "{\"\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80\"}",
+        "{\"\xc0\x80\"}",
+        "{\"\xed\xa0\x80\"}",
+        "{\"\xe2\x82\"}",
+        "{\"\xf5\x80\x80\x80\"}",
+        "{\"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/=\":\"0123456789abcdef0123456789abcdef\x7f\"}",
+        "[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]",
+        "[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]",
+        "[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]"
+    };
+    size_t i;
+
+    for( i = 0; i < ( sizeof( documents ) / sizeof( documents[ 0 ] ) ); i++ )
+    {
+        validateAndCompare( documents[ i ], strlen( documents[ i ] ) );
+    }
+
+    /* Escaped control characters and embedded NULs. */
+    validateAndCompare( "{\"a\\\0\":1}", 10U );
+    validateAndCompare( "{\"a\0\":1}", 9U );
+    validateAndCompare( "{\"a\":1}\0", 8U );
+
+    TEST_ASSERT_EQUAL( JSONNullParameter, jsonValidate( NULL, 1U ) );
+    TEST_ASSERT_EQUAL( JSONBadParameter, jsonValidate( "{}", 0U ) );
+}
+
+/**
+ * @brief Test that jsonValidate gives the same result as JSON_Validate on
+ *        random mutations and truncations of a job message.
+ */
+void test_OTA_jsonValidate_MatchesJsonValidateMutated( void )
+{
+    static const char mutations[] = "{}[]\":,\\ 0-.eEtu\x01\x80\xc3\xe2";
+    char json[ JSON_CUSTOM_JOB_MSG_LEN ];
+    uint32_t seed = 1U;
+    uint32_t n;
+    size_t length;
+
+    for( n = 0; n < JSON_VALIDATE_NUM_MUTATIONS; n++ )
+    {
+        ( void ) memcpy( json, JSON_CUSTOM_JOB_MSG, JSON_CUSTOM_JOB_MSG_LEN );
+
+        /* A small linear congruential generator keeps the test repeatable. */
+        seed = ( seed * 1103515245U ) + 12345U;
+        json[ ( seed >> 8 ) % JSON_CUSTOM_JOB_MSG_LEN ] = mutations[ ( seed >> 20 ) % ( sizeof( mutations ) - 1U ) ];
+        seed = ( seed * 1103515245U ) + 12345U;
+        length = ( ( seed & 3U ) == 0U ) ? ( ( seed >> 8 ) % JSON_CUSTOM_JOB_MSG_LEN ) + 1U : JSON_CUSTOM_JOB_MSG_LEN;
+
+        validateAndCompare( json, length );
+    }
+}
@@ -27,7 +27,9 @@
 
 #include <string.h>
 #include <mqueue.h>
+#include <time.h>
 #include <unistd.h>
+#include <pthread.h>
 #include "unity.h"
 
 /* For accessing OTA private functions and error codes. */
@@ -37,17 +39,33 @@
 /* Testing constants. */
 #define TIMER_NAME             "dummy_name"
 #define OTA_DEFAULT_TIMEOUT    1000 /*!< Timeout in milliseconds. */
+#define OTA_SHORT_TIMEOUT      50   /*!< Sub-second timeout in milliseconds. */
+#define RING_PRODUCERS         4    /*!< Threads sending to the event ring. */
+#define RING_EVENTS            5000 /*!< Events sent by each thread. */
 
 /* Interfaces for Timer and Event. */
 static OtaTimerInterface_t timer;
 static OtaEventInterface_t event;
 static OtaEventContext_t * pEventContext = NULL;
 static bool timerCallbackInovked = false;
+static void * pTimerCallbackContext = NULL;
 
-static void timerCallback()
+static void timerCallback( OtaTimerId_t otaTimerId,
+                           void * pCallbackContext )
 {
+    ( void ) otaTimerId;
+
+    pTimerCallbackContext = pCallbackContext;
     timerCallbackInovked = true;
 }
+
+static void countingTimerCallback( OtaTimerId_t otaTimerId,
+                                   void * pCallbackContext )
+{
+    ( void ) otaTimerId;
+
+    ( *( volatile uint32_t * ) pCallbackContext )++;
+}
 /* ============================   UNITY FIXTURES ============================ */
 
 void setUp( void )
@@ -55,17 +73,22 @@ void setUp( void )
     timer.start = Posix_OtaStartTimer;
     timer.delete = Posix_OtaDeleteTimer;
     timer.stop = Posix_OtaStopTimer;
+    timer.pTimerContext = NULL;
 
     event.init = Posix_OtaInitEvent;
     event.send = Posix_OtaSendEvent;
     event.recv = Posix_OtaReceiveEvent;
     event.deinit = Posix_OtaDeinitEvent;
     event.pEventContext = pEventContext;
+    event.recvBatch = NULL;
+    event.signalShutdown = Posix_OtaSignalShutdown;
+    event.waitShutdown = Posix_OtaWaitShutdown;
 }
 
 void tearDown( void )
 {
     timerCallbackInovked = false;
+    pTimerCallbackContext = NULL;
 }
 
 /* ========================================================================== */
@@ -111,12 +134,458 @@ void test_OTA_posix_InvalidEventQueue( void )
     TEST_ASSERT_EQUAL( OtaOsEventQueueDeleteFailed, result );
 }
 
+/**
+ * @brief Test that a receive with a timeout returns once the timeout expires on an empty queue.
+ */
+void test_OTA_posix_RecvEventTimeout( void )
+{
+    OtaEventMsg_t otaEventToSend = { 0 };
+    OtaEventMsg_t otaEventToRecv = { 0 };
+    OtaErr_t result = OtaErrUninitialized;
+
+    result = event.init( event.pEventContext );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+
+    result = event.recv( event.pEventContext, &otaEventToRecv, 10 );
+    TEST_ASSERT_EQUAL( OtaOsEventQueueReceiveTimeout, result );
+
+    /* A pending event is returned without waiting for the timeout. */
+    otaEventToSend.eventId = OtaAgentEventStart;
+    result = event.send( event.pEventContext, &otaEventToSend, 0 );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+    result = event.recv( event.pEventContext, &otaEventToRecv, 10 );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+    TEST_ASSERT_EQUAL( otaEventToSend.eventId, otaEventToRecv.eventId );
+
+    result = event.deinit( event.pEventContext );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+}
+
+/**
+ * @brief Test that the event queue delivers control events before timer events before data events.
+ */
+void test_OTA_posix_SendEventPriority( void )
+{
+    OtaEventMsg_t otaEventToSend = { 0 };
+    OtaEventMsg_t otaEventToRecv = { 0 };
+    OtaErr_t result = OtaErrUninitialized;
+    const OtaEvent_t sent[] =
+    {
+        OtaAgentEventReceivedFileBlock,
+        OtaAgentEventRequestTimer,
+        OtaAgentEventReceivedFileBlock,
+        OtaAgentEventShutdown
+    };
+    const OtaEvent_t expected[] =
+    {
+        OtaAgentEventShutdown,
+        OtaAgentEventRequestTimer,
+        OtaAgentEventReceivedFileBlock,
+        OtaAgentEventReceivedFileBlock
+    };
+    uint32_t i = 0;
+
+    result = event.init( event.pEventContext );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+
+    for( i = 0; i < ( sizeof( sent ) / sizeof( sent[ 0 ] ) ); i++ )
+    {
+        otaEventToSend.eventId = sent[ i ];
+        result = event.send( event.pEventContext, &otaEventToSend, 0 );
+        TEST_ASSERT_EQUAL( OtaErrNone, result );
+    }
+
+    for( i = 0; i < ( sizeof( expected ) / sizeof( expected[ 0 ] ) ); i++ )
+    {
+        result = event.recv( event.pEventContext, &otaEventToRecv, 0 );
+        TEST_ASSERT_EQUAL( OtaErrNone, result );
+        TEST_ASSERT_EQUAL( expected[ i ], otaEventToRecv.eventId );
+    }
+
+    result = event.deinit( event.pEventContext );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+}
+
+static void setEventRing( void )
+{
+    event.init = Posix_OtaInitEventRing;
+    event.send = Posix_OtaSendEventRing;
+    event.recv = Posix_OtaReceiveEventRing;
+    event.deinit = Posix_OtaDeinitEventRing;
+    event.recvBatch = Posix_OtaReceiveEventBatchRing;
+}
+
+/**
+ * @brief Test that events pass through the event ring in order until it is full.
+ */
+void test_OTA_posix_EventRingSendAndRecv( void )
+{
+    OtaEventMsg_t otaEventToSend = { 0 };
+    OtaEventMsg_t otaEventToRecv = { 0 };
+    OtaErr_t result = OtaErrUninitialized;
+    uintptr_t lap = 0;
+    uintptr_t i = 0;
+
+    otaEventToSend.eventId = OtaAgentEventReceivedFileBlock;
+    setEventRing();
+    result = event.init( event.pEventContext );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+
+    /* Go around the ring a few times so the positions wrap. */
+    for( lap = 0; lap < 3; lap++ )
+    {
+        for( i = 0; i < OTA_EVENT_RING_SIZE; i++ )
+        {
+            otaEventToSend.pEventData = ( OtaEventData_t * ) ( lap + i );
+            result = event.send( event.pEventContext, &otaEventToSend, 0 );
+            TEST_ASSERT_EQUAL( OtaErrNone, result );
+        }
+
+        /* The data lane is full. */
+        result = event.send( event.pEventContext, &otaEventToSend, 0 );
+        TEST_ASSERT_EQUAL( OtaOsEventQueueSendFailed, result );
+
+        for( i = 0; i < OTA_EVENT_RING_SIZE; i++ )
+        {
+            result = event.recv( event.pEventContext, &otaEventToRecv, 0 );
+            TEST_ASSERT_EQUAL( OtaErrNone, result );
+            TEST_ASSERT_EQUAL( lap + i, ( uintptr_t ) otaEventToRecv.pEventData );
+        }
+    }
+
+    result = event.deinit( event.pEventContext );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+
+    /* Try to deinitialize a ring that has been deinitialized. */
+    result = event.deinit( event.pEventContext );
+    TEST_ASSERT_EQUAL( OtaOsEventQueueDeleteFailed, result );
+}
+
+/**
+ * @brief Test that the event ring delivers control events before timer events before data events.
+ */
+void test_OTA_posix_EventRingPriority( void )
+{
+    OtaEventMsg_t otaEventToSend = { 0 };
+    OtaEventMsg_t otaEventToRecv = { 0 };
+    OtaErr_t result = OtaErrUninitialized;
+    const OtaEvent_t sent[] =
+    {
+        OtaAgentEventReceivedFileBlock,
+        OtaAgentEventRequestTimer,
+        OtaAgentEventReceivedFileBlock,
+        OtaAgentEventSuspend,
+        OtaAgentEventRequestTimer,
+        OtaAgentEventShutdown
+    };
+    const OtaEvent_t expected[] =
+    {
+        OtaAgentEventSuspend,
+        OtaAgentEventShutdown,
+        OtaAgentEventRequestTimer,
+        OtaAgentEventRequestTimer,
+        OtaAgentEventReceivedFileBlock,
+        OtaAgentEventReceivedFileBlock
+    };
+    uint32_t i = 0;
+
+    setEventRing();
+    result = event.init( event.pEventContext );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+
+    for( i = 0; i < ( sizeof( sent ) / sizeof( sent[ 0 ] ) ); i++ )
+    {
+        otaEventToSend.eventId = sent[ i ];
+        result = event.send( event.pEventContext, &otaEventToSend, 0 );
+        TEST_ASSERT_EQUAL( OtaErrNone, result );
+    }
+
+    for( i = 0; i < ( sizeof( expected ) / sizeof( expected[ 0 ] ) ); i++ )
+    {
+        result = event.recv( event.pEventContext, &otaEventToRecv, 0 );
+        TEST_ASSERT_EQUAL( OtaErrNone, result );
+        TEST_ASSERT_EQUAL( expected[ i ], otaEventToRecv.eventId );
+    }
+
+    result = event.deinit( event.pEventContext );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+}
+
+/**
+ * @brief Test that a batch receive takes the pending events in priority order without waiting again.
+ */
+void test_OTA_posix_EventRingRecvBatch( void )
+{
+    OtaEventMsg_t otaEventToSend = { 0 };
+    OtaEventMsg_t otaEventsToRecv[ 4 ];
+    OtaErr_t result = OtaErrUninitialized;
+    uint32_t numEvents = 0;
+
+    setEventRing();
+    result = event.init( event.pEventContext );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+
+    /* Zero events requested. */
+    result = event.recvBatch( event.pEventContext, otaEventsToRecv, 0, &numEvents, 0 );
+    TEST_ASSERT_EQUAL( OtaOsEventQueueReceiveFailed, result );
+    TEST_ASSERT_EQUAL( 0, numEvents );
+
+    otaEventToSend.eventId = OtaAgentEventReceivedFileBlock;
+    event.send( event.pEventContext, &otaEventToSend, 0 );
+    event.send( event.pEventContext, &otaEventToSend, 0 );
+    otaEventToSend.eventId = OtaAgentEventUserAbort;
+    event.send( event.pEventContext, &otaEventToSend, 0 );
+
+    /* All pending events fit. */
+    result = event.recvBatch( event.pEventContext, otaEventsToRecv, 4, &numEvents, 0 );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+    TEST_ASSERT_EQUAL( 3, numEvents );
+    TEST_ASSERT_EQUAL( OtaAgentEventUserAbort, otaEventsToRecv[ 0 ].eventId );
+    TEST_ASSERT_EQUAL( OtaAgentEventReceivedFileBlock, otaEventsToRecv[ 1 ].eventId );
+    TEST_ASSERT_EQUAL( OtaAgentEventReceivedFileBlock, otaEventsToRecv[ 2 ].eventId );
+
+    /* More events are pending than requested. */
+    otaEventToSend.eventId = OtaAgentEventReceivedFileBlock;
+    event.send( event.pEventContext, &otaEventToSend, 0 );
+    event.send( event.pEventContext, &otaEventToSend, 0 );
+    event.send( event.pEventContext, &otaEventToSend, 0 );
+    result = event.recvBatch( event.pEventContext, otaEventsToRecv, 2, &numEvents, 0 );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+    TEST_ASSERT_EQUAL( 2, numEvents );
+    result = event.recvBatch( event.pEventContext, otaEventsToRecv, 2, &numEvents, 0 );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+    TEST_ASSERT_EQUAL( 1, numEvents );
+
+    result = event.deinit( event.pEventContext );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+}
+
+/**
+ * @brief Test that single and batch receives on the event ring return once the timeout expires.
+ */
+void test_OTA_posix_EventRingRecvTimeout( void )
+{
+    OtaEventMsg_t otaEventToRecv = { 0 };
+    OtaEventMsg_t otaEventsToRecv[ 4 ];
+    OtaErr_t result = OtaErrUninitialized;
+    uint32_t numEvents = 1;
+
+    setEventRing();
+    result = event.init( event.pEventContext );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+
+    result = event.recv( event.pEventContext, &otaEventToRecv, 10 );
+    TEST_ASSERT_EQUAL( OtaOsEventQueueReceiveTimeout, result );
+
+    result = event.recvBatch( event.pEventContext, otaEventsToRecv, 4, &numEvents, 10 );
+    TEST_ASSERT_EQUAL( OtaOsEventQueueReceiveTimeout, result );
+    TEST_ASSERT_EQUAL( 0, numEvents );
+
+    result = event.deinit( event.pEventContext );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+}
+
+static void * ringProducer( void * pArg )
+{
+    OtaEventMsg_t otaEventToSend = { 0 };
+    uint32_t sent = 0;
+
+    /* Encode the producer in the event ID and the count in the data pointer. */
+    otaEventToSend.eventId = ( OtaEvent_t ) ( uintptr_t ) pArg;
+
+    while( sent < RING_EVENTS )
+    {
+        otaEventToSend.pEventData = ( OtaEventData_t * ) ( uintptr_t ) sent;
+
+        if( event.send( event.pEventContext, &otaEventToSend, 0 ) == OtaOsSuccess )
+        {
+            sent++;
+        }
+        else
+        {
+            /* The ring is full, let the receiver catch up. */
+            usleep( 1 );
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Test that events from several threads are all received, each thread's in order.
+ */
+void test_OTA_posix_EventRingMultipleSenders( void )
+{
+    pthread_t producers[ RING_PRODUCERS ];
+    uint32_t expected[ RING_PRODUCERS ] = { 0 };
+    OtaEventMsg_t otaEventToRecv = { 0 };
+    OtaErr_t result = OtaErrUninitialized;
+    uintptr_t i = 0;
+
+    setEventRing();
+    result = event.init( event.pEventContext );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+
+    for( i = 0; i < RING_PRODUCERS; i++ )
+    {
+        TEST_ASSERT_EQUAL( 0, pthread_create( &producers[ i ], NULL, ringProducer, ( void * ) i ) );
+    }
+
+    for( i = 0; i < ( RING_PRODUCERS * RING_EVENTS ); i++ )
+    {
+        result = event.recv( event.pEventContext, &otaEventToRecv, 0 );
+        TEST_ASSERT_EQUAL( OtaErrNone, result );
+        TEST_ASSERT_LESS_THAN( RING_PRODUCERS, otaEventToRecv.eventId );
+        TEST_ASSERT_EQUAL( expected[ otaEventToRecv.eventId ], ( uintptr_t ) otaEventToRecv.pEventData );
+        expected[ otaEventToRecv.eventId ]++;
+    }
+
+    for( i = 0; i < RING_PRODUCERS; i++ )
+    {
+        TEST_ASSERT_EQUAL( 0, pthread_join( producers[ i ], NULL ) );
+    }
+
+    result = event.deinit( event.pEventContext );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+}
+
+/**
+ * @brief Test that the event rings of two event contexts are independent.
+ */
+void test_OTA_posix_EventRingContextsAreIndependent( void )
+{
+    static OtaEventContext_t eventContexts[ 2 ];
+    OtaEventMsg_t otaEventToSend = { 0 };
+    OtaEventMsg_t otaEventToRecv = { 0 };
+    OtaErr_t result = OtaErrUninitialized;
+
+    setEventRing();
+    TEST_ASSERT_EQUAL( OtaErrNone, event.init( &eventContexts[ 0 ] ) );
+    TEST_ASSERT_EQUAL( OtaErrNone, event.init( &eventContexts[ 1 ] ) );
+
+    otaEventToSend.eventId = OtaAgentEventStart;
+    result = event.send( &eventContexts[ 0 ], &otaEventToSend, 0 );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+
+    /* The event is only pending on the context it was sent to. */
+    result = event.recv( &eventContexts[ 1 ], &otaEventToRecv, 10 );
+    TEST_ASSERT_EQUAL( OtaOsEventQueueReceiveTimeout, result );
+    result = event.recv( &eventContexts[ 0 ], &otaEventToRecv, 10 );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+    TEST_ASSERT_EQUAL( OtaAgentEventStart, otaEventToRecv.eventId );
+
+    TEST_ASSERT_EQUAL( OtaErrNone, event.deinit( &eventContexts[ 0 ] ) );
+    TEST_ASSERT_EQUAL( OtaErrNone, event.deinit( &eventContexts[ 1 ] ) );
+}
+
+/**
+ * @brief Test that every event context has its own message queue.
+ */
+void test_OTA_posix_EventQueueContextsAreIndependent( void )
+{
+    static OtaEventContext_t eventContexts[ 2 ];
+    OtaEventMsg_t otaEventToSend = { 0 };
+    OtaEventMsg_t otaEventToRecv = { 0 };
+    OtaErr_t result = OtaErrUninitialized;
+
+    TEST_ASSERT_EQUAL( OtaErrNone, event.init( &eventContexts[ 0 ] ) );
+    TEST_ASSERT_EQUAL( OtaErrNone, event.init( &eventContexts[ 1 ] ) );
+    TEST_ASSERT_NOT_EQUAL( 0, strcmp( eventContexts[ 0 ].queueName, eventContexts[ 1 ].queueName ) );
+
+    otaEventToSend.eventId = OtaAgentEventStart;
+    result = event.send( &eventContexts[ 0 ], &otaEventToSend, 0 );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+
+    /* The event is only pending on the context it was sent to. */
+    result = event.recv( &eventContexts[ 1 ], &otaEventToRecv, 10 );
+    TEST_ASSERT_EQUAL( OtaOsEventQueueReceiveTimeout, result );
+    result = event.recv( &eventContexts[ 0 ], &otaEventToRecv, 10 );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+    TEST_ASSERT_EQUAL( OtaAgentEventStart, otaEventToRecv.eventId );
+
+    TEST_ASSERT_EQUAL( OtaErrNone, event.deinit( &eventContexts[ 0 ] ) );
+    TEST_ASSERT_EQUAL( OtaErrNone, event.deinit( &eventContexts[ 1 ] ) );
+}
+
+static void * shutdownSignaler( void * pArg )
+{
+    ( void ) pArg;
+
+    /* Let the main thread block before signaling. */
+    usleep( 10000 );
+    ( void ) event.signalShutdown( event.pEventContext );
+
+    return NULL;
+}
+
+/**
+ * @brief Test that waiting for shutdown blocks until it is signaled or times out.
+ */
+void test_OTA_posix_WaitShutdown( void )
+{
+    pthread_t signaler;
+    OtaErr_t result = OtaErrUninitialized;
+
+    result = event.init( event.pEventContext );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+
+    /* Nothing signaled yet, so the wait times out. */
+    result = event.waitShutdown( event.pEventContext, 10 );
+    TEST_ASSERT_EQUAL( OtaOsShutdownWaitFailed, result );
+
+    /* Signaled by another thread while waiting. */
+    TEST_ASSERT_EQUAL( 0, pthread_create( &signaler, NULL, shutdownSignaler, NULL ) );
+    result = event.waitShutdown( event.pEventContext, OTA_DEFAULT_TIMEOUT );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+    TEST_ASSERT_EQUAL( 0, pthread_join( signaler, NULL ) );
+
+    /* The signal stays set until the events are initialized again. */
+    result = event.waitShutdown( event.pEventContext, 0 );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+
+    result = event.deinit( event.pEventContext );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+
+    result = event.init( event.pEventContext );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+    result = event.waitShutdown( event.pEventContext, 0 );
+    TEST_ASSERT_EQUAL( OtaOsShutdownWaitFailed, result );
+
+    result = event.deinit( event.pEventContext );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+}
+
+/**
+ * @brief Test that the shutdown signal of one event context does not wake up another.
+ */
+void test_OTA_posix_ShutdownContextsAreIndependent( void )
+{
+    static OtaEventContext_t eventContexts[ 2 ];
+    OtaErr_t result = OtaErrUninitialized;
+
+    setEventRing();
+    TEST_ASSERT_EQUAL( OtaErrNone, event.init( &eventContexts[ 0 ] ) );
+    TEST_ASSERT_EQUAL( OtaErrNone, event.init( &eventContexts[ 1 ] ) );
+
+    result = event.signalShutdown( &eventContexts[ 0 ] );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+
+    /* Only the agent of the signaled context has shut down. */
+    result = event.waitShutdown( &eventContexts[ 1 ], 10 );
+    TEST_ASSERT_EQUAL( OtaOsShutdownWaitFailed, result );
+    result = event.waitShutdown( &eventContexts[ 0 ], 0 );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+
+    TEST_ASSERT_EQUAL( OtaErrNone, event.deinit( &eventContexts[ 0 ] ) );
+    TEST_ASSERT_EQUAL( OtaErrNone, event.deinit( &eventContexts[ 1 ] ) );
+}
+
 void timerCreateAndStop( OtaTimerId_t timer_id )
 {
     OtaErr_t result = OtaErrUninitialized;
     int wait = 2 * OTA_DEFAULT_TIMEOUT; /* Wait for 2 times of the timeout specified. */
 
-    result = timer.start( timer_id, TIMER_NAME, OTA_DEFAULT_TIMEOUT, timerCallback );
+    result = timer.start( timer.pTimerContext, timer_id, TIMER_NAME, OTA_DEFAULT_TIMEOUT, timerCallback, &timer );
     TEST_ASSERT_EQUAL( OtaErrNone, result );
 
     /* Wait for the timer callback to be invoked. */
@@ -128,11 +597,12 @@ void timerCreateAndStop( OtaTimerId_t timer_id )
     }
 
     TEST_ASSERT_EQUAL( true, timerCallbackInovked );
+    TEST_ASSERT_EQUAL_PTR( &timer, pTimerCallbackContext );
 
-    result = timer.stop( timer_id );
+    result = timer.stop( timer.pTimerContext, timer_id );
     TEST_ASSERT_EQUAL( OtaErrNone, result );
 
-    result = timer.delete( timer_id );
+    result = timer.delete( timer.pTimerContext, timer_id );
     TEST_ASSERT_EQUAL( OtaErrNone, result );
 }
 
@@ -152,6 +622,83 @@ void test_OTA_posix_SelfTestTimerCreateAndStop( void )
     timerCreateAndStop( OtaSelfTestTimer );
 }
 
+/**
+ * @brief Test timers expire after a sub-second timeout.
+ */
+void test_OTA_posix_TimerSubSecondTimeout( void )
+{
+    OtaErr_t result = OtaErrUninitialized;
+    struct timespec start, end;
+    long elapsedUs = 0;
+    int wait = OTA_DEFAULT_TIMEOUT;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &start );
+    result = timer.start( timer.pTimerContext, OtaRequestTimer, TIMER_NAME, OTA_SHORT_TIMEOUT, timerCallback, NULL );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+
+    /* Wait for the timer callback to be invoked. */
+    while( timerCallbackInovked == false && wait > 0 )
+    {
+        /* Sleep 1 ms. */
+        usleep( 1000 );
+        --wait;
+    }
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &end );
+    elapsedUs = ( ( long ) ( end.tv_sec - start.tv_sec ) * 1000000L ) +
+                ( ( end.tv_nsec - start.tv_nsec ) / 1000L );
+
+    /* The timer fires after the timeout and well before a whole second. */
+    TEST_ASSERT_EQUAL( true, timerCallbackInovked );
+    TEST_ASSERT_TRUE( elapsedUs >= OTA_SHORT_TIMEOUT * 1000L );
+    TEST_ASSERT_TRUE( elapsedUs < OTA_DEFAULT_TIMEOUT * 1000L );
+
+    result = timer.delete( timer.pTimerContext, OtaRequestTimer );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+}
+
+/**
+ * @brief Test timers with the same ID in different timer contexts run independently.
+ */
+void test_OTA_posix_TimerContextsAreIndependent( void )
+{
+    static OtaTimerContext_t firstTimers;
+    static OtaTimerContext_t secondTimers;
+    static volatile uint32_t firstExpired = 0;
+    static volatile uint32_t secondExpired = 0;
+    OtaErr_t result = OtaErrUninitialized;
+    int wait = OTA_DEFAULT_TIMEOUT;
+
+    result = timer.start( &firstTimers, OtaRequestTimer, TIMER_NAME, OTA_SHORT_TIMEOUT,
+                          countingTimerCallback, ( void * ) &firstExpired );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+    result = timer.start( &secondTimers, OtaRequestTimer, TIMER_NAME, OTA_SHORT_TIMEOUT,
+                          countingTimerCallback, ( void * ) &secondExpired );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+
+    /* Stopping the timer in one context leaves the other one running. */
+    result = timer.stop( &secondTimers, OtaRequestTimer );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+
+    while( firstExpired == 0U && wait > 0 )
+    {
+        /* Sleep 1 ms. */
+        usleep( 1000 );
+        --wait;
+    }
+
+    /* Give a late expiry of the stopped timer the chance to show up. */
+    usleep( 2 * OTA_SHORT_TIMEOUT * 1000 );
+
+    TEST_ASSERT_EQUAL( 1, firstExpired );
+    TEST_ASSERT_EQUAL( 0, secondExpired );
+
+    result = timer.delete( &firstTimers, OtaRequestTimer );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+    result = timer.delete( &secondTimers, OtaRequestTimer );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+}
+
 /**
  * @brief Test invalid operations on timers.
  */
@@ -160,21 +707,21 @@ void test_OTA_posix_InvalidTimerOperations( void )
     OtaErr_t result = OtaErrUninitialized;
     OtaTimerId_t timer_id = OtaRequestTimer;
 
-    result = timer.start( timer_id, TIMER_NAME, OTA_DEFAULT_TIMEOUT, NULL );
+    result = timer.start( timer.pTimerContext, timer_id, TIMER_NAME, OTA_DEFAULT_TIMEOUT, NULL, NULL );
     TEST_ASSERT_EQUAL( OtaErrNone, result );
 
     /* Set the timeout to 0 and stop the timer*/
-    result = timer.start( timer_id, TIMER_NAME, 0, NULL );
+    result = timer.start( timer.pTimerContext, timer_id, TIMER_NAME, 0, NULL, NULL );
     TEST_ASSERT_EQUAL( OtaErrNone, result );
 
-    result = timer.stop( timer_id );
+    result = timer.stop( timer.pTimerContext, timer_id );
     TEST_ASSERT_EQUAL( OtaErrNone, result );
 
-    result = timer.delete( timer_id );
+    result = timer.delete( timer.pTimerContext, timer_id );
     TEST_ASSERT_EQUAL( OtaErrNone, result );
 
     /* Delete a timer that has been deleted. */
-    result = timer.delete( timer_id );
+    result = timer.delete( timer.pTimerContext, timer_id );
     TEST_ASSERT_NOT_EQUAL( OtaErrNone, result );
 }
 
@@ -115,6 +115,10 @@ static OtaEventMsg_t otaEventQueue[ OTA_NUM_MSG_Q_ENTRIES ];
 static OtaEventMsg_t * otaEventQueueEnd = otaEventQueue;
 static OtaEventData_t eventBuffer;
 static bool eventIgnore;
+static bool shutdownSignaled;
+static OtaState_t shutdownSignaledState;
+static uint32_t receiveTimeout;
+static bool suspendOnReceive;
 
 /* OTA File handle and buffer. */
 static FILE * pOtaFileHandle = NULL;
@@ -131,33 +135,47 @@ static const uint8_t unsubscribeFlag = 1;
 /* Global static variable defined in ota.c for managing the state machine. */
 extern OtaAgentContext_t otaAgent;
 
-/* Global static variable defined in ota.c for managing the data interface
- * protocol function pointers. */
-extern OtaDataInterface_t otaDataInterface;
-
-/* Global static variable defined in ota.c for managing the control interface
- * protocol function pointers. */
-extern OtaControlInterface_t otaControlInterface;
+/* Global static transition table and its length defined in ota.c. */
+extern OtaStateTableEntry_t otaTransitionTable[];
+extern const uint32_t otaTransitionTableLength;
 
 /* Static function defined in ota.c for processing events. */
-extern void receiveAndProcessOtaEvent( void );
+extern void receiveAndProcessOtaEvent( OtaAgentContext_t * pAgentCtx );
+extern uint32_t searchTransition( OtaAgentContext_t * pAgentCtx,
+                                  const OtaEventMsg_t * pEventMsg );
 
 /* Static state machine function handlers under test defined in ota.c. */
-extern OtaErr_t initFileHandler( const OtaEventData_t * pEventData );
-extern OtaErr_t requestDataHandler( const OtaEventData_t * pEventData );
-extern OtaErr_t requestJobHandler( const OtaEventData_t * pEventData );
-extern OtaErr_t processDataHandler( const OtaEventData_t * pEventData );
-extern OtaErr_t resumeHandler( const OtaEventData_t * pEventData );
-extern OtaErr_t jobNotificationHandler( const OtaEventData_t * pEventData );
-extern OtaErr_t shutdownHandler( const OtaEventData_t * pEventData );
+extern OtaErr_t initFileHandler( OtaAgentContext_t * pAgentCtx,
+                                 const OtaEventData_t * pEventData );
+extern OtaErr_t requestDataHandler( OtaAgentContext_t * pAgentCtx,
+                                    const OtaEventData_t * pEventData );
+extern OtaErr_t requestJobHandler( OtaAgentContext_t * pAgentCtx,
+                                   const OtaEventData_t * pEventData );
+extern OtaErr_t processDataHandler( OtaAgentContext_t * pAgentCtx,
+                                    const OtaEventData_t * pEventData );
+extern OtaErr_t resumeHandler( OtaAgentContext_t * pAgentCtx,
+                               const OtaEventData_t * pEventData );
+extern OtaErr_t jobNotificationHandler( OtaAgentContext_t * pAgentCtx,
+                                        const OtaEventData_t * pEventData );
+extern OtaErr_t shutdownHandler( OtaAgentContext_t * pAgentCtx,
+                                 const OtaEventData_t * pEventData );
 
 /* Static helper function under test defined in ota.c. */
-extern OtaErr_t setImageStateWithReason( OtaImageState_t stateToSet,
+extern OtaErr_t setImageStateWithReason( OtaAgentContext_t * pAgentCtx,
+                                         OtaImageState_t stateToSet,
                                          uint32_t reasonToSet );
-extern bool otaClose( OtaFileContext_t * const pFileContext );
+extern bool otaClose( OtaAgentContext_t * pAgentCtx,
+                      OtaFileContext_t * const pFileContext );
 extern bool validateDataBlock( const OtaFileContext_t * pFileContext,
                                uint32_t blockIndex,
                                uint32_t blockSize );
+extern void adaptRequestTimeoutOnRequest( OtaAgentContext_t * pAgentCtx );
+extern void adaptRequestTimeoutOnBlock( OtaAgentContext_t * pAgentCtx );
+extern uint32_t fileBlockRequestTimeout( const OtaAgentContext_t * pAgentCtx );
+extern uint32_t retryDelay( OtaAgentContext_t * pAgentCtx,
+                            uint32_t baseMs );
+extern bool progressReportDue( OtaAgentContext_t * pAgentCtx );
+extern void agentIdleHook( OtaAgentContext_t * pAgentCtx );
 
 /* ========================================================================== */
 /* ====================== Unit test helper functions ======================== */
@@ -169,11 +187,25 @@ static void * mockMallocAlwaysFail( size_t size )
     return NULL;
 }
 
+static OtaAgentStatistics_t otaStatistics( void )
+{
+    OtaAgentStatistics_t statistics = { 0 };
+
+    TEST_ASSERT_EQUAL( OtaErrNone, OTA_GetStatistics( &statistics ) );
+
+    return statistics;
+}
+
 static OtaOsStatus_t mockOSEventReset( OtaEventContext_t * unused )
 {
     otaEventQueueEnd = otaEventQueue;
     eventIgnore = false;
 
+    /* Events dropped by the mocks are never received, so clear the marks the
+     * agent keeps of the events it has queued. */
+    otaAgent.requestTimerPending = 0;
+    otaAgent.requestFileBlockPending = 0;
+
     ( void ) unused;
 
     return OtaOsSuccess;
@@ -289,49 +321,177 @@ static OtaOsStatus_t mockOSEventReceive( OtaEventContext_t * unused_1,
     return err;
 }
 
-static OtaOsStatus_t stubOSTimerStart( OtaTimerId_t timerId,
+static OtaOsStatus_t mockOSEventReceiveBatch( OtaEventContext_t * unused_1,
+                                              void * pEventMsgs,
+                                              uint32_t maxEvents,
+                                              uint32_t * pNumEvents,
+                                              uint32_t unused_2 )
+{
+    OtaEventMsg_t * pOtaEvents = pEventMsgs;
+    uint32_t numEvents = 0;
+
+    while( ( numEvents < maxEvents ) &&
+           ( mockOSEventReceive( unused_1, &pOtaEvents[ numEvents ], unused_2 ) == OtaOsSuccess ) )
+    {
+        numEvents++;
+    }
+
+    *pNumEvents = numEvents;
+
+    return ( numEvents > 0 ) ? OtaOsSuccess : OtaOsEventQueueReceiveFailed;
+}
+
+/* Receive a batch and signal a suspend event while the batch is processed. */
+static OtaOsStatus_t mockOSEventReceiveBatchThenSuspend( OtaEventContext_t * unused_1,
+                                                         void * pEventMsgs,
+                                                         uint32_t maxEvents,
+                                                         uint32_t * pNumEvents,
+                                                         uint32_t timeout )
+{
+    OtaOsStatus_t err = mockOSEventReceiveBatch( unused_1, pEventMsgs, maxEvents, pNumEvents, timeout );
+    OtaEventMsg_t otaEvent = { 0 };
+
+    receiveTimeout = timeout;
+
+    if( suspendOnReceive == true )
+    {
+        suspendOnReceive = false;
+        otaEvent.eventId = OtaAgentEventSuspend;
+        TEST_ASSERT_TRUE( OTA_SignalEvent( &otaEvent ) );
+    }
+
+    return err;
+}
+
+/* Record the timeout the agent waits with and let it expire when the queue is empty. */
+static OtaOsStatus_t mockOSEventReceiveTimeout( OtaEventContext_t * unused_1,
+                                                void * pEventMsg,
+                                                uint32_t timeout )
+{
+    OtaOsStatus_t err = OtaOsSuccess;
+
+    receiveTimeout = timeout;
+
+    if( otaEventQueueEnd != otaEventQueue )
+    {
+        err = mockOSEventReceive( unused_1, pEventMsg, timeout );
+    }
+    else
+    {
+        err = OtaOsEventQueueReceiveTimeout;
+    }
+
+    return err;
+}
+
+static OtaOsStatus_t mockOSEventSignalShutdown( OtaEventContext_t * unused )
+{
+    ( void ) unused;
+
+    shutdownSignaled = true;
+    shutdownSignaledState = OTA_GetState();
+
+    return OtaOsSuccess;
+}
+
+static OtaOsStatus_t mockOSEventWaitShutdown( OtaEventContext_t * unused_1,
+                                              uint32_t unused_2 )
+{
+    ( void ) unused_2;
+
+    /* Run the agent as its task would while the caller is blocked. */
+    if( shutdownSignaled == false )
+    {
+        receiveAndProcessOtaEvent( &otaAgent );
+    }
+
+    return ( shutdownSignaled == true ) ? OtaOsSuccess : OtaOsShutdownWaitFailed;
+}
+
+static OtaOsStatus_t stubOSTimerStart( OtaTimerContext_t * pTimerCtx,
+                                       OtaTimerId_t timerId,
                                        const char * const pTimerName,
                                        const uint32_t timeout,
-                                       OtaTimerCallback_t callback )
+                                       OtaTimerCallback_t callback,
+                                       void * pCallbackContext )
 {
+    ( void ) pTimerCtx;
     ( void ) timerId;
     ( void ) pTimerName;
     ( void ) timeout;
     ( void ) callback;
+    ( void ) pCallbackContext;
     return OtaOsSuccess;
 }
 
-static OtaOsStatus_t mockOSTimerInvokeCallback( OtaTimerId_t timerId,
+static OtaOsStatus_t mockOSTimerInvokeCallback( OtaTimerContext_t * pTimerCtx,
+                                                OtaTimerId_t timerId,
                                                 const char * const pTimerName,
                                                 const uint32_t timeout,
-                                                OtaTimerCallback_t callback )
+                                                OtaTimerCallback_t callback,
+                                                void * pCallbackContext )
 {
-    callback( timerId );
+    callback( timerId, pCallbackContext );
+    ( void ) pTimerCtx;
     ( void ) timeout;
     ( void ) pTimerName;
     return OtaOsSuccess;
 }
 
-static OtaOsStatus_t mockOSTimerStartAlwaysFail( OtaTimerId_t unused_1,
-                                                 const char * const unused_2,
-                                                 const uint32_t unused_3,
-                                                 OtaTimerCallback_t unused_4 )
+static OtaOsStatus_t mockOSTimerStartAlwaysFail( OtaTimerContext_t * unused_1,
+                                                 OtaTimerId_t unused_2,
+                                                 const char * const unused_3,
+                                                 const uint32_t unused_4,
+                                                 OtaTimerCallback_t unused_5,
+                                                 void * unused_6 )
 {
     ( void ) unused_1;
     ( void ) unused_2;
     ( void ) unused_3;
     ( void ) unused_4;
+    ( void ) unused_5;
+    ( void ) unused_6;
     return OtaOsTimerStartFailed;
 }
 
-static OtaOsStatus_t stubOSTimerStop( OtaTimerId_t timerId )
+static uint32_t lastTimerTimeout = 0;
+
+/* Record the timeout of the timer started last. */
+static OtaOsStatus_t mockOSTimerStartRecordTimeout( OtaTimerContext_t * pTimerCtx,
+                                                    OtaTimerId_t timerId,
+                                                    const char * const pTimerName,
+                                                    const uint32_t timeout,
+                                                    OtaTimerCallback_t callback,
+                                                    void * pCallbackContext )
+{
+    ( void ) pTimerCtx;
+    ( void ) timerId;
+    ( void ) pTimerName;
+    ( void ) callback;
+    ( void ) pCallbackContext;
+    lastTimerTimeout = timeout;
+    return OtaOsSuccess;
+}
+
+static uint32_t mockTimeMs = 0;
+
+static uint32_t mockOSGetTimeMs( void )
+{
+    return mockTimeMs;
+}
+
+static OtaOsStatus_t stubOSTimerStop( OtaTimerContext_t * pTimerCtx,
+                                      OtaTimerId_t timerId )
 {
+    ( void ) pTimerCtx;
     ( void ) timerId;
     return OtaOsSuccess;
 }
 
-static OtaOsStatus_t stubOSTimerDelete( OtaTimerId_t timerId )
+static OtaOsStatus_t stubOSTimerDelete( OtaTimerContext_t * pTimerCtx,
+                                        OtaTimerId_t timerId )
 {
+    ( void ) pTimerCtx;
     ( void ) timerId;
     return OtaOsSuccess;
 }
@@ -373,6 +533,39 @@ static OtaMqttStatus_t stubMqttPublish( const char * const unused_1,
     return OtaMqttSuccess;
 }
 
+static const char * pLastPublishTopic = NULL;
+
+static OtaMqttStatus_t stubMqttPublishRecordTopic( const char * const pTopic,
+                                                   uint16_t topicLen,
+                                                   const char * unused_1,
+                                                   uint32_t unused_2,
+                                                   uint8_t unused_3 )
+{
+    ( void ) unused_1;
+    ( void ) unused_2;
+    ( void ) unused_3;
+
+    TEST_ASSERT_EQUAL( strlen( pTopic ), topicLen );
+    pLastPublishTopic = pTopic;
+
+    return OtaMqttSuccess;
+}
+
+static uint32_t subscribeCount = 0;
+
+static OtaMqttStatus_t stubMqttSubscribeCount( const char * unused_1,
+                                               uint16_t unused_2,
+                                               uint8_t unused_3 )
+{
+    ( void ) unused_1;
+    ( void ) unused_2;
+    ( void ) unused_3;
+
+    subscribeCount++;
+
+    return OtaMqttSuccess;
+}
+
 OtaErr_t mockControlInterfaceRequestJobAlwaysFail( OtaAgentContext_t * unused )
 {
     ( void ) unused;
@@ -393,6 +586,24 @@ OtaErr_t mockControlInterfaceUpdateJobAlwaysFail( OtaAgentContext_t * unused1,
     return OtaErrUpdateJobStatusFailed;
 }
 
+static uint32_t progressUpdateCount = 0;
+
+OtaErr_t mockControlInterfaceUpdateJobCountProgress( OtaAgentContext_t * unused1,
+                                                     OtaJobStatus_t status,
+                                                     int32_t reason,
+                                                     int32_t unused2 )
+{
+    ( void ) unused1;
+    ( void ) unused2;
+
+    if( ( status == JobStatusInProgress ) && ( reason == ( int32_t ) JobReasonReceiving ) )
+    {
+        progressUpdateCount++;
+    }
+
+    return OtaErrNone;
+}
+
 OtaErr_t mockDataInterfaceInitFileTransferAlwaysFail( OtaAgentContext_t * unused )
 {
     ( void ) unused;
@@ -627,10 +838,15 @@ static void otaInterfaceDefault()
     otaInterfaces.os.event.send = mockOSEventSendThenStop;
     otaInterfaces.os.event.recv = mockOSEventReceive;
     otaInterfaces.os.event.deinit = mockOSEventReset;
+    otaInterfaces.os.event.recvBatch = NULL;
+    otaInterfaces.os.event.signalShutdown = mockOSEventSignalShutdown;
+    otaInterfaces.os.event.waitShutdown = NULL;
+    shutdownSignaled = false;
 
     otaInterfaces.os.timer.start = stubOSTimerStart;
     otaInterfaces.os.timer.stop = stubOSTimerStop;
     otaInterfaces.os.timer.delete = stubOSTimerDelete;
+    otaInterfaces.os.timer.getTimeMs = NULL;
 
     otaInterfaces.os.mem.malloc = malloc;
     otaInterfaces.os.mem.free = free;
@@ -681,7 +897,7 @@ static void processEntireQueue()
 
     while( otaEventQueueEnd != otaEventQueue )
     {
-        receiveAndProcessOtaEvent();
+        receiveAndProcessOtaEvent( &otaAgent );
     }
 }
 
@@ -758,40 +974,40 @@ static void otaGoToState( OtaState_t state )
             otaGoToState( OtaAgentStateReady );
             otaEvent.eventId = OtaAgentEventStart;
             OTA_SignalEvent( &otaEvent );
-            receiveAndProcessOtaEvent();
+            receiveAndProcessOtaEvent( &otaAgent );
             break;
 
         case OtaAgentStateWaitingForJob:
             otaGoToState( OtaAgentStateRequestingJob );
             otaEvent.eventId = OtaAgentEventRequestJobDocument;
             OTA_SignalEvent( &otaEvent );
-            receiveAndProcessOtaEvent();
+            receiveAndProcessOtaEvent( &otaAgent );
             break;
 
         case OtaAgentStateCreatingFile:
             otaGoToState( OtaAgentStateWaitingForJob );
             otaReceiveJobDocument();
-            receiveAndProcessOtaEvent();
+            receiveAndProcessOtaEvent( &otaAgent );
             break;
 
         case OtaAgentStateRequestingFileBlock:
             otaGoToState( OtaAgentStateCreatingFile );
             otaEvent.eventId = OtaAgentEventCreateFile;
             OTA_SignalEvent( &otaEvent );
-            receiveAndProcessOtaEvent();
+            receiveAndProcessOtaEvent( &otaAgent );
             break;
 
         case OtaAgentStateWaitingForFileBlock:
             otaGoToState( OtaAgentStateRequestingFileBlock );
             otaEvent.eventId = OtaAgentEventRequestFileBlock;
             OTA_SignalEvent( &otaEvent );
-            receiveAndProcessOtaEvent();
+            receiveAndProcessOtaEvent( &otaAgent );
             break;
 
         case OtaAgentStateSuspended:
             otaGoToState( OtaAgentStateReady );
             OTA_Suspend();
-            receiveAndProcessOtaEvent();
+            receiveAndProcessOtaEvent( &otaAgent );
             break;
 
         default:
@@ -915,19 +1131,75 @@ void test_OTA_InitZeroAppBufferSizes()
     TEST_ASSERT_EQUAL( OtaAgentStateInit, OTA_GetState() );
 }
 
+void test_OTA_InitCtxSecondAgent()
+{
+    static OtaAgentContext_t secondAgent;
+    OtaAgentStatistics_t statistics = { 0 };
+    OtaEventMsg_t otaEvent = { 0 };
+
+    otaGoToState( OtaAgentStateReady );
+
+    /* A second, zero-initialized context can be initialized next to the default one. */
+    TEST_ASSERT_EQUAL( OtaErrNone, OTA_InitCtx( &secondAgent,
+                                                &pOtaAppBuffer,
+                                                &otaInterfaces,
+                                                ( const uint8_t * ) pOtaDefaultClientId,
+                                                mockAppCallback ) );
+    TEST_ASSERT_EQUAL( OtaAgentStateInit, OTA_GetStateCtx( &secondAgent ) );
+    TEST_ASSERT_EQUAL( OtaAgentStateReady, OTA_GetState() );
+
+    /* Events signaled to the second context are only counted there. */
+    otaEvent.eventId = OtaAgentEventReceivedFileBlock;
+    otaInterfaces.os.event.send = mockOSEventSendAlwaysFail;
+    TEST_ASSERT_FALSE( OTA_SignalEventCtx( &secondAgent, &otaEvent ) );
+
+    TEST_ASSERT_EQUAL( OtaErrNone, OTA_GetStatisticsCtx( &secondAgent, &statistics ) );
+    TEST_ASSERT_EQUAL( 1, statistics.otaPacketsReceived );
+    TEST_ASSERT_EQUAL( 1, statistics.otaPacketsDropped );
+    TEST_ASSERT_EQUAL( 0, otaStatistics().otaPacketsReceived );
+
+    /* Shutting the second context down leaves the default one running. */
+    otaInterfaces.os.event.send = mockOSEventSend;
+    OTA_ShutdownCtx( &secondAgent, 0, 0 );
+    receiveAndProcessOtaEvent( &secondAgent );
+    TEST_ASSERT_EQUAL( OtaAgentStateStopped, OTA_GetStateCtx( &secondAgent ) );
+    TEST_ASSERT_EQUAL( OtaAgentStateReady, OTA_GetState() );
+}
+
 void test_OTA_ShutdownWithDelay()
 {
     otaGoToState( OtaAgentStateReady );
     OTA_Shutdown( 2000, 0 );
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateStopped, OTA_GetState() );
 }
 
+void test_OTA_ShutdownWaitsForAgent()
+{
+    otaInterfaces.os.event.send = mockOSEventSend;
+    otaInterfaces.os.event.waitShutdown = mockOSEventWaitShutdown;
+
+    /* Without a timeout OTA_Shutdown returns before the agent stops. */
+    otaGoToState( OtaAgentStateReady );
+    TEST_ASSERT_EQUAL( OtaAgentStateReady, OTA_Shutdown( 0, 0 ) );
+    receiveAndProcessOtaEvent( &otaAgent );
+    TEST_ASSERT_EQUAL( true, shutdownSignaled );
+
+    /* The agent signals once the stopped state is stored. */
+    TEST_ASSERT_EQUAL( OtaAgentStateStopped, shutdownSignaledState );
+
+    /* With a timeout it returns once the agent has signaled that it stopped. */
+    shutdownSignaled = false;
+    otaGoToState( OtaAgentStateReady );
+    TEST_ASSERT_EQUAL( OtaAgentStateStopped, OTA_Shutdown( 1000, 0 ) );
+    TEST_ASSERT_EQUAL( true, shutdownSignaled );
+}
+
 void test_OTA_ShutdownWhenStopped()
 {
     /* Calling shutdown when already stopped should have no effect. */
     OTA_Shutdown( otaDefaultWait, unsubscribeFlag );
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateStopped, OTA_GetState() );
 }
 
@@ -941,7 +1213,7 @@ void test_OTA_ShutdownFailToSendEvent()
 
     /* Shutdown should now fail and OTA agent should remain in ready state. */
     OTA_Shutdown( otaDefaultWait, unsubscribeFlag );
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateReady, OTA_GetState() );
 }
 
@@ -952,14 +1224,14 @@ void test_OTA_ShutdownTwiceBeforeProcessing()
     otaGoToState( OtaAgentStateReady );
     OTA_Shutdown( 0, 0 );
     OTA_Shutdown( 0, 0 );
-    receiveAndProcessOtaEvent();
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateStopped, OTA_GetState() );
 }
 
 void test_OTA_CloseNullInput()
 {
-    TEST_ASSERT_EQUAL( false, otaClose( NULL ) );
+    TEST_ASSERT_EQUAL( false, otaClose( &otaAgent, NULL ) );
 }
 
 void test_OTA_StartWhenReady()
@@ -974,7 +1246,7 @@ void test_OTA_StartWhenReady()
 
     otaEvent.eventId = OtaAgentEventStart;
     OTA_SignalEvent( &otaEvent );
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateRequestingJob, OTA_GetState() );
 }
 
@@ -994,7 +1266,7 @@ void test_OTA_StartFailedWhenReady()
     /* The event handler should fail, so OTA agent should remain in OtaAgentStateReady state. */
     otaEvent.eventId = OtaAgentEventStart;
     OTA_SignalEvent( &otaEvent );
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateReady, OTA_GetState() );
 }
 
@@ -1013,7 +1285,7 @@ void test_OTA_SuspendWhenReady()
     TEST_ASSERT_EQUAL( OtaAgentStateReady, OTA_GetState() );
 
     TEST_ASSERT_EQUAL( OtaErrNone, OTA_Suspend() );
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateSuspended, OTA_GetState() );
 }
 
@@ -1045,7 +1317,7 @@ void test_OTA_ResumeWhenSuspended()
     TEST_ASSERT_EQUAL( OtaAgentStateSuspended, OTA_GetState() );
 
     TEST_ASSERT_EQUAL( OtaErrNone, OTA_Resume() );
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateRequestingJob, OTA_GetState() );
 }
 
@@ -1057,7 +1329,7 @@ void test_OTA_ResumeWhenReady()
     /* Calling resume when OTA agent is not suspend state. This should be an unexpected event and
      * the agent should remain in ready state. */
     TEST_ASSERT_EQUAL( OtaErrNone, OTA_Resume() );
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateReady, OTA_GetState() );
 }
 
@@ -1090,13 +1362,39 @@ void test_OTA_Statistics()
     TEST_ASSERT_EQUAL( 0, statistics.otaPacketsDropped );
 }
 
+void test_OTA_GetStatisticsCountsFileBlocks()
+{
+    OtaEventMsg_t otaEvent = { 0 };
+
+    otaGoToState( OtaAgentStateReady );
+    otaEvent.eventId = OtaAgentEventReceivedFileBlock;
+
+    /* Two file blocks are queued and one finds the queue full. */
+    otaInterfaces.os.event.send = mockOSEventSend;
+    TEST_ASSERT_TRUE( OTA_SignalEvent( &otaEvent ) );
+    TEST_ASSERT_TRUE( OTA_SignalEvent( &otaEvent ) );
+    otaInterfaces.os.event.send = mockOSEventSendAlwaysFail;
+    TEST_ASSERT_FALSE( OTA_SignalEvent( &otaEvent ) );
+
+    TEST_ASSERT_EQUAL( 3, otaStatistics().otaPacketsReceived );
+    TEST_ASSERT_EQUAL( 2, otaStatistics().otaPacketsQueued );
+    TEST_ASSERT_EQUAL( 1, otaStatistics().otaPacketsDropped );
+
+    /* Initializing the running agent again resets the counters. */
+    otaInitDefault();
+    TEST_ASSERT_EQUAL( 0, otaStatistics().otaPacketsReceived );
+    TEST_ASSERT_EQUAL( 0, otaStatistics().otaPacketsQueued );
+    TEST_ASSERT_EQUAL( 0, otaStatistics().otaPacketsDropped );
+    TEST_ASSERT_EQUAL( 0, otaAgent.statistics.sequence & 1U );
+}
+
 void test_OTA_CheckForUpdate()
 {
     otaGoToState( OtaAgentStateRequestingJob );
     TEST_ASSERT_EQUAL( OtaAgentStateRequestingJob, OTA_GetState() );
 
     TEST_ASSERT_EQUAL( OtaErrNone, OTA_CheckForUpdate() );
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
 }
 
@@ -1155,7 +1453,7 @@ void test_OTA_ImageStateAbortWithActiveJob()
 
     /* Calling abort with an active job would make OTA agent transit to waiting for job state. */
     TEST_ASSERT_EQUAL( OtaErrNone, OTA_SetImageState( OtaImageStateAborted ) );
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
 }
 
@@ -1170,7 +1468,7 @@ void test_OTA_ImageStateAbortWithNoJob()
 
     /* Calling abort without an active job would fail. OTA agent should remain in ready state. */
     TEST_ASSERT_EQUAL( OtaErrNone, OTA_SetImageState( OtaImageStateAborted ) );
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateReady, OTA_GetState() );
 }
 
@@ -1197,8 +1495,8 @@ void test_OTA_ImageStateAbortUpdateStatusFail()
     TEST_ASSERT_EQUAL( OtaErrNone, OTA_SetImageState( OtaImageStateAborted ) );
 
     /* Process the event to abort the image and fail to update the job status. */
-    otaControlInterface.updateJobStatus = mockControlInterfaceUpdateJobAlwaysFail;
-    receiveAndProcessOtaEvent();
+    otaAgent.controlInterface.updateJobStatus = mockControlInterfaceUpdateJobAlwaysFail;
+    receiveAndProcessOtaEvent( &otaAgent );
 
     /* Test that the image state will be set regardless of whether or not the
      * job status was updated successfully. */
@@ -1259,7 +1557,7 @@ void test_OTA_ImageStateWithReasonPalFail()
 
     otaGoToState( OtaAgentStateReady );
     otaInterfaces.pal.setPlatformImageState = mockPalSetPlatformImageStateAlwaysFail;
-    error = setImageStateWithReason( stateToSet, OtaErrImageStateMismatch );
+    error = setImageStateWithReason( &otaAgent, stateToSet, OtaErrImageStateMismatch );
     TEST_ASSERT_EQUAL( OtaErrNoActiveJob, error );
 }
 
@@ -1283,23 +1581,23 @@ void test_OTA_RequestJobDocumentRetryFail()
     /* Place the OTA Agent into the state for requesting a job. */
     otaEvent.eventId = OtaAgentEventStart;
     OTA_SignalEvent( &otaEvent );
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateRequestingJob, OTA_GetState() );
 
     /* Fail the maximum number of attempts to request a job document. */
     for( i = 0U; i < otaconfigMAX_NUM_REQUEST_MOMENTUM; ++i )
     {
-        receiveAndProcessOtaEvent();
+        receiveAndProcessOtaEvent( &otaAgent );
         TEST_ASSERT_EQUAL( OtaAgentStateRequestingJob, OTA_GetState() );
     }
 
     /* Attempt to request another job document after failing the maximum number
      * of times, triggering a shutdown event. */
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateRequestingJob, OTA_GetState() );
 
     /* Shutdown after processing the shutdown event. */
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateStopped, OTA_GetState() );
 }
 
@@ -1311,7 +1609,7 @@ void test_OTA_ProcessJobDocumentInvalidJson()
     TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
 
     otaReceiveJobDocument();
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
 }
 
@@ -1328,7 +1626,7 @@ void test_OTA_ProcessJobDocumentInvalidBase64Key()
     TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
 
     otaReceiveJobDocument();
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
 }
 
@@ -1344,7 +1642,7 @@ void test_OTA_ProcessJobDocumentMissingRequiredKey()
     TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
 
     otaReceiveJobDocument();
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
 }
 
@@ -1357,7 +1655,7 @@ void test_OTA_RejectWhileAborted()
 
     otaInterfaces.pal.setPlatformImageState = mockPalSetPlatformImageStateAlwaysFail;
     otaReceiveJobDocument();
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
 
     /* Test that the OTA Agent is able to recover after failing to reject a job
      * due to already having aborted the job. It is not necessary for the call
@@ -1374,7 +1672,7 @@ void test_OTA_ProcessJobDocumentInvalidProtocol()
     TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
 
     otaReceiveJobDocument();
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateCreatingFile, OTA_GetState() );
 }
 
@@ -1386,7 +1684,7 @@ void test_OTA_ProcessJobDocumentValidJson()
     TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
 
     otaReceiveJobDocument();
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateCreatingFile, OTA_GetState() );
 }
 
@@ -1398,7 +1696,7 @@ void test_OTA_ProcessJobDocumentPalCreateFileFail()
     TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
 
     otaReceiveJobDocument();
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
 }
 
@@ -1411,7 +1709,7 @@ void test_OTA_ProcessJobDocumentBitmapMallocFail()
     TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
 
     otaReceiveJobDocument();
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaImageStateAborted, OTA_GetImageState() );
 }
 
@@ -1425,7 +1723,7 @@ void test_OTA_ProcessJobDocumentEventSendFail( void )
     otaReceiveJobDocument();
 
     otaInterfaces.os.event.send = mockOSEventSendAlwaysFail;
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
 }
 
@@ -1438,7 +1736,7 @@ static void otaInitFileTransfer()
 
     otaEvent.eventId = OtaAgentEventCreateFile;
     OTA_SignalEvent( &otaEvent );
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateRequestingFileBlock, OTA_GetState() );
 }
 
@@ -1476,23 +1774,23 @@ void test_OTA_InitFileTransferRetryFail()
     /* After receiving a valid job document, OTA agent should first transit to creating file state.
      * Then keep calling init file transfer until failed, which should then shutdown itself. */
     otaReceiveJobDocument();
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateCreatingFile, OTA_GetState() );
 
     /* Make the maximum number of failures based on the momentum parameter. */
     for( i = 0U; i < otaconfigMAX_NUM_REQUEST_MOMENTUM; ++i )
     {
-        receiveAndProcessOtaEvent();
+        receiveAndProcessOtaEvent( &otaAgent );
         TEST_ASSERT_EQUAL( OtaAgentStateCreatingFile, OTA_GetState() );
     }
 
     /* Make another attempt after already reaching the maximum number of
      * allowable attempts, which generates a shutdown event. */
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateCreatingFile, OTA_GetState() );
 
     /* Shutdown the OTA Agent after processing the event. */
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateStopped, OTA_GetState() );
 }
 
@@ -1505,7 +1803,7 @@ static void otaRequestFileBlock()
 
     otaEvent.eventId = OtaAgentEventRequestFileBlock;
     OTA_SignalEvent( &otaEvent );
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
 }
 
@@ -1544,9 +1842,9 @@ void test_OTA_RequestFileBlockTimerFails()
     /* Set the request timer to fail when attempting to start. */
     otaInterfaces.os.timer.start = mockOSTimerStartAlwaysFail;
     /* Process the event to request a block. */
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     /* Process the event to shut down. */
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateStopped, OTA_GetState() );
 }
 
@@ -1574,131 +1872,491 @@ void test_OTA_RequestFileBlockRetryFail()
 
     /* Receive the job document. */
     otaReceiveJobDocument();
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateCreatingFile, OTA_GetState() );
 
     /* Successfully initialize the file transfer. */
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateRequestingFileBlock, OTA_GetState() );
 
     /* Request a file block and fail the maximum number of times. */
     for( i = 0; i < otaconfigMAX_NUM_REQUEST_MOMENTUM; ++i )
     {
-        receiveAndProcessOtaEvent();
+        receiveAndProcessOtaEvent( &otaAgent );
         TEST_ASSERT_EQUAL( OtaAgentStateRequestingFileBlock, OTA_GetState() );
     }
 
     /* The timer triggers as we check for the number of attempts so far. The
      * number of attempts is at the maximum already so we also create a
      * shutdown event. */
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateRequestingFileBlock, OTA_GetState() );
 
     /* Process the timer event. */
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateRequestingFileBlock, OTA_GetState() );
 
     /* Process the shutdown event. */
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateStopped, OTA_GetState() );
 }
 
-void test_OTA_ReceiveFileBlockEmpty()
+void test_OTA_RequestTimeoutAdaptsToRoundTripTime()
 {
-    OtaEventMsg_t otaEvent = { 0 };
+    uint32_t i = 0;
+
+    otaGoToState( OtaAgentStateReady );
+
+    /* Without a time source the configured timeout is kept. */
+    adaptRequestTimeoutOnRequest( &otaAgent );
+    adaptRequestTimeoutOnBlock( &otaAgent );
+    TEST_ASSERT_EQUAL( otaconfigFILE_REQUEST_WAIT_MS, otaAgent.requestTimeoutMs );
+
+    otaInterfaces.os.timer.getTimeMs = mockOSGetTimeMs;
+
+    /* The first sample sets the round trip time and half of it as variation. The
+     * clock wraps around between the request and the block. */
+    mockTimeMs = UINT32_MAX - 99U;
+    adaptRequestTimeoutOnRequest( &otaAgent );
+    mockTimeMs = 300U;
+    adaptRequestTimeoutOnBlock( &otaAgent );
+    TEST_ASSERT_EQUAL( 400, otaAgent.smoothedRttMs );
+    TEST_ASSERT_EQUAL( 200, otaAgent.rttVariationMs );
+    TEST_ASSERT_EQUAL( 1200, otaAgent.requestTimeoutMs );
+
+    /* Only the first block after a request is a sample. */
+    mockTimeMs = 5000U;
+    adaptRequestTimeoutOnBlock( &otaAgent );
+    TEST_ASSERT_EQUAL( 400, otaAgent.smoothedRttMs );
+
+    /* Later samples are smoothed. */
+    adaptRequestTimeoutOnRequest( &otaAgent );
+    mockTimeMs += 80U;
+    adaptRequestTimeoutOnBlock( &otaAgent );
+    TEST_ASSERT_EQUAL( 360, otaAgent.smoothedRttMs );
+    TEST_ASSERT_EQUAL( 230, otaAgent.rttVariationMs );
+    TEST_ASSERT_EQUAL( 1280, otaAgent.requestTimeoutMs );
+
+    /* A steady fast link brings the timeout down to the lower bound. */
+    for( i = 0; i < 50U; i++ )
+    {
+        adaptRequestTimeoutOnRequest( &otaAgent );
+        mockTimeMs += 80U;
+        adaptRequestTimeoutOnBlock( &otaAgent );
+    }
+
+    TEST_ASSERT_EQUAL( otaconfigFILE_REQUEST_WAIT_MIN_MS, otaAgent.requestTimeoutMs );
+
+    /* Each request repeated after a timeout doubles the timeout up to the upper bound,
+     * and its response is not sampled. */
+    otaAgent.requestMomentum = 1;
+    adaptRequestTimeoutOnRequest( &otaAgent );
+    TEST_ASSERT_EQUAL( 2 * otaconfigFILE_REQUEST_WAIT_MIN_MS, otaAgent.requestTimeoutMs );
+
+    for( i = 0; i < 10U; i++ )
+    {
+        adaptRequestTimeoutOnRequest( &otaAgent );
+    }
+
+    TEST_ASSERT_EQUAL( otaconfigFILE_REQUEST_WAIT_MAX_MS, otaAgent.requestTimeoutMs );
+
+    mockTimeMs += 80U;
+    adaptRequestTimeoutOnBlock( &otaAgent );
+    TEST_ASSERT_EQUAL( otaconfigFILE_REQUEST_WAIT_MAX_MS, otaAgent.requestTimeoutMs );
+
+    /* The next request that is not a repeat samples the round trip time again. */
+    otaAgent.requestMomentum = 0;
+    adaptRequestTimeoutOnRequest( &otaAgent );
+    mockTimeMs += 80U;
+    adaptRequestTimeoutOnBlock( &otaAgent );
+    TEST_ASSERT_EQUAL( otaconfigFILE_REQUEST_WAIT_MIN_MS, otaAgent.requestTimeoutMs );
+}
 
+void test_OTA_RequestTimeoutShortensInEndgame()
+{
     otaGoToState( OtaAgentStateWaitingForFileBlock );
-    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
 
-    /* Set the event send interface to a mock function that allows events to be sent continuously.
-     * This is required because decode failure would cause OtaAgentEventCloseFile event to be sent
-     * within the OTA event handler and we want it to be processed. */
-    otaInterfaces.os.event.send = mockOSEventSend;
+    /* The whole test file fits in the endgame, so the request asks for exactly its blocks. */
+    TEST_ASSERT_EQUAL( OTA_TEST_FILE_NUM_BLOCKS, otaAgent.fileContext.blocksRemaining );
+    TEST_ASSERT_EQUAL( OTA_TEST_FILE_NUM_BLOCKS, otaAgent.numOfBlocksToReceive );
 
-    otaEvent.eventId = OtaAgentEventReceivedFileBlock;
-    otaEvent.pEventData = &eventBuffer;
-    otaEvent.pEventData->dataLength = 0;
-    OTA_SignalEvent( &otaEvent );
-    /* Process the event for receiving the block to trigger digesting it. */
-    receiveAndProcessOtaEvent();
+    /* Before the endgame the usual timeout is used. */
+    otaAgent.fileContext.blocksRemaining = otaconfigENDGAME_NUM_BLOCKS + 1U;
+    otaAgent.requestTimeoutMs = 4 * otaconfigFILE_REQUEST_WAIT_MIN_MS;
+    TEST_ASSERT_EQUAL( 4 * otaconfigFILE_REQUEST_WAIT_MIN_MS, fileBlockRequestTimeout( &otaAgent ) );
 
-    /* Process the event generated after failing to decode the block. The
-     * expected result is that we close the file and begin waiting for a new
-     * job document. */
-    receiveAndProcessOtaEvent();
-    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
+    /* In the endgame the timeout is halved, down to the lower bound. */
+    otaAgent.fileContext.blocksRemaining = otaconfigENDGAME_NUM_BLOCKS;
+    TEST_ASSERT_EQUAL( 2 * otaconfigFILE_REQUEST_WAIT_MIN_MS, fileBlockRequestTimeout( &otaAgent ) );
+
+    otaAgent.requestTimeoutMs = otaconfigFILE_REQUEST_WAIT_MIN_MS + 1U;
+    TEST_ASSERT_EQUAL( otaconfigFILE_REQUEST_WAIT_MIN_MS, fileBlockRequestTimeout( &otaAgent ) );
+
+    otaAgent.requestTimeoutMs = otaconfigFILE_REQUEST_WAIT_MIN_MS - 1U;
+    TEST_ASSERT_EQUAL( otaconfigFILE_REQUEST_WAIT_MIN_MS - 1U, fileBlockRequestTimeout( &otaAgent ) );
+
+    /* A single missing block is requested on its own. */
+    otaAgent.fileContext.blocksRemaining = 1U;
+    TEST_ASSERT_EQUAL( OtaErrNone, requestFileBlock_Mqtt( &otaAgent ) );
+    TEST_ASSERT_EQUAL( 1, otaAgent.numOfBlocksToReceive );
 }
 
-void test_OTA_ReceiveFileBlockTooLarge()
+void test_OTA_RequestBackoffJitter()
 {
-    OtaEventMsg_t otaEvent = { 0 };
+    OtaRequestBackoff_t backoff = { 0 };
+    uint32_t previousMs = 0;
+    uint32_t delayMs = 0;
+    uint32_t longestMs = 0;
+    uint32_t i = 0;
 
-    pOtaJobDoc = JOB_DOC_HTTP;
+    otaGoToState( OtaAgentStateReady );
 
-    otaGoToState( OtaAgentStateWaitingForFileBlock );
-    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+    /* Invalid backoffs are rejected. */
+    TEST_ASSERT_EQUAL( OtaErrInvalidArg, OTA_SetRequestBackoff( NULL ) );
+    backoff.baseMs = 0;
+    backoff.maxMs = 1000;
+    TEST_ASSERT_EQUAL( OtaErrInvalidArg, OTA_SetRequestBackoff( &backoff ) );
+    backoff.baseMs = 1001;
+    TEST_ASSERT_EQUAL( OtaErrInvalidArg, OTA_SetRequestBackoff( &backoff ) );
 
-    otaInterfaces.os.event.send = mockOSEventSend;
+    backoff.baseMs = 100;
+    TEST_ASSERT_EQUAL( OtaErrNone, OTA_SetRequestBackoff( &backoff ) );
 
-    otaEvent.eventId = OtaAgentEventReceivedFileBlock;
-    otaEvent.pEventData = &eventBuffer;
-    otaEvent.pEventData->dataLength = OTA_FILE_BLOCK_SIZE + 1;
-    OTA_SignalEvent( &otaEvent );
-    /* Process the event for receiving the block to trigger digesting it. */
-    receiveAndProcessOtaEvent();
-    /* Process the event generated after failing to decode the block. */
-    receiveAndProcessOtaEvent();
-    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
+    /* Each wait is between the base and three times the previous wait, up to the maximum. */
+    for( i = 0; i < 50U; i++ )
+    {
+        previousMs = ( otaAgent.retryDelayMs > 100U ) ? otaAgent.retryDelayMs : 100U;
+        delayMs = retryDelay( &otaAgent, 100 );
+
+        TEST_ASSERT_TRUE( delayMs >= 100U );
+        TEST_ASSERT_TRUE( delayMs <= 1000U );
+        TEST_ASSERT_TRUE( delayMs <= ( 3U * previousMs ) );
+
+        longestMs = ( delayMs > longestMs ) ? delayMs : longestMs;
+    }
+
+    /* The waits grow past the base. */
+    TEST_ASSERT_TRUE( longestMs > 300U );
+
+    /* A failed job request is retried after a wait drawn from the backoff. */
+    otaInterfaces.mqtt.subscribe = stubMqttSubscribeAlwaysFail;
+    otaInterfaces.os.timer.start = mockOSTimerStartRecordTimeout;
+    otaAgent.retryDelayMs = 0;
+    lastTimerTimeout = 0;
+    otaGoToState( OtaAgentStateWaitingForJob );
+    TEST_ASSERT_TRUE( otaAgent.retryDelayMs >= 100U );
+    TEST_ASSERT_TRUE( otaAgent.retryDelayMs <= 300U );
+    TEST_ASSERT_EQUAL( otaAgent.retryDelayMs, lastTimerTimeout );
 }
 
-void test_OTA_ReceiveLastFileBlockTooSmall()
+void test_OTA_JobStartDelay()
 {
+    OtaRequestBackoff_t backoff = { otaconfigREQUEST_BACKOFF_BASE_MS, otaconfigREQUEST_BACKOFF_MAX_MS, 500 };
     OtaEventMsg_t otaEvent = { 0 };
 
-    pOtaJobDoc = JOB_DOC_ONE_BLOCK;
-
-    otaGoToState( OtaAgentStateWaitingForFileBlock );
-    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+    otaGoToState( OtaAgentStateWaitingForJob );
+    TEST_ASSERT_EQUAL( OtaErrNone, OTA_SetRequestBackoff( &backoff ) );
 
     otaInterfaces.os.event.send = mockOSEventSend;
+    otaInterfaces.os.timer.start = mockOSTimerStartRecordTimeout;
 
-    otaEvent.eventId = OtaAgentEventReceivedFileBlock;
-    otaEvent.pEventData = &eventBuffer;
-    otaEvent.pEventData->dataLength = OTA_FILE_BLOCK_SIZE - 1;
+    /* A new job starts a random delay instead of creating the file right away. */
+    otaReceiveJobDocument();
+    receiveAndProcessOtaEvent( &otaAgent );
+    TEST_ASSERT_EQUAL( OtaAgentStateCreatingFile, OTA_GetState() );
+    TEST_ASSERT_EQUAL( 0, otaEventQueueEnd - otaEventQueue );
+    TEST_ASSERT_TRUE( ( lastTimerTimeout >= 1U ) && ( lastTimerTimeout <= 500U ) );
+
+    /* The file is created once the delay expires. */
+    otaEvent.eventId = OtaAgentEventRequestTimer;
     OTA_SignalEvent( &otaEvent );
-    /* Process the event to receive the invalid block. */
-    receiveAndProcessOtaEvent();
-    /* Process the event generated after receiving an invalid block. */
-    receiveAndProcessOtaEvent();
-    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
+    receiveAndProcessOtaEvent( &otaAgent );
+    TEST_ASSERT_EQUAL( OtaAgentStateRequestingFileBlock, OTA_GetState() );
 }
 
-void test_OTA_ReceiveFileBlockCompleteMqtt()
+void test_OTA_ProgressReportIntervals()
 {
-    OtaEventMsg_t otaEvent;
-    OtaEventData_t eventBuffers[ OTA_TEST_FILE_NUM_BLOCKS * OTA_TEST_DUPLICATE_NUM_BLOCKS ];
+    otaInterfaces.os.timer.getTimeMs = mockOSGetTimeMs;
+    mockTimeMs = 1000U;
+    otaGoToState( OtaAgentStateWaitingForFileBlock );
+    TEST_ASSERT_EQUAL( 1000U, otaAgent.progressReportTimeMs );
+
+    /* A step reached too soon after the last report is not reported on its own. */
+    otaAgent.fileContext.blocksRemaining = OTA_TEST_FILE_NUM_BLOCKS - 1U;
+    mockTimeMs += otaconfigPROGRESS_MIN_INTERVAL_MS - 1U;
+    TEST_ASSERT_FALSE( progressReportDue( &otaAgent ) );
+
+    /* The next block reports the latest progress. */
+    otaAgent.fileContext.blocksRemaining = OTA_TEST_FILE_NUM_BLOCKS - 2U;
+    mockTimeMs += 1U;
+    TEST_ASSERT_TRUE( progressReportDue( &otaAgent ) );
+    TEST_ASSERT_EQUAL( 200U / OTA_TEST_FILE_NUM_BLOCKS, otaAgent.progressReportPercent );
+
+    /* Without a new step the progress waits for the longest interval. */
+    mockTimeMs += otaconfigPROGRESS_MAX_INTERVAL_MS - 1U;
+    TEST_ASSERT_FALSE( progressReportDue( &otaAgent ) );
+    mockTimeMs += 1U;
+    TEST_ASSERT_TRUE( progressReportDue( &otaAgent ) );
+
+    /* Without a clock only the steps apply. */
+    otaInterfaces.os.timer.getTimeMs = NULL;
+    TEST_ASSERT_FALSE( progressReportDue( &otaAgent ) );
+    otaAgent.fileContext.blocksRemaining = 1U;
+    otaAgent.progressReportPercent = 0U;
+    TEST_ASSERT_TRUE( progressReportDue( &otaAgent ) );
+}
+
+void test_OTA_ProgressStatusDeferred()
+{
+    OtaEventMsg_t otaEvent = { 0 };
+    OtaEventData_t eventBuffer;
     uint8_t pFileBlock[ OTA_FILE_BLOCK_SIZE ] = { 0 };
     uint8_t pStreamingMessage[ OTA_FILE_BLOCK_SIZE * 2 ] = { 0 };
     size_t streamingMessageSize = 0;
-    int remainingBytes = OTA_TEST_FILE_SIZE;
-    int idx = 0;
-    int dupIdx = 0;
 
     otaGoToState( OtaAgentStateWaitingForFileBlock );
-    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+    otaInterfaces.os.event.send = mockOSEventSend;
+    otaAgent.controlInterface.updateJobStatus = mockControlInterfaceUpdateJobCountProgress;
+    progressUpdateCount = 0;
+
+    /* The block ends the request, so the next request is sent before the progress. */
+    otaAgent.numOfBlocksToReceive = 1;
+    createOtaStreamingMessage( pStreamingMessage,
+                               sizeof( pStreamingMessage ),
+                               0,
+                               pFileBlock,
+                               OTA_FILE_BLOCK_SIZE,
+                               &streamingMessageSize,
+                               true );
+    otaEvent.eventId = OtaAgentEventReceivedFileBlock;
+    otaEvent.pEventData = &eventBuffer;
+    memcpy( otaEvent.pEventData->data, pStreamingMessage, streamingMessageSize );
+    otaEvent.pEventData->dataLength = streamingMessageSize;
+    OTA_SignalEvent( &otaEvent );
+    receiveAndProcessOtaEvent( &otaAgent );
+    TEST_ASSERT_TRUE( otaAgent.progressStatusPending );
+    TEST_ASSERT_EQUAL( 0, progressUpdateCount );
 
-    /* Set the event send interface to a mock function that allows events to be sent continuously
-     * because we're receiving multiple blocks in this test. */
+    receiveAndProcessOtaEvent( &otaAgent );
+    TEST_ASSERT_FALSE( otaAgent.progressStatusPending );
+    TEST_ASSERT_EQUAL( 1, progressUpdateCount );
+
+    /* The idle hook publishes pending progress too. */
+    otaAgent.progressStatusPending = true;
+    agentIdleHook( &otaAgent );
+    TEST_ASSERT_EQUAL( 2, progressUpdateCount );
+
+    /* Progress of a file that is no longer received is dropped. */
+    otaAgent.progressStatusPending = true;
+    otaAgent.state = OtaAgentStateWaitingForJob;
+    agentIdleHook( &otaAgent );
+    TEST_ASSERT_FALSE( otaAgent.progressStatusPending );
+    TEST_ASSERT_EQUAL( 2, progressUpdateCount );
+}
+
+void test_OTA_ConnectionLossPausesRequests()
+{
+    OtaEventMsg_t otaEvent = { 0 };
+    uint32_t i = 0;
+
+    otaGoToState( OtaAgentStateWaitingForFileBlock );
     otaInterfaces.os.event.send = mockOSEventSend;
+    otaInterfaces.mqtt.subscribe = stubMqttSubscribeCount;
+    subscribeCount = 0;
 
-    /* Fill the file block. */
-    for( idx = 0; idx < ( int ) sizeof( pFileBlock ); idx++ )
+    /* Request timeouts are not charged while the connection is down. */
+    otaAgent.requestMomentum = 2;
+    TEST_ASSERT_EQUAL( OtaErrNone, OTA_NotifyConnectionState( OtaConnectionDown ) );
+
+    for( i = 0; i <= otaconfigMAX_NUM_REQUEST_MOMENTUM; i++ )
     {
-        pFileBlock[ idx ] = idx % UINT8_MAX;
+        otaEvent.eventId = OtaAgentEventRequestTimer;
+        OTA_SignalEvent( &otaEvent );
+        receiveAndProcessOtaEvent( &otaAgent );
     }
 
-    /* Send blocks. */
-    idx = 0;
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+    TEST_ASSERT_EQUAL( 2, otaAgent.requestMomentum );
+    TEST_ASSERT_EQUAL( 0, subscribeCount );
+
+    /* The missing blocks are requested right away once the connection is back, after the
+     * subscriptions are made again. The requests lost with the connection are not charged,
+     * so the request is neither backed off nor delayed. */
+    otaInterfaces.os.timer.start = mockOSTimerStartRecordTimeout;
+    otaAgent.retryDelayMs = 1000U;
+    lastTimerTimeout = 0;
+    TEST_ASSERT_EQUAL( OtaErrNone, OTA_NotifyConnectionState( OtaConnectionUp ) );
+    receiveAndProcessOtaEvent( &otaAgent );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+    TEST_ASSERT_EQUAL( 1, otaAgent.requestMomentum );
+    TEST_ASSERT_EQUAL( 0, otaAgent.retryDelayMs );
+    TEST_ASSERT_EQUAL( fileBlockRequestTimeout( &otaAgent ), lastTimerTimeout );
+    TEST_ASSERT_EQUAL( 2, subscribeCount );
+}
+
+/* Test that the job and file creation requests wait a random delay after the connection is back. */
+void test_OTA_ConnectionUpDelaysJobRequests()
+{
+    OtaRequestBackoff_t backoff = { 100, 1000, 500 };
+    OtaEventMsg_t otaEvent = { 0 };
+
+    otaGoToState( OtaAgentStateWaitingForJob );
+    TEST_ASSERT_EQUAL( OtaErrNone, OTA_SetRequestBackoff( &backoff ) );
+    otaInterfaces.os.event.send = mockOSEventSend;
+    otaInterfaces.os.timer.start = mockOSTimerStartRecordTimeout;
+    otaInterfaces.mqtt.subscribe = stubMqttSubscribeCount;
+    subscribeCount = 0;
+
+    /* The job is not requested at once, the request timer requests it after a random backoff. */
+    otaAgent.retryDelayMs = 0;
+    lastTimerTimeout = 0;
+    TEST_ASSERT_EQUAL( OtaErrNone, OTA_NotifyConnectionState( OtaConnectionDown ) );
+    TEST_ASSERT_EQUAL( OtaErrNone, OTA_NotifyConnectionState( OtaConnectionUp ) );
+    receiveAndProcessOtaEvent( &otaAgent );
+    TEST_ASSERT_EQUAL( OtaAgentStateRequestingJob, OTA_GetState() );
+    TEST_ASSERT_EQUAL( 0, otaEventQueueEnd - otaEventQueue );
+    TEST_ASSERT_EQUAL( 0, subscribeCount );
+    TEST_ASSERT_TRUE( ( lastTimerTimeout >= 100U ) && ( lastTimerTimeout <= 300U ) );
+
+    otaEvent.eventId = OtaAgentEventRequestTimer;
+    OTA_SignalEvent( &otaEvent );
+    receiveAndProcessOtaEvent( &otaAgent );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
+    TEST_ASSERT_TRUE( subscribeCount > 0U );
+
+    /* The file is created after a new job start delay. */
+    otaReceiveJobDocument();
+    receiveAndProcessOtaEvent( &otaAgent );
+    TEST_ASSERT_EQUAL( OtaAgentStateCreatingFile, OTA_GetState() );
+    lastTimerTimeout = 0;
+    TEST_ASSERT_EQUAL( OtaErrNone, OTA_NotifyConnectionState( OtaConnectionDown ) );
+    TEST_ASSERT_EQUAL( OtaErrNone, OTA_NotifyConnectionState( OtaConnectionUp ) );
+    receiveAndProcessOtaEvent( &otaAgent );
+    TEST_ASSERT_EQUAL( OtaAgentStateCreatingFile, OTA_GetState() );
+    TEST_ASSERT_EQUAL( 0, otaEventQueueEnd - otaEventQueue );
+    TEST_ASSERT_TRUE( ( lastTimerTimeout >= 1U ) && ( lastTimerTimeout <= 500U ) );
+
+    otaEvent.eventId = OtaAgentEventRequestTimer;
+    OTA_SignalEvent( &otaEvent );
+    receiveAndProcessOtaEvent( &otaAgent );
+    TEST_ASSERT_EQUAL( OtaAgentStateRequestingFileBlock, OTA_GetState() );
+
+    /* Without the timer the requests are sent right away. */
+    otaGoToState( OtaAgentStateWaitingForJob );
+    otaInterfaces.os.timer.start = mockOSTimerStartAlwaysFail;
+    TEST_ASSERT_EQUAL( OtaErrNone, OTA_NotifyConnectionState( OtaConnectionUp ) );
+    receiveAndProcessOtaEvent( &otaAgent );
+    TEST_ASSERT_EQUAL( OtaAgentStateRequestingJob, OTA_GetState() );
+    TEST_ASSERT_EQUAL( 1, otaEventQueueEnd - otaEventQueue );
+}
+
+/* Test that the connection up event is dropped in the states that do not hold back requests. */
+void test_OTA_ConnectionUpIgnoredWhenNotWaiting()
+{
+    otaGoToState( OtaAgentStateSuspended );
+    otaInterfaces.os.event.send = mockOSEventSend;
+
+    TEST_ASSERT_EQUAL( OtaErrNone, OTA_NotifyConnectionState( OtaConnectionUp ) );
+    receiveAndProcessOtaEvent( &otaAgent );
+    TEST_ASSERT_EQUAL( OtaAgentStateSuspended, OTA_GetState() );
+}
+
+void test_OTA_ReceiveFileBlockEmpty()
+{
+    OtaEventMsg_t otaEvent = { 0 };
+
+    otaGoToState( OtaAgentStateWaitingForFileBlock );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+    /* Set the event send interface to a mock function that allows events to be sent continuously.
+     * This is required because decode failure would cause OtaAgentEventCloseFile event to be sent
+     * within the OTA event handler and we want it to be processed. */
+    otaInterfaces.os.event.send = mockOSEventSend;
+
+    otaEvent.eventId = OtaAgentEventReceivedFileBlock;
+    otaEvent.pEventData = &eventBuffer;
+    otaEvent.pEventData->dataLength = 0;
+    OTA_SignalEvent( &otaEvent );
+    /* Process the event for receiving the block to trigger digesting it. */
+    receiveAndProcessOtaEvent( &otaAgent );
+
+    /* Process the event generated after failing to decode the block. The
+     * expected result is that we close the file and begin waiting for a new
+     * job document. */
+    receiveAndProcessOtaEvent( &otaAgent );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
+}
+
+void test_OTA_ReceiveFileBlockTooLarge()
+{
+    OtaEventMsg_t otaEvent = { 0 };
+
+    pOtaJobDoc = JOB_DOC_HTTP;
+
+    otaGoToState( OtaAgentStateWaitingForFileBlock );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+    otaInterfaces.os.event.send = mockOSEventSend;
+
+    otaEvent.eventId = OtaAgentEventReceivedFileBlock;
+    otaEvent.pEventData = &eventBuffer;
+    otaEvent.pEventData->dataLength = OTA_FILE_BLOCK_SIZE + 1;
+    OTA_SignalEvent( &otaEvent );
+    /* Process the event for receiving the block to trigger digesting it. */
+    receiveAndProcessOtaEvent( &otaAgent );
+    /* Process the event generated after failing to decode the block. */
+    receiveAndProcessOtaEvent( &otaAgent );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
+}
+
+void test_OTA_ReceiveLastFileBlockTooSmall()
+{
+    OtaEventMsg_t otaEvent = { 0 };
+
+    pOtaJobDoc = JOB_DOC_ONE_BLOCK;
+
+    otaGoToState( OtaAgentStateWaitingForFileBlock );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+    otaInterfaces.os.event.send = mockOSEventSend;
+
+    otaEvent.eventId = OtaAgentEventReceivedFileBlock;
+    otaEvent.pEventData = &eventBuffer;
+    otaEvent.pEventData->dataLength = OTA_FILE_BLOCK_SIZE - 1;
+    OTA_SignalEvent( &otaEvent );
+    /* Process the event to receive the invalid block. */
+    receiveAndProcessOtaEvent( &otaAgent );
+    /* Process the event generated after receiving an invalid block. */
+    receiveAndProcessOtaEvent( &otaAgent );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
+}
+
+void test_OTA_ReceiveFileBlockCompleteMqtt()
+{
+    OtaEventMsg_t otaEvent;
+    OtaEventData_t eventBuffers[ OTA_TEST_FILE_NUM_BLOCKS * OTA_TEST_DUPLICATE_NUM_BLOCKS ];
+    uint8_t pFileBlock[ OTA_FILE_BLOCK_SIZE ] = { 0 };
+    uint8_t pStreamingMessage[ OTA_FILE_BLOCK_SIZE * 2 ] = { 0 };
+    size_t streamingMessageSize = 0;
+    int remainingBytes = OTA_TEST_FILE_SIZE;
+    int idx = 0;
+    int dupIdx = 0;
+
+    otaGoToState( OtaAgentStateWaitingForFileBlock );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+    /* Set the event send interface to a mock function that allows events to be sent continuously
+     * because we're receiving multiple blocks in this test. */
+    otaInterfaces.os.event.send = mockOSEventSend;
+
+    /* Fill the file block. */
+    for( idx = 0; idx < ( int ) sizeof( pFileBlock ); idx++ )
+    {
+        pFileBlock[ idx ] = idx % UINT8_MAX;
+    }
+
+    /* Send blocks. */
+    idx = 0;
 
     while( remainingBytes >= 0 )
     {
@@ -1729,7 +2387,7 @@ void test_OTA_ReceiveFileBlockCompleteMqtt()
     /* Process all of the events for receiving an MQTT message. */
     processEntireQueue();
     /* OTA agent should complete the update and go back to waiting for job state. */
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
 
     /* Check if received complete file. */
@@ -1739,6 +2397,113 @@ void test_OTA_ReceiveFileBlockCompleteMqtt()
     }
 }
 
+void test_OTA_ReceiveFileBlockGapRequestedEarlyMqtt()
+{
+    OtaEventMsg_t otaEvent = { 0 };
+    OtaEventData_t eventBuffers[ OTA_TEST_FILE_NUM_BLOCKS ];
+    uint8_t pFileBlock[ OTA_FILE_BLOCK_SIZE ] = { 0 };
+    uint8_t pStreamingMessage[ OTA_FILE_BLOCK_SIZE * 2 ] = { 0 };
+    size_t streamingMessageSize = 0;
+    /* Block 1 is lost, then arrives after the early request. */
+    const uint32_t blockOrder[ OTA_TEST_FILE_NUM_BLOCKS ] = { 0, 2, 1 };
+    uint32_t blockSize = 0;
+    int idx = 0;
+
+    otaGoToState( OtaAgentStateWaitingForFileBlock );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+    otaInterfaces.os.event.send = mockOSEventSend;
+
+    for( idx = 0; idx < OTA_TEST_FILE_NUM_BLOCKS; idx++ )
+    {
+        blockSize = min( OTA_TEST_FILE_SIZE - ( blockOrder[ idx ] * OTA_FILE_BLOCK_SIZE ), OTA_FILE_BLOCK_SIZE );
+
+        createOtaStreamingMessage(
+            pStreamingMessage,
+            sizeof( pStreamingMessage ),
+            blockOrder[ idx ],
+            pFileBlock,
+            blockSize,
+            &streamingMessageSize,
+            true );
+
+        otaEvent.eventId = OtaAgentEventReceivedFileBlock;
+        otaEvent.pEventData = &eventBuffers[ idx ];
+        memcpy( otaEvent.pEventData->data, pStreamingMessage, streamingMessageSize );
+        otaEvent.pEventData->dataLength = streamingMessageSize;
+        OTA_SignalEvent( &otaEvent );
+        receiveAndProcessOtaEvent( &otaAgent );
+
+        if( idx == 0 )
+        {
+            /* More blocks are expected for this request. */
+            TEST_ASSERT_EQUAL( 0, otaEventQueueEnd - otaEventQueue );
+        }
+        else if( idx == 1 )
+        {
+            /* The block after the gap requests the missing block before all of
+             * the requested blocks are received. */
+            TEST_ASSERT_EQUAL( 1, otaEventQueueEnd - otaEventQueue );
+            TEST_ASSERT_EQUAL( OtaAgentEventRequestFileBlock, otaEventQueue[ 0 ].eventId );
+            TEST_ASSERT_EQUAL( 1, otaAgent.nextMissingBlock );
+
+            receiveAndProcessOtaEvent( &otaAgent );
+            TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+        }
+        else
+        {
+            /* The missing block completes the file. */
+            TEST_ASSERT_EQUAL( OTA_TEST_FILE_NUM_BLOCKS, otaAgent.nextMissingBlock );
+        }
+    }
+
+    processEntireQueue();
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
+}
+
+void test_OTA_ReceiveFileBlockGapRequestsOnlyMissingBlocksMqtt()
+{
+    OtaEventMsg_t otaEvent = { 0 };
+    OtaEventData_t eventBuffer = { 0 };
+    uint8_t pFileBlock[ OTA_FILE_BLOCK_SIZE ] = { 0 };
+    uint8_t pStreamingMessage[ OTA_FILE_BLOCK_SIZE * 2 ] = { 0 };
+    size_t streamingMessageSize = 0;
+    const uint32_t lastBlock = OTA_TEST_FILE_NUM_BLOCKS - 1;
+
+    otaGoToState( OtaAgentStateWaitingForFileBlock );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+    otaInterfaces.os.event.send = mockOSEventSend;
+
+    /* The last block arrives first, all the blocks before it are missing. */
+    createOtaStreamingMessage(
+        pStreamingMessage,
+        sizeof( pStreamingMessage ),
+        lastBlock,
+        pFileBlock,
+        OTA_TEST_FILE_SIZE - ( lastBlock * OTA_FILE_BLOCK_SIZE ),
+        &streamingMessageSize,
+        true );
+
+    otaEvent.eventId = OtaAgentEventReceivedFileBlock;
+    otaEvent.pEventData = &eventBuffer;
+    memcpy( otaEvent.pEventData->data, pStreamingMessage, streamingMessageSize );
+    otaEvent.pEventData->dataLength = streamingMessageSize;
+    OTA_SignalEvent( &otaEvent );
+    receiveAndProcessOtaEvent( &otaAgent );
+
+    TEST_ASSERT_EQUAL( 1, otaEventQueueEnd - otaEventQueue );
+    TEST_ASSERT_EQUAL( OtaAgentEventRequestFileBlock, otaEventQueue[ 0 ].eventId );
+    TEST_ASSERT_EQUAL( lastBlock, otaAgent.retransmitNumBlocks );
+
+    /* Out of the endgame, the request would otherwise ask for a full window. */
+    otaAgent.fileContext.blocksRemaining = otaconfigMAX_NUM_BLOCKS_REQUEST + otaconfigENDGAME_NUM_BLOCKS;
+    receiveAndProcessOtaEvent( &otaAgent );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+    TEST_ASSERT_EQUAL( lastBlock, otaAgent.numOfBlocksToReceive );
+    TEST_ASSERT_EQUAL( 0, otaAgent.retransmitNumBlocks );
+}
+
 void test_OTA_ReceiveFileBlockCompleteDynamicBufferMqtt()
 {
     memset( &pOtaAppBuffer, 0, sizeof( pOtaAppBuffer ) );
@@ -1783,9 +2548,9 @@ void test_OTA_ReceiveFileBlockMallocFail()
 
     /* Set malloc to fail and receive the block. */
     otaInterfaces.os.mem.malloc = mockMallocAlwaysFail;
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     /* Receive the event for closing the file after the failure. */
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
 }
 
@@ -1799,7 +2564,7 @@ void test_OTA_DroppedFileBlock()
     otaGoToState( OtaAgentStateWaitingForFileBlock );
     TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
     /* No blocks have been received or dropped yet. */
-    TEST_ASSERT_EQUAL( 0, otaAgent.statistics.otaPacketsDropped );
+    TEST_ASSERT_EQUAL( 0, otaStatistics().otaPacketsDropped );
 
 
     /* Prepare an event as if we are receiving a data block. */
@@ -1813,8 +2578,279 @@ void test_OTA_DroppedFileBlock()
     /* Simulate the application receiving a data block and failing to send it
      * to the OTA Agent. */
     TEST_ASSERT_EQUAL( false, OTA_SignalEvent( &otaEvent ) );
-    TEST_ASSERT_EQUAL( 1, otaAgent.statistics.otaPacketsDropped );
+    TEST_ASSERT_EQUAL( 1, otaStatistics().otaPacketsDropped );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+}
+
+void test_OTA_EventBufferPool()
+{
+    OtaEventData_t * pBuffers[ otaconfigEVENT_BUFFER_POOL_SIZE ] = { NULL };
+    OtaEventData_t * pBuffer = NULL;
+    uint32_t i = 0;
+
+    otaGoToState( OtaAgentStateReady );
+
+    /* Take every buffer in the pool. */
+    for( i = 0; i < otaconfigEVENT_BUFFER_POOL_SIZE; i++ )
+    {
+        pBuffers[ i ] = OTA_EventBufferGet();
+        TEST_ASSERT_NOT_NULL( pBuffers[ i ] );
+        TEST_ASSERT_TRUE( pBuffers[ i ]->bufferUsed );
+        TEST_ASSERT_EQUAL( 0, pBuffers[ i ]->dataLength );
+    }
+
+    /* The pool is exhausted. */
+    TEST_ASSERT_NULL( OTA_EventBufferGet() );
+    TEST_ASSERT_EQUAL( 1, otaStatistics().otaBuffersExhausted );
+
+    /* A retained buffer stays in use until every reference is released. */
+    OTA_EventBufferRetain( pBuffers[ 0 ] );
+    OTA_EventBufferRelease( pBuffers[ 0 ] );
+    TEST_ASSERT_TRUE( pBuffers[ 0 ]->bufferUsed );
+    TEST_ASSERT_NULL( OTA_EventBufferGet() );
+    TEST_ASSERT_EQUAL( 2, otaStatistics().otaBuffersExhausted );
+
+    OTA_EventBufferRelease( pBuffers[ 0 ] );
+    TEST_ASSERT_FALSE( pBuffers[ 0 ]->bufferUsed );
+    pBuffer = OTA_EventBufferGet();
+    TEST_ASSERT_EQUAL_PTR( pBuffers[ 0 ], pBuffer );
+
+    /* Buffers that are not from the pool and extra releases are ignored. */
+    OTA_EventBufferRetain( &eventBuffer );
+    OTA_EventBufferRelease( &eventBuffer );
+
+    for( i = 0; i < otaconfigEVENT_BUFFER_POOL_SIZE; i++ )
+    {
+        OTA_EventBufferRelease( pBuffers[ i ] );
+    }
+
+    OTA_EventBufferRelease( pBuffers[ 0 ] );
+    OTA_EventBufferRetain( pBuffers[ 0 ] );
+    TEST_ASSERT_FALSE( pBuffers[ 0 ]->bufferUsed );
+}
+
+void test_OTA_EventBufferReleasedAfterProcessing()
+{
+    OtaEventData_t * pBuffers[ otaconfigEVENT_BUFFER_POOL_SIZE ] = { NULL };
+    OtaEventMsg_t otaEvent = { 0 };
+    uint32_t i = 0;
+
+    otaInterfaces.os.event.send = mockOSEventSend;
+
+    otaGoToState( OtaAgentStateWaitingForFileBlock );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+    /* Hold every buffer of the pool, as if blocks were being received into them. */
+    for( i = 0; i < otaconfigEVENT_BUFFER_POOL_SIZE; i++ )
+    {
+        pBuffers[ i ] = OTA_EventBufferGet();
+        TEST_ASSERT_NOT_NULL( pBuffers[ i ] );
+    }
+
+    /* No buffer is free to receive more blocks into, so the request is held back. */
+    otaEvent.eventId = OtaAgentEventRequestTimer;
+    TEST_ASSERT_TRUE( OTA_SignalEvent( &otaEvent ) );
+    receiveAndProcessOtaEvent( &otaAgent );
+    TEST_ASSERT_EQUAL( 1, otaStatistics().otaRequestsDeferred );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+    /* Queue the (empty) blocks. The agent owns the buffers from here. */
+    otaEvent.eventId = OtaAgentEventReceivedFileBlock;
+
+    for( i = 0; i < otaconfigEVENT_BUFFER_POOL_SIZE; i++ )
+    {
+        otaEvent.pEventData = pBuffers[ i ];
+        TEST_ASSERT_TRUE( OTA_SignalEvent( &otaEvent ) );
+    }
+
+    processEntireQueue();
+
+    /* Processing the blocks released their buffers. */
+    for( i = 0; i < otaconfigEVENT_BUFFER_POOL_SIZE; i++ )
+    {
+        TEST_ASSERT_FALSE( pBuffers[ i ]->bufferUsed );
+    }
+}
+
+void test_OTA_ReceiveEventBatch()
+{
+    OtaEventMsg_t otaEvent = { 0 };
+
+    otaGoToState( OtaAgentStateReady );
+    TEST_ASSERT_EQUAL( OtaAgentStateReady, OTA_GetState() );
+
+    otaInterfaces.os.event.send = mockOSEventSend;
+    otaInterfaces.os.event.recvBatch = mockOSEventReceiveBatch;
+
+    otaEvent.eventId = OtaAgentEventSuspend;
+    TEST_ASSERT_TRUE( OTA_SignalEvent( &otaEvent ) );
+    otaEvent.eventId = OtaAgentEventResume;
+    TEST_ASSERT_TRUE( OTA_SignalEvent( &otaEvent ) );
+
+    /* Both events are processed in order after a single receive. */
+    receiveAndProcessOtaEvent( &otaAgent );
+    TEST_ASSERT_EQUAL( OtaAgentStateRequestingJob, OTA_GetState() );
+
+    /* Only the job document request signaled by the resume handler is left. */
+    TEST_ASSERT_EQUAL( 1, otaEventQueueEnd - otaEventQueue );
+    TEST_ASSERT_EQUAL( OtaAgentEventRequestJobDocument, otaEventQueue[ 0 ].eventId );
+}
+
+void test_OTA_ReceiveEventBatchEndsEarlyForControlEvent()
+{
+    OtaEventMsg_t otaEvent = { 0 };
+    OtaEventData_t * pBuffer = NULL;
+
+    otaGoToState( OtaAgentStateWaitingForFileBlock );
     TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+    otaInterfaces.os.event.send = mockOSEventSend;
+    otaInterfaces.os.event.recvBatch = mockOSEventReceiveBatchThenSuspend;
+
+    pBuffer = OTA_EventBufferGet();
+    TEST_ASSERT_NOT_NULL( pBuffer );
+    otaEvent.eventId = OtaAgentEventReceivedFileBlock;
+    otaEvent.pEventData = pBuffer;
+    TEST_ASSERT_TRUE( OTA_SignalEvent( &otaEvent ) );
+    otaEvent.eventId = OtaAgentEventRequestFileBlock;
+    otaEvent.pEventData = NULL;
+    TEST_ASSERT_TRUE( OTA_SignalEvent( &otaEvent ) );
+
+    /* The suspend signaled while the batch is processed ends it before its first event. */
+    suspendOnReceive = true;
+    receiveAndProcessOtaEvent( &otaAgent );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+    TEST_ASSERT_EQUAL( 2, otaAgent.numDeferredEvents );
+    TEST_ASSERT_EQUAL( 1, otaAgent.controlEventsPending );
+    TEST_ASSERT_TRUE( pBuffer->bufferUsed );
+
+    /* The suspend is waited for briefly and processed first, the deferred events after it. */
+    receiveAndProcessOtaEvent( &otaAgent );
+    TEST_ASSERT_EQUAL( 1, receiveTimeout );
+    TEST_ASSERT_EQUAL( OtaAgentStateSuspended, OTA_GetState() );
+    TEST_ASSERT_EQUAL( 0, otaAgent.numDeferredEvents );
+    TEST_ASSERT_EQUAL( 0, otaAgent.controlEventsPending );
+    TEST_ASSERT_EQUAL( 0, otaAgent.requestFileBlockPending );
+    TEST_ASSERT_FALSE( pBuffer->bufferUsed );
+    TEST_ASSERT_EQUAL( 0, otaEventQueueEnd - otaEventQueue );
+}
+
+void test_OTA_ReceiveEventTimeout()
+{
+    OtaEventMsg_t otaEvent = { 0 };
+    uint32_t packetsProcessed = 0;
+
+    otaGoToState( OtaAgentStateReady );
+    TEST_ASSERT_EQUAL( OtaAgentStateReady, OTA_GetState() );
+
+    otaInterfaces.os.event.send = mockOSEventSend;
+    otaInterfaces.os.event.recv = mockOSEventReceiveTimeout;
+    otaInterfaces.os.event.recvBatch = NULL;
+    receiveTimeout = UINT32_MAX;
+    packetsProcessed = otaStatistics().otaPacketsProcessed;
+
+    /* The agent waits for at most the idle period and nothing happens when it expires. */
+    receiveAndProcessOtaEvent( &otaAgent );
+    TEST_ASSERT_EQUAL( otaconfigAGENT_IDLE_PERIOD_MS, receiveTimeout );
+    TEST_ASSERT_EQUAL( OtaAgentStateReady, OTA_GetState() );
+    TEST_ASSERT_EQUAL( packetsProcessed, otaStatistics().otaPacketsProcessed );
+
+    /* Events are still processed as they arrive. */
+    otaEvent.eventId = OtaAgentEventSuspend;
+    TEST_ASSERT_TRUE( OTA_SignalEvent( &otaEvent ) );
+    receiveAndProcessOtaEvent( &otaAgent );
+    TEST_ASSERT_EQUAL( OtaAgentStateSuspended, OTA_GetState() );
+}
+
+void test_OTA_ReceiveEventBatchAfterShutdown()
+{
+    OtaEventMsg_t otaEvent = { 0 };
+    OtaEventData_t * pBuffer = NULL;
+
+    otaGoToState( OtaAgentStateWaitingForFileBlock );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+    otaInterfaces.os.event.send = mockOSEventSend;
+    otaInterfaces.os.event.recvBatch = mockOSEventReceiveBatch;
+
+    otaEvent.eventId = OtaAgentEventShutdown;
+    TEST_ASSERT_TRUE( OTA_SignalEvent( &otaEvent ) );
+
+    pBuffer = OTA_EventBufferGet();
+    TEST_ASSERT_NOT_NULL( pBuffer );
+    otaEvent.eventId = OtaAgentEventReceivedFileBlock;
+    otaEvent.pEventData = pBuffer;
+    TEST_ASSERT_TRUE( OTA_SignalEvent( &otaEvent ) );
+
+    /* The block batched behind the shutdown is dropped and its buffer released. */
+    receiveAndProcessOtaEvent( &otaAgent );
+    TEST_ASSERT_EQUAL( OtaAgentStateStopped, OTA_GetState() );
+    TEST_ASSERT_FALSE( pBuffer->bufferUsed );
+}
+
+void test_OTA_ShutdownReleasesQueuedBuffers()
+{
+    OtaEventMsg_t otaEvent = { 0 };
+    OtaEventData_t * pBuffer = NULL;
+
+    otaGoToState( OtaAgentStateWaitingForFileBlock );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+    otaInterfaces.os.event.send = mockOSEventSend;
+
+    otaEvent.eventId = OtaAgentEventShutdown;
+    TEST_ASSERT_TRUE( OTA_SignalEvent( &otaEvent ) );
+
+    pBuffer = OTA_EventBufferGet();
+    TEST_ASSERT_NOT_NULL( pBuffer );
+    otaEvent.eventId = OtaAgentEventReceivedFileBlock;
+    otaEvent.pEventData = pBuffer;
+    TEST_ASSERT_TRUE( OTA_SignalEvent( &otaEvent ) );
+
+    /* The block still queued behind the shutdown is drained and its buffer released. */
+    receiveAndProcessOtaEvent( &otaAgent );
+    TEST_ASSERT_EQUAL( OtaAgentStateStopped, OTA_GetState() );
+    TEST_ASSERT_EQUAL( 0, otaEventQueueEnd - otaEventQueue );
+    TEST_ASSERT_FALSE( pBuffer->bufferUsed );
+}
+
+void test_OTA_CoalesceRequestEvents()
+{
+    OtaEventMsg_t otaEvent = { 0 };
+
+    otaGoToState( OtaAgentStateWaitingForFileBlock );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+    otaInterfaces.os.event.send = mockOSEventSend;
+
+    /* Only the first of several block requests is queued. */
+    otaEvent.eventId = OtaAgentEventRequestFileBlock;
+    TEST_ASSERT_TRUE( OTA_SignalEvent( &otaEvent ) );
+    TEST_ASSERT_TRUE( OTA_SignalEvent( &otaEvent ) );
+
+    /* A timer expiry is redundant with the pending block request. */
+    otaEvent.eventId = OtaAgentEventRequestTimer;
+    TEST_ASSERT_TRUE( OTA_SignalEvent( &otaEvent ) );
+
+    TEST_ASSERT_EQUAL( 1, otaEventQueueEnd - otaEventQueue );
+    TEST_ASSERT_EQUAL( 2, otaStatistics().otaEventsCoalesced );
+
+    /* Once the request is received the next one is queued again. */
+    receiveAndProcessOtaEvent( &otaAgent );
+    TEST_ASSERT_EQUAL( 0, otaEventQueueEnd - otaEventQueue );
+    TEST_ASSERT_TRUE( OTA_SignalEvent( &otaEvent ) );
+    TEST_ASSERT_TRUE( OTA_SignalEvent( &otaEvent ) );
+    TEST_ASSERT_EQUAL( 1, otaEventQueueEnd - otaEventQueue );
+    TEST_ASSERT_EQUAL( 3, otaStatistics().otaEventsCoalesced );
+
+    /* An event that could not be queued is not left pending. */
+    receiveAndProcessOtaEvent( &otaAgent );
+    otaInterfaces.os.event.send = mockOSEventSendAlwaysFail;
+    TEST_ASSERT_FALSE( OTA_SignalEvent( &otaEvent ) );
+    otaInterfaces.os.event.send = mockOSEventSend;
+    TEST_ASSERT_TRUE( OTA_SignalEvent( &otaEvent ) );
+    TEST_ASSERT_EQUAL( 1, otaEventQueueEnd - otaEventQueue );
+    TEST_ASSERT_EQUAL( 3, otaStatistics().otaEventsCoalesced );
 }
 
 void test_OTA_ReceiveFileBlockCompleteHttp()
@@ -1917,8 +2953,8 @@ static void invokeSelfTestHandler()
     TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
 
     otaReceiveJobDocument();
-    receiveAndProcessOtaEvent();
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
+    receiveAndProcessOtaEvent( &otaAgent );
 }
 
 void test_OTA_SelfTestJob()
@@ -1940,7 +2976,7 @@ void test_OTA_SelfTestJobEventSendFail()
     otaReceiveJobDocument();
     otaInterfaces.os.event.send = mockOSEventSendAlwaysFail;
 
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
 }
 
@@ -1971,7 +3007,7 @@ void test_OTA_SelfTestJobDowngrade()
     TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
 
     otaReceiveJobDocument();
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( true, resetCalled );
 }
 
@@ -2002,7 +3038,7 @@ void test_OTA_ReceiveNewJobDocWhileInProgress()
     /* Sending another job document should cause OTA agent to abort current update. */
     pOtaJobDoc = JOB_DOC_B;
     otaReceiveJobDocument();
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateRequestingJob, OTA_GetState() );
 }
 
@@ -2024,21 +3060,21 @@ static void refreshWithJobDoc( const char * initJobDoc,
      * to request job doc again and transit to waiting for job state. */
     otaEvent.eventId = OtaAgentEventRequestJobDocument;
     OTA_SignalEvent( &otaEvent );
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
 
     /* Now send the new job doc, OTA agent should abort current job and start the new job. */
     pOtaJobDoc = newJobDoc;
     otaReceiveJobDocument();
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateCreatingFile, OTA_GetState() );
 
     /* Request file block. */
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateRequestingFileBlock, OTA_GetState() );
 
     /* Wait for the file block. */
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
 }
 
@@ -2068,7 +3104,7 @@ void test_OTA_UnexpectedEventReceiveJobDoc()
     otaEvent.eventId = OtaAgentEventReceivedJobDocument;
     OTA_SignalEvent( &otaEvent );
 
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateSuspended, OTA_GetState() );
 }
 
@@ -2082,7 +3118,7 @@ void test_OTA_UnexpectedEventReceiveFileBlock()
     otaEvent.eventId = OtaAgentEventReceivedFileBlock;
     OTA_SignalEvent( &otaEvent );
 
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateSuspended, OTA_GetState() );
 }
 
@@ -2096,7 +3132,7 @@ void test_OTA_UnexpectedEventOthers()
     otaEvent.eventId = OtaAgentEventStart;
     OTA_SignalEvent( &otaEvent );
 
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateSuspended, OTA_GetState() );
 }
 
@@ -2144,7 +3180,7 @@ void test_OTA_MQTT_CleanupFailed()
 
     otaEvent.eventId = OtaAgentEventShutdown;
     OTA_SignalEvent( &otaEvent );
-    receiveAndProcessOtaEvent();
+    receiveAndProcessOtaEvent( &otaAgent );
     TEST_ASSERT_EQUAL( OtaAgentStateStopped, OTA_GetState() );
 }
 
@@ -2160,7 +3196,11 @@ void test_OTA_MQTT_EncodingFailed()
     pFileContext->pRxBlockBitmap = NULL;
 
     err = requestFileBlock_Mqtt( &otaAgent );
-    TEST_ASSERT_EQUAL( OtaErrFailedToEncodeCbor, err );
+    #if ( otaconfigMQTT_JSON_STREAM_PAYLOAD == 1U )
+        TEST_ASSERT_EQUAL( OtaErrRequestFileBlockFailed, err );
+    #else
+        TEST_ASSERT_EQUAL( OtaErrFailedToEncodeCbor, err );
+    #endif
 }
 
 /* Test that requestFileBlock_Mqtt fails if the Publish fails. */
@@ -2174,6 +3214,102 @@ void test_OTA_MQTT_RequestFileFailed()
     TEST_ASSERT_EQUAL( OtaErrRequestFileBlockFailed, err );
 }
 
+/* Test that the MQTT topics are built when the file transfer starts and reused by requests. */
+void test_OTA_MQTT_TopicsCachedPerJob()
+{
+    char expectedTopic[ OTA_MQTT_TOPIC_MAX_SIZE ];
+
+    otaGoToState( OtaAgentStateWaitingForFileBlock );
+    otaInterfaces.mqtt.publish = stubMqttPublishRecordTopic;
+
+    ( void ) snprintf( expectedTopic, sizeof( expectedTopic ), "$aws/things/%s/streams/AFR_OTA-XYZ/get/cbor", pOtaDefaultClientId );
+    TEST_ASSERT_EQUAL_STRING( expectedTopic, otaAgent.mqttCache.pGetStreamTopic );
+    TEST_ASSERT_TRUE( otaAgent.mqttCache.streamRequestPrefixLen > 0U );
+
+    ( void ) snprintf( expectedTopic, sizeof( expectedTopic ), "$aws/things/%s/jobs/AFR_OTA-testjob20/update", pOtaDefaultClientId );
+    TEST_ASSERT_EQUAL_STRING( expectedTopic, otaAgent.mqttCache.pJobStatusTopic );
+
+    /* Requests and status updates publish to the cached topics. */
+    TEST_ASSERT_EQUAL( OtaErrNone, requestFileBlock_Mqtt( &otaAgent ) );
+    TEST_ASSERT_EQUAL_PTR( otaAgent.mqttCache.pGetStreamTopic, pLastPublishTopic );
+
+    TEST_ASSERT_EQUAL( OtaErrNone, updateJobStatus_Mqtt( &otaAgent, JobStatusInProgress, JobReasonReceiving, 0 ) );
+    TEST_ASSERT_EQUAL_PTR( otaAgent.mqttCache.pJobStatusTopic, pLastPublishTopic );
+
+    /* The job status topic follows the active job. */
+    ( void ) strcpy( ( char * ) otaAgent.pActiveJobName, "AFR_OTA-testjob21" );
+    TEST_ASSERT_EQUAL( OtaErrNone, updateJobStatus_Mqtt( &otaAgent, JobStatusInProgress, JobReasonReceiving, 0 ) );
+    ( void ) snprintf( expectedTopic, sizeof( expectedTopic ), "$aws/things/%s/jobs/AFR_OTA-testjob21/update", pOtaDefaultClientId );
+    TEST_ASSERT_EQUAL_STRING( expectedTopic, pLastPublishTopic );
+}
+
+/* Test that topics are subscribed once per connection. */
+void test_OTA_MQTT_SubscriptionsCachedPerConnection()
+{
+    otaInitDefault();
+    otaInterfaces.mqtt.subscribe = stubMqttSubscribeCount;
+    subscribeCount = 0;
+
+    /* Job requests subscribe to the job notification topic once. */
+    TEST_ASSERT_EQUAL( OtaErrNone, requestJob_Mqtt( &otaAgent ) );
+    TEST_ASSERT_EQUAL( OtaErrNone, requestJob_Mqtt( &otaAgent ) );
+    TEST_ASSERT_EQUAL( 1, subscribeCount );
+
+    /* Files of the same stream subscribe to the data stream topic once, unless the closed
+     * files unsubscribe from it. */
+    otaAgent.unsubscribeOnShutdown = 0;
+    TEST_ASSERT_EQUAL( OtaErrNone, initFileTransfer_Mqtt( &otaAgent ) );
+    TEST_ASSERT_EQUAL( OtaErrNone, initFileTransfer_Mqtt( &otaAgent ) );
+    TEST_ASSERT_EQUAL( 2, subscribeCount );
+    otaAgent.unsubscribeOnShutdown = 1;
+    TEST_ASSERT_EQUAL( OtaErrNone, initFileTransfer_Mqtt( &otaAgent ) );
+    TEST_ASSERT_EQUAL( 3, subscribeCount );
+
+    /* A new connection needs new subscriptions. */
+    TEST_ASSERT_EQUAL( OtaErrNone, OTA_NotifyConnectionState( OtaConnectionDown ) );
+    TEST_ASSERT_EQUAL( OtaErrNone, OTA_NotifyConnectionState( OtaConnectionUp ) );
+    TEST_ASSERT_EQUAL( OtaErrNone, requestJob_Mqtt( &otaAgent ) );
+    TEST_ASSERT_EQUAL( OtaErrNone, initFileTransfer_Mqtt( &otaAgent ) );
+    TEST_ASSERT_EQUAL( 5, subscribeCount );
+
+    /* A new run of the agent starts without subscriptions, and topics that are not
+     * subscribed are not unsubscribed. */
+    otaDeinit();
+    otaInitDefault();
+    TEST_ASSERT_FALSE( otaAgent.mqttCache.jobTopicsSubscribed );
+    TEST_ASSERT_EQUAL( 0, otaAgent.mqttCache.dataStreamTopicLen );
+    otaInterfaces.mqtt.unsubscribe = stubMqttUnsubscribeAlwaysFail;
+    TEST_ASSERT_EQUAL( OtaErrNone, cleanupControl_Mqtt( &otaAgent ) );
+    TEST_ASSERT_EQUAL( OtaErrNone, cleanupData_Mqtt( &otaAgent ) );
+
+    TEST_ASSERT_EQUAL( OtaErrInvalidArg, OTA_NotifyConnectionState( ( OtaConnectionState_t ) 2 ) );
+}
+
+/* Test that each agent context builds its own topics and counts its own job requests. */
+void test_OTA_MQTT_JobRequestsPerContext()
+{
+    static OtaAgentContext_t otherAgent;
+    char expectedTopic[ OTA_MQTT_TOPIC_MAX_SIZE ];
+
+    otaInitDefault();
+    otaInterfaces.mqtt.subscribe = stubMqttSubscribeCount;
+
+    ( void ) memcpy( &otherAgent, &otaAgent, sizeof( otherAgent ) );
+    ( void ) memset( &otherAgent.mqttCache, 0, sizeof( otherAgent.mqttCache ) );
+    ( void ) strcpy( ( char * ) otherAgent.pThingName, "otherThing" );
+
+    TEST_ASSERT_EQUAL( OtaErrNone, requestJob_Mqtt( &otaAgent ) );
+    TEST_ASSERT_EQUAL( OtaErrNone, requestJob_Mqtt( &otherAgent ) );
+    TEST_ASSERT_EQUAL( OtaErrNone, requestJob_Mqtt( &otaAgent ) );
+
+    TEST_ASSERT_EQUAL( 2, otaAgent.mqttCache.jobRequestCounter );
+    TEST_ASSERT_EQUAL( 1, otherAgent.mqttCache.jobRequestCounter );
+
+    ( void ) snprintf( expectedTopic, sizeof( expectedTopic ), "$aws/things/%s/jobs/notify-next", pOtaDefaultClientId );
+    TEST_ASSERT_EQUAL_STRING( expectedTopic, otaAgent.mqttCache.pJobNotifyTopic );
+    TEST_ASSERT_EQUAL_STRING( "$aws/things/otherThing/jobs/notify-next", otherAgent.mqttCache.pJobNotifyTopic );
+}
+
 /* Test that requestJob_Mqtt fails if the Subscribe fails. */
 void test_OTA_MQTT_JobSubscribingFailed()
 {
@@ -2207,6 +3343,90 @@ void test_OTA_MQTT_UpdateStatusFailed()
     TEST_ASSERT_EQUAL( OtaErrUpdateJobStatusFailed, err );
 }
 
+/* Test that decodeFileBlockJson_Mqtt decodes a JSON stream response in one pass. */
+void test_OTA_MQTT_DecodeFileBlockJson()
+{
+    static const char message[] = "{ \"f\":2,\"i\": 17 ,\"c\":\"rdy\",\"l\":5,\"x\":true,\"p\":\"aGVsbG8=\" }";
+    uint8_t decodeMem[ 8 ] = { 0 };
+    uint8_t * pPayload = decodeMem;
+    size_t payloadSize = sizeof( decodeMem );
+    int32_t fileId = -1;
+    int32_t blockId = -1;
+    int32_t blockSize = -1;
+    OtaErr_t err = OtaErrUninitialized;
+
+    err = decodeFileBlockJson_Mqtt( &otaAgent, ( const uint8_t * ) message, strlen( message ),
+                                    &fileId, &blockId, &blockSize, &pPayload, &payloadSize );
+
+    TEST_ASSERT_EQUAL( OtaErrNone, err );
+    TEST_ASSERT_EQUAL( 2, fileId );
+    TEST_ASSERT_EQUAL( 17, blockId );
+    TEST_ASSERT_EQUAL( 5, blockSize );
+    TEST_ASSERT_EQUAL( decodeMem, pPayload );
+    TEST_ASSERT_EQUAL( 5, payloadSize );
+    TEST_ASSERT_EQUAL_MEMORY( "hello", decodeMem, 5 );
+}
+
+/* Test that decodeFileBlockJson_Mqtt resolves the escapes in the Base64 payload. */
+void test_OTA_MQTT_DecodeFileBlockJsonEscapedPayload()
+{
+    static const char message[] = "{\"f\":2,\"c\":\"r\\\"dy\",\"i\":17,\"l\":7,\"p\":\"\\u0061GVsbG8\\/Pw\\n==\"}";
+    uint8_t decodeMem[ 8 ] = { 0 };
+    uint8_t * pPayload = decodeMem;
+    size_t payloadSize = sizeof( decodeMem );
+    int32_t fileId = -1;
+    int32_t blockId = -1;
+    int32_t blockSize = -1;
+    OtaErr_t err = OtaErrUninitialized;
+
+    err = decodeFileBlockJson_Mqtt( &otaAgent, ( const uint8_t * ) message, strlen( message ),
+                                    &fileId, &blockId, &blockSize, &pPayload, &payloadSize );
+
+    TEST_ASSERT_EQUAL( OtaErrNone, err );
+    TEST_ASSERT_EQUAL( 17, blockId );
+    TEST_ASSERT_EQUAL( 7, payloadSize );
+    TEST_ASSERT_EQUAL_MEMORY( "hello??", decodeMem, 7 );
+}
+
+/* Test that decodeFileBlockJson_Mqtt rejects malformed and incomplete stream responses. */
+void test_OTA_MQTT_DecodeFileBlockJsonInvalid()
+{
+    static const char * messages[] =
+    {
+        "",
+        "[1]",
+        "{\"f\":2,\"i\":1,\"l\":5}",                                    /* Missing payload. */
+        "{\"f\":2,\"i\":1,\"l\":5,\"p\":5}",                            /* Payload is not a string. */
+        "{\"f\":2,\"i\":1,\"l\":5,\"p\":\"aGVs*G8=\"}",                 /* Invalid Base64. */
+        "{\"f\":2,\"i\":1,\"l\":5,\"p\":\"aGVsbG8gd29ybGQ=\"}",         /* Payload larger than the buffer. */
+        "{\"f\":-2,\"i\":1,\"l\":5,\"p\":\"aGVsbG8=\"}",                /* Negative field. */
+        "{\"f\":2147483648,\"i\":1,\"l\":5,\"p\":\"aGVsbG8=\"}",        /* Field exceeds 31 bits. */
+        "{\"f\":2,\"f\":3,\"i\":1,\"l\":5,\"p\":\"aGVsbG8=\"}",         /* Duplicate field. */
+        "{\"f\":2,\"i\":1,\"l\":5,\"x\":{},\"p\":\"aGVsbG8=\"}",        /* Nested value. */
+        "{\"f\":2,\"i\":1,\"l\":5,\"p\":\"aGVs\\xG8=\"}",               /* Unknown escape. */
+        "{\"f\":2,\"i\":1,\"l\":5,\"p\":\"aGVs\\u00e9G8=\"}",           /* Escaped symbol is not Base64. */
+        "{\"f\":2,\"i\":1,\"l\":5,\"p\":\"aGVs\\u00G8=\"}",             /* Truncated escape. */
+        "{\"f\":2,\"i\":1,\"l\":5,\"p\":\"aGU=\\/G8=\"}",               /* Symbols after the padding. */
+        "{\"f\":2,\"i\":1,\"l\":5,\"p\":\"aGVsbG8=\",}",                /* Trailing comma. */
+        "{\"f\":2,\"i\":1,\"l\":5,\"p\":\"aGVsbG8=\""                   /* Unterminated object. */
+    };
+    uint8_t decodeMem[ 8 ] = { 0 };
+    uint8_t * pPayload = decodeMem;
+    size_t payloadSize = 0;
+    int32_t fileId = 0;
+    int32_t blockId = 0;
+    int32_t blockSize = 0;
+    size_t i;
+
+    for( i = 0; i < ( sizeof( messages ) / sizeof( messages[ 0 ] ) ); i++ )
+    {
+        payloadSize = sizeof( decodeMem );
+        TEST_ASSERT_EQUAL( OtaErrFailedToDecodeJson,
+                           decodeFileBlockJson_Mqtt( &otaAgent, ( const uint8_t * ) messages[ i ], strlen( messages[ i ] ),
+                                                     &fileId, &blockId, &blockSize, &pPayload, &payloadSize ) );
+    }
+}
+
 /* Test data cleanup fails with HTTP deinit failure*/
 void test_OTA_HTTP_cleanupFailed()
 {
@@ -2299,7 +3519,10 @@ void test_OTA_Err_strerror( void )
     err = OtaErrActivateFailed;
     str = OTA_Err_strerror( err );
     TEST_ASSERT_EQUAL_STRING( "OtaErrActivateFailed", str );
-    err = OtaErrActivateFailed + 1;
+    err = OtaErrFailedToDecodeJson;
+    str = OTA_Err_strerror( err );
+    TEST_ASSERT_EQUAL_STRING( "OtaErrFailedToDecodeJson", str );
+    err = OtaErrFailedToDecodeJson + 1;
     str = OTA_Err_strerror( err );
     TEST_ASSERT_EQUAL_STRING( "InvalidErrorCode", str );
 }
@@ -2342,7 +3565,13 @@ void test_OTA_OsStatus_strerror( void )
     status = OtaOsTimerDeleteFailed;
     str = OTA_OsStatus_strerror( status );
     TEST_ASSERT_EQUAL_STRING( "OtaOsTimerDeleteFailed", str );
-    status = OtaOsTimerDeleteFailed + 1;
+    status = OtaOsShutdownWaitFailed;
+    str = OTA_OsStatus_strerror( status );
+    TEST_ASSERT_EQUAL_STRING( "OtaOsShutdownWaitFailed", str );
+    status = OtaOsEventQueueReceiveTimeout;
+    str = OTA_OsStatus_strerror( status );
+    TEST_ASSERT_EQUAL_STRING( "OtaOsEventQueueReceiveTimeout", str );
+    status = OtaOsEventQueueReceiveTimeout + 1;
     str = OTA_OsStatus_strerror( status );
     TEST_ASSERT_EQUAL_STRING( "InvalidErrorCode", str );
 }
@@ -2513,11 +3742,11 @@ void test_OTA_initFileHandler_TimerFails( void )
     /* Initialize the OTA interfaces so they are not NULL. */
     otaGoToState( OtaAgentStateReady );
     /* Fail to initialize the file transfer so the timer is started. */
-    otaDataInterface.initFileTransfer = mockDataInterfaceInitFileTransferAlwaysFail;
+    otaAgent.dataInterface.initFileTransfer = mockDataInterfaceInitFileTransferAlwaysFail;
     /* Fail to start the timer. */
     otaInterfaces.os.timer.start = mockOSTimerStartAlwaysFail;
 
-    TEST_ASSERT_EQUAL( OtaErrInitFileTransferFailed, initFileHandler( otaEvent.pEventData ) );
+    TEST_ASSERT_EQUAL( OtaErrInitFileTransferFailed, initFileHandler( &otaAgent, otaEvent.pEventData ) );
 }
 
 /**
@@ -2534,7 +3763,7 @@ void test_OTA_initFileHandler_EventSendFails( void )
     /* Test failing while trying to send the shutdown event after failing
      * to initialize the file. */
     /* Fail to initialize the file transfer so the timer is started. */
-    otaDataInterface.initFileTransfer = mockDataInterfaceInitFileTransferAlwaysFail;
+    otaAgent.dataInterface.initFileTransfer = mockDataInterfaceInitFileTransferAlwaysFail;
 
     /* Simulate reaching the maximum number of attempts before considering
      * the attempt to be a failure. */
@@ -2542,18 +3771,18 @@ void test_OTA_initFileHandler_EventSendFails( void )
     /* Fail to send the OTA event. */
     otaInterfaces.os.event.send = mockOSEventSendAlwaysFail;
 
-    TEST_ASSERT_EQUAL( OtaErrSignalEventFailed, initFileHandler( otaEvent.pEventData ) );
+    TEST_ASSERT_EQUAL( OtaErrSignalEventFailed, initFileHandler( &otaAgent, otaEvent.pEventData ) );
 
     /* Test failing while trying to send the request block event after
      * successfully initializing the file. */
 
     /* Succeed with the file initialization to then attempt to send the event
      * for requesting a block. */
-    otaDataInterface.initFileTransfer = mockDataInitFileTransferAlwaysSucceed;
+    otaAgent.dataInterface.initFileTransfer = mockDataInitFileTransferAlwaysSucceed;
     /* Fail to send the OTA event. */
     otaInterfaces.os.event.send = mockOSEventSendAlwaysFail;
 
-    TEST_ASSERT_EQUAL( OtaErrSignalEventFailed, initFileHandler( otaEvent.pEventData ) );
+    TEST_ASSERT_EQUAL( OtaErrSignalEventFailed, initFileHandler( &otaAgent, otaEvent.pEventData ) );
 }
 
 /**
@@ -2577,7 +3806,7 @@ void test_OTA_requestDataHandler_EventSendFails( void )
     /* Fail to send the OTA event. */
     otaInterfaces.os.event.send = mockOSEventSendAlwaysFail;
 
-    TEST_ASSERT_EQUAL( OtaErrSignalEventFailed, requestDataHandler( otaEvent.pEventData ) );
+    TEST_ASSERT_EQUAL( OtaErrSignalEventFailed, requestDataHandler( &otaAgent, otaEvent.pEventData ) );
 }
 
 /**
@@ -2592,11 +3821,11 @@ void test_OTA_requestJobHandler_TimerFails( void )
     otaGoToState( OtaAgentStateReady );
 
     /* Fail requesting the job document. */
-    otaControlInterface.requestJob = mockControlInterfaceRequestJobAlwaysFail;
+    otaAgent.controlInterface.requestJob = mockControlInterfaceRequestJobAlwaysFail;
     /* Fail to start the request timer. */
     otaInterfaces.os.timer.start = mockOSTimerStartAlwaysFail;
 
-    TEST_ASSERT_EQUAL( OtaErrRequestJobFailed, requestJobHandler( otaEvent.pEventData ) );
+    TEST_ASSERT_EQUAL( OtaErrRequestJobFailed, requestJobHandler( &otaAgent, otaEvent.pEventData ) );
 }
 
 /**
@@ -2611,7 +3840,7 @@ void test_OTA_requestJobHandler_EventSendFails( void )
     otaGoToState( OtaAgentStateReady );
 
     /* Fail requesting the job document. */
-    otaControlInterface.requestJob = mockControlInterfaceRequestJobAlwaysFail;
+    otaAgent.controlInterface.requestJob = mockControlInterfaceRequestJobAlwaysFail;
 
     /* Simulate reaching the maximum number of attempts before considering
      * the attempt to be a failure. */
@@ -2619,7 +3848,7 @@ void test_OTA_requestJobHandler_EventSendFails( void )
     /* Fail to send the OTA event. */
     otaInterfaces.os.event.send = mockOSEventSendAlwaysFail;
 
-    TEST_ASSERT_EQUAL( OtaErrSignalEventFailed, requestJobHandler( otaEvent.pEventData ) );
+    TEST_ASSERT_EQUAL( OtaErrSignalEventFailed, requestJobHandler( &otaAgent, otaEvent.pEventData ) );
 }
 
 /**
@@ -2634,7 +3863,7 @@ void test_OTA_processDataHandler_InvalidEvent( void )
      * The expected return is OtaErrNone because the error return value of this
      * handler represents the success of updating the job document when there
      * is an issue processing the block. */
-    TEST_ASSERT_EQUAL( OtaErrNone, processDataHandler( NULL ) );
+    TEST_ASSERT_EQUAL( OtaErrNone, processDataHandler( &otaAgent, NULL ) );
 }
 
 /**
@@ -2649,7 +3878,7 @@ void test_OTA_resumeHandler_EventSendFails()
     /* Fail to send the OTA event. */
     otaInterfaces.os.event.send = mockOSEventSendAlwaysFail;
 
-    TEST_ASSERT_EQUAL( OtaErrSignalEventFailed, resumeHandler( NULL ) );
+    TEST_ASSERT_EQUAL( OtaErrSignalEventFailed, resumeHandler( &otaAgent, NULL ) );
 }
 
 void test_OTA_jobNotificationHandler_EventSendFails()
@@ -2659,7 +3888,7 @@ void test_OTA_jobNotificationHandler_EventSendFails()
 
     otaInterfaces.os.event.send = mockOSEventSendAlwaysFail;
 
-    TEST_ASSERT_EQUAL( OtaErrSignalEventFailed, jobNotificationHandler( NULL ) );
+    TEST_ASSERT_EQUAL( OtaErrSignalEventFailed, jobNotificationHandler( &otaAgent, NULL ) );
 }
 
 /**
@@ -2670,16 +3899,16 @@ void test_OTA_shutdownHandler_NullInterface()
 {
     otaGoToState( OtaAgentStateReady );
 
-    otaDataInterface.cleanup = NULL;
-    otaDataInterface.decodeFileBlock = NULL;
-    otaDataInterface.initFileTransfer = NULL;
-    otaDataInterface.requestFileBlock = NULL;
+    otaAgent.dataInterface.cleanup = NULL;
+    otaAgent.dataInterface.decodeFileBlock = NULL;
+    otaAgent.dataInterface.initFileTransfer = NULL;
+    otaAgent.dataInterface.requestFileBlock = NULL;
 
-    otaControlInterface.cleanup = NULL;
-    otaControlInterface.requestJob = NULL;
-    otaControlInterface.updateJobStatus = NULL;
+    otaAgent.controlInterface.cleanup = NULL;
+    otaAgent.controlInterface.requestJob = NULL;
+    otaAgent.controlInterface.updateJobStatus = NULL;
 
-    TEST_ASSERT_EQUAL( OtaErrNone, shutdownHandler( NULL ) );
+    TEST_ASSERT_EQUAL( OtaErrNone, shutdownHandler( &otaAgent, NULL ) );
 }
 
 /* ========================================================================== */
@@ -2784,3 +4013,49 @@ void test_OTA_validateDataBlockInputSize()
     /* Block size is larger than the expected size. */
     TEST_ASSERT_EQUAL( false, validateDataBlock( &fileContext, 0, OTA_FILE_BLOCK_SIZE + 1 ) );
 }
+
+void test_OTA_searchTransition_MatchesTransitionTable()
+{
+    OtaEventMsg_t eventMsg = { 0 };
+    OtaState_t savedState;
+    uint32_t state = 0;
+    uint32_t event = 0;
+    uint32_t expected = 0;
+
+    /* The dispatch table is built by OTA_Init. */
+    otaInitDefault();
+    savedState = otaAgent.state;
+
+    /* An out of range state has no transition and returns the table length. */
+    otaAgent.state = OtaAgentStateAll;
+    eventMsg.eventId = OtaAgentEventStart;
+    TEST_ASSERT_EQUAL( otaTransitionTableLength, searchTransition( &otaAgent, &eventMsg ) );
+
+    for( state = 0; state < OtaAgentStateAll; state++ )
+    {
+        for( event = 0; event < OtaAgentEventMax; event++ )
+        {
+            /* Linear search of the transition table. */
+            for( expected = 0; expected < otaTransitionTableLength; expected++ )
+            {
+                if( ( ( otaTransitionTable[ expected ].currentState == ( OtaState_t ) state ) ||
+                      ( otaTransitionTable[ expected ].currentState == OtaAgentStateAll ) ) &&
+                    ( otaTransitionTable[ expected ].eventId == ( OtaEvent_t ) event ) )
+                {
+                    break;
+                }
+            }
+
+            otaAgent.state = ( OtaState_t ) state;
+            eventMsg.eventId = ( OtaEvent_t ) event;
+            TEST_ASSERT_EQUAL( expected, searchTransition( &otaAgent, &eventMsg ) );
+        }
+    }
+
+    /* Out of range events have no transition either. */
+    otaAgent.state = OtaAgentStateReady;
+    eventMsg.eventId = OtaAgentEventMax;
+    TEST_ASSERT_EQUAL( otaTransitionTableLength, searchTransition( &otaAgent, &eventMsg ) );
+
+    otaAgent.state = savedState;
+}